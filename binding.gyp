@@ -13,7 +13,7 @@
       "defines": [ "NAPI_DISABLE_CPP_EXCEPTIONS" ],
       "conditions": [
         [ 'OS=="win"', {
-          "libraries": [ "<(module_root_dir)/native/bin/windows/portaudio.lib" ],
+          "libraries": [ "<(module_root_dir)/native/bin/windows/portaudio.lib", "avrt.lib", "ole32.lib" ],
           "copies": [
             {
               "files": [ "<(module_root_dir)/native/bin/windows/portaudio.dll" ],
@@ -22,7 +22,7 @@
           ]
         }],
         [ 'OS=="mac"', {
-          "libraries": [ "<(module_root_dir)/native/bin/macos/libportaudio.dylib" ],
+          "libraries": [ "<(module_root_dir)/native/bin/macos/libportaudio.dylib", "-framework CoreAudio" ],
           "copies": [
             {
               "files": [ "<(module_root_dir)/native/bin/macos/libportaudio.dylib" ],
@@ -40,6 +40,24 @@
           ]
         }]
       ]
+    },
+    {
+      "target_name": "portaudio_bench",
+      "sources": [ "native/portaudio.cc", "native/bench/null_portaudio.cc" ],
+      "include_dirs": [
+        "<!(node -p \"require('path').dirname(require.resolve('node-addon-api'))\")",
+        "native/include"
+      ],
+      "dependencies": [ "<!(node -p \"require('node-addon-api').gyp\")" ],
+      "cflags!": [ "-fno-exceptions" ],
+      "cflags_cc!": [ "-fno-exceptions" ],
+      "defines": [ "NAPI_DISABLE_CPP_EXCEPTIONS", "ZEAKER_BENCH" ],
+      "product_dir": "<(PRODUCT_DIR)/bench",
+      "conditions": [
+        [ 'OS=="win"', {
+          "libraries": [ "avrt.lib" ]
+        }]
+      ]
     }
   ]
 }
@@ -0,0 +1,300 @@
+// Output analysis tap for visualization (see setAnalysisTap in portaudio.cc).
+//
+// The audio callback hands every block it plays to Feed(), which only copies it into a
+// lock-free ring (dropping the block if the ring is full). A background thread drains
+// the ring and, at a fixed UI rate, computes per-channel peak and RMS plus a windowed
+// FFT folded into log-spaced bands, so JS receives a few hundred floats per frame
+// instead of the raw samples.
+#pragma once
+
+#include <portaudio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "math_constants.h"
+#include "ring_buffer.h"
+#include "sample_format.h"
+
+static const uint32_t kAnalysisMinFftSize = 64;
+static const uint32_t kAnalysisMaxFftSize = 16384;
+static const uint32_t kAnalysisMaxBands = 1024;
+// Level of an empty band, in dBFS
+static const float kAnalysisFloorDb = -120.0f;
+
+struct AnalysisConfig
+{
+  uint32_t fftSize = 2048;
+  uint32_t bands = 64;
+  double rateHz = 30.0;
+};
+
+// Hann-windowed real FFT of the newest fftSize mono samples, reduced to `bands`
+// log-spaced bands (the loudest bin of each, in dBFS)
+class SpectrumAnalyzer
+{
+public:
+  // fftSize must be a power of two
+  void Configure(uint32_t fftSize, uint32_t bands, double sampleRate)
+  {
+    size_ = fftSize;
+    re_.assign(fftSize, 0.0f);
+    im_.assign(fftSize, 0.0f);
+    window_.resize(fftSize);
+    float windowSum = 0.0f;
+    for (uint32_t i = 0; i < fftSize; ++i)
+    {
+      window_[i] = 0.5f - 0.5f * std::cos(2.0f * static_cast<float>(kPi) * i / fftSize);
+      windowSum += window_[i];
+    }
+    // Full-scale sine -> 0 dBFS
+    scale_ = 2.0f / windowSum;
+    twiddleRe_.resize(fftSize / 2);
+    twiddleIm_.resize(fftSize / 2);
+    for (uint32_t i = 0; i < fftSize / 2; ++i)
+    {
+      twiddleRe_[i] = static_cast<float>(std::cos(-2.0 * kPi * i / fftSize));
+      twiddleIm_[i] = static_cast<float>(std::sin(-2.0 * kPi * i / fftSize));
+    }
+    bitReverse_.resize(fftSize);
+    uint32_t bits = 0;
+    while ((1u << bits) < fftSize)
+      ++bits;
+    for (uint32_t i = 0; i < fftSize; ++i)
+    {
+      uint32_t r = 0;
+      for (uint32_t b = 0; b < bits; ++b)
+        r |= ((i >> b) & 1u) << (bits - 1 - b);
+      bitReverse_[i] = r;
+    }
+    // Log-spaced band edges from 20 Hz to Nyquist, at least one bin per band
+    const uint32_t bins = fftSize / 2;
+    const double binHz = sampleRate / fftSize;
+    const double lowHz = std::max(20.0, binHz);
+    const double highHz = sampleRate / 2;
+    bandStart_.resize(bands);
+    bandEnd_.resize(bands);
+    for (uint32_t b = 0; b < bands; ++b)
+    {
+      uint32_t lo = static_cast<uint32_t>(lowHz * std::pow(highHz / lowHz, static_cast<double>(b) / bands) / binHz);
+      uint32_t hi = static_cast<uint32_t>(lowHz * std::pow(highHz / lowHz, static_cast<double>(b + 1) / bands) / binHz);
+      lo = std::min(std::max(lo, 1u), bins - 1);
+      bandStart_[b] = lo;
+      bandEnd_[b] = std::min(std::max(hi, lo + 1), bins);
+    }
+  }
+
+  uint32_t Size() const { return size_; }
+
+  // `samples` holds Size() samples, oldest first; writes one level per band to `bands`
+  void Process(const float *samples, float *bands)
+  {
+    for (uint32_t i = 0; i < size_; ++i)
+    {
+      re_[bitReverse_[i]] = samples[i] * window_[i];
+      im_[bitReverse_[i]] = 0.0f;
+    }
+    for (uint32_t len = 2; len <= size_; len <<= 1)
+    {
+      const uint32_t half = len / 2;
+      const uint32_t step = size_ / len;
+      for (uint32_t start = 0; start < size_; start += len)
+      {
+        for (uint32_t k = 0; k < half; ++k)
+        {
+          const float wr = twiddleRe_[k * step];
+          const float wi = twiddleIm_[k * step];
+          const uint32_t a = start + k;
+          const uint32_t b = a + half;
+          const float tr = re_[b] * wr - im_[b] * wi;
+          const float ti = re_[b] * wi + im_[b] * wr;
+          re_[b] = re_[a] - tr;
+          im_[b] = im_[a] - ti;
+          re_[a] += tr;
+          im_[a] += ti;
+        }
+      }
+    }
+    for (size_t b = 0; b < bandStart_.size(); ++b)
+    {
+      float peak = 0.0f;
+      for (uint32_t k = bandStart_[b]; k < bandEnd_[b]; ++k)
+        peak = std::max(peak, re_[k] * re_[k] + im_[k] * im_[k]);
+      const float magnitude = std::sqrt(peak) * scale_;
+      bands[b] = magnitude > 0.0f ? std::max(20.0f * std::log10(magnitude), kAnalysisFloorDb) : kAnalysisFloorDb;
+    }
+  }
+
+private:
+  uint32_t size_ = 0;
+  float scale_ = 1.0f;
+  std::vector<float> re_, im_, window_, twiddleRe_, twiddleIm_;
+  std::vector<uint32_t> bitReverse_, bandStart_, bandEnd_;
+};
+
+class AnalysisTap
+{
+public:
+  // Called on the analysis thread after each new result
+  using Notify = std::function<void()>;
+
+  ~AnalysisTap() { Stop(); }
+
+  // Main thread: (re)start analysis of a stream's output. The sample ring is allocated
+  // on the first start and kept until the tap is destroyed, because the audio callback
+  // may still be inside Feed() when a later Stop() returns.
+  void Start(int channels, PaSampleFormat format, double sampleRate, const AnalysisConfig &config, Notify notify)
+  {
+    Stop();
+    channels_ = channels;
+    format_ = format;
+    bytesPerFrame_ = channels * BytesPerSample(format);
+    config_ = config;
+    if (storage_.empty())
+    {
+      const uint32_t capacity = RingCapacityFor(static_cast<uint64_t>(2) * kAnalysisMaxFftSize * bytesPerFrame_);
+      storage_.assign(kRingHeaderBytes + capacity, 0);
+      ring_.Attach(storage_.data(), capacity);
+    }
+    else
+    {
+      // Samples left over from before the restart are stale
+      ring_.Skip(static_cast<int32_t>(ring_.ReadAvailable()));
+    }
+    analyzer_.Configure(config.fftSize, config.bands, sampleRate);
+    history_.assign(config.fftSize, 0.0f);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      latest_.assign(ResultSize(), 0.0f);
+      hasNew_ = false;
+    }
+    notify_ = std::move(notify);
+    stop_.store(false, std::memory_order_relaxed);
+    enabled_.store(true, std::memory_order_release);
+    thread_ = std::thread(&AnalysisTap::Run, this);
+  }
+
+  // Main thread: stop feeding and join the analysis thread
+  void Stop()
+  {
+    enabled_.store(false, std::memory_order_release);
+    stop_.store(true, std::memory_order_relaxed);
+    if (thread_.joinable())
+      thread_.join();
+    notify_ = nullptr;
+  }
+
+  bool Running() const { return thread_.joinable(); }
+
+  // Audio thread: tap one block of output. Whole blocks only, so the ring never holds
+  // a partial frame; a block that does not fit is dropped.
+  void Feed(const void *data, uint32_t frames)
+  {
+    if (!enabled_.load(std::memory_order_acquire))
+      return;
+    const uint32_t bytes = frames * bytesPerFrame_;
+    if (ring_.WriteAvailable() >= bytes)
+      ring_.Write(data, bytes);
+  }
+
+  // Floats per result: peak per channel, RMS per channel, then the bands
+  uint32_t ResultSize() const { return 2 * channels_ + config_.bands; }
+
+  // Main thread: copy the newest result into dst (ResultSize() floats); false if there
+  // has been none since the last call
+  bool TakeLatest(float *dst)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!hasNew_)
+      return false;
+    std::copy(latest_.begin(), latest_.end(), dst);
+    hasNew_ = false;
+    return true;
+  }
+
+private:
+  void Run()
+  {
+    const uint32_t kBlockFrames = 1024;
+    std::vector<uint8_t> raw(static_cast<size_t>(kBlockFrames) * bytesPerFrame_);
+    std::vector<float> block(static_cast<size_t>(kBlockFrames) * channels_);
+    std::vector<float> result(ResultSize());
+    std::vector<float> peak(channels_), sumSquares(channels_);
+    const uint32_t fftSize = config_.fftSize;
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / config_.rateHz));
+    auto next = std::chrono::steady_clock::now() + period;
+    uint64_t frames = 0;
+    while (!stop_.load(std::memory_order_relaxed))
+    {
+      // Drain everything played since the last pass
+      uint32_t n;
+      while ((n = ring_.Read(raw.data(), kBlockFrames * bytesPerFrame_) / bytesPerFrame_) > 0)
+      {
+        SamplesToFloat(format_, raw.data(), block.data(), static_cast<size_t>(n) * channels_);
+        const uint32_t keep = std::min(n, fftSize);
+        std::memmove(history_.data(), history_.data() + keep, (fftSize - keep) * sizeof(float));
+        float *tail = history_.data() + fftSize - keep;
+        for (uint32_t f = 0; f < n; ++f)
+        {
+          float mono = 0.0f;
+          for (int c = 0; c < channels_; ++c)
+          {
+            const float s = block[f * channels_ + c];
+            peak[c] = std::max(peak[c], std::fabs(s));
+            sumSquares[c] += s * s;
+            mono += s;
+          }
+          if (f >= n - keep)
+            tail[f - (n - keep)] = mono / channels_;
+        }
+        frames += n;
+      }
+      if (std::chrono::steady_clock::now() >= next)
+      {
+        for (int c = 0; c < channels_; ++c)
+        {
+          result[c] = peak[c];
+          result[channels_ + c] = frames > 0 ? std::sqrt(sumSquares[c] / frames) : 0.0f;
+          peak[c] = 0.0f;
+          sumSquares[c] = 0.0f;
+        }
+        frames = 0;
+        analyzer_.Process(history_.data(), result.data() + 2 * channels_);
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          latest_.swap(result);
+          hasNew_ = true;
+        }
+        if (notify_)
+          notify_();
+        next += period;
+        // Fell far behind (e.g. the machine slept): resume from now
+        if (std::chrono::steady_clock::now() > next + period)
+          next = std::chrono::steady_clock::now() + period;
+      }
+      std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(next - std::chrono::steady_clock::now(), std::chrono::milliseconds(5)));
+    }
+  }
+
+  int channels_ = 2;
+  PaSampleFormat format_ = paFloat32;
+  uint32_t bytesPerFrame_ = 8;
+  AnalysisConfig config_;
+  std::vector<uint8_t> storage_;
+  PcmRing ring_;
+  SpectrumAnalyzer analyzer_;
+  std::vector<float> history_;
+  std::atomic<bool> enabled_{false};
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+  Notify notify_;
+  std::mutex mutex_;
+  std::vector<float> latest_;
+  bool hasNew_ = false;
+};
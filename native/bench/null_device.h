@@ -0,0 +1,42 @@
+// Simulated output device for the portaudio_bench target (see null_portaudio.cc).
+//
+// The bench build links portaudio.cc against a stand-in PortAudio with one "Null
+// Output" device instead of the real library, so the addon's blocking and callback
+// paths run unchanged on any machine, with no audio hardware and a known clock.
+// Callback streams are driven by a thread that wakes once per period; blocking streams
+// drain a virtual device buffer at the stream rate. Both time everything they observe.
+#pragma once
+
+#include <portaudio.h>
+#include <cstdint>
+#include <vector>
+
+struct NullDeviceConfig
+{
+  // Pace callbacks and writes in real time; false runs them back to back (throughput)
+  bool realtime = true;
+  // Device buffer behind Pa_WriteStream, and the latency reported to streams
+  double latencySeconds = 0.02;
+};
+
+struct NullDeviceReport
+{
+  uint64_t callbacks = 0;
+  // Callbacks that finished after their period's deadline (the device would glitch)
+  uint64_t lateCallbacks = 0;
+  uint64_t underflows = 0;
+  // Per callback: how long it took to fill the buffer, and how far after its scheduled
+  // time it started, in microseconds (the most recent ones if there were more)
+  std::vector<float> fillUs;
+  std::vector<float> jitterUs;
+  // Blocking streams
+  uint64_t writeCalls = 0;
+  uint64_t framesWritten = 0;
+  double writeBlockedUs = 0.0;
+  double elapsedSeconds = 0.0;
+};
+
+void NullDeviceConfigure(const NullDeviceConfig &config);
+// Copy a stream's measurements; false if it is not a null-device stream
+bool NullDeviceGetReport(PaStream *stream, NullDeviceReport *report);
+void NullDeviceResetReport(PaStream *stream);
@@ -0,0 +1,422 @@
+// Stand-in PortAudio for the portaudio_bench target: one simulated output device (see
+// null_device.h). Implements the subset of the PortAudio API portaudio.cc uses.
+#include "null_device.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+// Per-callback timings kept for percentiles (the most recent ones)
+const size_t kMaxTimings = 1 << 20;
+const int kMaxNullChannels = 32;
+
+NullDeviceConfig g_config;
+std::mutex g_configMutex;
+int g_initCount = 0;
+
+PaHostApiInfo g_hostApi = {1, paInDevelopment, "Null", 1, 0, -1};
+PaDeviceInfo g_device = {2, "Null Output", 0, 0, kMaxNullChannels, 0.0, 0.005, 0.0, 0.05, 48000.0};
+
+size_t BytesPerNullSample(PaSampleFormat format)
+{
+  switch (format & ~paNonInterleaved)
+  {
+  case paInt16:
+    return 2;
+  case paInt24:
+    return 3;
+  case paInt8:
+  case paUInt8:
+    return 1;
+  default:
+    return 4;
+  }
+}
+
+double Seconds(Clock::duration d)
+{
+  return std::chrono::duration<double>(d).count();
+}
+
+struct NullStream
+{
+  PaStreamCallback *callback = nullptr;
+  void *userData = nullptr;
+  int channels = 2;
+  PaSampleFormat format = paFloat32;
+  double sampleRate = 48000.0;
+  unsigned long framesPerBuffer = 256;
+  NullDeviceConfig config;
+  PaStreamInfo info = {};
+  std::vector<uint8_t> buffer;
+  std::thread thread;
+  std::atomic<bool> active{false};
+  std::atomic<bool> stopRequested{false};
+  Clock::time_point started;
+  // Blocking streams: frames still queued in the virtual device buffer as of `drained`
+  double queuedFrames = 0.0;
+  Clock::time_point drained;
+  double capacityFrames = 0.0;
+  std::atomic<double> cpuLoad{0.0};
+
+  std::mutex reportMutex;
+  NullDeviceReport report;
+  size_t nextTiming = 0;
+
+  void Record(float fillUs, float jitterUs, bool late)
+  {
+    std::lock_guard<std::mutex> lock(reportMutex);
+    ++report.callbacks;
+    if (late)
+      ++report.lateCallbacks;
+    if (report.fillUs.size() < kMaxTimings)
+    {
+      report.fillUs.push_back(fillUs);
+      report.jitterUs.push_back(jitterUs);
+    }
+    else
+    {
+      report.fillUs[nextTiming] = fillUs;
+      report.jitterUs[nextTiming] = jitterUs;
+      nextTiming = (nextTiming + 1) % kMaxTimings;
+    }
+  }
+
+  // Callback streams: one period per wake-up, on the device's schedule
+  void Run()
+  {
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(framesPerBuffer / sampleRate));
+    Clock::time_point next = Clock::now();
+    PaStreamCallbackFlags flags = 0;
+    while (!stopRequested.load(std::memory_order_relaxed))
+    {
+      if (config.realtime)
+        std::this_thread::sleep_until(next);
+      const Clock::time_point begin = Clock::now();
+      PaStreamCallbackTimeInfo timeInfo;
+      timeInfo.inputBufferAdcTime = 0.0;
+      timeInfo.currentTime = Seconds(begin - started);
+      timeInfo.outputBufferDacTime = timeInfo.currentTime + info.outputLatency;
+      const int result = callback(nullptr, buffer.data(), framesPerBuffer, &timeInfo, flags, userData);
+      const Clock::time_point end = Clock::now();
+      const Clock::time_point deadline = next + period;
+      const bool late = config.realtime && end > deadline;
+      Record(static_cast<float>(std::chrono::duration<double, std::micro>(end - begin).count()),
+             config.realtime ? static_cast<float>(std::chrono::duration<double, std::micro>(begin - next).count()) : 0.0f, late);
+      cpuLoad.store(0.9 * cpuLoad.load(std::memory_order_relaxed) + 0.1 * Seconds(end - begin) / Seconds(period), std::memory_order_relaxed);
+      flags = 0;
+      next = deadline;
+      if (late && end > next + period)
+      {
+        // More than a whole period behind: the device played silence; resynchronise
+        flags = paOutputUnderflow;
+        {
+          std::lock_guard<std::mutex> lock(reportMutex);
+          ++report.underflows;
+        }
+        next = end;
+      }
+      if (result != paContinue)
+        break;
+    }
+    active.store(false, std::memory_order_release);
+  }
+
+  // Blocking streams: account for the frames the device played since the last call
+  void Drain(Clock::time_point now)
+  {
+    const double played = Seconds(now - drained) * sampleRate;
+    drained = now;
+    if (played > queuedFrames && report.writeCalls > 0 && config.realtime)
+    {
+      std::lock_guard<std::mutex> lock(reportMutex);
+      ++report.underflows;
+    }
+    queuedFrames = std::max(queuedFrames - played, 0.0);
+  }
+};
+
+NullStream *AsNull(PaStream *stream)
+{
+  return static_cast<NullStream *>(stream);
+}
+
+PaError CheckOutput(const PaStreamParameters *output, double sampleRate)
+{
+  if (!output)
+    return paInvalidChannelCount;
+  if (output->device != 0)
+    return paInvalidDevice;
+  if (output->channelCount <= 0 || output->channelCount > kMaxNullChannels)
+    return paInvalidChannelCount;
+  if (!(sampleRate >= 8000.0 && sampleRate <= 768000.0))
+    return paInvalidSampleRate;
+  return paNoError;
+}
+} // namespace
+
+void NullDeviceConfigure(const NullDeviceConfig &config)
+{
+  std::lock_guard<std::mutex> lock(g_configMutex);
+  g_config = config;
+}
+
+bool NullDeviceGetReport(PaStream *stream, NullDeviceReport *report)
+{
+  NullStream *s = AsNull(stream);
+  if (!s)
+    return false;
+  std::lock_guard<std::mutex> lock(s->reportMutex);
+  *report = s->report;
+  report->elapsedSeconds = Seconds(Clock::now() - s->started);
+  return true;
+}
+
+void NullDeviceResetReport(PaStream *stream)
+{
+  NullStream *s = AsNull(stream);
+  if (!s)
+    return;
+  std::lock_guard<std::mutex> lock(s->reportMutex);
+  s->report = NullDeviceReport();
+  s->nextTiming = 0;
+  s->started = Clock::now();
+}
+
+PaError Pa_Initialize(void)
+{
+  ++g_initCount;
+  return paNoError;
+}
+
+PaError Pa_Terminate(void)
+{
+  if (g_initCount == 0)
+    return paNotInitialized;
+  --g_initCount;
+  return paNoError;
+}
+
+const char *Pa_GetVersionText(void)
+{
+  return "PortAudio null device (benchmark build)";
+}
+
+const char *Pa_GetErrorText(PaError errorCode)
+{
+  switch (errorCode)
+  {
+  case paNoError:
+    return "Success";
+  case paNotInitialized:
+    return "PortAudio not initialized";
+  case paInvalidChannelCount:
+    return "Invalid number of channels";
+  case paInvalidSampleRate:
+    return "Invalid sample rate";
+  case paInvalidDevice:
+    return "Invalid device";
+  case paInsufficientMemory:
+    return "Insufficient memory";
+  case paBadStreamPtr:
+    return "Invalid stream pointer";
+  case paStreamIsStopped:
+    return "Stream is stopped";
+  case paStreamIsNotStopped:
+    return "Stream is not stopped";
+  case paCanNotWriteToACallbackStream:
+    return "Can't write to a callback stream";
+  default:
+    return "Illegal error number";
+  }
+}
+
+PaDeviceIndex Pa_GetDeviceCount(void)
+{
+  return g_initCount > 0 ? 1 : paNotInitialized;
+}
+
+PaDeviceIndex Pa_GetDefaultOutputDevice(void)
+{
+  return g_initCount > 0 ? 0 : paNoDevice;
+}
+
+// Output only: duplex and capture streams are refused
+PaDeviceIndex Pa_GetDefaultInputDevice(void)
+{
+  return paNoDevice;
+}
+
+const PaDeviceInfo *Pa_GetDeviceInfo(PaDeviceIndex device)
+{
+  return device == 0 && g_initCount > 0 ? &g_device : nullptr;
+}
+
+const PaHostApiInfo *Pa_GetHostApiInfo(PaHostApiIndex hostApi)
+{
+  return hostApi == 0 && g_initCount > 0 ? &g_hostApi : nullptr;
+}
+
+PaError Pa_IsFormatSupported(const PaStreamParameters *inputParameters, const PaStreamParameters *outputParameters, double sampleRate)
+{
+  if (inputParameters)
+    return paInvalidChannelCount;
+  PaError err = CheckOutput(outputParameters, sampleRate);
+  return err == paNoError ? paFormatIsSupported : err;
+}
+
+PaError Pa_OpenStream(PaStream **stream, const PaStreamParameters *inputParameters, const PaStreamParameters *outputParameters,
+                      double sampleRate, unsigned long framesPerBuffer, PaStreamFlags, PaStreamCallback *streamCallback, void *userData)
+{
+  if (inputParameters)
+    return paInvalidChannelCount;
+  PaError err = CheckOutput(outputParameters, sampleRate);
+  if (err != paNoError)
+    return err;
+  auto *s = new NullStream();
+  {
+    std::lock_guard<std::mutex> lock(g_configMutex);
+    s->config = g_config;
+  }
+  s->callback = streamCallback;
+  s->userData = userData;
+  s->channels = outputParameters->channelCount;
+  s->format = outputParameters->sampleFormat;
+  s->sampleRate = sampleRate;
+  s->framesPerBuffer = framesPerBuffer == paFramesPerBufferUnspecified ? 256 : framesPerBuffer;
+  s->info.structVersion = 1;
+  s->info.sampleRate = sampleRate;
+  s->info.outputLatency = std::max(s->config.latencySeconds, s->framesPerBuffer / sampleRate);
+  s->buffer.assign(s->framesPerBuffer * s->channels * BytesPerNullSample(s->format), 0);
+  s->capacityFrames = s->info.outputLatency * sampleRate;
+  s->started = s->drained = Clock::now();
+  *stream = s;
+  return paNoError;
+}
+
+PaError Pa_OpenDefaultStream(PaStream **stream, int numInputChannels, int numOutputChannels, PaSampleFormat sampleFormat,
+                             double sampleRate, unsigned long framesPerBuffer, PaStreamCallback *streamCallback, void *userData)
+{
+  if (numInputChannels > 0)
+    return paInvalidChannelCount;
+  PaStreamParameters output = {0, numOutputChannels, sampleFormat, g_device.defaultLowOutputLatency, nullptr};
+  return Pa_OpenStream(stream, nullptr, &output, sampleRate, framesPerBuffer, paNoFlag, streamCallback, userData);
+}
+
+PaError Pa_StartStream(PaStream *stream)
+{
+  NullStream *s = AsNull(stream);
+  if (!s)
+    return paBadStreamPtr;
+  if (s->active.load(std::memory_order_acquire) || s->thread.joinable())
+    return paStreamIsNotStopped;
+  s->started = s->drained = Clock::now();
+  s->queuedFrames = 0.0;
+  s->stopRequested.store(false, std::memory_order_relaxed);
+  s->active.store(true, std::memory_order_release);
+  if (s->callback)
+    s->thread = std::thread(&NullStream::Run, s);
+  return paNoError;
+}
+
+PaError Pa_StopStream(PaStream *stream)
+{
+  NullStream *s = AsNull(stream);
+  if (!s)
+    return paBadStreamPtr;
+  s->stopRequested.store(true, std::memory_order_relaxed);
+  if (s->thread.joinable())
+    s->thread.join();
+  s->active.store(false, std::memory_order_release);
+  return paNoError;
+}
+
+PaError Pa_CloseStream(PaStream *stream)
+{
+  NullStream *s = AsNull(stream);
+  if (!s)
+    return paBadStreamPtr;
+  Pa_StopStream(stream);
+  delete s;
+  return paNoError;
+}
+
+PaError Pa_IsStreamActive(PaStream *stream)
+{
+  NullStream *s = AsNull(stream);
+  if (!s)
+    return paBadStreamPtr;
+  return s->active.load(std::memory_order_acquire) ? 1 : 0;
+}
+
+const PaStreamInfo *Pa_GetStreamInfo(PaStream *stream)
+{
+  NullStream *s = AsNull(stream);
+  return s ? &s->info : nullptr;
+}
+
+PaTime Pa_GetStreamTime(PaStream *stream)
+{
+  NullStream *s = AsNull(stream);
+  return s ? Seconds(Clock::now() - s->started) : 0.0;
+}
+
+double Pa_GetStreamCpuLoad(PaStream *stream)
+{
+  NullStream *s = AsNull(stream);
+  return s ? s->cpuLoad.load(std::memory_order_relaxed) : 0.0;
+}
+
+signed long Pa_GetStreamWriteAvailable(PaStream *stream)
+{
+  NullStream *s = AsNull(stream);
+  if (!s)
+    return paBadStreamPtr;
+  if (s->callback)
+    return paCanNotWriteToACallbackStream;
+  if (!s->config.realtime)
+    return static_cast<signed long>(s->capacityFrames);
+  s->Drain(Clock::now());
+  return static_cast<signed long>(std::max(s->capacityFrames - s->queuedFrames, 0.0));
+}
+
+PaError Pa_WriteStream(PaStream *stream, const void *buffer, unsigned long frames)
+{
+  NullStream *s = AsNull(stream);
+  if (!s)
+    return paBadStreamPtr;
+  if (s->callback)
+    return paCanNotWriteToACallbackStream;
+  if (!s->active.load(std::memory_order_acquire))
+    return paStreamIsStopped;
+  // Touch the samples like a driver copying them out would
+  volatile uint8_t sink = 0;
+  const size_t bytes = frames * s->channels * BytesPerNullSample(s->format);
+  const uint8_t *data = static_cast<const uint8_t *>(buffer);
+  for (size_t i = 0; i < bytes; i += 64)
+    sink = sink ^ data[i];
+  const Clock::time_point begin = Clock::now();
+  if (s->config.realtime)
+  {
+    s->Drain(begin);
+    // Block until the virtual buffer has room, as a real device write would
+    const double excess = s->queuedFrames + frames - std::max(s->capacityFrames, static_cast<double>(frames));
+    if (excess > 0.0)
+    {
+      std::this_thread::sleep_for(std::chrono::duration<double>(excess / s->sampleRate));
+      s->Drain(Clock::now());
+    }
+    s->queuedFrames += frames;
+  }
+  std::lock_guard<std::mutex> lock(s->reportMutex);
+  ++s->report.writeCalls;
+  s->report.framesWritten += frames;
+  s->report.writeBlockedUs += std::chrono::duration<double, std::micro>(Clock::now() - begin).count();
+  return paNoError;
+}
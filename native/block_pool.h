@@ -0,0 +1,139 @@
+// Bounded PCM prebuffers backed by a pool of fixed-size blocks.
+//
+// A prebuffer holds decoded audio for a track that has not started yet, outside the JS
+// heap and up to a byte cap, so the decoder can be paused (backpressure) instead of
+// buffering a whole album. Blocks are recycled through a shared pool, so steady-state
+// prebuffering never allocates. Main thread only.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+
+static const uint32_t kPoolBlockBytes = 64 * 1024;
+
+class BlockPool
+{
+public:
+  // Keep at most maxIdle released blocks for reuse; the rest are freed
+  explicit BlockPool(size_t maxIdle) : maxIdle_(maxIdle) {}
+
+  uint8_t *Acquire()
+  {
+    ++inUse_;
+    if (idle_.empty())
+      return new uint8_t[kPoolBlockBytes];
+    uint8_t *block = idle_.back().release();
+    idle_.pop_back();
+    return block;
+  }
+
+  void Release(uint8_t *block)
+  {
+    --inUse_;
+    if (idle_.size() < maxIdle_)
+      idle_.emplace_back(block);
+    else
+      delete[] block;
+  }
+
+  size_t InUse() const { return inUse_; }
+  size_t Idle() const { return idle_.size(); }
+
+private:
+  size_t maxIdle_;
+  size_t inUse_ = 0;
+  std::vector<std::unique_ptr<uint8_t[]>> idle_;
+};
+
+// FIFO of bytes stored in pool blocks, never holding more than its capacity
+class BlockQueue
+{
+public:
+  BlockQueue(BlockPool &pool, size_t capacity) : pool_(pool), capacity_(capacity) {}
+  BlockQueue(const BlockQueue &) = delete;
+  BlockQueue &operator=(const BlockQueue &) = delete;
+
+  ~BlockQueue()
+  {
+    for (Block &b : blocks_)
+      pool_.Release(b.data);
+  }
+
+  // Append up to `bytes`; returns how many fit under the capacity
+  size_t Write(const uint8_t *src, size_t bytes)
+  {
+    size_t n = std::min(bytes, capacity_ - size_);
+    size_t done = 0;
+    while (done < n)
+    {
+      if (blocks_.empty() || blocks_.back().end == kPoolBlockBytes)
+        blocks_.push_back(Block{pool_.Acquire(), 0, 0});
+      Block &b = blocks_.back();
+      size_t chunk = std::min<size_t>(n - done, kPoolBlockBytes - b.end);
+      std::memcpy(b.data + b.end, src + done, chunk);
+      b.end += static_cast<uint32_t>(chunk);
+      done += chunk;
+    }
+    size_ += n;
+    return n;
+  }
+
+  // Hand up to `maxBytes` from the front to `sink(data, bytes)`, which returns how many
+  // it accepted; stops at the first partial accept. Returns bytes consumed.
+  template <typename Sink>
+  size_t Drain(Sink &&sink, size_t maxBytes)
+  {
+    size_t done = 0;
+    while (done < maxBytes && !blocks_.empty())
+    {
+      Block &b = blocks_.front();
+      size_t chunk = std::min<size_t>(maxBytes - done, b.end - b.begin);
+      if (chunk == 0)
+        break; // only the emptied last block is left
+      size_t accepted = sink(b.data + b.begin, chunk);
+      b.begin += static_cast<uint32_t>(accepted);
+      done += accepted;
+      if (b.begin == b.end && (blocks_.size() > 1 || b.end == kPoolBlockBytes))
+      {
+        pool_.Release(b.data);
+        blocks_.pop_front();
+      }
+      else if (b.begin == b.end)
+      {
+        b.begin = b.end = 0; // last block emptied: refill it from the start
+      }
+      if (accepted < chunk)
+        break;
+    }
+    size_ -= done;
+    return done;
+  }
+
+  size_t Read(uint8_t *dst, size_t bytes)
+  {
+    return Drain([&dst](const uint8_t *data, size_t n)
+                 { std::memcpy(dst, data, n); dst += n; return n; }, bytes);
+  }
+
+  size_t Size() const { return size_; }
+  size_t Capacity() const { return capacity_; }
+  size_t Blocks() const { return blocks_.size(); }
+
+private:
+  struct Block
+  {
+    uint8_t *data;
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  BlockPool &pool_;
+  size_t capacity_;
+  size_t size_ = 0;
+  std::deque<Block> blocks_;
+};
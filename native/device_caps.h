@@ -0,0 +1,169 @@
+// Cache of probed output device capabilities (see GetDeviceCapabilities).
+//
+// Probing a device means one Pa_IsFormatSupported call per sample rate, channel count
+// and sample format, which takes hundreds of milliseconds on multichannel or ASIO/WASAPI
+// devices. Results are cached per device identity (host API, name and channel counts,
+// since indices shift when devices come and go) for as long as the device list stays the
+// same, and can be filled on a worker thread at startup.
+//
+// PortAudio is not thread safe, so every probe, and Pa_Initialize/Pa_Terminate, holds
+// ProbeMutex(). Cache lookups take a separate lock and never wait for a probe.
+#pragma once
+
+#include <portaudio.h>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+struct DeviceCapabilities
+{
+  std::vector<double> sampleRates;
+  std::vector<int> channels;
+  std::vector<int> bitDepths;
+  // isOutputFormatSupported() answers, keyed by FormatKey()
+  std::map<uint64_t, bool> formats;
+};
+
+inline std::string DeviceIdentity(const PaDeviceInfo *dev)
+{
+  const PaHostApiInfo *hostApi = Pa_GetHostApiInfo(dev->hostApi);
+  return std::string(hostApi && hostApi->name ? hostApi->name : "") + '\n' + (dev->name ? dev->name : "") + '\n' +
+         std::to_string(dev->maxInputChannels) + '\n' + std::to_string(dev->maxOutputChannels);
+}
+
+// Identities of every device, in index order; changes whenever the device list does
+inline std::string DeviceListSignature()
+{
+  std::string signature;
+  const int count = Pa_GetDeviceCount();
+  for (int i = 0; i < count; ++i)
+  {
+    const PaDeviceInfo *dev = Pa_GetDeviceInfo(i);
+    if (dev)
+      signature += DeviceIdentity(dev) + '\0';
+  }
+  return signature;
+}
+
+inline uint64_t FormatKey(double sampleRate, int channels, PaSampleFormat format)
+{
+  return static_cast<uint64_t>(sampleRate) << 32 | static_cast<uint64_t>(channels & 0xFFFF) << 16 | (format & 0xFFFF);
+}
+
+inline bool ProbeOutputFormat(int index, const PaDeviceInfo *dev, double sampleRate, int channels, PaSampleFormat format)
+{
+  PaStreamParameters outputParams;
+  outputParams.device = index;
+  outputParams.channelCount = channels;
+  outputParams.sampleFormat = format;
+  outputParams.suggestedLatency = dev->defaultLowOutputLatency;
+  outputParams.hostApiSpecificStreamInfo = nullptr;
+  return Pa_IsFormatSupported(nullptr, &outputParams, sampleRate) == paNoError;
+}
+
+// Probe common sample rates and the sample formats at the device's channel count, and
+// every channel count at its default rate. Caller holds ProbeMutex().
+inline DeviceCapabilities ProbeDeviceCapabilities(int index, const PaDeviceInfo *dev)
+{
+  static const double kRates[] = {8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 176400, 192000};
+  struct BitDepthFormat
+  {
+    PaSampleFormat format;
+    int bitDepth;
+  };
+  static const BitDepthFormat kBitDepths[] = {{paInt16, 16}, {paInt24, 24}, {paInt32, 32}, {paFloat32, 32}};
+  DeviceCapabilities caps;
+  for (double rate : kRates)
+  {
+    if (ProbeOutputFormat(index, dev, rate, dev->maxOutputChannels, paFloat32))
+      caps.sampleRates.push_back(rate);
+  }
+  for (int ch = 1; ch <= dev->maxOutputChannels; ++ch)
+  {
+    if (ProbeOutputFormat(index, dev, dev->defaultSampleRate, ch, paFloat32))
+      caps.channels.push_back(ch);
+  }
+  for (const BitDepthFormat &bdf : kBitDepths)
+  {
+    if (ProbeOutputFormat(index, dev, dev->defaultSampleRate, dev->maxOutputChannels, bdf.format))
+      caps.bitDepths.push_back(bdf.bitDepth);
+  }
+  return caps;
+}
+
+class CapabilityCache
+{
+public:
+  // Capabilities of a device whose full probe has run
+  bool Get(const std::string &identity, DeviceCapabilities *caps)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(identity);
+    if (it == entries_.end() || probed_.count(identity) == 0)
+      return false;
+    *caps = it->second;
+    return true;
+  }
+
+  // Store a probe result, keeping any format answers already cached for the device
+  void Put(const std::string &identity, DeviceCapabilities caps)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(identity);
+    if (it != entries_.end())
+      caps.formats.insert(it->second.formats.begin(), it->second.formats.end());
+    entries_[identity] = std::move(caps);
+    probed_.insert(identity);
+  }
+
+  bool GetFormat(const std::string &identity, uint64_t key, bool *supported)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(identity);
+    if (it == entries_.end())
+      return false;
+    auto f = it->second.formats.find(key);
+    if (f == it->second.formats.end())
+      return false;
+    *supported = f->second;
+    return true;
+  }
+
+  void PutFormat(const std::string &identity, uint64_t key, bool supported)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[identity].formats[key] = supported;
+  }
+
+  // Drop everything if the device list differs from the one the cache was filled for
+  bool Revalidate(const std::string &signature)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (signature == signature_)
+      return false;
+    signature_ = signature;
+    entries_.clear();
+    probed_.clear();
+    return true;
+  }
+
+  void Clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    signature_.clear();
+    entries_.clear();
+    probed_.clear();
+  }
+
+  std::mutex &ProbeMutex() { return probeMutex_; }
+
+private:
+  std::mutex mutex_;
+  std::mutex probeMutex_;
+  std::string signature_;
+  std::map<std::string, DeviceCapabilities> entries_;
+  std::set<std::string> probed_;
+};
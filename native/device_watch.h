@@ -0,0 +1,248 @@
+// Audio device hotplug notifications (watchDevices()).
+//
+// PortAudio enumerates devices once, in Pa_Initialize, and has no notifications of its
+// own, so the watcher listens to the platform instead: an IMMNotificationClient on
+// Windows, CoreAudio property listeners on the hardware object on macOS, and inotify on
+// /dev/snd on Linux, where every ALSA card (and so every PulseAudio or PipeWire sink on
+// it) appears and disappears as device nodes. The callback runs on a platform thread,
+// typically several times per physical event; debouncing and rescanning the PortAudio
+// device list (refreshDevicesAsync) are left to the caller.
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#if defined(ZEAKER_BENCH)
+// The null device never changes
+#elif defined(_WIN32)
+#include <windows.h>
+#include <mmdeviceapi.h>
+#define ZEAKER_WATCH_WASAPI 1
+#elif defined(__APPLE__)
+#include <CoreAudio/CoreAudio.h>
+#define ZEAKER_WATCH_COREAUDIO 1
+#elif defined(__linux__)
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define ZEAKER_WATCH_INOTIFY 1
+#endif
+
+class DeviceWatcher
+{
+public:
+  // Called with "added", "removed", "state" or "default" (the default device changed)
+  using Callback = std::function<void(const char *reason)>;
+
+  ~DeviceWatcher() { Stop(); }
+
+  // Main thread. Returns false if the platform has no notifications or refused them
+  bool Start(Callback callback)
+  {
+    Stop();
+    callback_ = std::move(callback);
+#if defined(ZEAKER_WATCH_WASAPI)
+    const HRESULT init = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    // An STA thread (RPC_E_CHANGED_MODE) can still create the enumerator, but must not
+    // be uninitialised by us
+    comInitialized_ = SUCCEEDED(init);
+    if (FAILED(CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr, CLSCTX_ALL, __uuidof(IMMDeviceEnumerator),
+                                reinterpret_cast<void **>(&enumerator_))))
+    {
+      enumerator_ = nullptr;
+      Stop();
+      return false;
+    }
+    client_ = new NotificationClient(this);
+    if (FAILED(enumerator_->RegisterEndpointNotificationCallback(client_)))
+    {
+      Stop();
+      return false;
+    }
+    registered_ = true;
+    backend_ = "wasapi";
+    return true;
+#elif defined(ZEAKER_WATCH_COREAUDIO)
+    for (const AudioObjectPropertyAddress &address : kAddresses)
+    {
+      if (AudioObjectAddPropertyListener(kAudioObjectSystemObject, &address, OnPropertyChange, this) != noErr)
+      {
+        Stop();
+        return false;
+      }
+      ++listeners_;
+    }
+    backend_ = "coreaudio";
+    return true;
+#elif defined(ZEAKER_WATCH_INOTIFY)
+    inotifyFd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stopFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotifyFd_ < 0 || stopFd_ < 0 || inotify_add_watch(inotifyFd_, "/dev/snd", IN_CREATE | IN_DELETE) < 0)
+    {
+      Stop();
+      return false;
+    }
+    thread_ = std::thread([this] { WatchLoop(); });
+    backend_ = "inotify";
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // Main thread. Once it returns the callback is not called again
+  void Stop()
+  {
+#if defined(ZEAKER_WATCH_WASAPI)
+    if (registered_)
+      enumerator_->UnregisterEndpointNotificationCallback(client_);
+    registered_ = false;
+    if (client_)
+      client_->Release();
+    client_ = nullptr;
+    if (enumerator_)
+      enumerator_->Release();
+    enumerator_ = nullptr;
+    if (comInitialized_)
+      CoUninitialize();
+    comInitialized_ = false;
+#elif defined(ZEAKER_WATCH_COREAUDIO)
+    // Removing a listener waits for a notification in progress to return
+    for (; listeners_ > 0; --listeners_)
+      AudioObjectRemovePropertyListener(kAudioObjectSystemObject, &kAddresses[listeners_ - 1], OnPropertyChange, this);
+#elif defined(ZEAKER_WATCH_INOTIFY)
+    if (thread_.joinable())
+    {
+      const uint64_t one = 1;
+      (void)!write(stopFd_, &one, sizeof(one));
+      thread_.join();
+    }
+    if (inotifyFd_ >= 0)
+      close(inotifyFd_);
+    if (stopFd_ >= 0)
+      close(stopFd_);
+    inotifyFd_ = stopFd_ = -1;
+#endif
+    backend_ = nullptr;
+  }
+
+  // Notification source in use, or nullptr when not watching
+  const char *Backend() const { return backend_; }
+
+private:
+  void Notify(const char *reason)
+  {
+    if (callback_)
+      callback_(reason);
+  }
+
+#if defined(ZEAKER_WATCH_WASAPI)
+  // Endpoint notifications arrive on a system thread pool thread
+  class NotificationClient : public IMMNotificationClient
+  {
+  public:
+    explicit NotificationClient(DeviceWatcher *owner) : owner_(owner) {}
+
+    ULONG STDMETHODCALLTYPE AddRef() override { return InterlockedIncrement(&refs_); }
+    ULONG STDMETHODCALLTYPE Release() override
+    {
+      const ULONG refs = InterlockedDecrement(&refs_);
+      if (refs == 0)
+        delete this;
+      return refs;
+    }
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **object) override
+    {
+      if (iid == __uuidof(IUnknown) || iid == __uuidof(IMMNotificationClient))
+      {
+        *object = static_cast<IMMNotificationClient *>(this);
+        AddRef();
+        return S_OK;
+      }
+      *object = nullptr;
+      return E_NOINTERFACE;
+    }
+    HRESULT STDMETHODCALLTYPE OnDeviceStateChanged(LPCWSTR, DWORD) override { return Forward("state"); }
+    HRESULT STDMETHODCALLTYPE OnDeviceAdded(LPCWSTR) override { return Forward("added"); }
+    HRESULT STDMETHODCALLTYPE OnDeviceRemoved(LPCWSTR) override { return Forward("removed"); }
+    HRESULT STDMETHODCALLTYPE OnDefaultDeviceChanged(EDataFlow, ERole role, LPCWSTR) override
+    {
+      // Reported once per role; the console role stands for all three
+      return role == eConsole ? Forward("default") : S_OK;
+    }
+    // Volume and format property changes do not change the device list
+    HRESULT STDMETHODCALLTYPE OnPropertyValueChanged(LPCWSTR, const PROPERTYKEY) override { return S_OK; }
+
+  private:
+    HRESULT Forward(const char *reason)
+    {
+      owner_->Notify(reason);
+      return S_OK;
+    }
+
+    DeviceWatcher *owner_;
+    LONG refs_ = 1;
+  };
+
+  IMMDeviceEnumerator *enumerator_ = nullptr;
+  NotificationClient *client_ = nullptr;
+  bool registered_ = false;
+  bool comInitialized_ = false;
+#elif defined(ZEAKER_WATCH_COREAUDIO)
+  // Element 0 is kAudioObjectPropertyElementMain (kAudioObjectPropertyElementMaster before macOS 12)
+  static constexpr AudioObjectPropertyAddress kAddresses[] = {
+      {kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, 0},
+      {kAudioHardwarePropertyDefaultOutputDevice, kAudioObjectPropertyScopeGlobal, 0},
+      {kAudioHardwarePropertyDefaultInputDevice, kAudioObjectPropertyScopeGlobal, 0}};
+
+  static OSStatus OnPropertyChange(AudioObjectID, UInt32 count, const AudioObjectPropertyAddress *addresses, void *context)
+  {
+    DeviceWatcher *watcher = static_cast<DeviceWatcher *>(context);
+    for (UInt32 i = 0; i < count; ++i)
+      watcher->Notify(addresses[i].mSelector == kAudioHardwarePropertyDevices ? "added" : "default");
+    return noErr;
+  }
+
+  int listeners_ = 0;
+#elif defined(ZEAKER_WATCH_INOTIFY)
+  // Watcher thread: one notification per batch of device node events, which a card
+  // produces a dozen of at a time (control, pcm and timer nodes)
+  void WatchLoop()
+  {
+    alignas(inotify_event) char buffer[4096];
+    for (;;)
+    {
+      pollfd fds[2] = {{inotifyFd_, POLLIN, 0}, {stopFd_, POLLIN, 0}};
+      if (poll(fds, 2, -1) < 0)
+        continue;
+      if (fds[1].revents & POLLIN)
+        return;
+      bool added = false;
+      bool removed = false;
+      ssize_t n;
+      while ((n = read(inotifyFd_, buffer, sizeof(buffer))) > 0)
+      {
+        for (char *p = buffer; p < buffer + n;)
+        {
+          const inotify_event *event = reinterpret_cast<const inotify_event *>(p);
+          added |= (event->mask & IN_CREATE) != 0;
+          removed |= (event->mask & IN_DELETE) != 0;
+          p += sizeof(inotify_event) + event->len;
+        }
+      }
+      if (removed)
+        Notify("removed");
+      if (added)
+        Notify("added");
+    }
+  }
+
+  std::thread thread_;
+  int inotifyFd_ = -1;
+  int stopFd_ = -1;
+#endif
+
+  Callback callback_;
+  const char *backend_ = nullptr;
+};
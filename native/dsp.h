@@ -0,0 +1,369 @@
+// Per-stream DSP chain run in the audio callback (see setStreamDsp in portaudio.cc):
+// channel matrix, then parametric EQ, then a look-ahead limiter.
+//
+// The main thread edits DspSettings, derives coefficients from them and publishes the
+// result through a triple buffer, so the callback picks up a new parameter set at its
+// next block without ever waiting. EQ and matrix loops run channel-innermost over
+// fixed-size state so the compiler can vectorise them across channels.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "math_constants.h"
+
+static const int kDspMaxChannels = 8;
+static const int kDspMaxEqBands = 16;
+static const double kLimiterMaxLookaheadMs = 20.0;
+
+enum BiquadType : uint32_t
+{
+  kBiquadPeaking = 0,
+  kBiquadLowShelf = 1,
+  kBiquadHighShelf = 2,
+  kBiquadLowPass = 3,
+  kBiquadHighPass = 4
+};
+
+struct BiquadCoeffs
+{
+  float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+};
+
+// RBJ cookbook biquad; gainDb only applies to peaking and shelf filters
+inline BiquadCoeffs DesignBiquad(BiquadType type, double sampleRate, double frequency, double q, double gainDb)
+{
+  const double A = std::pow(10.0, gainDb / 40.0);
+  const double w0 = 2.0 * kPi * std::min(frequency, sampleRate * 0.49) / sampleRate;
+  const double cosw = std::cos(w0);
+  const double alpha = std::sin(w0) / (2.0 * q);
+  const double sqrtA2alpha = 2.0 * std::sqrt(A) * alpha;
+  double b0, b1, b2, a0, a1, a2;
+  switch (type)
+  {
+  case kBiquadLowShelf:
+    b0 = A * ((A + 1) - (A - 1) * cosw + sqrtA2alpha);
+    b1 = 2 * A * ((A - 1) - (A + 1) * cosw);
+    b2 = A * ((A + 1) - (A - 1) * cosw - sqrtA2alpha);
+    a0 = (A + 1) + (A - 1) * cosw + sqrtA2alpha;
+    a1 = -2 * ((A - 1) + (A + 1) * cosw);
+    a2 = (A + 1) + (A - 1) * cosw - sqrtA2alpha;
+    break;
+  case kBiquadHighShelf:
+    b0 = A * ((A + 1) + (A - 1) * cosw + sqrtA2alpha);
+    b1 = -2 * A * ((A - 1) + (A + 1) * cosw);
+    b2 = A * ((A + 1) + (A - 1) * cosw - sqrtA2alpha);
+    a0 = (A + 1) - (A - 1) * cosw + sqrtA2alpha;
+    a1 = 2 * ((A - 1) - (A + 1) * cosw);
+    a2 = (A + 1) - (A - 1) * cosw - sqrtA2alpha;
+    break;
+  case kBiquadLowPass:
+    b0 = (1 - cosw) / 2;
+    b1 = 1 - cosw;
+    b2 = (1 - cosw) / 2;
+    a0 = 1 + alpha;
+    a1 = -2 * cosw;
+    a2 = 1 - alpha;
+    break;
+  case kBiquadHighPass:
+    b0 = (1 + cosw) / 2;
+    b1 = -(1 + cosw);
+    b2 = (1 + cosw) / 2;
+    a0 = 1 + alpha;
+    a1 = -2 * cosw;
+    a2 = 1 - alpha;
+    break;
+  default:
+    b0 = 1 + alpha * A;
+    b1 = -2 * cosw;
+    b2 = 1 - alpha * A;
+    a0 = 1 + alpha / A;
+    a1 = -2 * cosw;
+    a2 = 1 - alpha / A;
+  }
+  BiquadCoeffs c;
+  c.b0 = static_cast<float>(b0 / a0);
+  c.b1 = static_cast<float>(b1 / a0);
+  c.b2 = static_cast<float>(b2 / a0);
+  c.a1 = static_cast<float>(a1 / a0);
+  c.a2 = static_cast<float>(a2 / a0);
+  return c;
+}
+
+// What JS configures (main thread only)
+struct DspSettings
+{
+  struct Band
+  {
+    BiquadType type = kBiquadPeaking;
+    double frequency = 1000.0;
+    double q = 0.7071;
+    double gainDb = 0.0;
+  };
+  int eqBands = 0;
+  Band eq[kDspMaxEqBands];
+  // Row-major: out[o] = sum_i matrix[o * channels + i] * in[i]
+  bool matrixEnabled = false;
+  float matrix[kDspMaxChannels * kDspMaxChannels] = {};
+  bool limiterEnabled = false;
+  double ceilingDb = -1.0;
+  double lookaheadMs = 5.0;
+  double releaseMs = 50.0;
+};
+
+// What the callback runs with, derived from DspSettings for one sample rate
+struct DspParams
+{
+  int eqBands = 0;
+  BiquadCoeffs eq[kDspMaxEqBands];
+  bool matrixEnabled = false;
+  float matrix[kDspMaxChannels * kDspMaxChannels] = {};
+  bool limiterEnabled = false;
+  float ceiling = 1.0f;
+  uint32_t lookaheadFrames = 1;
+  float releaseAlpha = 1.0f;
+};
+
+// Single-producer/single-consumer "latest value" exchange: the writer fills Back() and
+// publishes it, the reader swaps in the newest published value; neither ever waits
+template <typename T>
+class TripleBuffer
+{
+public:
+  T &Back() { return slots_[back_]; }
+
+  void Publish()
+  {
+    back_ = middle_.exchange(back_ | kDirty, std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  // Reader: adopt the newest published value; true if there was one
+  bool Update()
+  {
+    if (!(middle_.load(std::memory_order_relaxed) & kDirty))
+      return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+    return true;
+  }
+
+  const T &Front() const { return slots_[front_]; }
+
+private:
+  static const uint32_t kDirty = 4;
+  static const uint32_t kIndexMask = 3;
+  T slots_[3];
+  uint32_t back_ = 0;
+  std::atomic<uint32_t> middle_{1};
+  uint32_t front_ = 2;
+};
+
+class DspChain
+{
+public:
+  // Main thread, while the callback is not running (before the chain is handed to it,
+  // or with the stream stopped for a device switch); follow with Apply()
+  void Configure(int channels, double sampleRate)
+  {
+    channels_ = channels;
+    sampleRate_ = sampleRate;
+    const uint32_t maxLookahead = static_cast<uint32_t>(kLimiterMaxLookaheadMs * 0.001 * sampleRate) + 1;
+    delay_.assign(static_cast<size_t>(maxLookahead) * channels, 0.0f);
+    minValue_.assign(maxLookahead + 1, 1.0f);
+    minIndex_.assign(maxLookahead + 1, 0);
+    box_.assign(maxLookahead, 1.0f);
+    maxLookahead_ = maxLookahead;
+    // Makes the next Adopt() restart the limiter in the resized buffers
+    lookahead_ = 0;
+  }
+
+  // Main thread: apply new settings (takes effect at the callback's next block)
+  void Apply(const DspSettings &settings)
+  {
+    settings_ = settings;
+    DspParams &p = params_.Back();
+    p.eqBands = settings.eqBands;
+    for (int b = 0; b < settings.eqBands; ++b)
+    {
+      const DspSettings::Band &band = settings.eq[b];
+      p.eq[b] = DesignBiquad(band.type, sampleRate_, band.frequency, band.q, band.gainDb);
+    }
+    p.matrixEnabled = settings.matrixEnabled;
+    std::memcpy(p.matrix, settings.matrix, sizeof(p.matrix));
+    p.limiterEnabled = settings.limiterEnabled;
+    p.ceiling = static_cast<float>(std::pow(10.0, settings.ceilingDb / 20.0));
+    p.lookaheadFrames = LookaheadFrames(settings);
+    p.releaseAlpha = static_cast<float>(1.0 - std::exp(-1000.0 / (std::max(settings.releaseMs, 1.0) * sampleRate_)));
+    params_.Publish();
+  }
+
+  const DspSettings &Settings() const { return settings_; }
+
+  // Frames the limiter delays the output by with the current settings
+  uint32_t LatencyFrames() const
+  {
+    return settings_.limiterEnabled ? LookaheadFrames(settings_) - 1 : 0;
+  }
+
+  // Audio thread: gain the limiter applied to the last frame (1 = none)
+  float LimiterGain() const { return lastGain_.load(std::memory_order_relaxed); }
+
+  // Audio thread: process interleaved float frames in place
+  void Process(float *samples, uint32_t frames)
+  {
+    if (params_.Update())
+      Adopt();
+    const DspParams &p = params_.Front();
+    if (p.matrixEnabled)
+      ProcessMatrix(p, samples, frames);
+    for (int b = 0; b < p.eqBands; ++b)
+      ProcessBiquad(p.eq[b], z1_[b], z2_[b], samples, frames);
+    if (p.limiterEnabled)
+      ProcessLimiter(p, samples, frames);
+  }
+
+private:
+  uint32_t LookaheadFrames(const DspSettings &settings) const
+  {
+    return std::min(std::max<uint32_t>(static_cast<uint32_t>(settings.lookaheadMs * 0.001 * sampleRate_), 1u), maxLookahead_);
+  }
+
+  // Audio thread: reset the state a new parameter set invalidates
+  void Adopt()
+  {
+    const DspParams &p = params_.Front();
+    for (int b = p.eqBands; b < kDspMaxEqBands; ++b)
+    {
+      std::fill(z1_[b], z1_[b] + kDspMaxChannels, 0.0f);
+      std::fill(z2_[b], z2_[b] + kDspMaxChannels, 0.0f);
+    }
+    if (p.lookaheadFrames != lookahead_ || p.limiterEnabled != limiterActive_)
+    {
+      // A new look-ahead (or re-enabling) restarts the delay line
+      lookahead_ = p.lookaheadFrames;
+      limiterActive_ = p.limiterEnabled;
+      std::fill(delay_.begin(), delay_.end(), 0.0f);
+      std::fill(box_.begin(), box_.end(), 1.0f);
+      boxSum_ = lookahead_;
+      minHead_ = minTail_ = 0;
+      release_ = 1.0f;
+      frame_ = 0;
+    }
+  }
+
+  void ProcessMatrix(const DspParams &p, float *samples, uint32_t frames)
+  {
+    const int ch = channels_;
+    float in[kDspMaxChannels];
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+      float *frame = samples + static_cast<size_t>(f) * ch;
+      std::memcpy(in, frame, ch * sizeof(float));
+      for (int o = 0; o < ch; ++o)
+      {
+        float acc = 0.0f;
+        const float *row = p.matrix + o * ch;
+        for (int i = 0; i < ch; ++i)
+          acc += row[i] * in[i];
+        frame[o] = acc;
+      }
+    }
+  }
+
+  // Transposed direct form II, one state pair per channel
+  void ProcessBiquad(const BiquadCoeffs &c, float *z1, float *z2, float *samples, uint32_t frames)
+  {
+    const int ch = channels_;
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+      float *frame = samples + static_cast<size_t>(f) * ch;
+      for (int i = 0; i < ch; ++i)
+      {
+        const float x = frame[i];
+        const float y = c.b0 * x + z1[i];
+        z1[i] = c.b1 * x - c.a1 * y + z2[i];
+        z2[i] = c.b2 * x - c.a2 * y;
+        frame[i] = y;
+      }
+    }
+    // Flush denormals left by decaying tails, which are slow on x86
+    for (int i = 0; i < ch; ++i)
+    {
+      if (std::fabs(z1[i]) < 1e-20f)
+        z1[i] = 0.0f;
+      if (std::fabs(z2[i]) < 1e-20f)
+        z2[i] = 0.0f;
+    }
+  }
+
+  // Brickwall look-ahead limiter. The required gain of each frame goes through a
+  // sliding minimum over the look-ahead window, then a release envelope that may only
+  // stay below it, then a box average over the same window. Every gain in that average
+  // is at most the requirement of the oldest frame in the window, so delaying the
+  // audio by lookahead - 1 frames keeps the output under the ceiling while the gain
+  // moves smoothly.
+  void ProcessLimiter(const DspParams &p, float *samples, uint32_t frames)
+  {
+    const int ch = channels_;
+    const uint32_t L = lookahead_;
+    const uint32_t slots = maxLookahead_ + 1;
+    float gain = 1.0f;
+    for (uint32_t f = 0; f < frames; ++f, ++frame_)
+    {
+      float *frame = samples + static_cast<size_t>(f) * ch;
+      float peak = 0.0f;
+      for (int i = 0; i < ch; ++i)
+        peak = std::max(peak, std::fabs(frame[i]));
+      const float required = peak > p.ceiling ? p.ceiling / peak : 1.0f;
+      // Monotonic queue of (value, frame) holding the window minimum at its head
+      while (minTail_ != minHead_ && minValue_[(minTail_ + slots - 1) % slots] >= required)
+        minTail_ = (minTail_ + slots - 1) % slots;
+      minValue_[minTail_] = required;
+      minIndex_[minTail_] = frame_;
+      minTail_ = (minTail_ + 1) % slots;
+      while (frame_ - minIndex_[minHead_] >= L)
+        minHead_ = (minHead_ + 1) % slots;
+      const float windowMin = minValue_[minHead_];
+      release_ = std::min(windowMin, release_ + (1.0f - release_) * p.releaseAlpha);
+      const uint32_t pos = static_cast<uint32_t>(frame_ % L);
+      boxSum_ += release_ - box_[pos];
+      box_[pos] = release_;
+      gain = std::min(static_cast<float>(boxSum_ / L), 1.0f);
+      // Delay line of L - 1 frames (none for a one-frame look-ahead): the slot after
+      // this frame's holds the frame written L - 1 frames ago
+      const float *delayed = delay_.data() + static_cast<size_t>((frame_ + 1) % L) * ch;
+      float *slot = delay_.data() + static_cast<size_t>(pos) * ch;
+      for (int i = 0; i < ch; ++i)
+      {
+        const float x = frame[i];
+        const float out = (L > 1 ? delayed[i] : x) * gain;
+        slot[i] = x;
+        // Guard against rounding in the running sum
+        frame[i] = std::min(std::max(out, -p.ceiling), p.ceiling);
+      }
+    }
+    lastGain_.store(gain, std::memory_order_relaxed);
+  }
+
+  int channels_ = 2;
+  double sampleRate_ = 44100.0;
+  DspSettings settings_;
+  TripleBuffer<DspParams> params_;
+  float z1_[kDspMaxEqBands][kDspMaxChannels] = {};
+  float z2_[kDspMaxEqBands][kDspMaxChannels] = {};
+  // Limiter state (audio thread)
+  uint32_t maxLookahead_ = 1;
+  uint32_t lookahead_ = 0;
+  bool limiterActive_ = false;
+  std::vector<float> delay_;
+  std::vector<float> minValue_;
+  std::vector<uint64_t> minIndex_;
+  uint32_t minHead_ = 0, minTail_ = 0;
+  std::vector<float> box_;
+  double boxSum_ = 0.0;
+  float release_ = 1.0f;
+  uint64_t frame_ = 0;
+  std::atomic<float> lastGain_{1.0f};
+};
@@ -0,0 +1,147 @@
+// Input side of duplex streams (the input stream option and openCaptureStream()).
+//
+// The callback that plays a stream also receives its input, so monitoring happens in
+// place: the input is mixed into the output of the same callback, and the monitoring
+// latency is the device's input plus output latency with no event-loop trip. Talkover
+// ducking lowers the playback mix while the input is active. Captured audio (the input,
+// or the output mix for loopback recording) goes to a float32 PcmRing that JS drains in
+// large batches (see PcmRingReader in src/utils/RingBuffer.js).
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+// What the capture ring records
+enum CaptureSource
+{
+  kCaptureNone = 0,
+  kCaptureInput,
+  // The final output mix, as sent to the device (loopback recording)
+  kCaptureOutput
+};
+
+struct DuplexSettings
+{
+  // Linear gain of the input in the output mix (0: not monitored)
+  float monitorGain = 0.0f;
+  bool duck = false;
+  // Playback gain while the input is active
+  float duckGain = 0.25f;
+  // Input peak above which the input counts as active (about -40 dBFS)
+  float duckThreshold = 0.01f;
+  float attackMs = 10.0f;
+  float releaseMs = 300.0f;
+  // How long the duck holds after the input falls silent, so pauses between words
+  // do not pump the playback
+  float holdMs = 250.0f;
+};
+
+class DuplexProcessor
+{
+public:
+  // Main thread, before the stream starts (and after a rate change)
+  void Configure(int inputChannels, int outputChannels, double sampleRate)
+  {
+    inputChannels_ = std::max(inputChannels, 1);
+    outputChannels_ = std::max(outputChannels, 1);
+    sampleRate_ = sampleRate > 0 ? sampleRate : 48000.0;
+    Apply(settings_);
+  }
+
+  // Main thread: publish new settings; the callback picks them up on its next block
+  void Apply(const DuplexSettings &settings)
+  {
+    settings_ = settings;
+    monitorGain_.store(std::max(settings.monitorGain, 0.0f), std::memory_order_relaxed);
+    duckGain_.store(std::min(std::max(settings.duckGain, 0.0f), 1.0f), std::memory_order_relaxed);
+    duckThreshold_.store(std::max(settings.duckThreshold, 0.0f), std::memory_order_relaxed);
+    attackCoef_.store(SmoothingCoef(settings.attackMs), std::memory_order_relaxed);
+    releaseCoef_.store(SmoothingCoef(settings.releaseMs), std::memory_order_relaxed);
+    holdFrames_.store(static_cast<uint32_t>(std::max(settings.holdMs, 0.0f) * 0.001 * sampleRate_), std::memory_order_relaxed);
+    duck_.store(settings.duck, std::memory_order_release);
+  }
+
+  const DuplexSettings &Settings() const { return settings_; }
+  int InputChannels() const { return inputChannels_; }
+
+  // Audio thread: duck the playback in `mix` by the input's activity, then add the
+  // monitored input. `input` holds `frames` interleaved frames of inputChannels; output
+  // channel c monitors input channel c modulo the input channel count (a mono microphone
+  // is heard on every channel)
+  void Process(const float *input, float *mix, uint32_t frames)
+  {
+    const float monitor = monitorGain_.load(std::memory_order_relaxed);
+    const bool duck = duck_.load(std::memory_order_acquire);
+    const float peak = Meter(input, frames);
+    if (duck || gain_ != 1.0f)
+    {
+      if (duck && peak >= duckThreshold_.load(std::memory_order_relaxed))
+        holdRemaining_ = holdFrames_.load(std::memory_order_relaxed) + frames;
+      const float target = duck && holdRemaining_ > 0 ? duckGain_.load(std::memory_order_relaxed) : 1.0f;
+      const float coef = target < gain_ ? attackCoef_.load(std::memory_order_relaxed) : releaseCoef_.load(std::memory_order_relaxed);
+      for (uint32_t f = 0; f < frames; ++f)
+      {
+        gain_ += (target - gain_) * coef;
+        float *frame = mix + static_cast<size_t>(f) * outputChannels_;
+        for (int c = 0; c < outputChannels_; ++c)
+          frame[c] *= gain_;
+      }
+      // Snap once the release has converged, so the common path skips the loop
+      if (target == 1.0f && gain_ > 0.9999f)
+        gain_ = 1.0f;
+      holdRemaining_ -= std::min(holdRemaining_, frames);
+    }
+    if (monitor > 0.0f)
+    {
+      for (uint32_t f = 0; f < frames; ++f)
+      {
+        const float *in = input + static_cast<size_t>(f) * inputChannels_;
+        float *frame = mix + static_cast<size_t>(f) * outputChannels_;
+        for (int c = 0; c < outputChannels_; ++c)
+          frame[c] += in[c % inputChannels_] * monitor;
+      }
+    }
+    duckLevel_.store(gain_, std::memory_order_relaxed);
+  }
+
+  // Audio thread: record the input's peak level (capture-only streams stop here)
+  float Meter(const float *input, uint32_t frames)
+  {
+    float peak = 0.0f;
+    for (uint32_t i = 0; i < frames * static_cast<uint32_t>(inputChannels_); ++i)
+      peak = std::max(peak, std::fabs(input[i]));
+    peak_.store(peak, std::memory_order_relaxed);
+    return peak;
+  }
+
+  // Metering for getDuplexState(): last block's input peak and the playback gain applied
+  float InputPeak() const { return peak_.load(std::memory_order_relaxed); }
+  float DuckLevel() const { return duckLevel_.load(std::memory_order_relaxed); }
+
+private:
+  // One-pole coefficient that covers ~63% of a step in `ms`
+  float SmoothingCoef(float ms) const
+  {
+    const double frames = std::max(static_cast<double>(ms), 0.1) * 0.001 * sampleRate_;
+    return static_cast<float>(1.0 - std::exp(-1.0 / frames));
+  }
+
+  DuplexSettings settings_;
+  int inputChannels_ = 1;
+  int outputChannels_ = 2;
+  double sampleRate_ = 48000.0;
+  std::atomic<float> monitorGain_{0.0f};
+  std::atomic<bool> duck_{false};
+  std::atomic<float> duckGain_{0.25f};
+  std::atomic<float> duckThreshold_{0.01f};
+  std::atomic<float> attackCoef_{1.0f};
+  std::atomic<float> releaseCoef_{1.0f};
+  std::atomic<uint32_t> holdFrames_{0};
+  // Audio thread state
+  float gain_ = 1.0f;
+  uint32_t holdRemaining_ = 0;
+  std::atomic<float> peak_{0.0f};
+  std::atomic<float> duckLevel_{1.0f};
+};
@@ -0,0 +1,115 @@
+// Real-time-safe stream event reporting.
+//
+// The audio callback must never block or allocate, so it only bumps atomic counters
+// (status flags such as underflows) and posts fixed-size records into a lock-free
+// single-producer/single-consumer queue (discrete events such as a voice ending).
+// A non-real-time dispatcher drains both periodically and coalesces them before
+// anything crosses into JS (see EventDispatchLoop in portaudio.cc).
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+enum StreamEventType : uint32_t
+{
+  kEventOutputUnderflow = 0,
+  kEventOutputOverflow,
+  kEventPrimingOutput,
+  kEventVoiceEnded,
+  kEventInputOverflow,
+  kStreamEventTypeCount
+};
+
+inline const char *StreamEventName(uint32_t type)
+{
+  switch (type)
+  {
+  case kEventOutputUnderflow:
+    return "outputUnderflow";
+  case kEventOutputOverflow:
+    return "outputOverflow";
+  case kEventPrimingOutput:
+    return "primingOutput";
+  case kEventVoiceEnded:
+    return "voiceEnded";
+  case kEventInputOverflow:
+    return "inputOverflow";
+  default:
+    return "unknown";
+  }
+}
+
+// Plural noun used in coalesced messages ("37 underflows in the last 100 ms")
+inline const char *StreamEventNoun(uint32_t type)
+{
+  switch (type)
+  {
+  case kEventOutputUnderflow:
+    return "underflows";
+  case kEventOutputOverflow:
+    return "overflows";
+  case kEventPrimingOutput:
+    return "priming callbacks";
+  case kEventInputOverflow:
+    return "input overflows";
+  default:
+    return "events";
+  }
+}
+
+struct StreamEventRecord
+{
+  uint32_t type;
+  int32_t arg;
+};
+
+// Bounded SPSC queue; Push() is wait-free and fails instead of blocking when full
+template <typename T, uint32_t N>
+class SpscQueue
+{
+  static_assert((N & (N - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+  bool Push(const T &item)
+  {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == N)
+      return false;
+    items_[head & (N - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Pop(T *item)
+  {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+      return false;
+    *item = items_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  alignas(64) std::atomic<uint32_t> head_{0};
+  alignas(64) std::atomic<uint32_t> tail_{0};
+  T items_[N];
+};
+
+// Per-stream event state written by the audio callback
+struct StreamEventChannel
+{
+  // Callback: count a status flag occurrence
+  void Count(uint32_t type) { counts[type].fetch_add(1, std::memory_order_relaxed); }
+
+  // Callback: post a discrete event; counted as dropped if the dispatcher fell behind
+  void Post(uint32_t type, int32_t arg)
+  {
+    if (!queue.Push(StreamEventRecord{type, arg}))
+      dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  std::atomic<uint32_t> counts[kStreamEventTypeCount] = {};
+  std::atomic<uint32_t> dropped{0};
+  SpscQueue<StreamEventRecord, 256> queue;
+};
@@ -0,0 +1,287 @@
+// One decoder feeding several ring-mode streams (attachFanOut(), multi-zone playback).
+//
+// A single producer thread reads the decoder pipe once and copies every chunk into one
+// voice ring per output, so N rooms cost one decode and amount to N rings of PCM. The
+// outputs run on independent device clocks, so each one's programme position drifts
+// away from the first output's (the reference) by the clocks' difference, tens of ppm,
+// which is audible as phasing between rooms within minutes. The producer measures each
+// output's position from its ring fill level and the device's output latency, and
+// trims the speed of that voice's varispeed resampler with a PI controller (a few
+// hundred ppm at most: inaudible) until the positions agree.
+//
+// Per-output delay (e.g. for a room further from the listener) is silence put in front
+// of that output's programme, and is honoured by the controller.
+//
+// An output that is paused, or whose device stopped consuming, is left out of the
+// pacing and drops what does not fit in its ring, so one room cannot stall the others.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <unistd.h>
+#include "ring_buffer.h"
+#include "resampler.h"
+
+struct FanOutTarget
+{
+  PcmRing *ring = nullptr;
+  // The voice's varispeed resampler, trimmed for drift
+  Resampler *resampler = nullptr;
+  // Set while the output's stream is paused (it outputs silence and consumes nothing)
+  const std::atomic<bool> *paused = nullptr;
+  uint32_t bytesPerFrame = 8;
+  // Source rate of the ring's PCM and the device's output latency in source frames
+  double sourceRate = 44100.0;
+  double latencyFrames = 0.0;
+  // Silence put in front of the programme, in frames
+  uint64_t delayFrames = 0;
+  // Producer-owned
+  uint64_t silencePending = 0;
+  // Last time the ring had room; an output without any for kStallMs is stalled
+  std::chrono::steady_clock::time_point lastRoom;
+  double integral = 0.0;
+  double filteredError = 0.0;
+  bool measured = false;
+  // Published for getFanOutState(): last offset from the reference and applied speed
+  std::atomic<double> offsetMs{0.0};
+  std::atomic<double> speedPpm{0.0};
+};
+
+struct FanOutSettings
+{
+  // Largest speed trim, in ppm
+  double maxCorrectionPpm = 500.0;
+  // Proportional and integral gains: ppm of correction per ms of offset, and per ms*s
+  double proportionalPpmPerMs = 100.0;
+  double integralPpmPerMsSecond = 5.0;
+  // Offsets are averaged over about this long, since callbacks consume a period at a time
+  double smoothingMs = 500.0;
+};
+
+class FanOutGroup
+{
+public:
+  ~FanOutGroup() { Stop(); }
+
+  // Main thread, before Start()
+  void Add(std::unique_ptr<FanOutTarget> target) { targets_.push_back(std::move(target)); }
+
+  void Configure(const FanOutSettings &settings) { settings_ = settings; }
+
+  // Main thread: the producer takes ownership of fd and runs until EOF or Stop()
+  template <typename StartThread>
+  void Start(int fd, StartThread &&startThread)
+  {
+    fd_ = fd;
+    active_ = targets_.size();
+    // Lower-latency outputs start later by the difference, so all start in step
+    double maxLatency = 0.0;
+    for (auto &target : targets_)
+      maxLatency = std::max(maxLatency, target->latencyFrames);
+    const auto now = std::chrono::steady_clock::now();
+    for (auto &target : targets_)
+    {
+      target->silencePending = target->delayFrames + static_cast<uint64_t>(maxLatency - target->latencyFrames);
+      target->lastRoom = now;
+    }
+    thread_ = startThread([this] { Run(); });
+  }
+
+  // Main thread (the target's voice is being released): stop writing to its ring. When
+  // it returns the producer no longer touches it. The last detach stops the producer.
+  void Detach(const PcmRing *ring)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto &target : targets_)
+      {
+        if (target && target->ring == ring)
+        {
+          target.reset();
+          --active_;
+        }
+      }
+    }
+    if (active_ == 0)
+      Stop();
+  }
+
+  void Stop()
+  {
+    stop_.store(true, std::memory_order_relaxed);
+    if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id())
+      thread_.join();
+  }
+
+  // Main thread: state of the target fed into `ring`, for getFanOutState()
+  bool State(const PcmRing *ring, double *offsetMs, double *speedPpm)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &target : targets_)
+    {
+      if (target && target->ring == ring)
+      {
+        *offsetMs = target->offsetMs.load(std::memory_order_relaxed);
+        *speedPpm = target->speedPpm.load(std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  static const uint32_t kChunkBytes = 16384;
+  static const int kControlIntervalMs = 20;
+  // Far longer than any device period, so only a device that stopped counts as stalled
+  static const int kStallMs = 500;
+
+  static bool Stalled(const FanOutTarget &target, std::chrono::steady_clock::time_point now)
+  {
+    return target.paused->load(std::memory_order_relaxed) || now - target.lastRoom > std::chrono::milliseconds(kStallMs);
+  }
+
+  void Run()
+  {
+    std::vector<uint8_t> chunk(kChunkBytes);
+    std::vector<uint8_t> silence(kChunkBytes, 0);
+    // All outputs take the same PCM; only whole frames are copied, so that an output
+    // that drops data stays frame aligned. A partial frame read waits in `carry`.
+    const uint32_t frameBytes = targets_[0]->bytesPerFrame;
+    uint32_t carry = 0;
+    auto lastControl = std::chrono::steady_clock::now();
+    while (!stop_.load(std::memory_order_relaxed))
+    {
+      const auto now = std::chrono::steady_clock::now();
+      const double elapsed = std::chrono::duration<double>(now - lastControl).count();
+      if (elapsed * 1000.0 >= kControlIntervalMs)
+      {
+        Control(elapsed, now);
+        lastControl = now;
+      }
+      // Copy when every live output has room, so no output ever gets ahead of the others
+      uint32_t space = kChunkBytes;
+      bool live = false;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &target : targets_)
+        {
+          if (!target)
+            continue;
+          if (target->silencePending > 0)
+          {
+            const uint64_t frames = std::min<uint64_t>(target->silencePending, target->ring->WriteAvailable() / target->bytesPerFrame);
+            const uint32_t bytes = static_cast<uint32_t>(std::min<uint64_t>(frames * target->bytesPerFrame, kChunkBytes));
+            target->silencePending -= target->ring->Write(silence.data(), bytes) / target->bytesPerFrame;
+          }
+          const uint32_t room = target->ring->WriteAvailable();
+          if (room > 0)
+            target->lastRoom = now;
+          if (Stalled(*target, now))
+            continue;
+          live = true;
+          space = std::min(space, room);
+        }
+      }
+      // With no live output (all paused, say) nothing is read, so nothing is lost
+      space = live ? space / frameBytes * frameBytes : 0;
+      if (space == 0)
+      {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        continue;
+      }
+      struct pollfd pfd = {fd_, POLLIN, 0};
+      int ready = poll(&pfd, 1, 50);
+      if (ready < 0 && errno == EINTR)
+        continue;
+      if (ready < 0)
+        break;
+      if (ready == 0)
+        continue;
+      ssize_t n = read(fd_, chunk.data() + carry, space - carry);
+      if (n < 0 && (errno == EINTR || errno == EAGAIN))
+        continue;
+      if (n <= 0)
+        break;
+      const uint32_t bytes = carry + static_cast<uint32_t>(n);
+      const uint32_t whole = bytes / frameBytes * frameBytes;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &target : targets_)
+        {
+          // Live outputs have room for all of it; stalled ones keep what fits
+          if (target)
+            target->ring->Write(chunk.data(), std::min(whole, target->ring->WriteAvailable() / frameBytes * frameBytes));
+        }
+      }
+      carry = bytes - whole;
+      std::memmove(chunk.data(), chunk.data() + whole, carry);
+    }
+    close(fd_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &target : targets_)
+    {
+      if (target)
+        target->ring->MarkEndOfStream();
+    }
+  }
+
+  // Programme frames an output has sent to its speaker plus the delay it was given, up to
+  // a constant shared by all outputs (the programme written): only differences count
+  static double Position(const FanOutTarget &target)
+  {
+    const double buffered = static_cast<double>(target.ring->ReadAvailable()) / target.bytesPerFrame;
+    return static_cast<double>(target.delayFrames) - static_cast<double>(target.silencePending) - buffered - target.latencyFrames;
+  }
+
+  // Steer every output towards the reference (the first live output still attached)
+  void Control(double elapsedSeconds, std::chrono::steady_clock::time_point now)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    FanOutTarget *reference = nullptr;
+    for (auto &target : targets_)
+    {
+      if (target && !Stalled(*target, now))
+      {
+        reference = target.get();
+        break;
+      }
+    }
+    if (!reference)
+      return;
+    const double referenceMs = Position(*reference) * 1000.0 / reference->sourceRate;
+    const double alpha = std::min(1.0, elapsedSeconds * 1000.0 / settings_.smoothingMs);
+    for (auto &target : targets_)
+    {
+      if (!target || target.get() == reference || Stalled(*target, now))
+        continue;
+      // Positive: this output is ahead of the reference
+      const double errorMs = Position(*target) * 1000.0 / target->sourceRate - referenceMs;
+      target->filteredError = target->measured ? target->filteredError + (errorMs - target->filteredError) * alpha : errorMs;
+      target->measured = true;
+      const double limit = settings_.maxCorrectionPpm;
+      // Anti-windup: the integral alone never exceeds the correction limit
+      target->integral = std::min(std::max(target->integral + target->filteredError * elapsedSeconds * settings_.integralPpmPerMsSecond, -limit), limit);
+      const double ppm = std::min(std::max(-(target->filteredError * settings_.proportionalPpmPerMs + target->integral), -limit), limit);
+      target->resampler->SetSpeed(1.0 + ppm * 1e-6);
+      target->offsetMs.store(target->filteredError, std::memory_order_relaxed);
+      target->speedPpm.store(ppm, std::memory_order_relaxed);
+    }
+  }
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<FanOutTarget>> targets_;
+  FanOutSettings settings_;
+  std::atomic<size_t> active_{0};
+  std::atomic<bool> stop_{false};
+  std::thread thread_;
+  int fd_ = -1;
+};
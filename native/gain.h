@@ -0,0 +1,102 @@
+// Gain stage for the output path.
+//
+// ApplyGain() scales interleaved float samples from a source into a destination
+// (which may be the same buffer), vectorised with AVX, SSE2 or NEON when the
+// compiler targets them. VolumeRamp smooths stream volume changes per sample so
+// setStreamVolume() never causes zipper noise.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ZEAKER_GAIN_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+// dst[i] = src[i] * gain for `count` samples; src and dst may alias exactly
+inline void ApplyGain(const float *src, float *dst, size_t count, float gain)
+{
+  if (gain == 1.0f)
+  {
+    if (src != dst)
+      std::memcpy(dst, src, count * sizeof(float));
+    return;
+  }
+  size_t i = 0;
+#if defined(__AVX__)
+  const __m256 g = _mm256_set1_ps(gain);
+  for (; i + 8 <= count; i += 8)
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), g));
+#elif defined(ZEAKER_GAIN_SSE2)
+  const __m128 g = _mm_set1_ps(gain);
+  for (; i + 4 <= count; i += 4)
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  const float32x4_t g = vdupq_n_f32(gain);
+  for (; i + 4 <= count; i += 4)
+    vst1q_f32(dst + i, vmulq_f32(vld1q_f32(src + i), g));
+#endif
+  for (; i < count; ++i)
+    dst[i] = src[i] * gain;
+}
+
+// Stream volume with per-sample smoothing. The main thread publishes a target and a
+// ramp length; the audio consumer (callback or blocking writer) owns the current gain.
+class VolumeRamp
+{
+public:
+  // Main thread: ramp to `target` over `rampFrames` frames (0 jumps immediately)
+  void Set(float target, uint32_t rampFrames)
+  {
+    pendingRamp_.store(rampFrames, std::memory_order_relaxed);
+    target_.store(target, std::memory_order_release);
+  }
+
+  float Target() const { return target_.load(std::memory_order_relaxed); }
+
+  // Consumer: true when Process() would leave samples unchanged
+  bool IsUnity() const
+  {
+    return remaining_ == 0 && current_ == 1.0f && target_.load(std::memory_order_acquire) == 1.0f;
+  }
+
+  // Consumer: dst = src * gain over interleaved frames, advancing any ramp in progress
+  void Process(const float *src, float *dst, uint32_t frames, int channels)
+  {
+    float target = target_.load(std::memory_order_acquire);
+    if (target != rampTarget_)
+    {
+      rampTarget_ = target;
+      remaining_ = pendingRamp_.load(std::memory_order_relaxed);
+      if (remaining_ == 0)
+        current_ = target;
+      else
+        step_ = (target - current_) / static_cast<float>(remaining_);
+    }
+    uint32_t f = 0;
+    for (; f < frames && remaining_ > 0; ++f)
+    {
+      current_ = --remaining_ == 0 ? rampTarget_ : current_ + step_;
+      for (int c = 0; c < channels; ++c)
+        dst[f * channels + c] = src[f * channels + c] * current_;
+    }
+    if (f < frames)
+      ApplyGain(src + f * channels, dst + f * channels, static_cast<size_t>(frames - f) * channels, current_);
+  }
+
+private:
+  std::atomic<float> target_{1.0f};
+  std::atomic<uint32_t> pendingRamp_{0};
+  // Consumer-owned state
+  float current_ = 1.0f;
+  float rampTarget_ = 1.0f;
+  float step_ = 0.0f;
+  uint32_t remaining_ = 0;
+};
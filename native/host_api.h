@@ -0,0 +1,155 @@
+// Host-API-specific stream settings (the hostApi, clipOff and ditherOff stream options).
+//
+// A stream's settings name what it wants from each host API (WASAPI exclusive mode and
+// thread priority, an ALSA device string such as "hw:0,0" for direct hardware access,
+// CoreAudio device-parameter changes); only the entry for the host API of the device
+// actually opened is used, so one configuration works on every platform and survives a
+// device switch. The extension structs come from PortAudio's pa_win_wasapi.h,
+// pa_linux_alsa.h and pa_mac_core.h; a build without those headers still opens
+// streams, but reports any host setting the device would have needed as unsupported.
+#pragma once
+
+#include <portaudio.h>
+#include <string>
+#if defined(_WIN32) && defined(__has_include)
+#if __has_include(<pa_win_wasapi.h>)
+#include <pa_win_wasapi.h>
+#define ZEAKER_HAVE_WASAPI 1
+#endif
+#elif defined(__APPLE__) && defined(__has_include)
+#if __has_include(<pa_mac_core.h>)
+#include <pa_mac_core.h>
+#define ZEAKER_HAVE_MAC_CORE 1
+#endif
+#elif defined(__linux__) && defined(__has_include)
+#if __has_include(<pa_linux_alsa.h>)
+#include <pa_linux_alsa.h>
+#define ZEAKER_HAVE_ALSA 1
+#endif
+#endif
+
+// WASAPI thread priority names, in PaWasapiThreadPriority order
+static const char *const kWasapiThreadPriorities[] = {"none", "audio", "capture", "distribution", "games", "playback", "proAudio", "windowManager"};
+static const int kWasapiThreadPriorityCount = 8;
+
+struct HostApiSettings
+{
+  // paClipOff / paDitherOff
+  PaStreamFlags flags = paNoFlag;
+  bool wasapiExclusive = false;
+  // Index into kWasapiThreadPriorities, or -1 to leave PortAudio's choice
+  int wasapiThreadPriority = -1;
+  bool wasapiPolling = false;
+  bool wasapiAutoConvert = false;
+  // ALSA device string ("hw:1,0"); replaces the device index
+  std::string alsaDevice;
+  bool alsaRealtime = false;
+  bool macChangeDeviceParameters = false;
+  bool macFailIfConversionRequired = false;
+
+  bool Wasapi() const { return wasapiExclusive || wasapiThreadPriority >= 0 || wasapiPolling || wasapiAutoConvert; }
+  bool Alsa() const { return !alsaDevice.empty() || alsaRealtime; }
+  bool MacCore() const { return macChangeDeviceParameters || macFailIfConversionRequired; }
+};
+
+// Host-specific struct handed to Pa_OpenStream, which copies what it needs
+struct HostApiStreamInfo
+{
+#ifdef ZEAKER_HAVE_WASAPI
+  PaWasapiStreamInfo wasapi;
+#endif
+#ifdef ZEAKER_HAVE_MAC_CORE
+  PaMacCoreStreamInfo macCore;
+#endif
+#ifdef ZEAKER_HAVE_ALSA
+  PaAlsaStreamInfo alsa;
+#endif
+  int unused = 0;
+};
+
+inline PaHostApiTypeId DeviceHostApiType(PaDeviceIndex device)
+{
+  const PaDeviceInfo *dev = Pa_GetDeviceInfo(device);
+  const PaHostApiInfo *api = dev ? Pa_GetHostApiInfo(dev->hostApi) : nullptr;
+  return api ? api->type : paInDevelopment;
+}
+
+// Point params at the settings for its device's host API. Returns false, with a message,
+// if the device needs a setting this build cannot apply
+inline bool PrepareHostApiStream(const HostApiSettings &settings, PaStreamParameters *params, HostApiStreamInfo *storage,
+                                 std::string *error)
+{
+  params->hostApiSpecificStreamInfo = nullptr;
+  const PaHostApiTypeId type = DeviceHostApiType(params->device);
+  if (type == paWASAPI && settings.Wasapi())
+  {
+#ifdef ZEAKER_HAVE_WASAPI
+    PaWasapiStreamInfo &info = storage->wasapi;
+    info = PaWasapiStreamInfo();
+    info.size = sizeof(PaWasapiStreamInfo);
+    info.hostApiType = paWASAPI;
+    info.version = 1;
+    if (settings.wasapiExclusive)
+      info.flags |= paWinWasapiExclusive;
+    if (settings.wasapiPolling)
+      info.flags |= paWinWasapiPolling;
+    if (settings.wasapiAutoConvert)
+      info.flags |= paWinWasapiAutoConvert;
+    if (settings.wasapiThreadPriority >= 0)
+    {
+      info.flags |= paWinWasapiThreadPriority;
+      info.threadPriority = static_cast<PaWasapiThreadPriority>(settings.wasapiThreadPriority);
+    }
+    params->hostApiSpecificStreamInfo = &info;
+#else
+    *error = "WASAPI stream settings are not available in this build";
+    return false;
+#endif
+  }
+  else if (type == paALSA && settings.Alsa())
+  {
+#ifdef ZEAKER_HAVE_ALSA
+    if (!settings.alsaDevice.empty())
+    {
+      PaAlsaStreamInfo &info = storage->alsa;
+      PaAlsa_InitializeStreamInfo(&info);
+      info.deviceString = settings.alsaDevice.c_str();
+      params->device = paUseHostApiSpecificDeviceSpecification;
+      params->hostApiSpecificStreamInfo = &info;
+    }
+#else
+    *error = "ALSA stream settings are not available in this build";
+    return false;
+#endif
+  }
+  else if (type == paCoreAudio && settings.MacCore())
+  {
+#ifdef ZEAKER_HAVE_MAC_CORE
+    unsigned long flags = 0;
+    if (settings.macChangeDeviceParameters)
+      flags |= paMacCoreChangeDeviceParameters;
+    if (settings.macFailIfConversionRequired)
+      flags |= paMacCoreFailIfConversionRequired;
+    PaMacCore_SetupStreamInfo(&storage->macCore, flags);
+    params->hostApiSpecificStreamInfo = &storage->macCore;
+#else
+    *error = "CoreAudio stream settings are not available in this build";
+    return false;
+#endif
+  }
+  (void)storage;
+  return true;
+}
+
+// After Pa_OpenStream succeeded and before the stream starts
+inline void FinishHostApiStream(const HostApiSettings &settings, PaDeviceIndex device, PaStream *stream)
+{
+#ifdef ZEAKER_HAVE_ALSA
+  if (settings.alsaRealtime && DeviceHostApiType(device) == paALSA)
+    PaAlsa_EnableRealtimeScheduling(stream, 1);
+#else
+  (void)settings;
+  (void)device;
+  (void)stream;
+#endif
+}
@@ -0,0 +1,276 @@
+// Offline loudness measurement (see AnalyzeLoudnessAsync in portaudio.cc).
+//
+// ITU-R BS.1770-4 / EBU R128: K-weighted, channel-weighted energy in 400 ms blocks
+// every 100 ms, gated at -70 LUFS and 10 LU below the ungated mean for integrated
+// loudness; loudness range (EBU Tech 3342) from 3 s short-term values gated at -70 LUFS
+// and 20 LU below their mean, as the 10th to 95th percentile spread; true peak from 4x
+// oversampling. Meant for a worker thread: it runs in double precision and keeps one
+// float per 100 ms of audio.
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "math_constants.h"
+
+static const int kLoudnessMaxChannels = 8;
+// ReplayGain 2.0 reference level
+static const double kReplayGainReferenceLufs = -18.0;
+
+struct LoudnessResult
+{
+  // LUFS; -inf for silence
+  double integrated = -HUGE_VAL;
+  // LU
+  double range = 0.0;
+  // dBTP and dBFS; -inf for silence
+  double truePeak = -HUGE_VAL;
+  double samplePeak = -HUGE_VAL;
+  uint64_t frames = 0;
+};
+
+class LoudnessMeter
+{
+public:
+  // False for channel counts or rates the meter does not handle
+  bool Configure(int channels, double sampleRate)
+  {
+    if (channels <= 0 || channels > kLoudnessMaxChannels || !(sampleRate >= 8000.0))
+      return false;
+    channels_ = channels;
+    sampleRate_ = sampleRate;
+    DesignKWeighting(sampleRate);
+    for (int c = 0; c < channels; ++c)
+      weight_[c] = 1.0;
+    // BS.1770 surround weights for the usual 5.0 and 5.1 orders (L R C [LFE] Ls Rs)
+    if (channels == 5)
+      weight_[3] = weight_[4] = 1.41;
+    else if (channels == 6)
+    {
+      weight_[3] = 0.0;
+      weight_[4] = weight_[5] = 1.41;
+    }
+    hopFrames_ = std::max<uint32_t>(static_cast<uint32_t>(std::lround(sampleRate / 10.0)), 1);
+    DesignOversampler();
+    std::fill(&z_[0][0], &z_[0][0] + sizeof(z_) / sizeof(double), 0.0);
+    std::fill(&history_[0][0], &history_[0][0] + sizeof(history_) / sizeof(float), 0.0f);
+    hopEnergy_ = 0.0;
+    hopFill_ = 0;
+    hops_.clear();
+    blocks_.clear();
+    shortTerm_.clear();
+    peak_ = truePeak_ = 0.0;
+    frames_ = 0;
+    return true;
+  }
+
+  // Interleaved float frames
+  void Process(const float *samples, size_t frames)
+  {
+    for (size_t f = 0; f < frames; ++f)
+    {
+      const float *frame = samples + f * channels_;
+      for (int c = 0; c < channels_; ++c)
+      {
+        const double x = frame[c];
+        peak_ = std::max(peak_, std::fabs(x));
+        TruePeakSample(c, frame[c]);
+        if (weight_[c] == 0.0)
+          continue;
+        // Pre-filter (high shelf) then RLB high-pass, transposed direct form II
+        double *z = z_[c];
+        const double s = shelfB_[0] * x + z[0];
+        z[0] = shelfB_[1] * x - shelfA_[1] * s + z[1];
+        z[1] = shelfB_[2] * x - shelfA_[2] * s;
+        const double y = s + z[2];
+        z[2] = -2.0 * s - highA_[1] * y + z[3];
+        z[3] = s - highA_[2] * y;
+        hopEnergy_ += weight_[c] * y * y;
+      }
+      if (++hopFill_ == hopFrames_)
+        EndHop();
+    }
+    frames_ += frames;
+  }
+
+  LoudnessResult Finish() const
+  {
+    LoudnessResult result;
+    result.frames = frames_;
+    result.samplePeak = peak_ > 0.0 ? 20.0 * std::log10(peak_) : -HUGE_VAL;
+    const double tp = std::max(truePeak_, peak_);
+    result.truePeak = tp > 0.0 ? 20.0 * std::log10(tp) : -HUGE_VAL;
+    result.integrated = GatedLoudness(blocks_, -10.0);
+    result.range = LoudnessRange();
+    return result;
+  }
+
+private:
+  static double EnergyToLufs(double z) { return -0.691 + 10.0 * std::log10(z); }
+  static double LufsToEnergy(double l) { return std::pow(10.0, (l + 0.691) / 10.0); }
+
+  void DesignKWeighting(double rate)
+  {
+    // BS.1770 coefficients re-derived for the rate (they are given for 48 kHz)
+    const double f0 = 1681.974450955533, G = 3.999843853973347, Q = 0.7071752369554196;
+    double K = std::tan(kPi * f0 / rate);
+    const double Vh = std::pow(10.0, G / 20.0);
+    const double Vb = std::pow(Vh, 0.4996667741545416);
+    double a0 = 1.0 + K / Q + K * K;
+    shelfB_[0] = (Vh + Vb * K / Q + K * K) / a0;
+    shelfB_[1] = 2.0 * (K * K - Vh) / a0;
+    shelfB_[2] = (Vh - Vb * K / Q + K * K) / a0;
+    shelfA_[1] = 2.0 * (K * K - 1.0) / a0;
+    shelfA_[2] = (1.0 - K / Q + K * K) / a0;
+    const double f1 = 38.13547087602444, Q1 = 0.5003270373238773;
+    K = std::tan(kPi * f1 / rate);
+    a0 = 1.0 + K / Q1 + K * K;
+    highA_[1] = 2.0 * (K * K - 1.0) / a0;
+    highA_[2] = (1.0 - K / Q1 + K * K) / a0;
+  }
+
+  // 4x polyphase interpolator: 48-tap Blackman-windowed sinc, each phase normalised to
+  // unity gain at DC
+  void DesignOversampler()
+  {
+    const int taps = kPhases * kPhaseTaps;
+    const double centre = (taps - 1) / 2.0;
+    for (int p = 0; p < kPhases; ++p)
+    {
+      double sum = 0.0;
+      for (int t = 0; t < kPhaseTaps; ++t)
+      {
+        const int n = t * kPhases + p;
+        const double x = (n - centre) / kPhases;
+        const double sinc = x == 0.0 ? 1.0 : std::sin(kPi * x) / (kPi * x);
+        const double w = 0.42 - 0.5 * std::cos(2.0 * kPi * n / (taps - 1)) + 0.08 * std::cos(4.0 * kPi * n / (taps - 1));
+        phase_[p][t] = sinc * w;
+        sum += phase_[p][t];
+      }
+      for (int t = 0; t < kPhaseTaps; ++t)
+        phase_[p][t] /= sum;
+    }
+  }
+
+  void TruePeakSample(int c, float x)
+  {
+    float *h = history_[c];
+    std::copy_backward(h, h + kPhaseTaps - 1, h + kPhaseTaps);
+    h[0] = x;
+    for (int p = 0; p < kPhases; ++p)
+    {
+      double y = 0.0;
+      for (int t = 0; t < kPhaseTaps; ++t)
+        y += phase_[p][t] * h[t];
+      truePeak_ = std::max(truePeak_, std::fabs(y));
+    }
+  }
+
+  // Every 100 ms: close the 400 ms block and the 3 s window ending here
+  void EndHop()
+  {
+    hops_.push_back(hopEnergy_);
+    hopEnergy_ = 0.0;
+    hopFill_ = 0;
+    if (hops_.size() > kShortTermHops)
+      hops_.erase(hops_.begin());
+    if (hops_.size() >= kBlockHops)
+    {
+      double sum = 0.0;
+      for (size_t i = hops_.size() - kBlockHops; i < hops_.size(); ++i)
+        sum += hops_[i];
+      blocks_.push_back(static_cast<float>(sum / (static_cast<double>(kBlockHops) * hopFrames_)));
+    }
+    if (hops_.size() == kShortTermHops)
+    {
+      double sum = 0.0;
+      for (double e : hops_)
+        sum += e;
+      shortTerm_.push_back(static_cast<float>(sum / (static_cast<double>(kShortTermHops) * hopFrames_)));
+    }
+  }
+
+  // Mean loudness of the energies above -70 LUFS and `relativeGate` LU below their mean
+  static double GatedLoudness(const std::vector<float> &energies, double relativeGate)
+  {
+    const double absolute = LufsToEnergy(-70.0);
+    double sum = 0.0;
+    size_t count = 0;
+    for (float z : energies)
+    {
+      if (z > absolute)
+      {
+        sum += z;
+        ++count;
+      }
+    }
+    if (count == 0)
+      return -HUGE_VAL;
+    const double relative = LufsToEnergy(EnergyToLufs(sum / count) + relativeGate);
+    sum = 0.0;
+    count = 0;
+    for (float z : energies)
+    {
+      if (z > absolute && z > relative)
+      {
+        sum += z;
+        ++count;
+      }
+    }
+    return count > 0 ? EnergyToLufs(sum / count) : -HUGE_VAL;
+  }
+
+  double LoudnessRange() const
+  {
+    const double absolute = LufsToEnergy(-70.0);
+    double sum = 0.0;
+    size_t count = 0;
+    for (float z : shortTerm_)
+    {
+      if (z > absolute)
+      {
+        sum += z;
+        ++count;
+      }
+    }
+    if (count == 0)
+      return 0.0;
+    const double relative = LufsToEnergy(EnergyToLufs(sum / count) - 20.0);
+    std::vector<double> levels;
+    for (float z : shortTerm_)
+    {
+      if (z > absolute && z > relative)
+        levels.push_back(EnergyToLufs(z));
+    }
+    if (levels.size() < 2)
+      return 0.0;
+    std::sort(levels.begin(), levels.end());
+    const size_t last = levels.size() - 1;
+    return levels[static_cast<size_t>(std::lround(0.95 * last))] - levels[static_cast<size_t>(std::lround(0.10 * last))];
+  }
+
+  static const int kPhases = 4;
+  static const int kPhaseTaps = 12;
+  static const size_t kBlockHops = 4;
+  static const size_t kShortTermHops = 30;
+
+  int channels_ = 2;
+  double sampleRate_ = 48000.0;
+  double weight_[kLoudnessMaxChannels] = {};
+  double shelfB_[3] = {}, shelfA_[3] = {}, highA_[3] = {};
+  double z_[kLoudnessMaxChannels][4] = {};
+  double phase_[kPhases][kPhaseTaps] = {};
+  float history_[kLoudnessMaxChannels][kPhaseTaps] = {};
+  uint32_t hopFrames_ = 4800;
+  uint32_t hopFill_ = 0;
+  double hopEnergy_ = 0.0;
+  // Energy of the last 30 hops (unnormalised sums), oldest first
+  std::vector<double> hops_;
+  // Mean-square energies of every 400 ms block and 3 s window
+  std::vector<float> blocks_;
+  std::vector<float> shortTerm_;
+  double peak_ = 0.0;
+  double truePeak_ = 0.0;
+  uint64_t frames_ = 0;
+};
@@ -0,0 +1,7 @@
+// Mathematical constants shared by the DSP headers.
+//
+// M_PI is not standard C++ (MSVC only defines it with _USE_MATH_DEFINES before the
+// first <cmath>), so filters, windows and FFT twiddles use these instead.
+#pragma once
+
+static constexpr double kPi = 3.14159265358979323846;
@@ -0,0 +1,504 @@
+// Multi-voice mixer for ring-mode streams.
+//
+// Every voice owns a PcmRing (in the stream's sample format) and a gain envelope;
+// the PortAudio callback sums all active voices into a float output buffer. The main thread only publishes
+// state through atomics (voice state, envelope seqlock), so mixing stays
+// lock-free and crossfades/gapless hand-offs are sample accurate.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "ring_buffer.h"
+#include "gain.h"
+#include "sample_format.h"
+#include "resampler.h"
+
+static const int kMaxVoices = 8;
+
+// Largest block rendered in one pass; longer callbacks are split into blocks
+static const uint32_t kMixBlockFrames = 1024;
+
+// Length of the fades that hide a seek: in-ring jumps fade out and back in, splices
+// onto a replacement voice crossfade
+static const uint32_t kSeekFadeFrames = 256;
+
+// Curve shapes, matching validateCrossfadeCurve() in src/utils/AudioUtils.js
+enum CrossfadeCurve : int32_t
+{
+  kCurveLinear = 0,
+  kCurveLogarithmic = 1,
+  kCurveExponential = 2,
+  kCurveEqualPower = 3
+};
+
+enum VoiceState : int32_t
+{
+  kVoiceFree = 0,     // slot unused, owned by the main thread
+  kVoiceActive = 1,   // mixed by the callback
+  kVoiceRetiring = 2  // removed, waiting for the callback to stop touching it
+};
+
+// Rising shape for x in [0, 1]
+inline float CurveValue(int32_t curve, float x)
+{
+  switch (curve)
+  {
+  case kCurveLogarithmic:
+    return std::log10(9.0f * x + 1.0f);
+  case kCurveExponential:
+    return x <= 0.0f ? 0.0f : std::pow(2.0f, 10.0f * (x - 1.0f));
+  case kCurveEqualPower:
+    return std::sin(x * 1.57079632679f);
+  default:
+    return x;
+  }
+}
+
+// Gain envelope whose target is published from the main thread through a seqlock.
+// Fades out use the complement of the rising curve (as mixCrossfade does), except
+// equal-power which mirrors it so that power stays constant across a crossfade.
+class GainEnvelope
+{
+public:
+  // Main thread, only while the voice is not active
+  void Reset(float gain)
+  {
+    gain_ = start_ = target_ = gain;
+    rampFrames_ = rampPos_ = 0;
+    seen_ = seq_.load(std::memory_order_relaxed);
+    published_.store(gain, std::memory_order_relaxed);
+  }
+
+  // Main thread: ramp from whatever the current gain is to `target`
+  void Set(float target, uint32_t rampFrames, int32_t curve)
+  {
+    uint32_t s = seq_.load(std::memory_order_relaxed);
+    seq_.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    pendingTarget_.store(target, std::memory_order_relaxed);
+    pendingRamp_.store(rampFrames, std::memory_order_relaxed);
+    pendingCurve_.store(curve, std::memory_order_relaxed);
+    seq_.store(s + 2, std::memory_order_release);
+  }
+
+  // Callback: pick up a newly published target, if any
+  void Poll()
+  {
+    uint32_t s1 = seq_.load(std::memory_order_acquire);
+    if (s1 == seen_ || (s1 & 1))
+      return;
+    float target = pendingTarget_.load(std::memory_order_relaxed);
+    uint32_t ramp = pendingRamp_.load(std::memory_order_relaxed);
+    int32_t curve = pendingCurve_.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq_.load(std::memory_order_relaxed) != s1)
+      return; // torn read, retry next block
+    seen_ = s1;
+    start_ = gain_;
+    target_ = target;
+    curve_ = curve;
+    rampFrames_ = ramp;
+    rampPos_ = 0;
+    if (ramp == 0)
+      gain_ = target;
+  }
+
+  // Callback: fade from silence up to the current target (a splice starting this voice)
+  void FadeIn(uint32_t frames, int32_t curve)
+  {
+    start_ = gain_ = 0.0f;
+    curve_ = curve;
+    rampFrames_ = frames;
+    rampPos_ = 0;
+  }
+
+  // Callback: fade from the current gain to silence (a splice replacing this voice)
+  void FadeOut(uint32_t frames, int32_t curve)
+  {
+    start_ = gain_;
+    target_ = 0.0f;
+    curve_ = curve;
+    rampFrames_ = frames;
+    rampPos_ = 0;
+  }
+
+  bool Ramping() const { return rampPos_ < rampFrames_; }
+  float Gain() const { return gain_; }
+
+  // Callback: multiply interleaved frames by the envelope, advancing it
+  void Apply(float *buf, uint32_t frames, int channels)
+  {
+    if (!Ramping())
+    {
+      ApplyGain(buf, buf, static_cast<size_t>(frames) * channels, gain_);
+    }
+    else
+    {
+      for (uint32_t f = 0; f < frames; ++f)
+      {
+        if (rampPos_ < rampFrames_)
+        {
+          float x = static_cast<float>(++rampPos_) / rampFrames_;
+          if (target_ >= start_)
+            gain_ = start_ + (target_ - start_) * CurveValue(curve_, x);
+          else if (curve_ == kCurveEqualPower)
+            gain_ = target_ + (start_ - target_) * CurveValue(curve_, 1.0f - x);
+          else
+            gain_ = start_ - (start_ - target_) * CurveValue(curve_, x);
+        }
+        for (int c = 0; c < channels; ++c)
+          buf[f * channels + c] *= gain_;
+      }
+    }
+    published_.store(gain_, std::memory_order_relaxed);
+  }
+
+  // Any thread: last gain reached by the callback
+  float PublishedGain() const { return published_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint32_t> seq_{0};
+  std::atomic<float> pendingTarget_{1.0f};
+  std::atomic<uint32_t> pendingRamp_{0};
+  std::atomic<int32_t> pendingCurve_{kCurveLinear};
+  std::atomic<float> published_{1.0f};
+  // Callback-owned state
+  uint32_t seen_ = 0;
+  float gain_ = 1.0f;
+  float start_ = 1.0f;
+  float target_ = 1.0f;
+  int32_t curve_ = kCurveLinear;
+  uint32_t rampFrames_ = 0;
+  uint32_t rampPos_ = 0;
+};
+
+struct MixerVoice
+{
+  std::atomic<int32_t> state{kVoiceFree};
+  // Index of the voice this one starts after (gapless), or -1 to start immediately
+  std::atomic<int32_t> follows{-1};
+  std::atomic<bool> started{false};
+  std::atomic<bool> finished{false};
+  PcmRing ring;
+  GainEnvelope envelope;
+  // Fixed per-track gain on top of the envelope (loudness normalisation), set from JS
+  std::atomic<float> trim{1.0f};
+  // Converts the ring's source rate to the stream rate (inactive when they match)
+  Resampler resampler;
+  // Requested read position in frames since the voice started, or -1 (see Mixer::ApplySeek)
+  std::atomic<int64_t> seekFrame{-1};
+  // Voice this one takes over from once prefillFrames are buffered (a seek splice), or -1
+  std::atomic<int32_t> replaces{-1};
+  uint32_t prefillFrames = 0;
+  // Callback-owned: frames read from the ring since the voice started (moved by seeks)
+  // and the furthest read so far
+  uint64_t position = 0;
+  uint64_t highWater = 0;
+  // Callback-owned: seek fade on top of the envelope (-1 fading out, 1 fading in)
+  int32_t seekFadeDir = 0;
+  uint32_t seekFadeRemaining = 0;
+  // Callback-owned: set on a voice being replaced, which finishes once it has faded out
+  bool retireAfterFade = false;
+  // Callback-owned: where in the current block the voice ran dry after end-of-stream
+  // (-1 while it still has data), used to start a follower at the exact next sample
+  int32_t endedAtFrame = -1;
+  bool renderedThisBlock = false;
+};
+
+class Mixer
+{
+public:
+  void Configure(int channels, PaSampleFormat format = paFloat32)
+  {
+    channels_ = channels;
+    format_ = format;
+    bytesPerFrame_ = channels * BytesPerSample(format);
+    scratch_.assign(kMixBlockFrames * channels, 0.0f);
+    if (format != paFloat32)
+      rawScratch_.assign(kMixBlockFrames * bytesPerFrame_, 0);
+  }
+
+  // Main thread, only while the voice is not active: rate of the PCM written to its ring
+  // (varispeed keeps the resampler running at equal rates for drift compensation)
+  void SetVoiceRate(int index, double sourceRate, double outputRate, int32_t quality, bool varispeed = false)
+  {
+    voices_[index].resampler.Configure(channels_, sourceRate, outputRate, quality, varispeed);
+  }
+
+  // Main thread, only while the stream is stopped: the stream rate changed (new device)
+  void Retune(double outputRate)
+  {
+    for (MixerVoice &v : voices_)
+    {
+      if (v.state.load(std::memory_order_acquire) != kVoiceFree)
+        v.resampler.Retune(outputRate);
+    }
+  }
+
+  MixerVoice &Voice(int index) { return voices_[index]; }
+  const MixerVoice &Voice(int index) const { return voices_[index]; }
+
+  // Callback: mix all active voices into `out` (interleaved float, frames <= any size)
+  void Render(float *out, uint32_t frames)
+  {
+    while (frames > 0)
+    {
+      uint32_t block = frames < kMixBlockFrames ? frames : kMixBlockFrames;
+      RenderBlock(out, block);
+      out += block * channels_;
+      frames -= block;
+    }
+  }
+
+  // Callback: voices that ran out since the last call, as a bit mask
+  uint32_t TakeEndedMask()
+  {
+    uint32_t mask = endedMask_;
+    endedMask_ = 0;
+    return mask;
+  }
+
+  // Callback: output frames that carried audio from at least one voice since the last call
+  uint32_t TakeDeliveredFrames()
+  {
+    uint32_t frames = deliveredFrames_;
+    deliveredFrames_ = 0;
+    return frames;
+  }
+
+  // Callback: frames voices had to skip for lack of data since the last call
+  uint32_t TakeStarvedFrames()
+  {
+    uint32_t frames = starvedFrames_;
+    starvedFrames_ = 0;
+    return frames;
+  }
+
+private:
+  void RenderBlock(float *out, uint32_t frames)
+  {
+    std::memset(out, 0, static_cast<size_t>(frames) * channels_ * sizeof(float));
+    blockCovered_ = 0;
+    for (MixerVoice &v : voices_)
+    {
+      v.renderedThisBlock = false;
+      v.endedAtFrame = -1;
+    }
+    StartSplices();
+    // Voices that are already playing first, then followers whose leader just ended;
+    // repeat so chained gapless queues resolve within one block
+    for (int pass = 0; pass <= kMaxVoices; ++pass)
+    {
+      bool progressed = false;
+      for (int i = 0; i < kMaxVoices; ++i)
+      {
+        MixerVoice &v = voices_[i];
+        if (v.renderedThisBlock || v.state.load(std::memory_order_acquire) != kVoiceActive)
+          continue;
+        uint32_t offset = 0;
+        if (!v.started.load(std::memory_order_relaxed))
+        {
+          if (v.replaces.load(std::memory_order_relaxed) >= 0)
+            continue; // waiting in StartSplices()
+          int32_t leader = v.follows.load(std::memory_order_relaxed);
+          if (leader >= 0 && leader < kMaxVoices && leader != i)
+          {
+            const MixerVoice &l = voices_[leader];
+            bool leaderLive = l.state.load(std::memory_order_acquire) == kVoiceActive && !l.finished.load(std::memory_order_relaxed);
+            if (leaderLive && !(l.renderedThisBlock && l.endedAtFrame >= 0))
+              continue; // leader still playing (or not rendered yet this pass)
+            if (leaderLive)
+              offset = static_cast<uint32_t>(l.endedAtFrame);
+          }
+          v.started.store(true, std::memory_order_relaxed);
+        }
+        RenderVoice(v, out, offset, frames);
+        progressed = true;
+      }
+      if (!progressed)
+        break;
+    }
+    deliveredFrames_ += blockCovered_;
+  }
+
+  // Start replacement voices whose data is ready: both sides crossfade within this block,
+  // and voices queued after the replaced one follow the replacement instead
+  void StartSplices()
+  {
+    for (int i = 0; i < kMaxVoices; ++i)
+    {
+      MixerVoice &v = voices_[i];
+      if (v.state.load(std::memory_order_acquire) != kVoiceActive || v.started.load(std::memory_order_relaxed))
+        continue;
+      int32_t replaced = v.replaces.load(std::memory_order_relaxed);
+      if (replaced < 0 || replaced >= kMaxVoices || replaced == i)
+        continue;
+      MixerVoice &r = voices_[replaced];
+      if (r.state.load(std::memory_order_acquire) == kVoiceActive && !r.finished.load(std::memory_order_relaxed))
+      {
+        if (v.ring.ReadAvailable() < v.prefillFrames * bytesPerFrame_ && !v.ring.EndOfStream())
+          continue; // the replaced voice keeps playing until the decoder has caught up
+        r.envelope.FadeOut(kSeekFadeFrames, kCurveEqualPower);
+        r.retireAfterFade = true;
+        v.envelope.FadeIn(kSeekFadeFrames, kCurveEqualPower);
+        for (MixerVoice &f : voices_)
+        {
+          if (f.follows.load(std::memory_order_relaxed) == replaced)
+            f.follows.store(i, std::memory_order_relaxed);
+        }
+      }
+      v.replaces.store(-1, std::memory_order_relaxed);
+      v.started.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  void RenderVoice(MixerVoice &v, float *out, uint32_t offset, uint32_t frames)
+  {
+    v.renderedThisBlock = true;
+    v.envelope.Poll();
+    if (v.finished.load(std::memory_order_relaxed))
+      return;
+    uint32_t wanted = frames - offset;
+    uint32_t done = 0;
+    // Seeks inside the buffered window fade out, move the read position, then fade in
+    if (v.seekFrame.load(std::memory_order_acquire) >= 0 && v.seekFadeDir >= 0)
+    {
+      v.seekFadeRemaining = v.seekFadeDir > 0 ? kSeekFadeFrames - v.seekFadeRemaining : kSeekFadeFrames;
+      v.seekFadeDir = -1;
+    }
+    if (v.seekFadeDir < 0)
+    {
+      uint32_t fade = v.seekFadeRemaining < wanted ? v.seekFadeRemaining : wanted;
+      done = RenderSpan(v, out, offset, fade, v.ring.EndOfStream());
+      if (v.seekFadeRemaining == 0 || done < fade)
+      {
+        ApplySeek(v);
+        v.seekFadeDir = 1;
+        v.seekFadeRemaining = kSeekFadeFrames;
+      }
+    }
+    // Check end-of-stream before reading availability so no trailing data is missed
+    bool eos = v.ring.EndOfStream();
+    uint32_t n = RenderSpan(v, out, offset + done, wanted - done, eos);
+    bool dry = n < wanted - done;
+    bool ended = dry && (v.resampler.Active() ? v.resampler.Drained() : eos);
+    // A replaced voice ends when its splice fade has run out
+    if (v.retireAfterFade && (dry || !v.envelope.Ramping()))
+      ended = true;
+    n += done;
+    if (ended)
+    {
+      v.endedAtFrame = static_cast<int32_t>(offset + n);
+      v.finished.store(true, std::memory_order_relaxed);
+      endedMask_ |= 1u << (&v - voices_);
+    }
+    else if (dry)
+    {
+      starvedFrames_ += wanted - n;
+    }
+  }
+
+  // Render up to `frames` frames of a voice into out[offset..]; returns frames rendered
+  uint32_t RenderSpan(MixerVoice &v, float *out, uint32_t offset, uint32_t frames, bool eos)
+  {
+    if (frames == 0)
+      return 0;
+    uint32_t n;
+    if (v.resampler.Active())
+      n = v.resampler.Render(scratch_.data(), frames, [this, &v](float *dst, uint32_t maxFrames)
+                             { return ReadFrames(v, dst, maxFrames); }, eos);
+    else
+      n = ReadFrames(v, scratch_.data(), frames);
+    if (n == 0)
+      return 0;
+    v.envelope.Apply(scratch_.data(), n, channels_);
+    if (v.seekFadeDir != 0)
+      ApplySeekFade(v, n);
+    float *dst = out + offset * channels_;
+    // Folded into the mix so a trim costs no extra pass
+    const float trim = v.trim.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < n * channels_; ++i)
+      dst[i] += scratch_[i] * trim;
+    if (offset + n > blockCovered_)
+      blockCovered_ = offset + n;
+    return n;
+  }
+
+  void ApplySeekFade(MixerVoice &v, uint32_t frames)
+  {
+    const float step = 1.0f / kSeekFadeFrames;
+    for (uint32_t f = 0; f < frames; ++f)
+    {
+      if (v.seekFadeRemaining > 0)
+        --v.seekFadeRemaining;
+      float g = v.seekFadeDir < 0 ? v.seekFadeRemaining * step : 1.0f - v.seekFadeRemaining * step;
+      for (int c = 0; c < channels_; ++c)
+        scratch_[f * channels_ + c] *= g;
+    }
+    if (v.seekFadeDir > 0 && v.seekFadeRemaining == 0)
+      v.seekFadeDir = 0;
+  }
+
+  // Move a voice's read position to its requested seek frame, clamped to the data still
+  // in the ring: everything buffered ahead, and the retained history behind. The producer
+  // may still be filling towards the furthest read index it saw, so history is counted
+  // back from there.
+  void ApplySeek(MixerVoice &v)
+  {
+    int64_t target = v.seekFrame.exchange(-1, std::memory_order_acq_rel);
+    if (target < 0)
+      return;
+    const int64_t ahead = v.ring.ReadAvailable() / bytesPerFrame_;
+    int64_t behind = v.ring.HistoryAvailable() / bytesPerFrame_;
+    behind = std::min<int64_t>(behind, static_cast<int64_t>(v.ring.Retain() / bytesPerFrame_) - static_cast<int64_t>(v.highWater - v.position));
+    behind = std::max<int64_t>(std::min<int64_t>(behind, static_cast<int64_t>(v.position)), 0);
+    int64_t delta = target - static_cast<int64_t>(v.position);
+    delta = std::min(std::max(delta, -behind), ahead);
+    if (delta != 0)
+    {
+      v.ring.Skip(static_cast<int32_t>(delta * bytesPerFrame_));
+      v.position = static_cast<uint64_t>(static_cast<int64_t>(v.position) + delta);
+    }
+    // Whatever the filter buffered belongs to the old position
+    if (v.resampler.Active())
+      v.resampler.Reset();
+  }
+
+  // Copy up to maxFrames (<= kMixBlockFrames) frames out of a voice ring as float
+  uint32_t ReadFrames(MixerVoice &v, float *dst, uint32_t maxFrames)
+  {
+    uint32_t avail = v.ring.ReadAvailable() / bytesPerFrame_;
+    uint32_t n = avail < maxFrames ? avail : maxFrames;
+    if (n == 0)
+      return 0;
+    if (format_ == paFloat32)
+    {
+      v.ring.Read(dst, n * bytesPerFrame_);
+    }
+    else
+    {
+      v.ring.Read(rawScratch_.data(), n * bytesPerFrame_);
+      SamplesToFloat(format_, rawScratch_.data(), dst, static_cast<size_t>(n) * channels_);
+    }
+    v.position += n;
+    if (v.position > v.highWater)
+      v.highWater = v.position;
+    return n;
+  }
+
+  MixerVoice voices_[kMaxVoices];
+  std::vector<float> scratch_;
+  std::vector<uint8_t> rawScratch_;
+  uint32_t endedMask_ = 0;
+  uint32_t starvedFrames_ = 0;
+  uint32_t deliveredFrames_ = 0;
+  // Furthest frame of the current block any voice wrote to
+  uint32_t blockCovered_ = 0;
+  int channels_ = 2;
+  PaSampleFormat format_ = paFloat32;
+  uint32_t bytesPerFrame_ = 2 * sizeof(float);
+};
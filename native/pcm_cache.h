@@ -0,0 +1,69 @@
+// Header of decoded-PCM cache files (see src/utils/PcmCache.js, which writes them).
+//
+// A cache file is one little-endian header padded to kPcmCacheHeaderBytes, so the
+// sample data that follows is page aligned for mmap, then raw interleaved frames in
+// the stream's sample format. Keep the layout in sync with PcmCache.js.
+//
+//   byte 0   magic "ZKPCM001"
+//   byte 8   header size   (uint32, kPcmCacheHeaderBytes)
+//   byte 12  sample rate   (uint32)
+//   byte 16  channels      (uint32)
+//   byte 20  sample format (uint32, see kPcmCacheFormat*)
+//   byte 24  flags         (uint32, see kPcmCacheFlag*)
+//   byte 32  frames        (uint64)
+#pragma once
+
+#include <portaudio.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "sample_format.h"
+
+static const uint32_t kPcmCacheHeaderBytes = 4096;
+static const char kPcmCacheMagic[8] = {'Z', 'K', 'P', 'C', 'M', '0', '0', '1'};
+
+// Set once the file holds a complete decode
+static const uint32_t kPcmCacheFlagComplete = 1u << 0;
+
+enum PcmCacheFormat : uint32_t
+{
+  kPcmCacheFormatFloat32 = 0,
+  kPcmCacheFormatInt16 = 1,
+  kPcmCacheFormatInt24 = 2,
+  kPcmCacheFormatInt32 = 3
+};
+
+struct PcmCacheHeader
+{
+  uint32_t sampleRate = 0;
+  uint32_t channels = 0;
+  PaSampleFormat sampleFormat = paFloat32;
+  uint64_t frames = 0;
+};
+
+inline uint32_t ReadLE32(const uint8_t *p)
+{
+  return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+// Parse and validate a mapped cache file; false if it is not a complete cache file
+// whose data fits in `size` bytes
+inline bool ParsePcmCacheHeader(const uint8_t *data, size_t size, PcmCacheHeader *header)
+{
+  if (size < kPcmCacheHeaderBytes || std::memcmp(data, kPcmCacheMagic, sizeof(kPcmCacheMagic)) != 0)
+    return false;
+  if (ReadLE32(data + 8) != kPcmCacheHeaderBytes || !(ReadLE32(data + 24) & kPcmCacheFlagComplete))
+    return false;
+  static const PaSampleFormat kFormats[] = {paFloat32, paInt16, paInt24, paInt32};
+  uint32_t format = ReadLE32(data + 20);
+  if (format > kPcmCacheFormatInt32)
+    return false;
+  header->sampleRate = ReadLE32(data + 12);
+  header->channels = ReadLE32(data + 16);
+  header->sampleFormat = kFormats[format];
+  header->frames = static_cast<uint64_t>(ReadLE32(data + 32)) | static_cast<uint64_t>(ReadLE32(data + 36)) << 32;
+  if (header->sampleRate == 0 || header->channels == 0)
+    return false;
+  const uint64_t bytes = header->frames * header->channels * BytesPerSample(header->sampleFormat);
+  return bytes <= size - kPcmCacheHeaderBytes;
+}
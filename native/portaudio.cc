@@ -5,68 +5,926 @@
 #include <map>
 #include <atomic>
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "ring_buffer.h"
+#include "mixer.h"
+#include "gain.h"
+#include "sample_format.h"
+#include "stream_writer.h"
+#include "event_queue.h"
+#include "stream_stats.h"
+#include "stream_clock.h"
+#include "pcm_cache.h"
+#include "block_pool.h"
+#include "wav_decoder.h"
+#include "device_caps.h"
+#include "analysis.h"
+#include "dsp.h"
+#include "loudness.h"
+#include "thread_tuning.h"
+#include "host_api.h"
+#include "duplex.h"
+#include "device_watch.h"
+#ifndef _WIN32
+#include "fan_out.h"
+#endif
+#ifdef ZEAKER_BENCH
+#include "bench/null_device.h"
+#endif
 
-// ThreadSafeFunction for async callback
-static std::unique_ptr<Napi::ThreadSafeFunction> g_audioCallbackTsfn;
+// Probed device capabilities, valid until the device list changes
+static CapabilityCache g_capabilityCache;
 
-// ThreadSafeFunction for event callback
-static std::unique_ptr<Napi::ThreadSafeFunction> g_eventCallbackTsfn;
+// Device rescans (refreshDevicesAsync) terminate and reinitialise PortAudio, which frees
+// every PaDeviceInfo and reassigns indices: they hold this exclusively, and anything
+// that reads the device list or opens a stream holds it shared
+static std::shared_mutex g_deviceListMutex;
+// Streams open in any environment; a background rescan only runs when there are none
+static std::atomic<int> g_liveStreams{0};
+
+struct LiveStreamCount
+{
+  LiveStreamCount() { g_liveStreams.fetch_add(1, std::memory_order_relaxed); }
+  ~LiveStreamCount() { Forget(); }
+  // The stream never opens a device (offline streams)
+  void Forget()
+  {
+    if (counted_)
+      g_liveStreams.fetch_sub(1, std::memory_order_relaxed);
+    counted_ = false;
+  }
+  LiveStreamCount(const LiveStreamCount &) = delete;
+  LiveStreamCount &operator=(const LiveStreamCount &) = delete;
+
+private:
+  bool counted_ = true;
+};
 
 // --- Stream state ---
+
+struct StreamInfo;
+// Runs a callback stream's JS audio callback on the main thread (see RefillCallbackRing)
+static void CallAudioJs(Napi::Env env, Napi::Function jsCallback, StreamInfo *sinfo, void *);
+using AudioCallbackTsfn = Napi::TypedThreadSafeFunction<StreamInfo, void, CallAudioJs>;
+
+// Main-thread resources behind one mixer voice
+struct VoiceResources
+{
+  Napi::ObjectReference storage;
+  // Native reader thread that fills the voice's ring from a decoder pipe (see AttachPipe)
+  std::thread pipeThread;
+  std::atomic<bool> pipeStop{false};
+#ifndef _WIN32
+  // Shared decoder feeding this voice and voices of other streams (see AttachFanOut)
+  std::shared_ptr<FanOutGroup> fanOut;
+#endif
+  // Callback epoch at which the voice was retired; reclaimed once the callback moved on
+  uint64_t retireEpoch = 0;
+  // Rate of the PCM written to the ring (the resampler converts it to the stream rate)
+  double sourceRate = 0.0;
+  // Ring storage locked in memory (lockMemory option), unlocked when the voice is freed
+  const void *lockedData = nullptr;
+  size_t lockedBytes = 0;
+};
+
+// One renderStreamAsync() call: its request, filled in by the render thread, and the
+// promise settled on the main thread once the thread has been joined
+struct OfflineRenderJob
+{
+  explicit OfflineRenderJob(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env)) {}
+
+  Napi::Promise::Deferred deferred;
+  uint64_t frames = 0;
+  bool untilEnd = false;
+  int fd = -1;
+  uint64_t offset = 0;
+  uint32_t waitMs = 2000;
+  // Render thread results
+  uint64_t rendered = 0;
+  bool ended = false;
+  uint32_t stalls = 0;
+  double renderSeconds = 0.0;
+  std::string error;
+  std::vector<uint8_t> output;
+};
+
 struct StreamInfo
 {
-  PaStream *stream;
-  float volume;
+  uint32_t id = 0;
+  PaStream *stream = nullptr;
+  // Created before a stream is opened and gone once it is closed
+  LiveStreamCount live;
+  // Output gain, smoothed per sample towards the last setStreamVolume() target
+  VolumeRamp volume;
+  double volumeRampMs = 20.0;
+  std::atomic<bool> paused{false};
+  int channels = 2;
+  double sampleRate = 44100.0;
+  // Device sample format; rings, queues and writeStream() data all use it unconverted
+  PaSampleFormat sampleFormat = paFloat32;
+  uint32_t bytesPerFrame = 2 * sizeof(float);
+  uint64_t defaultRingFrames = 0;
+  // Consumed frames every voice keeps behind its read position for in-place seeks back
+  uint64_t retainFrames = 0;
+  // Ring-mode streams pull PCM from mixer voices (voice 0 is the stream ring) shared
+  // with JS instead of calling into JS
+  bool ringMode = false;
+  // Bit-perfect ring streams copy voice 0 straight to the device (no mixing or gain)
+  bool bitPerfect = false;
+  Mixer mixer;
+  // Rate of the PCM written to voice rings (per voice override via addVoice) and the
+  // quality of the conversion to the stream rate when they differ
+  double sourceSampleRate = 44100.0;
+  int32_t resampleQuality = kResampleHigh;
+  // Float mix buffer for integer-format ring streams (kMixBlockFrames frames)
+  std::vector<float> mixScratch;
+  VoiceResources voices[kMaxVoices];
+  unsigned long framesPerBuffer = 256;
+  // Output device and requested latency (<= 0: device default), kept for switchStreamDevice()
+  int device = 0;
+  double suggestedLatency = 0.0;
+  // Blocking-mode staging buffers so writeStream() never scales the caller's samples
+  std::vector<uint8_t> writeScratch;
+  std::vector<float> writeFloatScratch;
+  // Blocking-mode background writer behind writeStreamAsync(), created on first use,
+  // with the promises waiting for its queue to drain below the high-water mark
+  size_t writeHighWaterMark = 0;
+  std::unique_ptr<StreamWriter> writer;
+  std::unique_ptr<Napi::ThreadSafeFunction> writerTsfn;
+  std::vector<Napi::Promise::Deferred> writeWaiters;
+  // Incremented after every ring-mode callback, used to reclaim retired voices safely
+  std::atomic<uint64_t> callbackEpoch{0};
+  // Offline streams (offline option) have no device: renderStreamAsync() runs the ring
+  // callback on renderThread against a virtual clock, as fast as the voices are fed.
+  // rendering is set while the thread may run the callback; renderJob lives from the
+  // call until its promise is settled
+  bool offline = false;
+  std::atomic<bool> rendering{false};
+  std::atomic<bool> renderStop{false};
+  uint64_t renderedFrames = 0;
+  std::thread renderThread;
+  std::unique_ptr<OfflineRenderJob> renderJob;
+  std::unique_ptr<Napi::ThreadSafeFunction> renderTsfn;
+  // Status flags and discrete events posted by the audio callback (see event_queue.h)
+  StreamEventChannel events;
+  // Cumulative callback telemetry for getStreamStats() (see stream_stats.h)
+  StreamStats stats;
+  // Playback position published by the callback into an ArrayBuffer JS reads directly
+  StreamClock clock;
+  Napi::ObjectReference clockStorage;
+  // Callback mode: the JS callback fills one period at a time into callbackBuffer (a
+  // Float32Array created once and reused), which is queued in callbackRing for the audio
+  // callback. Both are allocated when the stream opens, so steady-state playback
+  // allocates nothing; fillPending keeps at most one refill request in flight.
+  PcmRing callbackRing;
+  std::vector<uint8_t> callbackRingStorage;
+  Napi::ObjectReference callbackBuffer;
+  std::atomic<bool> fillPending{false};
+  // Per-stream callback context: JS audio callback (callback mode) and event channel.
+  // Both are fixed for the lifetime of the stream and released only when it closes.
+  std::unique_ptr<AudioCallbackTsfn> audioTsfn;
+  std::unique_ptr<Napi::ThreadSafeFunction> eventTsfn;
+  // Output analysis for visualization (see SetAnalysisTap): results are copied into
+  // analysisBuffer, a Float32Array that the analysisResult object's views share
+  AnalysisTap analysis;
+  std::unique_ptr<Napi::ThreadSafeFunction> analysisTsfn;
+  Napi::ObjectReference analysisBuffer;
+  Napi::ObjectReference analysisResult;
+  std::atomic<bool> analysisPending{false};
+  // Output DSP (EQ, channel matrix, limiter; see SetStreamDsp), created on first use and
+  // published to the callback through dspActive. Never set on bit-perfect streams.
+  std::unique_ptr<DspChain> dsp;
+  std::atomic<DspChain *> dspActive{nullptr};
+  // Opt-in real-time scheduling and page locking (see thread_tuning.h). The callback
+  // applies the tuning to its thread on the first callback after tuningPending is set
+  // (again after a device switch, which brings a new PortAudio thread); feeder threads
+  // apply it as they start. lockedBytes counts stream and voice memory locked so far.
+  ThreadTuning tuning;
+  // Host API settings and stream flags, reapplied by switchStreamDevice (see host_api.h)
+  HostApiSettings hostApi;
+  std::atomic<bool> tuningPending{false};
+  std::atomic<int> tuningStatus{kTuningOff};
+  std::atomic<int> feederTuningStatus{kTuningOff};
+  size_t lockedBytes = 0;
+  size_t lockFailures = 0;
+  // Duplex input (see duplex.h): the input device and its latency, reapplied by
+  // switchStreamDevice; monitoring and talkover ducking of the output mix; and the
+  // float32 capture ring JS drains (the input, or the output mix for loopback)
+  int inputDevice = paNoDevice;
+  int inputChannels = 0;
+  double inputLatency = 0.0;
+  DuplexProcessor duplex;
+  int captureSource = kCaptureNone;
+  PcmRing captureRing;
+  Napi::ObjectReference captureStorage;
+  const void *captureLockedData = nullptr;
+  size_t captureLockedBytes = 0;
+};
+
+// Addon state of one JS environment (the main thread or a worker_threads Worker), kept
+// as its instance data: each environment that loads the addon has its own streams, IDs
+// and callbacks, and only ever touches them from its own thread
+struct AddonData
+{
+  std::map<uint32_t, std::unique_ptr<StreamInfo>> streams;
+  uint32_t nextStreamId = 1;
+  // Default ThreadSafeFunction for stream events; streams opened without their own
+  // eventCallback acquire a reference to it for their lifetime
+  std::unique_ptr<Napi::ThreadSafeFunction> eventCallbackTsfn;
+  // Bounded prebuffers for tracks that have not started yet (see block_pool.h); up to
+  // 16 MiB of released blocks stay pooled for the next one
+  BlockPool blockPool{256};
+  std::map<uint32_t, std::unique_ptr<BlockQueue>> prebuffers;
+  uint32_t nextPrebufferId = 1;
+  // This environment holds a PortAudio reference (see AcquirePortAudio)
+  bool portAudioHeld = false;
+  // Hotplug notifications for watchDevices(), delivered through deviceTsfn
+  DeviceWatcher deviceWatcher;
+  std::unique_ptr<Napi::ThreadSafeFunction> deviceTsfn;
+};
+
+static AddonData *GetAddonData(Napi::Env env)
+{
+  return env.GetInstanceData<AddonData>();
+}
+
+// PortAudio is initialised once per process, however many environments use it: each
+// holds at most one reference, taken by init() and dropped by terminate() or when the
+// environment shuts down, and only the last one out calls Pa_Terminate
+static std::mutex g_portAudioMutex;
+static int g_portAudioUsers = 0;
+
+// --- Event dispatch ---
+
+// How often callback events are drained, coalesced and delivered to JS
+static const int kEventCoalesceMs = 100;
+
+// A stream's event channel as seen by the dispatcher thread
+struct EventRegistration
+{
+  uint32_t streamId;
+  StreamEventChannel *channel;
+  Napi::ThreadSafeFunction *tsfn;
 };
-static std::map<uint32_t, StreamInfo> g_streams;
-static std::atomic<uint32_t> g_nextStreamId{1};
+
+struct PendingStreamEvent
+{
+  uint32_t type;
+  uint32_t count;
+  int32_t arg;
+};
+
+static std::mutex g_eventMutex;
+static std::condition_variable g_eventCv;
+static std::vector<EventRegistration> g_eventRegistrations;
+static std::thread g_eventThread;
+static bool g_eventStop = false;
+// Serialises starting and stopping the dispatcher thread, which every environment shares
+static std::mutex g_eventThreadMutex;
+
+// Drain one channel and hand its coalesced events to JS in a single call (g_eventMutex held)
+static void DispatchEventsLocked(const EventRegistration &reg, double elapsedMs)
+{
+  std::vector<PendingStreamEvent> events;
+  for (uint32_t type = 0; type < kStreamEventTypeCount; ++type)
+  {
+    uint32_t count = reg.channel->counts[type].exchange(0, std::memory_order_relaxed);
+    if (count > 0)
+      events.push_back({type, count, -1});
+  }
+  StreamEventRecord record;
+  while (reg.channel->queue.Pop(&record))
+    events.push_back({record.type, 1, record.arg});
+  uint32_t dropped = reg.channel->dropped.exchange(0, std::memory_order_relaxed);
+  if (events.empty() && dropped == 0)
+    return;
+  uint32_t streamId = reg.streamId;
+  long intervalMs = std::lround(elapsedMs);
+  reg.tsfn->NonBlockingCall([streamId, events, dropped, intervalMs](Napi::Env env, Napi::Function jsCallback)
+                            {
+    for (const PendingStreamEvent &e : events) {
+      Napi::Object evt = Napi::Object::New(env);
+      evt.Set("type", StreamEventName(e.type));
+      evt.Set("streamId", streamId);
+      evt.Set("count", e.count);
+      if (e.type == kEventVoiceEnded) {
+        evt.Set("voiceId", e.arg);
+        evt.Set("message", "Voice " + std::to_string(e.arg) + " ended");
+      } else {
+        evt.Set("intervalMs", Napi::Number::New(env, static_cast<double>(intervalMs)));
+        evt.Set("message", std::to_string(e.count) + " " + StreamEventNoun(e.type) + " in the last " + std::to_string(intervalMs) + " ms");
+      }
+      jsCallback.Call({evt});
+    }
+    if (dropped > 0) {
+      Napi::Object evt = Napi::Object::New(env);
+      evt.Set("type", "eventsDropped");
+      evt.Set("streamId", streamId);
+      evt.Set("count", dropped);
+      evt.Set("message", std::to_string(dropped) + " events dropped");
+      jsCallback.Call({evt});
+    } });
+}
+
+static void EventDispatchLoop()
+{
+  std::unique_lock<std::mutex> lock(g_eventMutex);
+  auto last = std::chrono::steady_clock::now();
+  while (!g_eventStop)
+  {
+    g_eventCv.wait_for(lock, std::chrono::milliseconds(kEventCoalesceMs), []
+                       { return g_eventStop; });
+    auto now = std::chrono::steady_clock::now();
+    double elapsedMs = std::chrono::duration<double, std::milli>(now - last).count();
+    last = now;
+    for (const EventRegistration &reg : g_eventRegistrations)
+      DispatchEventsLocked(reg, elapsedMs);
+  }
+}
+
+// Start delivering a stream's callback events to its event TSFN
+static void RegisterEventChannel(StreamInfo *sinfo)
+{
+  if (!sinfo->eventTsfn)
+    return;
+  std::lock_guard<std::mutex> threadLock(g_eventThreadMutex);
+  std::lock_guard<std::mutex> lock(g_eventMutex);
+  g_eventRegistrations.push_back({sinfo->id, &sinfo->events, sinfo->eventTsfn.get()});
+  if (!g_eventThread.joinable())
+    g_eventThread = std::thread(EventDispatchLoop);
+}
+
+// Flush and stop delivering a stream's events; after this the dispatcher no longer
+// touches the stream, so its event TSFN may be released
+static void UnregisterEventChannel(StreamInfo *sinfo)
+{
+  std::lock_guard<std::mutex> lock(g_eventMutex);
+  for (auto it = g_eventRegistrations.begin(); it != g_eventRegistrations.end(); ++it)
+  {
+    if (it->channel == &sinfo->events)
+    {
+      DispatchEventsLocked(*it, kEventCoalesceMs);
+      g_eventRegistrations.erase(it);
+      break;
+    }
+  }
+}
+
+// Stop the dispatcher thread once no environment has a stream registered any more
+static void StopEventDispatcherIfIdle()
+{
+  std::lock_guard<std::mutex> threadLock(g_eventThreadMutex);
+  {
+    std::lock_guard<std::mutex> lock(g_eventMutex);
+    if (!g_eventRegistrations.empty())
+      return;
+    g_eventStop = true;
+  }
+  g_eventCv.notify_all();
+  if (g_eventThread.joinable())
+    g_eventThread.join();
+  g_eventStop = false;
+}
+
+// Frames per callback: the configured period, or the host's own choice when the stream
+// was opened with framesPerBuffer 0 (paFramesPerBufferUnspecified)
+static unsigned long StreamPeriodFrames(const StreamInfo *sinfo)
+{
+  if (sinfo->framesPerBuffer > 0)
+    return sinfo->framesPerBuffer;
+  const uint32_t observed = sinfo->stats.lastFrameCount.load(std::memory_order_relaxed);
+  return observed > 0 ? observed : 256;
+}
+
+// Callback: count PortAudio status flags (wait-free)
+static inline void CountStatusFlags(StreamInfo *sinfo, PaStreamCallbackFlags statusFlags)
+{
+  if (statusFlags & paOutputUnderflow)
+  {
+    sinfo->events.Count(kEventOutputUnderflow);
+    sinfo->stats.underflows.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (statusFlags & paOutputOverflow)
+  {
+    sinfo->events.Count(kEventOutputOverflow);
+    sinfo->stats.overflows.fetch_add(1, std::memory_order_relaxed);
+  }
+  if (statusFlags & paPrimingOutput)
+    sinfo->events.Count(kEventPrimingOutput);
+  if (statusFlags & paInputOverflow)
+  {
+    sinfo->events.Count(kEventInputOverflow);
+    sinfo->stats.inputOverflows.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+// Audio thread: append whole float32 frames to the capture ring, counting what did not fit
+static void WriteCapture(StreamInfo *sinfo, const float *samples, uint32_t frames, int channels)
+{
+  const uint32_t bytesPerFrame = static_cast<uint32_t>(channels * sizeof(float));
+  const uint32_t room = sinfo->captureRing.WriteAvailable() / bytesPerFrame;
+  const uint32_t n = std::min(frames, room);
+  if (n > 0)
+    sinfo->captureRing.Write(samples, n * bytesPerFrame);
+  if (n < frames)
+    sinfo->stats.captureDroppedFrames.fetch_add(frames - n, std::memory_order_relaxed);
+}
 
 // Helper to get stream info by ID
-StreamInfo *GetStreamInfoById(uint32_t id)
+StreamInfo *GetStreamInfoById(Napi::Env env, uint32_t id)
 {
-  auto it = g_streams.find(id);
-  return it != g_streams.end() ? &it->second : nullptr;
+  AddonData *data = GetAddonData(env);
+  auto it = data->streams.find(id);
+  return it != data->streams.end() ? it->second.get() : nullptr;
 }
 
-// Initialize PortAudio
-Napi::Value Init(const Napi::CallbackInfo &info)
+// Lock a buffer of the stream in memory if it asked for that; failures are only counted
+static bool LockStreamMemory(StreamInfo *sinfo, const void *data, size_t bytes)
 {
-  Napi::Env env = info.Env();
-  PaError err = Pa_Initialize();
-  if (err != paNoError)
+  if (!sinfo->tuning.lockMemory || !data || bytes == 0)
+    return false;
+  if (!LockPages(data, bytes))
   {
-    Napi::Error::New(env, Pa_GetErrorText(err)).ThrowAsJavaScriptException();
-    return env.Null();
+    ++sinfo->lockFailures;
+    return false;
   }
-  return env.Undefined();
+  sinfo->lockedBytes += bytes;
+  return true;
 }
 
-// Terminate PortAudio and close all streams
-Napi::Value Terminate(const Napi::CallbackInfo &info)
+static void UnlockStreamMemory(StreamInfo *sinfo, const void *data, size_t bytes)
 {
-  Napi::Env env = info.Env();
-  // Close all open streams
-  for (auto &kv : g_streams)
+  UnlockPages(data, bytes);
+  sinfo->lockedBytes -= std::min(sinfo->lockedBytes, bytes);
+}
+
+// Callback thread: promote the thread PortAudio runs the callback on (once per
+// PortAudio stream; the syscalls are not repeated in steady state)
+static void ApplyCallbackTuning(StreamInfo *sinfo)
+{
+  sinfo->tuningPending.store(false, std::memory_order_relaxed);
+  bool ok = TuneCurrentThread(sinfo->tuning, false);
+  sinfo->tuningStatus.store(ok ? kTuningApplied : kTuningDenied, std::memory_order_relaxed);
+}
+
+// Have the next callback tune its thread, if the stream asked for that; call whenever
+// the stream gets a new PortAudio stream
+static void RequestCallbackTuning(StreamInfo *sinfo)
+{
+  if (!sinfo->tuning.Requested())
+    return;
+  sinfo->tuningStatus.store(kTuningPending, std::memory_order_relaxed);
+  sinfo->tuningPending.store(true, std::memory_order_relaxed);
+}
+
+// Start a feeder thread for the stream that first applies its tuning, one step below
+// the callback. The thread is joined before the stream goes away
+template <typename Fn, typename... Args>
+static std::thread StartFeederThread(StreamInfo *sinfo, Fn fn, Args... args)
+{
+  if (!sinfo->tuning.Requested())
+    return std::thread(fn, args...);
+  const ThreadTuning tuning = sinfo->tuning;
+  std::atomic<int> *status = &sinfo->feederTuningStatus;
+  status->store(kTuningPending, std::memory_order_relaxed);
+  return std::thread([tuning, status, fn, args...]() mutable
+                     {
+    status->store(TuneCurrentThread(tuning, true) ? kTuningApplied : kTuningDenied, std::memory_order_relaxed);
+    fn(args...); });
+}
+
+// Parse the realtime, realtimePriority, cpu and lockMemory options; throws and returns
+// false for out-of-range values
+static bool ParseThreadTuning(Napi::Env env, const Napi::Object &opts, double periodSeconds, ThreadTuning *tuning)
+{
+  tuning->periodSeconds = periodSeconds > 0 ? periodSeconds : tuning->periodSeconds;
+  if (opts.Has("realtime"))
+    tuning->realtime = opts.Get("realtime").ToBoolean().Value();
+  if (opts.Has("realtimePriority"))
+  {
+    double priority = opts.Get("realtimePriority").ToNumber().DoubleValue();
+    if (!(priority >= 1 && priority <= 99))
+    {
+      Napi::RangeError::New(env, "realtimePriority must be between 1 and 99").ThrowAsJavaScriptException();
+      return false;
+    }
+    tuning->priority = static_cast<int>(priority);
+  }
+  if (opts.Has("cpu") && !opts.Get("cpu").IsUndefined() && !opts.Get("cpu").IsNull())
+  {
+    double cpu = opts.Get("cpu").ToNumber().DoubleValue();
+    unsigned cpus = std::max(std::thread::hardware_concurrency(), 1u);
+    if (!(cpu >= 0 && cpu < cpus) || cpu != std::floor(cpu))
+    {
+      Napi::RangeError::New(env, "cpu must be an integer between 0 and " + std::to_string(cpus - 1)).ThrowAsJavaScriptException();
+      return false;
+    }
+    tuning->cpu = static_cast<int>(cpu);
+  }
+  if (opts.Has("lockMemory"))
+    tuning->lockMemory = opts.Get("lockMemory").ToBoolean().Value();
+  return true;
+}
+
+// Parse the clipOff, ditherOff and hostApi options:
+// hostApi: { wasapi: { exclusive, threadPriority, polling, autoConvert },
+//            alsa: { device, realtime }, coreAudio: { changeDeviceParameters, failIfConversionRequired } }
+// Throws and returns false for malformed values
+static bool ParseHostApiSettings(Napi::Env env, const Napi::Object &opts, HostApiSettings *settings)
+{
+  if (opts.Has("clipOff") && opts.Get("clipOff").ToBoolean().Value())
+    settings->flags |= paClipOff;
+  if (opts.Has("ditherOff") && opts.Get("ditherOff").ToBoolean().Value())
+    settings->flags |= paDitherOff;
+  if (!opts.Has("hostApi") || opts.Get("hostApi").IsUndefined() || opts.Get("hostApi").IsNull())
+    return true;
+  if (!opts.Get("hostApi").IsObject())
+  {
+    Napi::TypeError::New(env, "hostApi must be an object").ThrowAsJavaScriptException();
+    return false;
+  }
+  Napi::Object hostApi = opts.Get("hostApi").As<Napi::Object>();
+  auto flag = [](const Napi::Object &o, const char *name)
+  { return o.Has(name) && o.Get(name).ToBoolean().Value(); };
+  if (hostApi.Has("wasapi") && hostApi.Get("wasapi").IsObject())
+  {
+    Napi::Object wasapi = hostApi.Get("wasapi").As<Napi::Object>();
+    settings->wasapiExclusive = flag(wasapi, "exclusive");
+    settings->wasapiPolling = flag(wasapi, "polling");
+    settings->wasapiAutoConvert = flag(wasapi, "autoConvert");
+    if (wasapi.Has("threadPriority") && !wasapi.Get("threadPriority").IsUndefined())
+    {
+      std::string name = wasapi.Get("threadPriority").ToString().Utf8Value();
+      for (int i = 0; i < kWasapiThreadPriorityCount; ++i)
+      {
+        if (name == kWasapiThreadPriorities[i])
+          settings->wasapiThreadPriority = i;
+      }
+      if (settings->wasapiThreadPriority < 0)
+      {
+        Napi::TypeError::New(env, "Unknown wasapi.threadPriority: " + name).ThrowAsJavaScriptException();
+        return false;
+      }
+    }
+  }
+  if (hostApi.Has("alsa") && hostApi.Get("alsa").IsObject())
+  {
+    Napi::Object alsa = hostApi.Get("alsa").As<Napi::Object>();
+    if (alsa.Has("device") && alsa.Get("device").IsString())
+      settings->alsaDevice = alsa.Get("device").As<Napi::String>().Utf8Value();
+    settings->alsaRealtime = flag(alsa, "realtime");
+  }
+  if (hostApi.Has("coreAudio") && hostApi.Get("coreAudio").IsObject())
+  {
+    Napi::Object coreAudio = hostApi.Get("coreAudio").As<Napi::Object>();
+    settings->macChangeDeviceParameters = flag(coreAudio, "changeDeviceParameters");
+    settings->macFailIfConversionRequired = flag(coreAudio, "failIfConversionRequired");
+  }
+  return true;
+}
+
+// Ask a voice's pipe reader thread (if any) to finish and wait for it
+static void StopPipeReader(VoiceResources &res)
+{
+  if (res.pipeThread.joinable())
   {
-    PaStream *stream = kv.second.stream;
+    res.pipeStop.store(true, std::memory_order_relaxed);
+    res.pipeThread.join();
+  }
+}
+
+// How a new voice is set up (see AllocateVoice)
+struct VoiceSetup
+{
+  uint64_t ringFrames = 0;
+  // Consumed frames kept in the ring behind the read position for seeking back
+  uint64_t retainFrames = 0;
+  float gain = 1.0f;
+  // Start after this voice runs dry (gapless), or -1
+  int follows = -1;
+  // Take over from this voice with a crossfade once prefillFrames are buffered, or -1
+  int replaces = -1;
+  uint32_t prefillFrames = 0;
+  double sourceRate = 0.0;
+  // Keep the resampler running at equal rates so attachFanOut() can trim its speed
+  bool varispeed = false;
+};
+
+// Set up a free voice slot with its own ring; returns the voice index or -1 if all are in use
+static int AllocateVoice(Napi::Env env, StreamInfo *sinfo, const VoiceSetup &setup)
+{
+  for (int i = 0; i < kMaxVoices; ++i)
+  {
+    MixerVoice &v = sinfo->mixer.Voice(i);
+    if (v.state.load(std::memory_order_acquire) != kVoiceFree)
+      continue;
+    uint32_t capacity = RingCapacityFor((setup.ringFrames + setup.retainFrames) * sinfo->bytesPerFrame);
+    Napi::ArrayBuffer storage = Napi::ArrayBuffer::New(env, kRingHeaderBytes + capacity);
+    std::memset(storage.Data(), 0, kRingHeaderBytes);
+    if (LockStreamMemory(sinfo, storage.Data(), storage.ByteLength()))
+    {
+      sinfo->voices[i].lockedData = storage.Data();
+      sinfo->voices[i].lockedBytes = storage.ByteLength();
+    }
+    v.ring.Attach(static_cast<uint8_t *>(storage.Data()), capacity);
+    v.ring.SetRetain(static_cast<uint32_t>(std::min<uint64_t>(setup.retainFrames * sinfo->bytesPerFrame, capacity / 2)));
+    sinfo->mixer.SetVoiceRate(i, setup.sourceRate, sinfo->sampleRate, sinfo->resampleQuality, setup.varispeed);
+    sinfo->voices[i].sourceRate = setup.sourceRate;
+    v.envelope.Reset(setup.gain);
+    v.trim.store(1.0f, std::memory_order_relaxed);
+    v.follows.store(setup.follows, std::memory_order_relaxed);
+    v.replaces.store(setup.replaces, std::memory_order_relaxed);
+    v.prefillFrames = setup.prefillFrames;
+    v.seekFrame.store(-1, std::memory_order_relaxed);
+    v.position = v.highWater = 0;
+    v.seekFadeDir = 0;
+    v.seekFadeRemaining = 0;
+    v.retireAfterFade = false;
+    v.started.store(false, std::memory_order_relaxed);
+    v.finished.store(false, std::memory_order_relaxed);
+    sinfo->voices[i].storage = Napi::Persistent(storage.As<Napi::Object>());
+    v.state.store(kVoiceActive, std::memory_order_release);
+    return i;
+  }
+  return -1;
+}
+
+// Free a voice slot; the callback must no longer be able to touch it
+static void ReleaseVoice(StreamInfo *sinfo, int index)
+{
+  MixerVoice &v = sinfo->mixer.Voice(index);
+  StopPipeReader(sinfo->voices[index]);
+#ifndef _WIN32
+  if (sinfo->voices[index].fanOut)
+  {
+    sinfo->voices[index].fanOut->Detach(&v.ring);
+    sinfo->voices[index].fanOut.reset();
+  }
+#endif
+  v.ring.Detach();
+  if (sinfo->voices[index].lockedData)
+  {
+    UnlockStreamMemory(sinfo, sinfo->voices[index].lockedData, sinfo->voices[index].lockedBytes);
+    sinfo->voices[index].lockedData = nullptr;
+    sinfo->voices[index].lockedBytes = 0;
+  }
+  sinfo->voices[index].storage.Reset();
+  v.state.store(kVoiceFree, std::memory_order_release);
+}
+
+// Free retired voices once the callback has completed a full period since retirement
+// (or is not running at all)
+static void ReclaimRetiredVoices(StreamInfo *sinfo)
+{
+  uint64_t epoch = sinfo->callbackEpoch.load(std::memory_order_acquire);
+  bool active = (sinfo->stream && Pa_IsStreamActive(sinfo->stream) == 1) || sinfo->rendering.load(std::memory_order_acquire);
+  for (int i = 0; i < kMaxVoices; ++i)
+  {
+    if (sinfo->mixer.Voice(i).state.load(std::memory_order_acquire) != kVoiceRetiring)
+      continue;
+    if (!active || epoch >= sinfo->voices[i].retireEpoch + 2)
+      ReleaseVoice(sinfo, i);
+  }
+}
+
+// Release every voice; only call once the stream is stopped
+static void ReleaseAllVoices(StreamInfo *sinfo)
+{
+  for (int i = 0; i < kMaxVoices; ++i)
+  {
+    if (sinfo->mixer.Voice(i).state.load(std::memory_order_acquire) != kVoiceFree)
+      ReleaseVoice(sinfo, i);
+  }
+}
+
+// Stop a stream's analysis thread, then release the function it notified
+static void StopAnalysisTap(StreamInfo *sinfo)
+{
+  sinfo->analysis.Stop();
+  if (sinfo->analysisTsfn)
+  {
+    sinfo->analysisTsfn->Release();
+    sinfo->analysisTsfn.reset();
+  }
+  sinfo->analysisBuffer.Reset();
+  sinfo->analysisResult.Reset();
+  sinfo->analysisPending.store(false, std::memory_order_relaxed);
+}
+
+// Release the stream's callback context; only call once the stream is stopped
+static void ReleaseStreamCallbacks(StreamInfo *sinfo)
+{
+  if (sinfo->tuning.lockMemory)
+  {
+    UnlockStreamMemory(sinfo, sinfo->callbackRingStorage.data(), sinfo->callbackRingStorage.size());
+    UnlockStreamMemory(sinfo, sinfo->mixScratch.data(), sinfo->mixScratch.size() * sizeof(float));
+  }
+  if (sinfo->captureLockedData)
+  {
+    UnlockStreamMemory(sinfo, sinfo->captureLockedData, sinfo->captureLockedBytes);
+    sinfo->captureLockedData = nullptr;
+  }
+  sinfo->captureRing.Detach();
+  sinfo->captureStorage.Reset();
+  if (sinfo->writer)
+  {
+    sinfo->writer->Stop();
+    sinfo->writer.reset();
+  }
+  if (sinfo->writerTsfn)
+  {
+    sinfo->writerTsfn->Release();
+    sinfo->writerTsfn.reset();
+  }
+  // Offline renders are joined before this, so nothing posts to it any more
+  if (sinfo->renderTsfn)
+  {
+    sinfo->renderTsfn->Release();
+    sinfo->renderTsfn.reset();
+  }
+  if (sinfo->audioTsfn)
+  {
+    // Abort rather than release: refill requests still queued would otherwise run
+    // against a closed stream; aborted ones reach CallAudioJs with a null env
+    sinfo->audioTsfn->Abort();
+    sinfo->audioTsfn.reset();
+  }
+  StopAnalysisTap(sinfo);
+  UnregisterEventChannel(sinfo);
+  sinfo->clock.Detach();
+  sinfo->clockStorage.Reset();
+  sinfo->callbackBuffer.Reset();
+  if (sinfo->eventTsfn)
+  {
+    sinfo->eventTsfn->Release();
+    sinfo->eventTsfn.reset();
+  }
+}
+
+// Main thread: end an offline stream's render in progress and join its thread; afterwards
+// no callback touches the stream's state. The job stays for SettleOfflineRender()
+static void StopOfflineRender(StreamInfo *sinfo)
+{
+  if (!sinfo->renderThread.joinable())
+    return;
+  sinfo->renderStop.store(true, std::memory_order_relaxed);
+  sinfo->renderThread.join();
+  sinfo->renderStop.store(false, std::memory_order_relaxed);
+}
+
+// Main thread: settle a finished (or stopped) render's promise with what it rendered
+static void SettleOfflineRender(Napi::Env env, StreamInfo *sinfo)
+{
+  if (!sinfo->renderJob)
+    return;
+  // The thread has posted its completion, so this join does not block
+  StopOfflineRender(sinfo);
+  std::unique_ptr<OfflineRenderJob> job = std::move(sinfo->renderJob);
+  if (!job->error.empty())
+  {
+    job->deferred.Reject(Napi::Error::New(env, job->error).Value());
+    return;
+  }
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("frames", Napi::Number::New(env, static_cast<double>(job->rendered)));
+  result.Set("ended", Napi::Boolean::New(env, job->ended));
+  result.Set("stalls", Napi::Number::New(env, job->stalls));
+  result.Set("renderSeconds", Napi::Number::New(env, job->renderSeconds));
+  if (job->fd < 0)
+    result.Set("buffer", Napi::Buffer<uint8_t>::Copy(env, job->output.data(), job->output.size()));
+  job->deferred.Resolve(result);
+}
+
+// Stop and close every open stream of an environment, releasing ring storage while the
+// env is alive
+static void CloseAllStreams(AddonData *data)
+{
+  for (auto &kv : data->streams)
+  {
+    PaStream *stream = kv.second->stream;
+    if (kv.second->writer)
+      kv.second->writer->Stop();
+    StopOfflineRender(kv.second.get());
     if (stream)
     {
       Pa_StopStream(stream);
       Pa_CloseStream(stream);
     }
+    ReleaseAllVoices(kv.second.get());
+    ReleaseStreamCallbacks(kv.second.get());
+    kv.second->writeWaiters.clear();
   }
-  g_streams.clear();
-  if (g_audioCallbackTsfn)
+  data->streams.clear();
+  StopEventDispatcherIfIdle();
+}
+
+// Stop hotplug notifications; none are delivered after this returns
+static void StopDeviceWatcher(AddonData *data)
+{
+  data->deviceWatcher.Stop();
+  if (data->deviceTsfn)
   {
-    g_audioCallbackTsfn->Release();
-    g_audioCallbackTsfn.reset();
+    data->deviceTsfn->Release();
+    data->deviceTsfn.reset();
   }
-  if (g_eventCallbackTsfn)
+}
+
+// Take the environment's PortAudio reference, initialising PortAudio for the first one
+static PaError AcquirePortAudio(AddonData *data)
+{
+  std::lock_guard<std::mutex> lock(g_portAudioMutex);
+  if (data->portAudioHeld)
+    return paNoError;
+  if (g_portAudioUsers == 0)
   {
-    g_eventCallbackTsfn->Release();
-    g_eventCallbackTsfn.reset();
+    std::unique_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+    std::lock_guard<std::mutex> probeLock(g_capabilityCache.ProbeMutex());
+    PaError err = Pa_Initialize();
+    if (err != paNoError)
+      return err;
+    // Re-initializing rescans the devices; cached probes survive unless the list changed
+    g_capabilityCache.Revalidate(DeviceListSignature());
   }
-  PaError err = Pa_Terminate();
+  ++g_portAudioUsers;
+  data->portAudioHeld = true;
+  return paNoError;
+}
+
+// Drop the environment's PortAudio reference, terminating PortAudio with the last one
+static PaError ReleasePortAudio(AddonData *data)
+{
+  std::lock_guard<std::mutex> lock(g_portAudioMutex);
+  if (!data->portAudioHeld)
+    return paNotInitialized;
+  data->portAudioHeld = false;
+  if (--g_portAudioUsers > 0)
+    return paNoError;
+  // Waits for device queries still running on worker threads
+  std::unique_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+  std::lock_guard<std::mutex> probeLock(g_capabilityCache.ProbeMutex());
+  return Pa_Terminate();
+}
+
+// Environment teardown (process exit or a worker ending): close its streams and release
+// everything it holds while the env is still alive
+static void ShutdownAddon(AddonData *data)
+{
+  StopDeviceWatcher(data);
+  CloseAllStreams(data);
+  if (data->eventCallbackTsfn)
+  {
+    data->eventCallbackTsfn->Release();
+    data->eventCallbackTsfn.reset();
+  }
+  data->prebuffers.clear();
+  ReleasePortAudio(data);
+}
+
+// Initialize PortAudio for this environment (a no-op if it already did)
+Napi::Value Init(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  PaError err = AcquirePortAudio(GetAddonData(env));
+  if (err != paNoError)
+  {
+    Napi::Error::New(env, Pa_GetErrorText(err)).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  return env.Undefined();
+}
+
+// Close this environment's streams and release its PortAudio reference; PortAudio
+// itself terminates once no environment uses it
+Napi::Value Terminate(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  AddonData *data = GetAddonData(env);
+  StopDeviceWatcher(data);
+  // Close all open streams
+  CloseAllStreams(data);
+  if (data->eventCallbackTsfn)
+  {
+    data->eventCallbackTsfn->Release();
+    data->eventCallbackTsfn.reset();
+  }
+  PaError err = ReleasePortAudio(data);
   if (err != paNoError)
   {
     Napi::Error::New(env, Pa_GetErrorText(err)).ThrowAsJavaScriptException();
@@ -87,12 +945,14 @@ Napi::Value GetVersion(const Napi::CallbackInfo &info)
 Napi::Value GetDevices(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
+  std::shared_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
   int numDevices = Pa_GetDeviceCount();
   if (numDevices < 0)
   {
     Napi::Error::New(env, Pa_GetErrorText(numDevices)).ThrowAsJavaScriptException();
     return env.Null();
   }
+  const PaDeviceIndex defaultOutput = Pa_GetDefaultOutputDevice();
   Napi::Array devices = Napi::Array::New(env, numDevices);
   for (int i = 0; i < numDevices; ++i)
   {
@@ -101,6 +961,7 @@ Napi::Value GetDevices(const Napi::CallbackInfo &info)
       continue;
     Napi::Object dev = Napi::Object::New(env);
     dev.Set("index", i);
+    dev.Set("isDefault", i == defaultOutput);
     dev.Set("name", deviceInfo->name ? deviceInfo->name : "");
     dev.Set("maxInputChannels", deviceInfo->maxInputChannels);
     dev.Set("maxOutputChannels", deviceInfo->maxOutputChannels);
@@ -115,23 +976,32 @@ Napi::Value GetDevices(const Napi::CallbackInfo &info)
   return devices;
 }
 
-// Open default output stream (stereo, 44.1kHz, float32)
+// Parse an optional `sampleFormat` option; throws and returns 0 for unknown names
+static PaSampleFormat GetSampleFormatOption(Napi::Env env, const Napi::Object &opts)
+{
+  if (!opts.Has("sampleFormat"))
+    return paFloat32;
+  PaSampleFormat format = ParseSampleFormat(opts.Get("sampleFormat").As<Napi::String>().Utf8Value());
+  if (format == 0)
+    Napi::TypeError::New(env, "sampleFormat must be one of float32, int16, int24, int32").ThrowAsJavaScriptException();
+  return format;
+}
+
+// Open default output stream (stereo, 44.1kHz, float32): openDefaultStream(framesPerBuffer = 256),
+// where 0 lets the host pick the period (paFramesPerBufferUnspecified)
 Napi::Value OpenDefaultStream(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
+  unsigned long framesPerBuffer = info.Length() > 0 && info[0].IsNumber() ? info[0].As<Napi::Number>().Uint32Value() : 256;
+  std::shared_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
   PaStream *stream = nullptr;
-  if (g_streams.size() > 0)
-  {
-    Napi::Error::New(env, "Stream already open").ThrowAsJavaScriptException();
-    return env.Null();
-  }
   PaError err = Pa_OpenDefaultStream(
       &stream,
       0, // no input
       2, // stereo output
       paFloat32,
       44100,
-      256,     // frames per buffer
+      framesPerBuffer,
       nullptr, // no callback (blocking API)
       nullptr);
   if (err != paNoError)
@@ -146,8 +1016,13 @@ Napi::Value OpenDefaultStream(const Napi::CallbackInfo &info)
     Pa_CloseStream(stream);
     return env.Null();
   }
-  uint32_t streamId = g_nextStreamId++;
-  g_streams[streamId] = {stream, 1.0f};
+  AddonData *data = GetAddonData(env);
+  uint32_t streamId = data->nextStreamId++;
+  auto sinfo = std::make_unique<StreamInfo>();
+  sinfo->id = streamId;
+  sinfo->stream = stream;
+  sinfo->framesPerBuffer = framesPerBuffer;
+  data->streams[streamId] = std::move(sinfo);
   return Napi::Number::New(env, streamId);
 }
 
@@ -155,6 +1030,7 @@ Napi::Value OpenDefaultStream(const Napi::CallbackInfo &info)
 Napi::Value OpenStream(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
+  std::shared_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
   try
   {
     // Validate arguments (device index, sample rate, channels, etc.)
@@ -163,6 +1039,20 @@ Napi::Value OpenStream(const Napi::CallbackInfo &info)
       Napi::TypeError::New(env, "Expected device index, sample rate, channels, and framesPerBuffer").ThrowAsJavaScriptException();
       return env.Null();
     }
+    // Optional 5th argument: { sampleFormat, highWaterMark, realtime, realtimePriority,
+    // cpu } (highWaterMark in bytes; it and the tuning apply to writeStreamAsync()'s
+    // writer thread)
+    size_t highWaterMark = 0;
+    PaSampleFormat sampleFormat = paFloat32;
+    if (info.Length() > 4 && info[4].IsObject())
+    {
+      Napi::Object opts = info[4].As<Napi::Object>();
+      if (opts.Has("highWaterMark"))
+        highWaterMark = opts.Get("highWaterMark").As<Napi::Number>().Uint32Value();
+      sampleFormat = GetSampleFormatOption(env, opts);
+      if (sampleFormat == 0)
+        return env.Null();
+    }
     int deviceIndex = info[0].As<Napi::Number>().Int32Value();
     double sampleRate = info[1].As<Napi::Number>().DoubleValue();
     int channels = info[2].As<Napi::Number>().Int32Value();
@@ -191,13 +1081,25 @@ Napi::Value OpenStream(const Napi::CallbackInfo &info)
       Napi::Error::New(env, "framesPerBuffer must be positive").ThrowAsJavaScriptException();
       return env.Null();
     }
+    ThreadTuning tuning;
+    HostApiSettings hostApi;
+    if (info.Length() > 4 && info[4].IsObject() &&
+        (!ParseThreadTuning(env, info[4].As<Napi::Object>(), framesPerBuffer / sampleRate, &tuning) ||
+         !ParseHostApiSettings(env, info[4].As<Napi::Object>(), &hostApi)))
+      return env.Null();
 
     PaStreamParameters outputParams;
     outputParams.device = deviceIndex;
     outputParams.channelCount = channels;
-    outputParams.sampleFormat = paFloat32;
+    outputParams.sampleFormat = sampleFormat;
     outputParams.suggestedLatency = Pa_GetDeviceInfo(deviceIndex)->defaultLowOutputLatency;
-    outputParams.hostApiSpecificStreamInfo = nullptr;
+    HostApiStreamInfo hostInfo;
+    std::string hostError;
+    if (!PrepareHostApiStream(hostApi, &outputParams, &hostInfo, &hostError))
+    {
+      Napi::Error::New(env, hostError).ThrowAsJavaScriptException();
+      return env.Null();
+    }
 
     PaStream *stream = nullptr;
     PaError err = Pa_OpenStream(
@@ -206,7 +1108,7 @@ Napi::Value OpenStream(const Napi::CallbackInfo &info)
         &outputParams, // output
         sampleRate,
         framesPerBuffer,
-        paNoFlag,
+        hostApi.flags,
         nullptr, // no callback (blocking)
         nullptr);
     if (err != paNoError)
@@ -215,6 +1117,7 @@ Napi::Value OpenStream(const Napi::CallbackInfo &info)
       Napi::Error::New(env, msg).ThrowAsJavaScriptException();
       return env.Null();
     }
+    FinishHostApiStream(hostApi, deviceIndex, stream);
     err = Pa_StartStream(stream);
     if (err != paNoError)
     {
@@ -223,8 +1126,20 @@ Napi::Value OpenStream(const Napi::CallbackInfo &info)
       Napi::Error::New(env, msg).ThrowAsJavaScriptException();
       return env.Null();
     }
-    uint32_t streamId = g_nextStreamId++;
-    g_streams[streamId] = {stream, 1.0f};
+    AddonData *data = GetAddonData(env);
+    uint32_t streamId = data->nextStreamId++;
+    auto sinfo = std::make_unique<StreamInfo>();
+    sinfo->id = streamId;
+    sinfo->stream = stream;
+    sinfo->channels = channels;
+    sinfo->sampleRate = sampleRate;
+    sinfo->sampleFormat = sampleFormat;
+    sinfo->bytesPerFrame = channels * BytesPerSample(sampleFormat);
+    sinfo->framesPerBuffer = framesPerBuffer;
+    sinfo->writeHighWaterMark = highWaterMark;
+    sinfo->tuning = tuning;
+    sinfo->hostApi = hostApi;
+    data->streams[streamId] = std::move(sinfo);
     return Napi::Number::New(env, streamId);
   }
   catch (const std::exception &ex)
@@ -234,7 +1149,41 @@ Napi::Value OpenStream(const Napi::CallbackInfo &info)
   }
 }
 
-// Write buffer to stream (expects Float32Array or Buffer of float32, plus stream ID)
+// Get the raw sample bytes behind a Buffer, Uint8Array or the typed array matching the
+// stream format (Float32Array, Int16Array, Int32Array); packed int24 data must be passed
+// as bytes. Throws a TypeError and returns false for anything else
+static bool GetSampleData(Napi::Env env, const Napi::Value &value, PaSampleFormat format, const uint8_t **data, size_t *bytes)
+{
+  if (value.IsBuffer())
+  {
+    Napi::Buffer<uint8_t> buf = value.As<Napi::Buffer<uint8_t>>();
+    *data = buf.Data();
+    *bytes = buf.Length();
+    return true;
+  }
+  if (value.IsTypedArray())
+  {
+    Napi::TypedArray arr = value.As<Napi::TypedArray>();
+    napi_typedarray_type type = arr.TypedArrayType();
+    bool matches = type == napi_uint8_array ||
+                   (format == paFloat32 && type == napi_float32_array) ||
+                   (format == paInt16 && type == napi_int16_array) ||
+                   (format == paInt32 && type == napi_int32_array);
+    if (!matches)
+    {
+      std::string msg = std::string("Typed array does not match the stream sample format (") + SampleFormatName(format) + ")";
+      Napi::TypeError::New(env, msg).ThrowAsJavaScriptException();
+      return false;
+    }
+    *data = static_cast<const uint8_t *>(arr.ArrayBuffer().Data()) + arr.ByteOffset();
+    *bytes = arr.ByteLength();
+    return true;
+  }
+  Napi::TypeError::New(env, "Expected Buffer or typed array").ThrowAsJavaScriptException();
+  return false;
+}
+
+// Write buffer to stream (samples in the stream's sample format, plus stream ID)
 Napi::Value WriteStream(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
@@ -246,51 +1195,39 @@ Napi::Value WriteStream(const Napi::CallbackInfo &info)
       return env.Null();
     }
     uint32_t streamId = info[1].As<Napi::Number>().Uint32Value();
-    StreamInfo *sinfo = GetStreamInfoById(streamId);
+    StreamInfo *sinfo = GetStreamInfoById(env, streamId);
     if (!sinfo)
     {
       throw std::runtime_error("Stream not open");
     }
+    if (sinfo->writer)
+    {
+      throw std::runtime_error("Stream is written asynchronously; use writeStreamAsync()");
+    }
     PaStream *stream = sinfo->stream;
-    float *data = nullptr;
+    const uint8_t *data = nullptr;
     size_t len = 0;
-    if (info[0].IsBuffer())
+    if (!GetSampleData(env, info[0], sinfo->sampleFormat, &data, &len))
+      return env.Null();
+    if (!data || len == 0)
     {
-      Napi::Buffer<float> buf = info[0].As<Napi::Buffer<float>>();
-      data = buf.Data();
-      len = buf.Length();
+      throw std::runtime_error("Empty buffer");
     }
-    else if (info[0].IsTypedArray())
+    // Apply volume into a staging buffer; the caller's samples are left untouched
+    unsigned long frames = static_cast<unsigned long>(len / sinfo->bytesPerFrame);
+    if (frames == 0)
     {
-      Napi::TypedArray arr = info[0].As<Napi::TypedArray>();
-      if (arr.TypedArrayType() != napi_float32_array)
-      {
-        Napi::TypeError::New(env, "Expected Float32Array").ThrowAsJavaScriptException();
-        return env.Null();
-      }
-      Napi::TypedArrayOf<float> f32arr = info[0].As<Napi::TypedArrayOf<float>>();
-      data = f32arr.Data();
-      len = f32arr.ElementLength();
-    }
-    else
-    {
-      Napi::TypeError::New(env, "Expected Buffer or Float32Array").ThrowAsJavaScriptException();
-      return env.Null();
-    }
-    if (!data || len == 0)
-    {
-      throw std::runtime_error("Empty buffer");
-    }
-    // Apply volume scaling
-    float volume = sinfo->volume;
-    if (volume != 1.0f)
-    {
-      for (size_t i = 0; i < len; ++i)
-      {
-        data[i] *= volume;
-      }
+      throw std::runtime_error("Buffer is shorter than one frame");
     }
-    PaError err = Pa_WriteStream(stream, data, len / 2); // stereo
+    const size_t bytes = static_cast<size_t>(frames) * sinfo->bytesPerFrame;
+    if (sinfo->writeScratch.size() < bytes)
+      sinfo->writeScratch.resize(bytes);
+    if (sinfo->writeFloatScratch.empty())
+      sinfo->writeFloatScratch.resize(kMixBlockFrames * sinfo->channels);
+    ProcessVolume(sinfo->volume, sinfo->sampleFormat, data, sinfo->writeScratch.data(), static_cast<uint32_t>(frames),
+                  sinfo->channels, sinfo->writeFloatScratch.data(), kMixBlockFrames);
+    sinfo->analysis.Feed(sinfo->writeScratch.data(), static_cast<uint32_t>(frames));
+    PaError err = Pa_WriteStream(stream, sinfo->writeScratch.data(), frames);
     if (err != paNoError)
     {
       throw std::runtime_error(Pa_GetErrorText(err));
@@ -304,325 +1241,3212 @@ Napi::Value WriteStream(const Napi::CallbackInfo &info)
   }
 }
 
-// Close the output stream (by stream ID)
-Napi::Value CloseStream(const Napi::CallbackInfo &info)
+// Settle the promises waiting on a stream's async writer (main thread, via writerTsfn)
+static void SettleWriteWaiters(Napi::Env env, uint32_t streamId)
+{
+  StreamInfo *sinfo = GetStreamInfoById(env, streamId);
+  if (!sinfo || !sinfo->writer || sinfo->writeWaiters.empty())
+    return;
+  PaError err = sinfo->writer->Error();
+  if (err == paNoError && sinfo->writer->NeedDrain())
+    return; // refilled above the high-water mark since the drain was signalled
+  std::vector<Napi::Promise::Deferred> waiters;
+  waiters.swap(sinfo->writeWaiters);
+  for (auto &deferred : waiters)
+  {
+    if (err != paNoError)
+      deferred.Reject(Napi::Error::New(env, Pa_GetErrorText(err)).Value());
+    else
+      deferred.Resolve(Napi::Boolean::New(env, true));
+  }
+}
+
+// Start the background writer of a blocking stream
+static void StartStreamWriter(Napi::Env env, StreamInfo *sinfo)
+{
+  uint32_t streamId = sinfo->id;
+  Napi::Function noop = Napi::Function::New(env, [](const Napi::CallbackInfo &) {});
+  sinfo->writerTsfn = std::make_unique<Napi::ThreadSafeFunction>(
+      Napi::ThreadSafeFunction::New(env, noop, "StreamWriter", 0, 1));
+  // The writer is stopped before its TSFN is released, so the pointer stays valid
+  Napi::ThreadSafeFunction *tsfn = sinfo->writerTsfn.get();
+  // Default high-water mark: ~100 ms of audio, at least 8 device buffers
+  size_t highWaterMark = sinfo->writeHighWaterMark;
+  if (highWaterMark == 0)
+    highWaterMark = std::max<size_t>(sinfo->framesPerBuffer * 8, static_cast<size_t>(sinfo->sampleRate / 10)) * sinfo->bytesPerFrame;
+  sinfo->writer = std::make_unique<StreamWriter>();
+  // The writer feeds the device directly, so it is tuned like a callback thread
+  StreamWriter::Notify threadStart;
+  if (sinfo->tuning.Requested())
+  {
+    const ThreadTuning tuning = sinfo->tuning;
+    std::atomic<int> *status = &sinfo->tuningStatus;
+    status->store(kTuningPending, std::memory_order_relaxed);
+    threadStart = [tuning, status]()
+    { status->store(TuneCurrentThread(tuning, false) ? kTuningApplied : kTuningDenied, std::memory_order_relaxed); };
+  }
+  sinfo->writer->Start(sinfo->stream, sinfo->channels, sinfo->sampleFormat, &sinfo->volume, &sinfo->analysis, highWaterMark, [tsfn, streamId]()
+                       { tsfn->NonBlockingCall([streamId](Napi::Env env, Napi::Function)
+                                               { SettleWriteWaiters(env, streamId); }); },
+                       std::move(threadStart));
+}
+
+// Queue a buffer for a blocking stream without blocking the event loop:
+// writeStreamAsync(buffer, streamId) -> Promise<boolean>. The samples are copied, so the
+// buffer may be reused immediately; the promise resolves once the queue is below the
+// high-water mark (right away if it already is), so awaiting it gives backpressure
+Napi::Value WriteStreamAsync(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
-  if (info.Length() < 1 || !info[0].IsNumber())
-    return env.Undefined();
-  uint32_t streamId = info[0].As<Napi::Number>().Uint32Value();
-  StreamInfo *sinfo = GetStreamInfoById(streamId);
+  if (info.Length() < 2 || !info[1].IsNumber())
+  {
+    Napi::TypeError::New(env, "Expected buffer and stream ID").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  uint32_t streamId = info[1].As<Napi::Number>().Uint32Value();
+  StreamInfo *sinfo = GetStreamInfoById(env, streamId);
   if (!sinfo)
-    return env.Undefined();
-  PaStream *stream = sinfo->stream;
-  PaError err = Pa_StopStream(stream);
-  if (err == paNoError)
-    err = Pa_CloseStream(stream);
-  g_streams.erase(streamId);
-  if (g_audioCallbackTsfn)
   {
-    g_audioCallbackTsfn->Release();
-    g_audioCallbackTsfn.reset();
+    Napi::Error::New(env, "Stream not open").ThrowAsJavaScriptException();
+    return env.Null();
   }
-  if (g_eventCallbackTsfn)
+  if (sinfo->ringMode || sinfo->audioTsfn)
   {
-    g_eventCallbackTsfn->Release();
-    g_eventCallbackTsfn.reset();
+    Napi::Error::New(env, "writeStreamAsync() requires a blocking stream (see openStream)").ThrowAsJavaScriptException();
+    return env.Null();
   }
+  const uint8_t *data = nullptr;
+  size_t len = 0;
+  if (!GetSampleData(env, info[0], sinfo->sampleFormat, &data, &len))
+    return env.Null();
+  size_t bytes = len - len % sinfo->bytesPerFrame;
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  if (!sinfo->writer)
+    StartStreamWriter(env, sinfo);
+  PaError err = sinfo->writer->Error();
   if (err != paNoError)
   {
-    Napi::Error::New(env, Pa_GetErrorText(err)).ThrowAsJavaScriptException();
-    return env.Null();
+    deferred.Reject(Napi::Error::New(env, Pa_GetErrorText(err)).Value());
+    return deferred.Promise();
   }
-  return env.Undefined();
+  if (bytes == 0 || sinfo->writer->Enqueue(data, bytes))
+    deferred.Resolve(Napi::Boolean::New(env, true));
+  else
+    sinfo->writeWaiters.push_back(deferred);
+  return deferred.Promise();
 }
 
-// Helper to emit event from PortAudio callback
-void EmitStreamEvent(const std::string &type, const std::string &message = "")
+// Report the async writer's queue: { queuedBytes, highWaterMark, needDrain }
+Napi::Value GetStreamWriteState(const Napi::CallbackInfo &info)
 {
-  if (g_eventCallbackTsfn)
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsNumber())
   {
-    g_eventCallbackTsfn->BlockingCall([type, message](Napi::Env env, Napi::Function jsCallback)
-                                      {
-      Napi::Object evt = Napi::Object::New(env);
-      evt.Set("type", type);
-      evt.Set("message", message);
-      jsCallback.Call({evt}); });
+    Napi::TypeError::New(env, "Expected stream ID").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  StreamInfo *sinfo = GetStreamInfoById(env, info[0].As<Napi::Number>().Uint32Value());
+  if (!sinfo)
+  {
+    Napi::Error::New(env, "Stream not open").ThrowAsJavaScriptException();
+    return env.Null();
   }
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("queuedBytes", Napi::Number::New(env, sinfo->writer ? static_cast<double>(sinfo->writer->QueuedBytes()) : 0.0));
+  result.Set("highWaterMark", Napi::Number::New(env, sinfo->writer ? static_cast<double>(sinfo->writer->HighWaterMark()) : static_cast<double>(sinfo->writeHighWaterMark)));
+  result.Set("needDrain", sinfo->writer ? sinfo->writer->NeedDrain() : false);
+  return result;
 }
 
-// Modified PortAudio stream callback for async playback with event reporting
-static int AudioCallback(const void *input, void *output,
-                         unsigned long frameCount,
-                         const PaStreamCallbackTimeInfo *timeInfo,
-                         PaStreamCallbackFlags statusFlags,
-                         void *userData)
+// Timing histogram as {bucketsUs, counts, maxUs, meanUs}; bucketsUs holds each bucket's
+// exclusive upper bound (the last bucket is open-ended)
+static Napi::Object HistogramToObject(Napi::Env env, const TimingHistogram &histogram)
 {
-  static int callCount = 0;
-  ++callCount;
-  auto *tsfn = static_cast<Napi::ThreadSafeFunction *>(userData);
-  float *out = static_cast<float *>(output);
-  napi_status status = tsfn->BlockingCall([out, frameCount](Napi::Env env, Napi::Function jsCallback)
-                                          {
-    // New pattern: JS returns a buffer/array, we copy it into out
-    std::vector<float> tempBuf(frameCount * 2, 0.0f);
-    Napi::Value result = jsCallback.Call({});
-    if (result.IsTypedArray()) {
-      Napi::TypedArray arr = result.As<Napi::TypedArray>();
-      if (arr.TypedArrayType() == napi_float32_array) {
-        Napi::TypedArrayOf<float> f32arr = result.As<Napi::TypedArrayOf<float>>();
-        size_t n = std::min<size_t>(f32arr.ElementLength(), tempBuf.size());
-        std::copy(f32arr.Data(), f32arr.Data() + n, tempBuf.begin());
-      }
-    } else if (result.IsBuffer()) {
-      Napi::Buffer<float> buf = result.As<Napi::Buffer<float>>();
-      size_t n = std::min<size_t>(buf.Length(), tempBuf.size());
-      std::copy(buf.Data(), buf.Data() + n, tempBuf.begin());
-    }
-    std::copy(tempBuf.begin(), tempBuf.end(), out); });
-  // Report underflow/overflow events
-  if (statusFlags & paOutputUnderflow)
-    EmitStreamEvent("outputUnderflow");
-  if (statusFlags & paOutputOverflow)
-    EmitStreamEvent("outputOverflow");
-  if (statusFlags & paPrimingOutput)
-    EmitStreamEvent("primingOutput");
-  return status == napi_ok ? paContinue : paAbort;
+  Napi::Array bounds = Napi::Array::New(env, kStatsBucketCount - 1);
+  Napi::Array counts = Napi::Array::New(env, kStatsBucketCount);
+  for (int i = 0; i < kStatsBucketCount; ++i)
+  {
+    if (i < kStatsBucketCount - 1)
+      bounds.Set(static_cast<uint32_t>(i), Napi::Number::New(env, kStatsBucketBoundsUs[i]));
+    counts.Set(static_cast<uint32_t>(i), Napi::Number::New(env, static_cast<double>(histogram.Count(i))));
+  }
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("bucketsUs", bounds);
+  result.Set("counts", counts);
+  result.Set("maxUs", Napi::Number::New(env, static_cast<double>(histogram.MaxUs())));
+  result.Set("meanUs", Napi::Number::New(env, histogram.MeanUs()));
+  return result;
 }
 
-// Set JS callback for stream events/errors
-Napi::Value SetStreamEventCallback(const Napi::CallbackInfo &info)
+// Stream telemetry: CPU load, latencies, xrun counters and callback timing histograms
+Napi::Value GetStreamStats(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
-  if (!info[0].IsFunction())
+  if (info.Length() < 1 || !info[0].IsNumber())
   {
-    Napi::TypeError::New(env, "Expected callback function").ThrowAsJavaScriptException();
+    Napi::TypeError::New(env, "Expected stream ID").ThrowAsJavaScriptException();
     return env.Null();
   }
-  Napi::Function jsCallback = info[0].As<Napi::Function>();
-  if (g_eventCallbackTsfn)
+  StreamInfo *sinfo = GetStreamInfoById(env, info[0].As<Napi::Number>().Uint32Value());
+  if (!sinfo)
+  {
+    Napi::Error::New(env, "Stream not open").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Object result = Napi::Object::New(env);
+  // Pa_GetStreamCpuLoad is 0 for blocking-API streams
+  result.Set("cpuLoad", Napi::Number::New(env, Pa_GetStreamCpuLoad(sinfo->stream)));
+  if (const PaStreamInfo *paInfo = Pa_GetStreamInfo(sinfo->stream))
   {
-    g_eventCallbackTsfn->Release();
-    g_eventCallbackTsfn.reset();
+    result.Set("inputLatency", Napi::Number::New(env, paInfo->inputLatency));
+    result.Set("outputLatency", Napi::Number::New(env, paInfo->outputLatency));
+    result.Set("sampleRate", Napi::Number::New(env, paInfo->sampleRate));
   }
-  g_eventCallbackTsfn = std::make_unique<Napi::ThreadSafeFunction>(
-      Napi::ThreadSafeFunction::New(env, jsCallback, "StreamEventCallback", 0, 1));
-  return env.Undefined();
+  const StreamStats &stats = sinfo->stats;
+  result.Set("callbacks", Napi::Number::New(env, static_cast<double>(stats.callbacks.load(std::memory_order_relaxed))));
+  result.Set("underflows", Napi::Number::New(env, static_cast<double>(stats.underflows.load(std::memory_order_relaxed))));
+  result.Set("overflows", Napi::Number::New(env, static_cast<double>(stats.overflows.load(std::memory_order_relaxed))));
+  result.Set("starvedFrames", Napi::Number::New(env, static_cast<double>(stats.starvedFrames.load(std::memory_order_relaxed))));
+  result.Set("starvedCallbacks", Napi::Number::New(env, static_cast<double>(stats.starvedCallbacks.load(std::memory_order_relaxed))));
+  result.Set("inputOverflows", Napi::Number::New(env, static_cast<double>(stats.inputOverflows.load(std::memory_order_relaxed))));
+  result.Set("captureDroppedFrames", Napi::Number::New(env, static_cast<double>(stats.captureDroppedFrames.load(std::memory_order_relaxed))));
+  // Requested period (0: left to the host) and the one the host actually delivers
+  result.Set("framesPerBuffer", Napi::Number::New(env, static_cast<double>(sinfo->framesPerBuffer)));
+  result.Set("callbackFrames", Napi::Number::New(env, stats.lastFrameCount.load(std::memory_order_relaxed)));
+  result.Set("suggestedLatency", Napi::Number::New(env, sinfo->suggestedLatency));
+  // Time available per callback, to compare the histograms against
+  result.Set("bufferBudgetUs", Napi::Number::New(env, sinfo->sampleRate > 0 ? StreamPeriodFrames(sinfo) * 1e6 / sinfo->sampleRate : 0.0));
+  result.Set("callbackTime", HistogramToObject(env, stats.callbackTime));
+  result.Set("waitTime", HistogramToObject(env, stats.waitTime));
+  // Outcome of the realtime/cpu/lockMemory options: off, pending, applied or denied
+  Napi::Object tuning = Napi::Object::New(env);
+  tuning.Set("audioThread", ThreadTuningStatusName(sinfo->tuningStatus.load(std::memory_order_relaxed)));
+  tuning.Set("feederThreads", ThreadTuningStatusName(sinfo->feederTuningStatus.load(std::memory_order_relaxed)));
+  tuning.Set("lockedBytes", Napi::Number::New(env, static_cast<double>(sinfo->lockedBytes)));
+  tuning.Set("lockFailures", Napi::Number::New(env, static_cast<double>(sinfo->lockFailures)));
+  result.Set("threadTuning", tuning);
+  return result;
 }
 
-// Open async stream with JS callback
-Napi::Value OpenStreamAsync(const Napi::CallbackInfo &info)
+// Shared playback clock of a callback or ring-mode stream (ArrayBuffer, see stream_clock.h)
+Napi::Value GetStreamClock(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
-  if (g_streams.size() > 0)
+  if (info.Length() < 1 || !info[0].IsNumber())
   {
-    Napi::Error::New(env, "Stream already open").ThrowAsJavaScriptException();
+    Napi::TypeError::New(env, "Expected stream ID").ThrowAsJavaScriptException();
     return env.Null();
   }
-  if (!info[0].IsObject() || !info[1].IsFunction())
+  StreamInfo *sinfo = GetStreamInfoById(env, info[0].As<Napi::Number>().Uint32Value());
+  if (!sinfo || sinfo->clockStorage.IsEmpty())
   {
-    Napi::TypeError::New(env, "Expected options object and callback").ThrowAsJavaScriptException();
+    Napi::Error::New(env, "Stream not open or has no clock").ThrowAsJavaScriptException();
     return env.Null();
   }
-  Napi::Object opts = info[0].As<Napi::Object>();
-  Napi::Function jsCallback = info[1].As<Napi::Function>();
-  int device = opts.Has("device") ? opts.Get("device").As<Napi::Number>().Int32Value() : Pa_GetDefaultOutputDevice();
-  int channels = opts.Has("channels") ? opts.Get("channels").As<Napi::Number>().Int32Value() : 2;
-  double sampleRate = opts.Has("sampleRate") ? opts.Get("sampleRate").As<Napi::Number>().DoubleValue() : 44100.0;
-  unsigned long framesPerBuffer = opts.Has("framesPerBuffer") ? opts.Get("framesPerBuffer").As<Napi::Number>().Uint32Value() : 256;
-  double latency = opts.Has("suggestedLatency") ? opts.Get("suggestedLatency").As<Napi::Number>().DoubleValue() : 0.0;
-
-  PaStreamParameters outputParams;
-  outputParams.device = device;
-  outputParams.channelCount = channels;
-  outputParams.sampleFormat = paFloat32;
-  if (latency > 0.0)
-  {
-    outputParams.suggestedLatency = latency;
-  }
-  else
-  {
-    const PaDeviceInfo *devInfo = Pa_GetDeviceInfo(device);
-    outputParams.suggestedLatency = devInfo ? devInfo->defaultLowOutputLatency : 0.05;
-  }
-  outputParams.hostApiSpecificStreamInfo = nullptr;
-
-  // Create ThreadSafeFunction for JS callback
-  g_audioCallbackTsfn = std::make_unique<Napi::ThreadSafeFunction>(
-      Napi::ThreadSafeFunction::New(env, jsCallback, "AudioCallback", 0, 1));
+  return sinfo->clockStorage.Value();
+}
 
-  PaStream *stream = nullptr;
-  PaError err = Pa_OpenStream(
-      &stream,
-      nullptr, // input
-      &outputParams,
-      sampleRate,
-      framesPerBuffer,
-      paNoFlag,
-      AudioCallback,
-      g_audioCallbackTsfn.get());
-  if (err != paNoError)
+// Current stream time (Pa_GetStreamTime), the time base of the clock's dacTime
+Napi::Value GetStreamTime(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsNumber())
   {
-    g_audioCallbackTsfn->Release();
-    g_audioCallbackTsfn.reset();
-    Napi::Error::New(env, Pa_GetErrorText(err)).ThrowAsJavaScriptException();
+    Napi::TypeError::New(env, "Expected stream ID").ThrowAsJavaScriptException();
     return env.Null();
   }
-  err = Pa_StartStream(stream);
-  if (err != paNoError)
+  StreamInfo *sinfo = GetStreamInfoById(env, info[0].As<Napi::Number>().Uint32Value());
+  if (!sinfo)
   {
-    Pa_CloseStream(stream);
-    g_audioCallbackTsfn->Release();
-    g_audioCallbackTsfn.reset();
-    Napi::Error::New(env, Pa_GetErrorText(err)).ThrowAsJavaScriptException();
+    Napi::Error::New(env, "Stream not open").ThrowAsJavaScriptException();
     return env.Null();
   }
-  uint32_t streamId = g_nextStreamId++;
-  g_streams[streamId] = {stream, 1.0f};
-  return Napi::Number::New(env, streamId);
+  return Napi::Number::New(env, Pa_GetStreamTime(sinfo->stream));
 }
 
-// Check if output format is supported for a device (float32, output only)
-Napi::Value IsOutputFormatSupported(const Napi::CallbackInfo &info)
+#ifdef ZEAKER_BENCH
+// Benchmark build only: pacing and buffer size of the null device for streams opened next
+Napi::Value ConfigureNullDevice(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
-  if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber())
+  NullDeviceConfig config;
+  if (info.Length() > 0 && info[0].IsObject())
   {
-    Napi::TypeError::New(env, "Expected device index, sample rate, channels").ThrowAsJavaScriptException();
-    return env.Null();
+    Napi::Object opts = info[0].As<Napi::Object>();
+    if (opts.Has("realtime"))
+      config.realtime = opts.Get("realtime").ToBoolean().Value();
+    if (opts.Has("latencyMs"))
+    {
+      double latencyMs = opts.Get("latencyMs").ToNumber().DoubleValue();
+      if (!(latencyMs > 0.0 && latencyMs <= 1000.0))
+      {
+        Napi::RangeError::New(env, "latencyMs must be in (0, 1000]").ThrowAsJavaScriptException();
+        return env.Null();
+      }
+      config.latencySeconds = latencyMs / 1000.0;
+    }
   }
-  int deviceIndex = info[0].As<Napi::Number>().Int32Value();
-  double sampleRate = info[1].As<Napi::Number>().DoubleValue();
-  int channels = info[2].As<Napi::Number>().Int32Value();
-
-  PaStreamParameters outputParams;
-  outputParams.device = deviceIndex;
-  outputParams.channelCount = channels;
-  outputParams.sampleFormat = paFloat32;
-  const PaDeviceInfo *devInfo = Pa_GetDeviceInfo(deviceIndex);
-  outputParams.suggestedLatency = devInfo ? devInfo->defaultLowOutputLatency : 0.05;
-  outputParams.hostApiSpecificStreamInfo = nullptr;
+  NullDeviceConfigure(config);
+  return env.Undefined();
+}
 
-  PaError err = Pa_IsFormatSupported(nullptr, &outputParams, sampleRate);
-  return Napi::Boolean::New(env, err == paNoError);
+// p50/p99/p999/max/mean of a set of microsecond timings
+static Napi::Object TimingsToObject(Napi::Env env, std::vector<float> values)
+{
+  Napi::Object result = Napi::Object::New(env);
+  double mean = 0.0;
+  for (float v : values)
+    mean += v;
+  std::sort(values.begin(), values.end());
+  auto quantile = [&values](double q)
+  {
+    return values.empty() ? 0.0 : static_cast<double>(values[static_cast<size_t>(q * (values.size() - 1))]);
+  };
+  result.Set("p50", Napi::Number::New(env, quantile(0.5)));
+  result.Set("p99", Napi::Number::New(env, quantile(0.99)));
+  result.Set("p999", Napi::Number::New(env, quantile(0.999)));
+  result.Set("max", Napi::Number::New(env, values.empty() ? 0.0 : values.back()));
+  result.Set("mean", Napi::Number::New(env, values.empty() ? 0.0 : mean / values.size()));
+  return result;
 }
 
-// Set stream volume
-Napi::Value SetStreamVolume(const Napi::CallbackInfo &info)
+// Benchmark build only: what the null device measured for a stream since it started or
+// since the last call, which resets it
+Napi::Value GetBenchReport(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
-  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber())
+  if (info.Length() < 1 || !info[0].IsNumber())
   {
-    Napi::TypeError::New(env, "Expected stream ID and volume").ThrowAsJavaScriptException();
+    Napi::TypeError::New(env, "Expected stream ID").ThrowAsJavaScriptException();
     return env.Null();
   }
-  uint32_t streamId = info[0].As<Napi::Number>().Uint32Value();
-  float volume = info[1].As<Napi::Number>().FloatValue();
-  if (volume < 0.0f)
-    volume = 0.0f;
-  if (volume > 2.0f)
-    volume = 2.0f;
-  StreamInfo *sinfo = GetStreamInfoById(streamId);
-  if (!sinfo)
+  StreamInfo *sinfo = GetStreamInfoById(env, info[0].As<Napi::Number>().Uint32Value());
+  NullDeviceReport report;
+  if (!sinfo || !NullDeviceGetReport(sinfo->stream, &report))
   {
     Napi::Error::New(env, "Stream not open").ThrowAsJavaScriptException();
     return env.Null();
   }
-  sinfo->volume = volume;
-  return env.Undefined();
+  NullDeviceResetReport(sinfo->stream);
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("elapsed", Napi::Number::New(env, report.elapsedSeconds));
+  result.Set("callbacks", Napi::Number::New(env, static_cast<double>(report.callbacks)));
+  result.Set("lateCallbacks", Napi::Number::New(env, static_cast<double>(report.lateCallbacks)));
+  result.Set("underflows", Napi::Number::New(env, static_cast<double>(report.underflows)));
+  result.Set("fillUs", TimingsToObject(env, std::move(report.fillUs)));
+  result.Set("jitterUs", TimingsToObject(env, std::move(report.jitterUs)));
+  result.Set("writeCalls", Napi::Number::New(env, static_cast<double>(report.writeCalls)));
+  result.Set("framesWritten", Napi::Number::New(env, static_cast<double>(report.framesWritten)));
+  result.Set("writeBlockedUs", Napi::Number::New(env, report.writeBlockedUs));
+  result.Set("framesPerSecond", Napi::Number::New(env, report.elapsedSeconds > 0 ? report.framesWritten / report.elapsedSeconds : 0.0));
+  return result;
 }
+#endif
 
-// Enumerate device capabilities (sample rates, channels, host API info)
-Napi::Value GetDeviceCapabilities(const Napi::CallbackInfo &info)
+// Close the output stream (by stream ID)
+Napi::Value CloseStream(const Napi::CallbackInfo &info)
 {
   Napi::Env env = info.Env();
-  int deviceIndex = Pa_GetDefaultOutputDevice();
-  if (info.Length() > 0 && info[0].IsNumber())
+  if (info.Length() < 1 || !info[0].IsNumber())
+    return env.Undefined();
+  uint32_t streamId = info[0].As<Napi::Number>().Uint32Value();
+  StreamInfo *sinfo = GetStreamInfoById(env, streamId);
+  if (!sinfo)
+    return env.Undefined();
+  PaStream *stream = sinfo->stream;
+  // The async writer must be gone before the stream it writes to
+  if (sinfo->writer)
+    sinfo->writer->Stop();
+  for (auto &deferred : sinfo->writeWaiters)
+    deferred.Reject(Napi::Error::New(env, "Stream closed").Value());
+  sinfo->writeWaiters.clear();
+  PaError err = paNoError;
+  if (sinfo->offline)
   {
-    deviceIndex = info[0].As<Napi::Number>().Int32Value();
+    // A render in progress resolves with what it rendered so far
+    SettleOfflineRender(env, sinfo);
   }
-  const PaDeviceInfo *devInfo = Pa_GetDeviceInfo(deviceIndex);
-  if (!devInfo)
+  else
   {
-    Napi::Error::New(env, "Invalid device index").ThrowAsJavaScriptException();
+    err = Pa_StopStream(stream);
+    if (err == paNoError)
+      err = Pa_CloseStream(stream);
+  }
+  ReleaseAllVoices(sinfo);
+  ReleaseStreamCallbacks(sinfo);
+  GetAddonData(env)->streams.erase(streamId);
+  if (err != paNoError)
+  {
+    Napi::Error::New(env, Pa_GetErrorText(err)).ThrowAsJavaScriptException();
     return env.Null();
   }
-  const PaHostApiInfo *hostApiInfo = Pa_GetHostApiInfo(devInfo->hostApi);
-  // Common sample rates to probe
-  std::vector<double> rates = {8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 176400, 192000};
-  Napi::Array supportedRates = Napi::Array::New(env);
-  int supportedCount = 0;
-  for (size_t i = 0; i < rates.size(); ++i)
+  return env.Undefined();
+}
+
+// Modified PortAudio stream callback for async playback with event reporting
+static int AudioCallback(const void * /*input*/, void *output,
+                         unsigned long frameCount,
+                         const PaStreamCallbackTimeInfo *timeInfo,
+                         PaStreamCallbackFlags statusFlags,
+                         void *userData)
+{
+  const auto callbackStart = std::chrono::steady_clock::now();
+  auto *sinfo = static_cast<StreamInfo *>(userData);
+  if (sinfo->tuningPending.load(std::memory_order_relaxed))
+    ApplyCallbackTuning(sinfo);
+  float *out = static_cast<float *>(output);
+  const uint32_t bytes = static_cast<uint32_t>(frameCount * sinfo->bytesPerFrame);
+  // Play whatever JS has queued; pad an underrun with silence
+  uint32_t n = sinfo->callbackRing.Read(out, bytes);
+  n -= n % sinfo->bytesPerFrame;
+  std::memset(reinterpret_cast<uint8_t *>(out) + n, 0, bytes - n);
+  const uint64_t delivered = n / sinfo->bytesPerFrame;
+  if (n < bytes)
+    RecordStarved(sinfo->stats, (bytes - n) / sinfo->bytesPerFrame);
+  sinfo->volume.Process(out, out, static_cast<uint32_t>(frameCount), sinfo->channels);
+  if (DspChain *dsp = sinfo->dspActive.load(std::memory_order_acquire))
+    dsp->Process(out, static_cast<uint32_t>(frameCount));
+  // Ask the main thread for more once a period is free; the request never blocks, and
+  // handing it over is the only wait left in callback mode
+  const auto requestStart = std::chrono::steady_clock::now();
+  const uint32_t period = static_cast<uint32_t>(sinfo->framesPerBuffer * sinfo->bytesPerFrame);
+  if (sinfo->callbackRing.WriteAvailable() >= period && !sinfo->fillPending.exchange(true, std::memory_order_acq_rel))
   {
-    PaStreamParameters outputParams;
-    outputParams.device = deviceIndex;
-    outputParams.channelCount = devInfo->maxOutputChannels;
-    outputParams.sampleFormat = paFloat32;
-    outputParams.suggestedLatency = devInfo->defaultLowOutputLatency;
-    outputParams.hostApiSpecificStreamInfo = nullptr;
-    PaError err = Pa_IsFormatSupported(nullptr, &outputParams, rates[i]);
-    if (err == paNoError)
+    if (sinfo->audioTsfn->NonBlockingCall() != napi_ok)
+      sinfo->fillPending.store(false, std::memory_order_release);
+  }
+  sinfo->stats.waitTime.Record(ElapsedUs(requestStart));
+  sinfo->analysis.Feed(out, static_cast<uint32_t>(frameCount));
+  // Report underflow/overflow events through the wait-free event channel
+  CountStatusFlags(sinfo, statusFlags);
+  sinfo->clock.Update(frameCount, delivered, timeInfo->outputBufferDacTime, timeInfo->currentTime);
+  sinfo->stats.callbacks.fetch_add(1, std::memory_order_relaxed);
+  sinfo->stats.lastFrameCount.store(static_cast<uint32_t>(frameCount), std::memory_order_relaxed);
+  sinfo->stats.lastCallbackUs.store(SteadyMicros(callbackStart), std::memory_order_relaxed);
+  sinfo->stats.callbackTime.Record(ElapsedUs(callbackStart));
+  return paContinue;
+}
+
+// Main thread: call the JS audio callback for one period. It gets the stream's reused
+// Float32Array and the frame count, and either fills the array in place (returning
+// nothing, or the number of frames written) or returns its own Float32Array/Buffer,
+// which is copied. Returns false if the callback threw.
+static bool FillCallbackPeriod(Napi::Env env, Napi::Function jsCallback, StreamInfo *sinfo)
+{
+  Napi::Float32Array buffer = sinfo->callbackBuffer.Value().As<Napi::Float32Array>();
+  float *dst = buffer.Data();
+  const size_t samples = buffer.ElementLength();
+  Napi::Value result = jsCallback.Call({buffer, Napi::Number::New(env, static_cast<double>(sinfo->framesPerBuffer))});
+  if (env.IsExceptionPending())
+    return false;
+  size_t filled = samples;
+  if (result.IsNumber())
+  {
+    filled = std::min<size_t>(static_cast<size_t>(std::max(result.As<Napi::Number>().DoubleValue(), 0.0)) * sinfo->channels, samples);
+  }
+  else if (result.IsTypedArray() && !result.StrictEquals(buffer))
+  {
+    // A callback returning a fresh array per period (the original API)
+    filled = 0;
+    Napi::TypedArray arr = result.As<Napi::TypedArray>();
+    if (arr.TypedArrayType() == napi_float32_array)
+    {
+      Napi::Float32Array f32arr = result.As<Napi::Float32Array>();
+      filled = std::min<size_t>(f32arr.ElementLength(), samples);
+      std::copy(f32arr.Data(), f32arr.Data() + filled, dst);
+    }
+    else if (result.IsBuffer())
     {
-      supportedRates.Set(supportedCount++, Napi::Number::New(env, rates[i]));
+      Napi::Buffer<float> buf = result.As<Napi::Buffer<float>>();
+      filled = std::min<size_t>(buf.Length(), samples);
+      std::copy(buf.Data(), buf.Data() + filled, dst);
     }
   }
-  // Supported channel counts (1 to maxOutputChannels)
-  Napi::Array supportedChannels = Napi::Array::New(env);
-  int chCount = 0;
-  for (int ch = 1; ch <= devInfo->maxOutputChannels; ++ch)
+  std::fill(dst + filled, dst + samples, 0.0f);
+  sinfo->callbackRing.Write(dst, static_cast<uint32_t>(samples * sizeof(float)));
+  return true;
+}
+
+// Main thread: top the callback ring up with whole periods
+static void RefillCallbackRing(Napi::Env env, Napi::Function jsCallback, StreamInfo *sinfo)
+{
+  const uint32_t period = static_cast<uint32_t>(sinfo->framesPerBuffer * sinfo->bytesPerFrame);
+  while (sinfo->callbackRing.WriteAvailable() >= period)
   {
-    PaStreamParameters outputParams;
-    outputParams.device = deviceIndex;
-    outputParams.channelCount = ch;
-    outputParams.sampleFormat = paFloat32;
-    outputParams.suggestedLatency = devInfo->defaultLowOutputLatency;
-    outputParams.hostApiSpecificStreamInfo = nullptr;
-    PaError err = Pa_IsFormatSupported(nullptr, &outputParams, devInfo->defaultSampleRate);
-    if (err == paNoError)
+    if (!FillCallbackPeriod(env, jsCallback, sinfo))
+      break;
+  }
+}
+
+static void CallAudioJs(Napi::Env env, Napi::Function jsCallback, StreamInfo *sinfo, void *)
+{
+  // env is null while the function is being torn down, and the stream may be gone
+  if (env == nullptr)
+    return;
+  if (jsCallback != nullptr && !sinfo->callbackBuffer.IsEmpty())
+    RefillCallbackRing(env, jsCallback, sinfo);
+  sinfo->fillPending.store(false, std::memory_order_release);
+}
+
+// PortAudio callback for ring-mode streams: only mixes out of the voice rings, never touches V8
+static int RingCallback(const void *input, void *output,
+                        unsigned long frameCount,
+                        const PaStreamCallbackTimeInfo *timeInfo,
+                        PaStreamCallbackFlags statusFlags,
+                        void *userData)
+{
+  const auto callbackStart = std::chrono::steady_clock::now();
+  auto *sinfo = static_cast<StreamInfo *>(userData);
+  if (sinfo->tuningPending.load(std::memory_order_relaxed))
+    ApplyCallbackTuning(sinfo);
+  uint8_t *out = static_cast<uint8_t *>(output);
+  const size_t bytes = frameCount * sinfo->bytesPerFrame;
+  uint64_t delivered = 0;
+  // Duplex streams: float32 input of this same period
+  const float *in = static_cast<const float *>(input);
+  const bool loopback = sinfo->captureSource == kCaptureOutput;
+  if (sinfo->paused.load(std::memory_order_relaxed))
+  {
+    // Output silence without consuming anything
+    std::memset(out, 0, bytes);
+  }
+  else if (sinfo->bitPerfect)
+  {
+    // Decoder bytes go to the device untouched; pad an underrun with silence
+    uint32_t n = sinfo->mixer.Voice(0).ring.Read(out, static_cast<uint32_t>(bytes));
+    n -= n % sinfo->bytesPerFrame;
+    std::memset(out + n, 0, bytes - n);
+    delivered = n / sinfo->bytesPerFrame;
+    if (n < bytes && !sinfo->mixer.Voice(0).ring.EndOfStream())
+      RecordStarved(sinfo->stats, (bytes - n) / sinfo->bytesPerFrame);
+  }
+  else if (sinfo->sampleFormat == paFloat32)
+  {
+    float *fout = reinterpret_cast<float *>(out);
+    sinfo->mixer.Render(fout, static_cast<uint32_t>(frameCount));
+    sinfo->volume.Process(fout, fout, static_cast<uint32_t>(frameCount), sinfo->channels);
+    if (DspChain *dsp = sinfo->dspActive.load(std::memory_order_acquire))
+      dsp->Process(fout, static_cast<uint32_t>(frameCount));
+    if (in)
+      sinfo->duplex.Process(in, fout, static_cast<uint32_t>(frameCount));
+    if (loopback)
+      WriteCapture(sinfo, fout, static_cast<uint32_t>(frameCount), sinfo->channels);
+  }
+  else
+  {
+    // Mix in float one block at a time, then encode to the device format
+    float *mix = sinfo->mixScratch.data();
+    DspChain *dsp = sinfo->dspActive.load(std::memory_order_acquire);
+    for (unsigned long done = 0; done < frameCount;)
     {
-      supportedChannels.Set(chCount++, Napi::Number::New(env, ch));
+      uint32_t n = static_cast<uint32_t>(std::min<unsigned long>(frameCount - done, kMixBlockFrames));
+      sinfo->mixer.Render(mix, n);
+      sinfo->volume.Process(mix, mix, n, sinfo->channels);
+      if (dsp)
+        dsp->Process(mix, n);
+      if (in)
+        sinfo->duplex.Process(in + done * sinfo->inputChannels, mix, n);
+      if (loopback)
+        WriteCapture(sinfo, mix, n, sinfo->channels);
+      FloatToSamples(sinfo->sampleFormat, mix, out + done * sinfo->bytesPerFrame, static_cast<size_t>(n) * sinfo->channels);
+      done += n;
     }
   }
-  // Supported bit depths (sample formats)
-  struct BitDepthFormat
-  {
-    PaSampleFormat format;
-    int bitDepth;
-  };
-  std::vector<BitDepthFormat> bitDepths = {
-      {paInt16, 16},
-      {paInt24, 24},
-      {paInt32, 32},
-      {paFloat32, 32}};
-  Napi::Array supportedBitDepths = Napi::Array::New(env);
-  int bitDepthCount = 0;
-  for (const auto &bdf : bitDepths)
+  if (!sinfo->bitPerfect)
+    delivered = sinfo->mixer.TakeDeliveredFrames();
+  sinfo->analysis.Feed(out, static_cast<uint32_t>(frameCount));
+  // Input is recorded even while playback is paused
+  if (in && sinfo->captureSource == kCaptureInput)
+    WriteCapture(sinfo, in, static_cast<uint32_t>(frameCount), sinfo->inputChannels);
+  CountStatusFlags(sinfo, statusFlags);
+  if (uint32_t ended = sinfo->mixer.TakeEndedMask())
   {
-    PaStreamParameters outputParams;
-    outputParams.device = deviceIndex;
-    outputParams.channelCount = devInfo->maxOutputChannels;
-    outputParams.sampleFormat = bdf.format;
-    outputParams.suggestedLatency = devInfo->defaultLowOutputLatency;
-    outputParams.hostApiSpecificStreamInfo = nullptr;
-    PaError err = Pa_IsFormatSupported(nullptr, &outputParams, devInfo->defaultSampleRate);
-    if (err == paNoError)
+    for (int i = 0; i < kMaxVoices; ++i)
     {
-      supportedBitDepths.Set(bitDepthCount++, Napi::Number::New(env, bdf.bitDepth));
+      if (ended & (1u << i))
+        sinfo->events.Post(kEventVoiceEnded, i);
     }
   }
-  Napi::Object result = Napi::Object::New(env);
-  result.Set("index", deviceIndex);
-  result.Set("name", devInfo->name ? devInfo->name : "");
-  result.Set("maxInputChannels", devInfo->maxInputChannels);
-  result.Set("maxOutputChannels", devInfo->maxOutputChannels);
-  result.Set("defaultSampleRate", devInfo->defaultSampleRate);
-  result.Set("supportedSampleRates", supportedRates);
-  result.Set("supportedChannels", supportedChannels);
-  result.Set("supportedBitDepths", supportedBitDepths);
-  result.Set("hostApi", devInfo->hostApi);
-  result.Set("hostApiName", hostApiInfo ? hostApiInfo->name : "");
-  result.Set("isDefaultOutput", deviceIndex == Pa_GetDefaultOutputDevice());
-  return result;
+  // Ring-mode callbacks never wait: missing data is substituted with silence and counted
+  if (uint32_t starved = sinfo->mixer.TakeStarvedFrames())
+    RecordStarved(sinfo->stats, starved);
+  sinfo->clock.Update(frameCount, delivered, timeInfo->outputBufferDacTime, timeInfo->currentTime);
+  sinfo->stats.callbacks.fetch_add(1, std::memory_order_relaxed);
+  sinfo->stats.lastFrameCount.store(static_cast<uint32_t>(frameCount), std::memory_order_relaxed);
+  sinfo->stats.lastCallbackUs.store(SteadyMicros(callbackStart), std::memory_order_relaxed);
+  sinfo->stats.callbackTime.Record(ElapsedUs(callbackStart));
+  sinfo->callbackEpoch.fetch_add(1, std::memory_order_release);
+  return paContinue;
+}
+
+// PortAudio callback for capture-only streams (openCaptureStream): record the input
+static int CaptureCallback(const void *input, void * /*output*/,
+                           unsigned long frameCount,
+                           const PaStreamCallbackTimeInfo * /*timeInfo*/,
+                           PaStreamCallbackFlags statusFlags,
+                           void *userData)
+{
+  const auto callbackStart = std::chrono::steady_clock::now();
+  auto *sinfo = static_cast<StreamInfo *>(userData);
+  if (sinfo->tuningPending.load(std::memory_order_relaxed))
+    ApplyCallbackTuning(sinfo);
+  if (const float *in = static_cast<const float *>(input))
+  {
+    sinfo->duplex.Meter(in, static_cast<uint32_t>(frameCount));
+    if (!sinfo->paused.load(std::memory_order_relaxed))
+      WriteCapture(sinfo, in, static_cast<uint32_t>(frameCount), sinfo->inputChannels);
+  }
+  CountStatusFlags(sinfo, statusFlags);
+  sinfo->stats.callbacks.fetch_add(1, std::memory_order_relaxed);
+  sinfo->stats.lastFrameCount.store(static_cast<uint32_t>(frameCount), std::memory_order_relaxed);
+  sinfo->stats.lastCallbackUs.store(SteadyMicros(callbackStart), std::memory_order_relaxed);
+  sinfo->stats.callbackTime.Record(ElapsedUs(callbackStart));
+  return paContinue;
+}
+
+// Set the default JS callback for stream events/errors (used by streams opened afterwards
+// without their own eventCallback option)
+Napi::Value SetStreamEventCallback(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (!info[0].IsFunction())
+  {
+    Napi::TypeError::New(env, "Expected callback function").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Function jsCallback = info[0].As<Napi::Function>();
+  AddonData *data = GetAddonData(env);
+  if (data->eventCallbackTsfn)
+  {
+    data->eventCallbackTsfn->Release();
+    data->eventCallbackTsfn.reset();
+  }
+  data->eventCallbackTsfn = std::make_unique<Napi::ThreadSafeFunction>(
+      Napi::ThreadSafeFunction::New(env, jsCallback, "StreamEventCallback", 0, 1));
+  return env.Undefined();
+}
+
+// Output parameters for a stream; latency <= 0 picks the device's default low latency
+static PaStreamParameters MakeOutputParams(int device, int channels, PaSampleFormat sampleFormat, double latency)
+{
+  PaStreamParameters outputParams;
+  outputParams.device = device;
+  outputParams.channelCount = channels;
+  outputParams.sampleFormat = sampleFormat;
+  if (latency > 0.0)
+  {
+    outputParams.suggestedLatency = latency;
+  }
+  else
+  {
+    const PaDeviceInfo *devInfo = Pa_GetDeviceInfo(device);
+    outputParams.suggestedLatency = devInfo ? devInfo->defaultLowOutputLatency : 0.05;
+  }
+  outputParams.hostApiSpecificStreamInfo = nullptr;
+  return outputParams;
+}
+
+// Input side of a duplex or capture stream; captured samples are always float32
+static PaStreamParameters MakeInputParams(int device, int channels, double latency)
+{
+  PaStreamParameters inputParams;
+  inputParams.device = device;
+  inputParams.channelCount = channels;
+  inputParams.sampleFormat = paFloat32;
+  if (latency > 0.0)
+  {
+    inputParams.suggestedLatency = latency;
+  }
+  else
+  {
+    const PaDeviceInfo *devInfo = Pa_GetDeviceInfo(device);
+    inputParams.suggestedLatency = devInfo ? devInfo->defaultLowInputLatency : 0.05;
+  }
+  inputParams.hostApiSpecificStreamInfo = nullptr;
+  return inputParams;
+}
+
+// Monitoring and ducking options of the input stream option and setDuplex():
+// { monitorGain, duck: true | { gain, threshold, attackMs, releaseMs, holdMs } }
+static bool ParseDuplexSettings(Napi::Env env, Napi::Object opts, DuplexSettings *settings)
+{
+  if (opts.Has("monitorGain") && !opts.Get("monitorGain").IsUndefined())
+  {
+    Napi::Value gain = opts.Get("monitorGain");
+    if (!gain.IsNumber() || gain.As<Napi::Number>().FloatValue() < 0.0f)
+    {
+      Napi::RangeError::New(env, "monitorGain must be a non-negative number").ThrowAsJavaScriptException();
+      return false;
+    }
+    settings->monitorGain = std::min(gain.As<Napi::Number>().FloatValue(), 4.0f);
+  }
+  if (opts.Has("duck") && !opts.Get("duck").IsUndefined())
+  {
+    Napi::Value duck = opts.Get("duck");
+    settings->duck = duck.IsObject() || duck.ToBoolean().Value();
+    if (duck.IsObject())
+    {
+      Napi::Object d = duck.As<Napi::Object>();
+      auto number = [&d](const char *name, float *field)
+      {
+        if (d.Has(name) && d.Get(name).IsNumber())
+          *field = d.Get(name).As<Napi::Number>().FloatValue();
+      };
+      number("gain", &settings->duckGain);
+      number("threshold", &settings->duckThreshold);
+      number("attackMs", &settings->attackMs);
+      number("releaseMs", &settings->releaseMs);
+      number("holdMs", &settings->holdMs);
+    }
+  }
+  return true;
+}
+
+// Allocate the float32 capture ring JS drains (see getCaptureRing)
+static void AllocateCaptureRing(Napi::Env env, StreamInfo *sinfo, uint64_t frames, int channels)
+{
+  uint32_t capacity = RingCapacityFor(frames * channels * sizeof(float));
+  Napi::ArrayBuffer storage = Napi::ArrayBuffer::New(env, kRingHeaderBytes + capacity);
+  std::memset(storage.Data(), 0, kRingHeaderBytes);
+  if (LockStreamMemory(sinfo, storage.Data(), storage.ByteLength()))
+  {
+    sinfo->captureLockedData = storage.Data();
+    sinfo->captureLockedBytes = storage.ByteLength();
+  }
+  sinfo->captureRing.Attach(static_cast<uint8_t *>(storage.Data()), capacity);
+  sinfo->captureStorage = Napi::Persistent(storage.As<Napi::Object>());
+}
+
+// Duplex options of openStreamAsync(): input: { device, channels, suggestedLatency,
+// monitorGain, duck }, capture: 'input' (the default with an input), 'output'
+// (loopback: the final mix) or 'none', and captureRingFrames (default 2 s)
+static bool ParseInputOptions(Napi::Env env, Napi::Object opts, bool ringMode, StreamInfo *sinfo)
+{
+  const bool hasInput = opts.Has("input") && opts.Get("input").IsObject();
+  std::string capture = hasInput ? "input" : "none";
+  if (opts.Has("capture") && !opts.Get("capture").IsUndefined())
+    capture = opts.Get("capture").ToString().Utf8Value();
+  if (capture != "input" && capture != "output" && capture != "none")
+  {
+    Napi::TypeError::New(env, "capture must be input, output or none").ThrowAsJavaScriptException();
+    return false;
+  }
+  if (!hasInput && capture == "input")
+  {
+    Napi::Error::New(env, "Capturing the input needs the input option").ThrowAsJavaScriptException();
+    return false;
+  }
+  if (!hasInput && capture == "none")
+    return true;
+  if (!ringMode)
+  {
+    Napi::Error::New(env, "Duplex input and capture need a ring-mode stream").ThrowAsJavaScriptException();
+    return false;
+  }
+  if (hasInput)
+  {
+    Napi::Object input = opts.Get("input").As<Napi::Object>();
+    int device = input.Has("device") ? input.Get("device").As<Napi::Number>().Int32Value() : Pa_GetDefaultInputDevice();
+    const PaDeviceInfo *devInfo = device >= 0 ? Pa_GetDeviceInfo(device) : nullptr;
+    if (!devInfo || devInfo->maxInputChannels <= 0)
+    {
+      Napi::Error::New(env, "No input device").ThrowAsJavaScriptException();
+      return false;
+    }
+    int channels = input.Has("channels") ? input.Get("channels").As<Napi::Number>().Int32Value() : std::min(devInfo->maxInputChannels, 2);
+    if (channels <= 0 || channels > devInfo->maxInputChannels)
+    {
+      Napi::RangeError::New(env, "Input channel count out of range for the device").ThrowAsJavaScriptException();
+      return false;
+    }
+    DuplexSettings settings;
+    if (!ParseDuplexSettings(env, input, &settings))
+      return false;
+    // Bit-perfect output is the source untouched, with nothing mixed in
+    if (sinfo->bitPerfect && (settings.monitorGain > 0.0f || settings.duck))
+    {
+      Napi::Error::New(env, "Bit-perfect streams cannot monitor or duck").ThrowAsJavaScriptException();
+      return false;
+    }
+    sinfo->inputDevice = device;
+    sinfo->inputChannels = channels;
+    sinfo->inputLatency = input.Has("suggestedLatency") ? input.Get("suggestedLatency").As<Napi::Number>().DoubleValue() : 0.0;
+    sinfo->duplex.Configure(channels, sinfo->channels, sinfo->sampleRate);
+    sinfo->duplex.Apply(settings);
+  }
+  if (capture == "output" && sinfo->bitPerfect)
+  {
+    // The output of a bit-perfect stream never exists as float
+    Napi::Error::New(env, "Bit-perfect streams cannot capture their output").ThrowAsJavaScriptException();
+    return false;
+  }
+  if (capture != "none")
+  {
+    sinfo->captureSource = capture == "input" ? kCaptureInput : kCaptureOutput;
+    const int channels = sinfo->captureSource == kCaptureInput ? sinfo->inputChannels : sinfo->channels;
+    uint64_t frames = opts.Has("captureRingFrames") ? opts.Get("captureRingFrames").As<Napi::Number>().Uint32Value() : 0;
+    if (frames == 0)
+      frames = static_cast<uint64_t>(sinfo->sampleRate * 2);
+    AllocateCaptureRing(env, sinfo, frames, channels);
+  }
+  return true;
+}
+
+// Open async stream with JS callback
+Napi::Value OpenStreamAsync(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (!info[0].IsObject() || (info.Length() > 1 && !info[1].IsUndefined() && !info[1].IsFunction()))
+  {
+    Napi::TypeError::New(env, "Expected options object and optional callback").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  std::shared_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+  Napi::Object opts = info[0].As<Napi::Object>();
+  // Without a JS callback the stream runs in ring mode (see GetStreamRing)
+  bool ringMode = info.Length() < 2 || !info[1].IsFunction();
+  int device = opts.Has("device") ? opts.Get("device").As<Napi::Number>().Int32Value() : Pa_GetDefaultOutputDevice();
+  int channels = opts.Has("channels") ? opts.Get("channels").As<Napi::Number>().Int32Value() : 2;
+  double sampleRate = opts.Has("sampleRate") ? opts.Get("sampleRate").As<Napi::Number>().DoubleValue() : 44100.0;
+  unsigned long framesPerBuffer = opts.Has("framesPerBuffer") ? opts.Get("framesPerBuffer").As<Napi::Number>().Uint32Value() : 256;
+  double latency = opts.Has("suggestedLatency") ? opts.Get("suggestedLatency").As<Napi::Number>().DoubleValue() : 0.0;
+  bool bitPerfect = opts.Has("bitPerfect") && opts.Get("bitPerfect").ToBoolean().Value();
+  // No device: the stream is rendered with renderStreamAsync()
+  bool offline = opts.Has("offline") && opts.Get("offline").ToBoolean().Value();
+  if (channels <= 0 || sampleRate <= 0)
+  {
+    Napi::Error::New(env, "Channel count and sample rate must be positive").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+#ifdef _WIN32
+  // renderStreamAsync() and its render thread are POSIX-only, so the stream could never run
+  if (offline)
+  {
+    Napi::Error::New(env, "Offline streams are not supported on this platform").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+#endif
+  if (offline && !ringMode)
+  {
+    Napi::Error::New(env, "Offline streams must be ring-mode streams").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  PaSampleFormat sampleFormat = GetSampleFormatOption(env, opts);
+  if (sampleFormat == 0)
+    return env.Null();
+  if (!ringMode && sampleFormat != paFloat32)
+  {
+    // JS audio callbacks exchange Float32Arrays
+    Napi::Error::New(env, "Callback streams only support the float32 sample format").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  double sourceSampleRate = opts.Has("sourceSampleRate") ? opts.Get("sourceSampleRate").As<Napi::Number>().DoubleValue() : sampleRate;
+  if (sourceSampleRate <= 0)
+    sourceSampleRate = sampleRate;
+  bool varispeed = opts.Has("varispeed") && opts.Get("varispeed").ToBoolean().Value();
+  if (bitPerfect && (sourceSampleRate != sampleRate || varispeed))
+  {
+    Napi::Error::New(env, "Bit-perfect streams cannot resample").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  int32_t resampleQuality = kResampleHigh;
+  if (opts.Has("resampleQuality"))
+  {
+    resampleQuality = ParseResamplerQuality(opts.Get("resampleQuality").ToString().Utf8Value());
+    if (resampleQuality < 0)
+    {
+      Napi::Error::New(env, "Unknown resampleQuality (expected low, medium, high or best)").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+  }
+
+  HostApiSettings hostApi;
+  if (!ParseHostApiSettings(env, opts, &hostApi))
+    return env.Null();
+  // Nothing is converted on the way to a bit-perfect device
+  if (bitPerfect)
+    hostApi.flags |= paClipOff | paDitherOff;
+  PaStreamParameters outputParams = MakeOutputParams(device, channels, sampleFormat, latency);
+  HostApiStreamInfo hostInfo;
+  std::string hostError;
+  if (!offline && !PrepareHostApiStream(hostApi, &outputParams, &hostInfo, &hostError))
+  {
+    Napi::Error::New(env, hostError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (opts.Has("eventCallback") && !opts.Get("eventCallback").IsFunction())
+  {
+    Napi::TypeError::New(env, "eventCallback must be a function").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  ThreadTuning tuning;
+  if (!ParseThreadTuning(env, opts, (framesPerBuffer > 0 ? framesPerBuffer : 256) / sampleRate, &tuning))
+    return env.Null();
+
+  // The ID is assigned up front because the callback reports it in events
+  AddonData *data = GetAddonData(env);
+  auto sinfo = std::make_unique<StreamInfo>();
+  sinfo->id = data->nextStreamId++;
+  sinfo->channels = channels;
+  sinfo->sampleRate = sampleRate;
+  sinfo->sampleFormat = sampleFormat;
+  sinfo->bytesPerFrame = channels * BytesPerSample(sampleFormat);
+  sinfo->framesPerBuffer = framesPerBuffer;
+  sinfo->device = device;
+  sinfo->suggestedLatency = latency;
+  sinfo->tuning = tuning;
+  sinfo->hostApi = hostApi;
+  sinfo->bitPerfect = ringMode && bitPerfect;
+  if (!ParseInputOptions(env, opts, ringMode, sinfo.get()))
+  {
+    ReleaseStreamCallbacks(sinfo.get());
+    return env.Null();
+  }
+  if (offline && sinfo->inputChannels > 0)
+  {
+    ReleaseStreamCallbacks(sinfo.get());
+    Napi::Error::New(env, "Offline streams cannot have an input").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (opts.Has("volumeRampMs"))
+    sinfo->volumeRampMs = std::max(opts.Get("volumeRampMs").As<Napi::Number>().DoubleValue(), 0.0);
+  if (opts.Has("eventCallback"))
+  {
+    sinfo->eventTsfn = std::make_unique<Napi::ThreadSafeFunction>(
+        Napi::ThreadSafeFunction::New(env, opts.Get("eventCallback").As<Napi::Function>(), "StreamEventCallback", 0, 1));
+  }
+  else if (data->eventCallbackTsfn)
+  {
+    // Share the default channel; our own reference keeps it alive if it is replaced
+    sinfo->eventTsfn = std::make_unique<Napi::ThreadSafeFunction>(*data->eventCallbackTsfn);
+    sinfo->eventTsfn->Acquire();
+  }
+  PaStreamCallback *callback = AudioCallback;
+  void *userData = sinfo.get();
+  if (ringMode)
+  {
+    // Default to half a second of audio so a busy event loop does not starve the device
+    uint64_t ringFrames = opts.Has("ringBufferFrames") ? opts.Get("ringBufferFrames").As<Napi::Number>().Uint32Value() : 0;
+    if (ringFrames == 0)
+      ringFrames = std::max<uint64_t>(framesPerBuffer * 4, static_cast<uint64_t>(sampleRate / 2));
+    sinfo->ringMode = true;
+    sinfo->bitPerfect = bitPerfect;
+    sinfo->sourceSampleRate = sourceSampleRate;
+    sinfo->resampleQuality = resampleQuality;
+    sinfo->defaultRingFrames = ringFrames;
+    if (opts.Has("seekRetentionFrames") && !bitPerfect)
+      sinfo->retainFrames = opts.Get("seekRetentionFrames").As<Napi::Number>().Uint32Value();
+    sinfo->mixer.Configure(channels, sampleFormat);
+    if (sampleFormat != paFloat32)
+    {
+      sinfo->mixScratch.assign(kMixBlockFrames * channels, 0.0f);
+      LockStreamMemory(sinfo.get(), sinfo->mixScratch.data(), sinfo->mixScratch.size() * sizeof(float));
+    }
+    VoiceSetup setup;
+    setup.ringFrames = ringFrames;
+    setup.retainFrames = sinfo->retainFrames;
+    setup.sourceRate = sinfo->sourceSampleRate;
+    setup.varispeed = varispeed;
+    AllocateVoice(env, sinfo.get(), setup);
+    callback = RingCallback;
+  }
+  else
+  {
+    // JS fills periods ahead of the device: a few periods of float32 queued natively,
+    // topped up from the main thread whenever one has been played
+    if (framesPerBuffer == 0)
+      sinfo->framesPerBuffer = 256;
+    const uint64_t periodBytes = static_cast<uint64_t>(sinfo->framesPerBuffer) * sinfo->bytesPerFrame;
+    uint32_t periods = opts.Has("callbackPeriods") ? std::max(opts.Get("callbackPeriods").As<Napi::Number>().Uint32Value(), 2u) : 3;
+    uint32_t capacity = RingCapacityFor(periods * periodBytes);
+    sinfo->callbackRingStorage.assign(kRingHeaderBytes + capacity, 0);
+    sinfo->callbackRing.Attach(sinfo->callbackRingStorage.data(), capacity);
+    LockStreamMemory(sinfo.get(), sinfo->callbackRingStorage.data(), sinfo->callbackRingStorage.size());
+    sinfo->callbackBuffer = Napi::Persistent(Napi::Float32Array::New(env, static_cast<size_t>(sinfo->framesPerBuffer) * channels).As<Napi::Object>());
+    sinfo->audioTsfn = std::make_unique<AudioCallbackTsfn>(
+        AudioCallbackTsfn::New(env, info[1].As<Napi::Function>(), "AudioCallback", 0, 1, sinfo.get()));
+    // Prime the queue so the first callbacks already have audio
+    RefillCallbackRing(env, info[1].As<Napi::Function>(), sinfo.get());
+    if (env.IsExceptionPending())
+    {
+      ReleaseStreamCallbacks(sinfo.get());
+      return env.Null();
+    }
+  }
+  Napi::ArrayBuffer clockStorage = Napi::ArrayBuffer::New(env, kClockBytes);
+  sinfo->clock.Attach(static_cast<uint8_t *>(clockStorage.Data()), sampleRate);
+  sinfo->clockStorage = Napi::Persistent(clockStorage.As<Napi::Object>());
+  if (offline)
+  {
+    sinfo->offline = true;
+    sinfo->live.Forget();
+    if (framesPerBuffer == 0)
+      sinfo->framesPerBuffer = 1024;
+    uint32_t streamId = sinfo->id;
+    RegisterEventChannel(sinfo.get());
+    data->streams[streamId] = std::move(sinfo);
+    return Napi::Number::New(env, streamId);
+  }
+
+  PaStreamParameters inputParams = MakeInputParams(sinfo->inputDevice, sinfo->inputChannels, sinfo->inputLatency);
+  PaStream *stream = nullptr;
+  PaError err = Pa_OpenStream(
+      &stream,
+      sinfo->inputChannels > 0 ? &inputParams : nullptr,
+      &outputParams,
+      sampleRate,
+      // Callback mode pinned an unspecified period to 256 above: its queue, buffer and
+      // stats assume fixed periods
+      sinfo->framesPerBuffer,
+      hostApi.flags,
+      callback,
+      userData);
+  if (err != paNoError)
+  {
+    ReleaseAllVoices(sinfo.get());
+    ReleaseStreamCallbacks(sinfo.get());
+    Napi::Error::New(env, Pa_GetErrorText(err)).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  FinishHostApiStream(hostApi, device, stream);
+  err = Pa_StartStream(stream);
+  if (err != paNoError)
+  {
+    Pa_CloseStream(stream);
+    ReleaseAllVoices(sinfo.get());
+    ReleaseStreamCallbacks(sinfo.get());
+    Napi::Error::New(env, Pa_GetErrorText(err)).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  uint32_t streamId = sinfo->id;
+  sinfo->stream = stream;
+  RequestCallbackTuning(sinfo.get());
+  RegisterEventChannel(sinfo.get());
+  data->streams[streamId] = std::move(sinfo);
+  return Napi::Number::New(env, streamId);
+}
+
+// Resolve the ring-mode stream and voice addressed by (streamId, voiceId = 0) arguments;
+// throws and returns nullptr on failure
+static StreamInfo *GetRingStream(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsNumber())
+  {
+    Napi::TypeError::New(env, "Expected stream ID").ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  StreamInfo *sinfo = GetStreamInfoById(env, info[0].As<Napi::Number>().Uint32Value());
+  if (!sinfo)
+  {
+    Napi::Error::New(env, "Stream not open").ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  if (!sinfo->ringMode)
+  {
+    Napi::Error::New(env, "Stream was not opened in ring mode").ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  return sinfo;
+}
+
+// Ring-mode stream from info[0] plus an active voice from info[voiceArg] (default 0)
+static StreamInfo *GetRingStreamArg(const Napi::CallbackInfo &info, size_t voiceArg, int *voice)
+{
+  Napi::Env env = info.Env();
+  StreamInfo *sinfo = GetRingStream(info);
+  if (!sinfo)
+    return nullptr;
+  *voice = info.Length() > voiceArg && info[voiceArg].IsNumber() ? info[voiceArg].As<Napi::Number>().Int32Value() : 0;
+  if (*voice < 0 || *voice >= kMaxVoices || sinfo->mixer.Voice(*voice).state.load(std::memory_order_acquire) != kVoiceActive)
+  {
+    Napi::Error::New(env, "Invalid voice ID").ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  return sinfo;
+}
+
+// Get the ArrayBuffer backing a voice ring, voice 0 by default (layout documented in ring_buffer.h)
+Napi::Value GetStreamRing(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  int voice = 0;
+  StreamInfo *sinfo = GetRingStreamArg(info, 1, &voice);
+  if (!sinfo)
+    return env.Null();
+  return sinfo->voices[voice].storage.Value();
+}
+
+static int ParseCurve(const std::string &name)
+{
+  if (name == "log" || name == "logarithmic")
+    return kCurveLogarithmic;
+  if (name == "exp" || name == "exponential")
+    return kCurveExponential;
+  if (name == "equal-power" || name == "equalpower")
+    return kCurveEqualPower;
+  return kCurveLinear;
+}
+
+// Add a mixer voice to a ring-mode stream:
+// addVoice(streamId, { gain, follows, replaces, prefillFrames, ringBufferFrames, retainFrames, sampleRate, varispeed })
+// `follows` starts the voice at the exact sample after that voice runs dry (gapless);
+// `replaces` holds it until prefillFrames are buffered, then crossfades over from that
+// voice within one block and finishes it (a seek splice)
+Napi::Value AddVoice(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  // Voice 0 may already have been removed (e.g. after a crossfade), so do not require it
+  StreamInfo *sinfo = GetRingStream(info);
+  if (!sinfo)
+    return env.Null();
+  ReclaimRetiredVoices(sinfo);
+  VoiceSetup setup;
+  setup.ringFrames = sinfo->defaultRingFrames;
+  setup.retainFrames = sinfo->retainFrames;
+  setup.sourceRate = sinfo->sourceSampleRate;
+  setup.prefillFrames = static_cast<uint32_t>(2 * StreamPeriodFrames(sinfo));
+  if (info.Length() > 1 && info[1].IsObject())
+  {
+    Napi::Object opts = info[1].As<Napi::Object>();
+    if (opts.Has("sampleRate") && opts.Get("sampleRate").As<Napi::Number>().DoubleValue() > 0)
+      setup.sourceRate = opts.Get("sampleRate").As<Napi::Number>().DoubleValue();
+    if (opts.Has("gain"))
+      setup.gain = std::min(std::max(opts.Get("gain").As<Napi::Number>().FloatValue(), 0.0f), 2.0f);
+    if (opts.Has("follows"))
+      setup.follows = opts.Get("follows").As<Napi::Number>().Int32Value();
+    if (opts.Has("replaces"))
+      setup.replaces = opts.Get("replaces").As<Napi::Number>().Int32Value();
+    if (opts.Has("prefillFrames"))
+      setup.prefillFrames = opts.Get("prefillFrames").As<Napi::Number>().Uint32Value();
+    if (opts.Has("ringBufferFrames") && opts.Get("ringBufferFrames").As<Napi::Number>().Uint32Value() > 0)
+      setup.ringFrames = opts.Get("ringBufferFrames").As<Napi::Number>().Uint32Value();
+    if (opts.Has("retainFrames") && !sinfo->bitPerfect)
+      setup.retainFrames = opts.Get("retainFrames").As<Napi::Number>().Uint32Value();
+    setup.varispeed = opts.Has("varispeed") && opts.Get("varispeed").ToBoolean().Value();
+  }
+  if (setup.follows >= kMaxVoices || setup.replaces >= kMaxVoices)
+  {
+    Napi::Error::New(env, "Invalid voice ID").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (sinfo->bitPerfect && (setup.sourceRate != sinfo->sampleRate || setup.varispeed))
+  {
+    Napi::Error::New(env, "Bit-perfect streams cannot resample").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  int voice = AllocateVoice(env, sinfo, setup);
+  if (voice < 0)
+  {
+    Napi::Error::New(env, "No free mixer voices").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  return Napi::Number::New(env, voice);
+}
+
+// Open a stream again on its recorded devices with the same callback and userData, so
+// its rings, voices, DSP and clock carry on (see refreshDevices and switchStreamDevice)
+static PaError ReopenStream(StreamInfo *sinfo, std::string *error)
+{
+  const bool output = sinfo->ringMode || sinfo->audioTsfn;
+  PaStreamParameters outputParams = MakeOutputParams(sinfo->device, sinfo->channels, sinfo->sampleFormat, sinfo->suggestedLatency);
+  HostApiStreamInfo hostInfo;
+  if (output && !PrepareHostApiStream(sinfo->hostApi, &outputParams, &hostInfo, error))
+    return paInvalidDevice;
+  PaStreamParameters inputParams = MakeInputParams(sinfo->inputDevice, sinfo->inputChannels, sinfo->inputLatency);
+  PaStreamCallback *callback = sinfo->ringMode ? RingCallback : output ? AudioCallback : CaptureCallback;
+  PaStream *stream = nullptr;
+  PaError err = Pa_OpenStream(&stream, sinfo->inputChannels > 0 ? &inputParams : nullptr, output ? &outputParams : nullptr,
+                              sinfo->sampleRate, sinfo->framesPerBuffer, output ? sinfo->hostApi.flags : paNoFlag, callback, sinfo);
+  if (err == paNoError)
+  {
+    if (output)
+      FinishHostApiStream(sinfo->hostApi, sinfo->device, stream);
+    sinfo->stream = stream;
+    RequestCallbackTuning(sinfo);
+    err = Pa_StartStream(stream);
+    if (err != paNoError)
+    {
+      Pa_CloseStream(stream);
+      sinfo->stream = nullptr;
+    }
+  }
+  if (err != paNoError)
+    *error = Pa_GetErrorText(err);
+  return err;
+}
+
+// Point a ring stream's rate-dependent state (mixer, DSP, duplex input, clock) and its
+// recorded devices at a new stream configuration; the stream must not be running
+static void RetuneRingStream(StreamInfo *sinfo, int device, int inputDevice, double sampleRate,
+                             unsigned long framesPerBuffer, double latency)
+{
+  sinfo->mixer.Retune(sampleRate);
+  if (sinfo->dsp && sampleRate != sinfo->sampleRate)
+  {
+    // Filter coefficients and the limiter's look-ahead depend on the rate
+    sinfo->dsp->Configure(sinfo->channels, sampleRate);
+    sinfo->dsp->Apply(sinfo->dsp->Settings());
+  }
+  if (sinfo->inputChannels > 0 && sampleRate != sinfo->sampleRate)
+    sinfo->duplex.Configure(sinfo->inputChannels, sinfo->channels, sampleRate);
+  sinfo->sampleRate = sampleRate;
+  sinfo->framesPerBuffer = framesPerBuffer;
+  sinfo->device = device;
+  sinfo->suggestedLatency = latency;
+  sinfo->inputDevice = inputDevice;
+  // Clock frames are device frames, so it restarts at the new rate
+  if (!sinfo->clockStorage.IsEmpty())
+    sinfo->clock.Attach(static_cast<uint8_t *>(sinfo->clockStorage.Value().As<Napi::ArrayBuffer>().Data()), sampleRate);
+  sinfo->tuning.periodSeconds = (framesPerBuffer > 0 ? framesPerBuffer : 256) / sampleRate;
+}
+
+// Move a ring-mode stream to another device and/or rate without touching its voices:
+// switchStreamDevice(streamId, { device, sampleRate, framesPerBuffer, suggestedLatency, inputDevice }).
+// Buffered PCM stays in the voice rings and is resampled to the new rate, so whatever
+// feeds the rings (decoder pipes, JS pumps) carries on uninterrupted. Reopening the same
+// device with another framesPerBuffer or latency is how adaptive buffering resizes. If the
+// new stream does not open or start, the stream is reopened as it was before throwing.
+Napi::Value SwitchStreamDevice(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  std::shared_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+  StreamInfo *sinfo = GetRingStream(info);
+  if (!sinfo)
+    return env.Null();
+  if (info.Length() < 2 || !info[1].IsObject())
+  {
+    Napi::TypeError::New(env, "Expected options object").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (sinfo->offline)
+  {
+    Napi::Error::New(env, "Offline streams have no device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Object opts = info[1].As<Napi::Object>();
+  int device = opts.Has("device") ? opts.Get("device").As<Napi::Number>().Int32Value() : sinfo->device;
+  double sampleRate = opts.Has("sampleRate") ? opts.Get("sampleRate").As<Napi::Number>().DoubleValue() : sinfo->sampleRate;
+  unsigned long framesPerBuffer = opts.Has("framesPerBuffer") ? opts.Get("framesPerBuffer").As<Napi::Number>().Uint32Value() : sinfo->framesPerBuffer;
+  double latency = opts.Has("suggestedLatency") ? opts.Get("suggestedLatency").As<Napi::Number>().DoubleValue() : sinfo->suggestedLatency;
+  // framesPerBuffer 0 leaves the period to the host (paFramesPerBufferUnspecified)
+  if (sampleRate <= 0)
+  {
+    Napi::Error::New(env, "Sample rate must be positive").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (sinfo->bitPerfect && sampleRate != sinfo->sampleRate)
+  {
+    Napi::Error::New(env, "Bit-perfect streams cannot resample").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  PaStreamParameters outputParams = MakeOutputParams(device, sinfo->channels, sinfo->sampleFormat, latency);
+  HostApiStreamInfo hostInfo;
+  std::string hostError;
+  if (!PrepareHostApiStream(sinfo->hostApi, &outputParams, &hostInfo, &hostError))
+  {
+    Napi::Error::New(env, hostError).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  // Duplex streams keep their input (or move it to inputDevice)
+  const int inputDevice = opts.Has("inputDevice") ? opts.Get("inputDevice").As<Napi::Number>().Int32Value() : sinfo->inputDevice;
+  PaStreamParameters inputParams = MakeInputParams(inputDevice, sinfo->inputChannels, sinfo->inputLatency);
+  const PaStreamParameters *input = sinfo->inputChannels > 0 ? &inputParams : nullptr;
+  // Validate first so an unsupported target leaves the current stream playing
+  PaError err = Pa_IsFormatSupported(input, &outputParams, sampleRate);
+  if (err != paFormatIsSupported)
+  {
+    Napi::Error::New(env, Pa_GetErrorText(err)).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  // Let queued buffers play out, then the callback no longer runs and its state is ours
+  Pa_StopStream(sinfo->stream);
+  Pa_CloseStream(sinfo->stream);
+  sinfo->stream = nullptr;
+  PaStream *stream = nullptr;
+  err = Pa_OpenStream(&stream, input, &outputParams, sampleRate, framesPerBuffer, sinfo->hostApi.flags, RingCallback, sinfo);
+  if (err == paNoError)
+  {
+    FinishHostApiStream(sinfo->hostApi, device, stream);
+    const int previousDevice = sinfo->device;
+    const int previousInputDevice = sinfo->inputDevice;
+    const double previousRate = sinfo->sampleRate;
+    const unsigned long previousFrames = sinfo->framesPerBuffer;
+    const double previousLatency = sinfo->suggestedLatency;
+    RetuneRingStream(sinfo, device, inputDevice, sampleRate, framesPerBuffer, latency);
+    sinfo->stream = stream;
+    RequestCallbackTuning(sinfo);
+    err = Pa_StartStream(stream);
+    if (err == paNoError)
+      return env.Undefined();
+    Pa_CloseStream(stream);
+    sinfo->stream = nullptr;
+    RetuneRingStream(sinfo, previousDevice, previousInputDevice, previousRate, previousFrames, previousLatency);
+  }
+  // Fall back to the previous device so playback is not lost, and report the failure
+  // only once that has been tried
+  std::string message = Pa_GetErrorText(err);
+  std::string rollbackError;
+  if (ReopenStream(sinfo, &rollbackError) != paNoError)
+    message += "; the previous device could not be restored either (" + rollbackError + ")";
+  Napi::Error::New(env, message).ThrowAsJavaScriptException();
+  return env.Null();
+}
+
+// Open an input-only stream that records into a capture ring (see getCaptureRing):
+// openCaptureStream({ device, channels, sampleRate, framesPerBuffer, suggestedLatency,
+// captureRingFrames, eventCallback, realtime, cpu, lockMemory }). Pausing it stops recording.
+Napi::Value OpenCaptureStream(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsObject())
+  {
+    Napi::TypeError::New(env, "Expected options object").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Object opts = info[0].As<Napi::Object>();
+  std::shared_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+  int device = opts.Has("device") ? opts.Get("device").As<Napi::Number>().Int32Value() : Pa_GetDefaultInputDevice();
+  const PaDeviceInfo *devInfo = device >= 0 ? Pa_GetDeviceInfo(device) : nullptr;
+  if (!devInfo || devInfo->maxInputChannels <= 0)
+  {
+    Napi::Error::New(env, "No input device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  int channels = opts.Has("channels") ? opts.Get("channels").As<Napi::Number>().Int32Value() : std::min(devInfo->maxInputChannels, 2);
+  double sampleRate = opts.Has("sampleRate") ? opts.Get("sampleRate").As<Napi::Number>().DoubleValue() : devInfo->defaultSampleRate;
+  unsigned long framesPerBuffer = opts.Has("framesPerBuffer") ? opts.Get("framesPerBuffer").As<Napi::Number>().Uint32Value() : 256;
+  double latency = opts.Has("suggestedLatency") ? opts.Get("suggestedLatency").As<Napi::Number>().DoubleValue() : 0.0;
+  if (channels <= 0 || channels > devInfo->maxInputChannels || sampleRate <= 0)
+  {
+    Napi::RangeError::New(env, "Channel count or sample rate out of range for the device").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (opts.Has("eventCallback") && !opts.Get("eventCallback").IsFunction())
+  {
+    Napi::TypeError::New(env, "eventCallback must be a function").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  ThreadTuning tuning;
+  if (!ParseThreadTuning(env, opts, (framesPerBuffer > 0 ? framesPerBuffer : 256) / sampleRate, &tuning))
+    return env.Null();
+
+  AddonData *data = GetAddonData(env);
+  auto sinfo = std::make_unique<StreamInfo>();
+  sinfo->id = data->nextStreamId++;
+  sinfo->channels = channels;
+  sinfo->sampleRate = sampleRate;
+  sinfo->bytesPerFrame = channels * sizeof(float);
+  sinfo->framesPerBuffer = framesPerBuffer;
+  sinfo->tuning = tuning;
+  sinfo->inputDevice = device;
+  sinfo->inputChannels = channels;
+  sinfo->inputLatency = latency;
+  sinfo->duplex.Configure(channels, channels, sampleRate);
+  sinfo->captureSource = kCaptureInput;
+  uint64_t frames = opts.Has("captureRingFrames") ? opts.Get("captureRingFrames").As<Napi::Number>().Uint32Value() : 0;
+  AllocateCaptureRing(env, sinfo.get(), frames > 0 ? frames : static_cast<uint64_t>(sampleRate * 2), channels);
+  if (opts.Has("eventCallback"))
+  {
+    sinfo->eventTsfn = std::make_unique<Napi::ThreadSafeFunction>(
+        Napi::ThreadSafeFunction::New(env, opts.Get("eventCallback").As<Napi::Function>(), "StreamEventCallback", 0, 1));
+  }
+  else if (data->eventCallbackTsfn)
+  {
+    sinfo->eventTsfn = std::make_unique<Napi::ThreadSafeFunction>(*data->eventCallbackTsfn);
+    sinfo->eventTsfn->Acquire();
+  }
+  PaStreamParameters inputParams = MakeInputParams(device, channels, latency);
+  PaStream *stream = nullptr;
+  PaError err = Pa_OpenStream(&stream, &inputParams, nullptr, sampleRate, framesPerBuffer, paNoFlag, CaptureCallback, sinfo.get());
+  if (err == paNoError)
+  {
+    err = Pa_StartStream(stream);
+    if (err != paNoError)
+      Pa_CloseStream(stream);
+  }
+  if (err != paNoError)
+  {
+    ReleaseStreamCallbacks(sinfo.get());
+    Napi::Error::New(env, Pa_GetErrorText(err)).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  uint32_t streamId = sinfo->id;
+  sinfo->stream = stream;
+  RequestCallbackTuning(sinfo.get());
+  RegisterEventChannel(sinfo.get());
+  data->streams[streamId] = std::move(sinfo);
+  return Napi::Number::New(env, streamId);
+}
+
+// Resolve a stream that has a capture ring or duplex input; throws and returns nullptr otherwise
+static StreamInfo *GetDuplexStream(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsNumber())
+  {
+    Napi::TypeError::New(env, "Expected stream ID").ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  StreamInfo *sinfo = GetStreamInfoById(env, info[0].As<Napi::Number>().Uint32Value());
+  if (!sinfo || (sinfo->inputChannels == 0 && sinfo->captureSource == kCaptureNone))
+  {
+    Napi::Error::New(env, "Stream not open or has no input or capture").ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  return sinfo;
+}
+
+// ArrayBuffer of a stream's capture ring: interleaved float32 frames in the layout of
+// ring_buffer.h, written by the audio callback and drained by JS (PcmRingReader)
+Napi::Value GetCaptureRing(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  StreamInfo *sinfo = GetDuplexStream(info);
+  if (!sinfo)
+    return env.Null();
+  if (sinfo->captureStorage.IsEmpty())
+  {
+    Napi::Error::New(env, "Stream does not capture").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("buffer", sinfo->captureStorage.Value());
+  result.Set("channels", Napi::Number::New(env, sinfo->captureSource == kCaptureInput ? sinfo->inputChannels : sinfo->channels));
+  result.Set("source", sinfo->captureSource == kCaptureInput ? "input" : "output");
+  return result;
+}
+
+// Change monitoring and ducking of a duplex stream while it runs:
+// setDuplex(streamId, { monitorGain, duck })
+Napi::Value SetDuplex(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  StreamInfo *sinfo = GetDuplexStream(info);
+  if (!sinfo)
+    return env.Null();
+  if (info.Length() < 2 || !info[1].IsObject())
+  {
+    Napi::TypeError::New(env, "Expected options object").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  // Capture-only streams have no output to monitor into
+  if (sinfo->inputChannels == 0 || !sinfo->ringMode)
+  {
+    Napi::Error::New(env, "Stream has no duplex input").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  DuplexSettings settings = sinfo->duplex.Settings();
+  if (!ParseDuplexSettings(env, info[1].As<Napi::Object>(), &settings))
+    return env.Null();
+  if (sinfo->bitPerfect && (settings.monitorGain > 0.0f || settings.duck))
+  {
+    Napi::Error::New(env, "Bit-perfect streams cannot monitor or duck").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  sinfo->duplex.Apply(settings);
+  return env.Undefined();
+}
+
+// Input metering and capture counters: getDuplexState(streamId)
+Napi::Value GetDuplexState(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  StreamInfo *sinfo = GetDuplexStream(info);
+  if (!sinfo)
+    return env.Null();
+  const DuplexSettings &settings = sinfo->duplex.Settings();
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("inputDevice", Napi::Number::New(env, sinfo->inputDevice));
+  result.Set("inputChannels", Napi::Number::New(env, sinfo->inputChannels));
+  result.Set("inputPeak", Napi::Number::New(env, sinfo->duplex.InputPeak()));
+  result.Set("monitorGain", Napi::Number::New(env, settings.monitorGain));
+  result.Set("duck", Napi::Boolean::New(env, settings.duck));
+  // Playback gain the duck currently applies (1 when not ducking)
+  result.Set("duckLevel", Napi::Number::New(env, sinfo->duplex.DuckLevel()));
+  result.Set("capture", sinfo->captureSource == kCaptureInput ? "input" : sinfo->captureSource == kCaptureOutput ? "output" : "none");
+  result.Set("captureDroppedFrames", Napi::Number::New(env, static_cast<double>(sinfo->stats.captureDroppedFrames.load(std::memory_order_relaxed))));
+  result.Set("inputOverflows", Napi::Number::New(env, static_cast<double>(sinfo->stats.inputOverflows.load(std::memory_order_relaxed))));
+  return result;
+}
+
+// Remove a voice; its ring storage is released once the callback can no longer touch it
+Napi::Value RemoveVoice(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  int voice = 0;
+  StreamInfo *sinfo = GetRingStreamArg(info, 1, &voice);
+  if (!sinfo)
+    return env.Null();
+  sinfo->voices[voice].retireEpoch = sinfo->callbackEpoch.load(std::memory_order_acquire);
+  sinfo->mixer.Voice(voice).state.store(kVoiceRetiring, std::memory_order_release);
+  ReclaimRetiredVoices(sinfo);
+  return env.Undefined();
+}
+
+// Ramp a voice's gain: setVoiceGain(streamId, voiceId, gain, rampFrames = 0, curve = 'linear')
+// rampFrames counts output frames at the stream rate: the envelope is applied after the
+// voice is resampled
+Napi::Value SetVoiceGain(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  int voice = 0;
+  StreamInfo *sinfo = GetRingStreamArg(info, 1, &voice);
+  if (!sinfo)
+    return env.Null();
+  if (info.Length() < 3 || !info[2].IsNumber())
+  {
+    Napi::TypeError::New(env, "Expected stream ID, voice ID and gain").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  float gain = std::min(std::max(info[2].As<Napi::Number>().FloatValue(), 0.0f), 2.0f);
+  uint32_t rampFrames = info.Length() > 3 && info[3].IsNumber() ? info[3].As<Napi::Number>().Uint32Value() : 0;
+  int curve = info.Length() > 4 && info[4].IsString() ? ParseCurve(info[4].As<Napi::String>().Utf8Value()) : kCurveLinear;
+  sinfo->mixer.Voice(voice).envelope.Set(gain, rampFrames, curve);
+  return env.Undefined();
+}
+
+// Set a voice's fixed track gain (e.g. from loudness analysis): setVoiceTrim(streamId,
+// voiceId, gain). Applied in the mix on top of the voice gain, without a ramp, so set
+// it before the voice starts.
+Napi::Value SetVoiceTrim(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  int voice = 0;
+  StreamInfo *sinfo = GetRingStreamArg(info, 1, &voice);
+  if (!sinfo)
+    return env.Null();
+  if (info.Length() < 3 || !info[2].IsNumber())
+  {
+    Napi::TypeError::New(env, "Expected stream ID, voice ID and gain").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (sinfo->bitPerfect)
+  {
+    Napi::Error::New(env, "Bit-perfect streams cannot apply gain").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  float gain = std::min(std::max(info[2].As<Napi::Number>().FloatValue(), 0.0f), 4.0f);
+  sinfo->mixer.Voice(voice).trim.store(gain, std::memory_order_relaxed);
+  return env.Undefined();
+}
+
+// Report a voice's progress: { started, finished, gain }
+Napi::Value GetVoiceState(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  int voice = 0;
+  StreamInfo *sinfo = GetRingStreamArg(info, 1, &voice);
+  if (!sinfo)
+    return env.Null();
+  const MixerVoice &v = sinfo->mixer.Voice(voice);
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("started", v.started.load(std::memory_order_relaxed));
+  result.Set("finished", v.finished.load(std::memory_order_relaxed));
+  result.Set("gain", v.envelope.PublishedGain());
+  return result;
+}
+
+// Move a voice's read position without touching its producer: seekVoice(streamId, voiceId, frame).
+// `frame` counts ring frames since the voice started; the callback fades out, jumps and
+// fades back in, clamping to what is still buffered ahead and retained behind
+Napi::Value SeekVoice(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  int voice = 0;
+  StreamInfo *sinfo = GetRingStreamArg(info, 1, &voice);
+  if (!sinfo)
+    return env.Null();
+  if (info.Length() < 3 || !info[2].IsNumber() || info[2].As<Napi::Number>().DoubleValue() < 0)
+  {
+    Napi::TypeError::New(env, "Expected stream ID, voice ID and a frame position").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (sinfo->bitPerfect)
+  {
+    Napi::Error::New(env, "Bit-perfect streams cannot seek in place").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  sinfo->mixer.Voice(voice).seekFrame.store(info[2].As<Napi::Number>().Int64Value(), std::memory_order_release);
+  return env.Undefined();
+}
+
+// Prebuffer from info[0], or nullptr after throwing
+static BlockQueue *GetPrebuffer(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsNumber())
+  {
+    Napi::TypeError::New(env, "Expected prebuffer ID").ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  AddonData *data = GetAddonData(env);
+  auto it = data->prebuffers.find(info[0].As<Napi::Number>().Uint32Value());
+  if (it == data->prebuffers.end())
+  {
+    Napi::Error::New(env, "Invalid prebuffer ID").ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  return it->second.get();
+}
+
+// Create a bounded prebuffer: createPrebuffer(capacityBytes) -> prebuffer ID
+Napi::Value CreatePrebuffer(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsNumber() || info[0].As<Napi::Number>().DoubleValue() < 1)
+  {
+    Napi::TypeError::New(env, "Expected a positive capacity in bytes").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  AddonData *data = GetAddonData(env);
+  uint32_t id = data->nextPrebufferId++;
+  data->prebuffers[id] = std::make_unique<BlockQueue>(data->blockPool, static_cast<size_t>(info[0].As<Napi::Number>().DoubleValue()));
+  return Napi::Number::New(env, id);
+}
+
+// Append PCM: prebufferWrite(id, buffer) -> bytes accepted (fewer once the cap is reached)
+Napi::Value PrebufferWrite(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  BlockQueue *queue = GetPrebuffer(info);
+  if (!queue)
+    return env.Null();
+  if (info.Length() < 2 || !info[1].IsTypedArray())
+  {
+    Napi::TypeError::New(env, "Expected prebuffer ID and a Buffer or TypedArray").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::TypedArray chunk = info[1].As<Napi::TypedArray>();
+  const uint8_t *data = static_cast<const uint8_t *>(chunk.ArrayBuffer().Data()) + chunk.ByteOffset();
+  return Napi::Number::New(env, static_cast<double>(queue->Write(data, chunk.ByteLength())));
+}
+
+// Take PCM out: prebufferRead(id, maxBytes) -> Buffer (empty once drained)
+Napi::Value PrebufferRead(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  BlockQueue *queue = GetPrebuffer(info);
+  if (!queue)
+    return env.Null();
+  size_t maxBytes = info.Length() > 1 && info[1].IsNumber() ? static_cast<size_t>(info[1].As<Napi::Number>().DoubleValue()) : queue->Size();
+  Napi::Buffer<uint8_t> out = Napi::Buffer<uint8_t>::New(env, std::min(maxBytes, queue->Size()));
+  queue->Read(out.Data(), out.Length());
+  return out;
+}
+
+// Move queued PCM straight into a voice ring: prebufferToVoice(id, streamId, voiceId) -> bytes moved.
+// The prebuffer must be the ring's only producer.
+Napi::Value PrebufferToVoice(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  BlockQueue *queue = GetPrebuffer(info);
+  if (!queue)
+    return env.Null();
+  if (info.Length() < 3 || !info[1].IsNumber() || !info[2].IsNumber())
+  {
+    Napi::TypeError::New(env, "Expected prebuffer ID, stream ID and voice ID").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  StreamInfo *sinfo = GetStreamInfoById(env, info[1].As<Napi::Number>().Uint32Value());
+  int voice = info[2].As<Napi::Number>().Int32Value();
+  if (!sinfo || !sinfo->ringMode || voice < 0 || voice >= kMaxVoices ||
+      sinfo->mixer.Voice(voice).state.load(std::memory_order_acquire) != kVoiceActive)
+  {
+    Napi::Error::New(env, "Invalid stream or voice ID").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  PcmRing &ring = sinfo->mixer.Voice(voice).ring;
+  size_t moved = queue->Drain([&ring](const uint8_t *data, size_t bytes)
+                              { return static_cast<size_t>(ring.Write(data, static_cast<uint32_t>(bytes))); },
+                              ring.WriteAvailable());
+  return Napi::Number::New(env, static_cast<double>(moved));
+}
+
+// Prebuffer fill level: { queuedBytes, capacityBytes, blocks, poolBlocksInUse, poolBlocksIdle }
+Napi::Value GetPrebufferState(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  BlockQueue *queue = GetPrebuffer(info);
+  if (!queue)
+    return env.Null();
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("queuedBytes", Napi::Number::New(env, static_cast<double>(queue->Size())));
+  result.Set("capacityBytes", Napi::Number::New(env, static_cast<double>(queue->Capacity())));
+  result.Set("blocks", Napi::Number::New(env, static_cast<double>(queue->Blocks())));
+  const BlockPool &pool = GetAddonData(env)->blockPool;
+  result.Set("poolBlocksInUse", Napi::Number::New(env, static_cast<double>(pool.InUse())));
+  result.Set("poolBlocksIdle", Napi::Number::New(env, static_cast<double>(pool.Idle())));
+  return result;
+}
+
+// Free a prebuffer, returning its blocks to the pool
+Napi::Value DestroyPrebuffer(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() > 0 && info[0].IsNumber())
+    GetAddonData(env)->prebuffers.erase(info[0].As<Napi::Number>().Uint32Value());
+  return env.Undefined();
+}
+
+#ifndef _WIN32
+// Write all of `bytes` to fd; false on error
+static bool WriteFully(int fd, const uint8_t *data, size_t bytes)
+{
+  while (bytes > 0)
+  {
+    ssize_t n = write(fd, data, bytes);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    data += n;
+    bytes -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// Empty a cache file being filled so it can never be finalised as a complete decode
+static void DiscardTee(int fd)
+{
+  while (ftruncate(fd, 0) != 0 && errno == EINTR)
+  {
+  }
+  close(fd);
+}
+
+// Reader thread body: read() decoded PCM from the pipe straight into a voice ring. With
+// a tee fd every byte is also appended to it (a PCM cache file being filled); the tee
+// is truncated unless the pipe reached EOF, so a cache entry is never mistaken for a
+// complete decode. Both fds are closed before end-of-stream is published, which is what
+// the JS side waits for before finalising.
+static void PipeReaderLoop(PcmRing *ring, std::atomic<bool> *stop, int fd, int teeFd)
+{
+  bool eof = false;
+  while (!stop->load(std::memory_order_relaxed))
+  {
+    uint8_t *region = nullptr;
+    uint32_t space = ring->WriteRegion(&region);
+    if (space == 0)
+    {
+      // Ring is full: the device drains it at its own pace
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      continue;
+    }
+    // Poll with a timeout so CloseStream can stop us even if the writer never hangs up
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, 50);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready < 0)
+      break;
+    if (ready == 0)
+      continue;
+    ssize_t n = read(fd, region, space);
+    if (n < 0 && (errno == EINTR || errno == EAGAIN))
+      continue;
+    if (n <= 0)
+    {
+      eof = n == 0;
+      break;
+    }
+    if (teeFd >= 0 && !WriteFully(teeFd, region, static_cast<size_t>(n)))
+    {
+      // Cache disk full or gone: keep playing, drop the cache entry
+      DiscardTee(teeFd);
+      teeFd = -1;
+    }
+    ring->CommitWrite(static_cast<uint32_t>(n));
+  }
+  close(fd);
+  if (teeFd >= 0 && !eof)
+    DiscardTee(teeFd);
+  else if (teeFd >= 0)
+    close(teeFd);
+  ring->MarkEndOfStream();
+}
+
+// Feeds a voice ring from a memory-mapped PCM cache file, then unmaps it
+static void MappedFileFeederLoop(PcmRing *ring, std::atomic<bool> *stop, uint8_t *map, size_t mapBytes, size_t offset, size_t end)
+{
+  while (offset < end && !stop->load(std::memory_order_relaxed))
+  {
+    uint8_t *region = nullptr;
+    uint32_t space = ring->WriteRegion(&region);
+    if (space == 0)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      continue;
+    }
+    uint32_t n = static_cast<uint32_t>(std::min<size_t>(space, end - offset));
+    std::memcpy(region, map + offset, n);
+    ring->CommitWrite(n);
+    offset += n;
+  }
+  munmap(map, mapBytes);
+  ring->MarkEndOfStream();
+}
+
+// Read the WAVE header of an open file; false if the native decoder cannot handle it
+static bool ProbeWavFile(int fd, WavFormat *format)
+{
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    return false;
+  std::vector<uint8_t> head(std::min<uint64_t>(kWavProbeBytes, static_cast<uint64_t>(st.st_size)));
+  ssize_t n = pread(fd, head.data(), head.size(), 0);
+  return n > 0 && ParseWavHeader(head.data(), static_cast<size_t>(n), static_cast<uint64_t>(st.st_size), format) && format->frames > 0;
+}
+
+static Napi::Object WavFormatToObject(Napi::Env env, const WavFormat &format)
+{
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("format", "wav");
+  result.Set("sampleRate", Napi::Number::New(env, format.sampleRate));
+  result.Set("channels", Napi::Number::New(env, format.channels));
+  result.Set("bitDepth", Napi::Number::New(env, format.bitsPerSample));
+  result.Set("isFloat", Napi::Boolean::New(env, format.isFloat));
+  result.Set("frames", Napi::Number::New(env, static_cast<double>(format.frames)));
+  result.Set("duration", Napi::Number::New(env, static_cast<double>(format.frames) / format.sampleRate));
+  return result;
+}
+
+// Describe a file the in-process decoder can play: probeAudioFile(path) returns
+// { format, sampleRate, channels, bitDepth, isFloat, frames, duration }, or null if the
+// file needs ffmpeg
+Napi::Value ProbeAudioFile(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsString())
+  {
+    Napi::TypeError::New(env, "Expected file path").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  std::string path = info[0].As<Napi::String>().Utf8Value();
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return env.Null();
+  WavFormat format;
+  bool ok = ProbeWavFile(fd, &format);
+  close(fd);
+  return ok ? WavFormatToObject(env, format) : env.Null();
+}
+
+// Measures one track on a libuv worker thread: a WAV file decoded natively, or raw
+// interleaved f32le PCM read from a pipe (ffmpeg's stdout) until EOF
+class LoudnessWorker : public Napi::AsyncWorker
+{
+public:
+  LoudnessWorker(Napi::Env env, Napi::Promise::Deferred deferred, int fd, bool wav, int channels, double sampleRate)
+      : Napi::AsyncWorker(env, "LoudnessAnalysis"), deferred_(deferred), fd_(fd), wav_(wav), channels_(channels), sampleRate_(sampleRate) {}
+
+  ~LoudnessWorker() override
+  {
+    if (fd_ >= 0)
+      close(fd_);
+  }
+
+protected:
+  void Execute() override
+  {
+    if (wav_)
+      MeasureWav();
+    else
+      MeasurePipe();
+    close(fd_);
+    fd_ = -1;
+  }
+
+  void OnOK() override
+  {
+    Napi::Env env = Env();
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("integrated", Napi::Number::New(env, result_.integrated));
+    result.Set("range", Napi::Number::New(env, result_.range));
+    result.Set("truePeak", Napi::Number::New(env, result_.truePeak));
+    result.Set("samplePeak", Napi::Number::New(env, result_.samplePeak));
+    result.Set("duration", Napi::Number::New(env, result_.frames / sampleRate_));
+    result.Set("replayGain", Napi::Number::New(env, std::isfinite(result_.integrated) ? kReplayGainReferenceLufs - result_.integrated : 0.0));
+    deferred_.Resolve(result);
+  }
+
+  void OnError(const Napi::Error &error) override
+  {
+    deferred_.Reject(error.Value());
+  }
+
+private:
+  void MeasureWav()
+  {
+    WavFormat format;
+    if (!ProbeWavFile(fd_, &format))
+    {
+      SetError("Not a supported WAV file");
+      return;
+    }
+    channels_ = static_cast<int>(format.channels);
+    sampleRate_ = format.sampleRate;
+    if (!meter_.Configure(channels_, sampleRate_))
+    {
+      SetError("Unsupported channel count or sample rate");
+      return;
+    }
+    posix_fadvise(fd_, static_cast<off_t>(format.dataOffset), 0, POSIX_FADV_SEQUENTIAL);
+    const uint32_t kDecodeFrames = 8192;
+    const uint32_t frameBytes = format.FrameBytes();
+    std::vector<uint8_t> src(static_cast<size_t>(kDecodeFrames) * frameBytes);
+    std::vector<float> samples(static_cast<size_t>(kDecodeFrames) * channels_);
+    std::vector<float> scratch(samples.size());
+    for (uint64_t frame = 0; frame < format.frames;)
+    {
+      const uint32_t frames = static_cast<uint32_t>(std::min<uint64_t>(kDecodeFrames, format.frames - frame));
+      ssize_t n = pread(fd_, src.data(), static_cast<size_t>(frames) * frameBytes, static_cast<off_t>(format.dataOffset + frame * frameBytes));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break; // truncated file: measure what is there
+      const uint32_t got = static_cast<uint32_t>(n / frameBytes);
+      if (got == 0)
+        break;
+      ConvertWavFrames(format, src.data(), paFloat32, channels_, reinterpret_cast<uint8_t *>(samples.data()), got, scratch.data());
+      meter_.Process(samples.data(), got);
+      frame += got;
+    }
+    result_ = meter_.Finish();
+  }
+
+  void MeasurePipe()
+  {
+    if (!meter_.Configure(channels_, sampleRate_))
+    {
+      SetError("Unsupported channel count or sample rate");
+      return;
+    }
+    const size_t frameBytes = static_cast<size_t>(channels_) * sizeof(float);
+    std::vector<float> samples(8192 * static_cast<size_t>(channels_));
+    uint8_t *buf = reinterpret_cast<uint8_t *>(samples.data());
+    const size_t capacity = samples.size() * sizeof(float);
+    // Reads need not end on a frame boundary; the remainder moves to the front
+    size_t filled = 0;
+    for (;;)
+    {
+      ssize_t n = read(fd_, buf + filled, capacity - filled);
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0)
+      {
+        SetError(std::string("Read failed: ") + strerror(errno));
+        return;
+      }
+      if (n == 0)
+        break;
+      filled += static_cast<size_t>(n);
+      const size_t frames = filled / frameBytes;
+      meter_.Process(samples.data(), frames);
+      const size_t used = frames * frameBytes;
+      std::memmove(buf, buf + used, filled - used);
+      filled -= used;
+    }
+    result_ = meter_.Finish();
+  }
+
+  Napi::Promise::Deferred deferred_;
+  int fd_;
+  bool wav_;
+  int channels_;
+  double sampleRate_;
+  LoudnessMeter meter_;
+  LoudnessResult result_;
+};
+
+// Measure a track's loudness (EBU R128) off the main thread:
+//   analyzeLoudnessAsync(path)                          - a WAV file, decoded natively
+//   analyzeLoudnessAsync({ fd, sampleRate, channels })  - f32le PCM read from fd to EOF
+// Resolves with { integrated (LUFS), range (LU), truePeak (dBTP), samplePeak (dBFS),
+// duration, replayGain (dB to -18 LUFS) }. The fd is closed when done. Each call takes
+// a libuv worker thread until it finishes, so callers bound how many run at once.
+Napi::Value AnalyzeLoudnessAsync(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  int fd = -1;
+  bool wav = false;
+  int channels = 0;
+  double sampleRate = 0.0;
+  if (info.Length() > 0 && info[0].IsString())
+  {
+    std::string path = info[0].As<Napi::String>().Utf8Value();
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+      Napi::Error::New(env, "Cannot open " + path + ": " + strerror(errno)).ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    wav = true;
+  }
+  else if (info.Length() > 0 && info[0].IsObject())
+  {
+    Napi::Object source = info[0].As<Napi::Object>();
+    if (!source.Get("fd").IsNumber() || !source.Get("sampleRate").IsNumber() || !source.Get("channels").IsNumber())
+    {
+      Napi::TypeError::New(env, "Expected { fd, sampleRate, channels }").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    fd = source.Get("fd").As<Napi::Number>().Int32Value();
+    sampleRate = source.Get("sampleRate").As<Napi::Number>().DoubleValue();
+    channels = source.Get("channels").As<Napi::Number>().Int32Value();
+  }
+  else
+  {
+    Napi::TypeError::New(env, "Expected file path or { fd, sampleRate, channels }").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  (new LoudnessWorker(env, deferred, fd, wav, channels, sampleRate))->Queue();
+  return deferred.Promise();
+}
+
+// Decode a file in-process into a voice: attachDecoder(streamId, path, voiceId = 0, startFrame = 0).
+// A native thread reads and converts the file straight into the ring, with no decoder
+// process. Returns { frames, sampleRate }, or null when the file is not one the native
+// decoder handles (or its rate differs from the voice's), in which case use ffmpeg.
+Napi::Value AttachDecoder(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString())
+  {
+    Napi::TypeError::New(env, "Expected stream ID and file path").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  int voice = 0;
+  StreamInfo *sinfo = GetRingStreamArg(info, 2, &voice);
+  if (!sinfo)
+    return env.Null();
+  VoiceResources &res = sinfo->voices[voice];
+  if (res.pipeThread.joinable() || res.fanOut)
+  {
+    Napi::Error::New(env, "A producer is already attached to this voice").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  std::string path = info[1].As<Napi::String>().Utf8Value();
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    Napi::Error::New(env, "Cannot open " + path + ": " + strerror(errno)).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  WavFormat format;
+  if (!ProbeWavFile(fd, &format) || format.sampleRate != res.sourceRate || !WavCanConvert(format, sinfo->channels))
+  {
+    close(fd);
+    return env.Null();
+  }
+  uint64_t startFrame = info.Length() > 3 && info[3].IsNumber() ? static_cast<uint64_t>(std::max(info[3].As<Napi::Number>().DoubleValue(), 0.0)) : 0;
+  startFrame = std::min(startFrame, format.frames);
+  posix_fadvise(fd, static_cast<off_t>(format.dataOffset), 0, POSIX_FADV_SEQUENTIAL);
+  res.pipeStop.store(false, std::memory_order_relaxed);
+  res.pipeThread = StartFeederThread(sinfo, WavDecoderLoop, &sinfo->mixer.Voice(voice).ring, &res.pipeStop, fd, format, startFrame,
+                               sinfo->sampleFormat, sinfo->channels);
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("frames", Napi::Number::New(env, static_cast<double>(format.frames)));
+  result.Set("sampleRate", Napi::Number::New(env, format.sampleRate));
+  return result;
+}
+
+// Create an anonymous pipe for a decoder's stdout (returns { readFd, writeFd })
+Napi::Value CreatePipe(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  int fds[2];
+  if (pipe(fds) != 0)
+  {
+    Napi::Error::New(env, std::string("pipe() failed: ") + strerror(errno)).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  // Keep both ends out of unrelated children; spawn() dup2's writeFd onto the child's stdout
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("readFd", fds[0]);
+  result.Set("writeFd", fds[1]);
+  return result;
+}
+
+// Attach a readable fd to a voice of a ring-mode stream: attachPipe(streamId, fd, voiceId = 0, teeFd = -1).
+// A native thread becomes the ring's producer and takes ownership of the fd (and of
+// teeFd, which receives a copy of everything read), closing it at EOF or when the
+// voice/stream is closed
+Napi::Value AttachPipe(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber())
+  {
+    Napi::TypeError::New(env, "Expected stream ID and file descriptor").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  int voice = 0;
+  StreamInfo *sinfo = GetRingStreamArg(info, 2, &voice);
+  if (!sinfo)
+    return env.Null();
+  int fd = info[1].As<Napi::Number>().Int32Value();
+  int teeFd = info.Length() > 3 && info[3].IsNumber() ? info[3].As<Napi::Number>().Int32Value() : -1;
+  VoiceResources &res = sinfo->voices[voice];
+  if (res.pipeThread.joinable() || res.fanOut)
+  {
+    Napi::Error::New(env, "A pipe is already attached to this voice").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (fd < 0)
+  {
+    Napi::Error::New(env, "Invalid file descriptor").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  res.pipeStop.store(false, std::memory_order_relaxed);
+  res.pipeThread = StartFeederThread(sinfo, PipeReaderLoop, &sinfo->mixer.Voice(voice).ring, &res.pipeStop, fd, teeFd);
+  return env.Undefined();
+}
+
+// Feed one decoder pipe into voices of several ring-mode streams (multi-zone playback):
+// attachFanOut(fd, [{ streamId, voiceId = 0, delayMs = 0 }, ...], { maxCorrectionPpm = 500 }).
+// A native thread takes ownership of the fd and copies everything read into each voice's
+// ring, trimming the speed of every voice but the first to keep the outputs in step
+// despite their devices' clock drift (see fan_out.h). The voices must all take the same
+// PCM (rate, channels, format) and be varispeed (or resampling) voices with nothing else
+// attached. Open the streams paused and resume them together once the rings are filled.
+// An output that is paused on its own, or whose device stops, misses programme instead
+// of holding back the others.
+Napi::Value AttachFanOut(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsArray())
+  {
+    Napi::TypeError::New(env, "Expected file descriptor and array of outputs").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  int fd = info[0].As<Napi::Number>().Int32Value();
+  Napi::Array outputs = info[1].As<Napi::Array>();
+  if (fd < 0 || outputs.Length() == 0)
+  {
+    Napi::Error::New(env, fd < 0 ? "Invalid file descriptor" : "Fan-out needs at least one output").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  FanOutSettings settings;
+  if (info.Length() > 2 && info[2].IsObject())
+  {
+    Napi::Object opts = info[2].As<Napi::Object>();
+    if (opts.Has("maxCorrectionPpm"))
+      settings.maxCorrectionPpm = std::min(std::max(opts.Get("maxCorrectionPpm").As<Napi::Number>().DoubleValue(), 0.0), 10000.0);
+  }
+  auto group = std::make_shared<FanOutGroup>();
+  group->Configure(settings);
+  std::vector<std::pair<StreamInfo *, int>> voices;
+  for (uint32_t i = 0; i < outputs.Length(); ++i)
+  {
+    Napi::Value entry = outputs.Get(i);
+    if (!entry.IsObject() || !entry.As<Napi::Object>().Get("streamId").IsNumber())
+    {
+      Napi::TypeError::New(env, "Expected { streamId, voiceId, delayMs } outputs").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    Napi::Object output = entry.As<Napi::Object>();
+    StreamInfo *sinfo = GetStreamInfoById(env, output.Get("streamId").As<Napi::Number>().Uint32Value());
+    int voice = output.Has("voiceId") ? output.Get("voiceId").As<Napi::Number>().Int32Value() : 0;
+    if (!sinfo || !sinfo->ringMode || voice < 0 || voice >= kMaxVoices ||
+        sinfo->mixer.Voice(voice).state.load(std::memory_order_acquire) != kVoiceActive)
+    {
+      Napi::Error::New(env, "Fan-out outputs must be active voices of open ring-mode streams").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    VoiceResources &res = sinfo->voices[voice];
+    MixerVoice &v = sinfo->mixer.Voice(voice);
+    if (res.pipeThread.joinable() || res.fanOut ||
+        std::find(voices.begin(), voices.end(), std::make_pair(sinfo, voice)) != voices.end())
+    {
+      Napi::Error::New(env, "A producer is already attached to this voice").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    if (!v.resampler.Active())
+    {
+      Napi::Error::New(env, "Fan-out voices must be opened with varispeed").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    if (!voices.empty() && (res.sourceRate != voices[0].first->voices[voices[0].second].sourceRate ||
+                            sinfo->bytesPerFrame != voices[0].first->bytesPerFrame))
+    {
+      Napi::Error::New(env, "Fan-out voices must take the same sample rate, channels and format").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    auto target = std::make_unique<FanOutTarget>();
+    target->ring = &v.ring;
+    target->resampler = &v.resampler;
+    target->paused = &sinfo->paused;
+    target->bytesPerFrame = sinfo->bytesPerFrame;
+    target->sourceRate = res.sourceRate;
+    if (const PaStreamInfo *paInfo = Pa_GetStreamInfo(sinfo->stream))
+      target->latencyFrames = paInfo->outputLatency * res.sourceRate;
+    double delayMs = output.Has("delayMs") ? output.Get("delayMs").As<Napi::Number>().DoubleValue() : 0.0;
+    target->delayFrames = static_cast<uint64_t>(std::max(delayMs, 0.0) * 0.001 * res.sourceRate);
+    group->Add(std::move(target));
+    voices.emplace_back(sinfo, voice);
+  }
+  for (const auto &entry : voices)
+    entry.first->voices[entry.second].fanOut = group;
+  // Tuned like the first output's feeders; the thread outlives any one stream
+  const ThreadTuning tuning = voices[0].first->tuning;
+  group->Start(fd, [tuning](auto fn)
+               { return std::thread([tuning, fn]
+                                    {
+    if (tuning.Requested())
+      TuneCurrentThread(tuning, true);
+    fn(); }); });
+  return env.Undefined();
+}
+
+// Drift compensation state of a fan-out voice: getFanOutState(streamId, voiceId = 0).
+// Returns { offsetMs, speedPpm }: the smoothed offset from the first output (positive:
+// ahead) and the speed trim applied against it, or null if the voice is not fanned out
+Napi::Value GetFanOutState(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  int voice = 0;
+  StreamInfo *sinfo = GetRingStreamArg(info, 1, &voice);
+  if (!sinfo)
+    return env.Null();
+  double offsetMs = 0.0;
+  double speedPpm = 0.0;
+  const std::shared_ptr<FanOutGroup> &group = sinfo->voices[voice].fanOut;
+  if (!group || !group->State(&sinfo->mixer.Voice(voice).ring, &offsetMs, &speedPpm))
+    return env.Null();
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("offsetMs", Napi::Number::New(env, offsetMs));
+  result.Set("speedPpm", Napi::Number::New(env, speedPpm));
+  return result;
+}
+
+// Render thread of an offline stream: the ring callback runs period after period with a
+// virtual clock, writing to a file descriptor or collecting the output in the job
+class OfflineRenderLoop
+{
+public:
+  OfflineRenderLoop(StreamInfo *sinfo, OfflineRenderJob *job) : sinfo_(sinfo), job_(job) {}
+
+  void Run()
+  {
+    const auto start = std::chrono::steady_clock::now();
+    const uint32_t period = static_cast<uint32_t>(sinfo_->framesPerBuffer);
+    const uint32_t bytesPerFrame = sinfo_->bytesPerFrame;
+    std::vector<uint8_t> block(static_cast<size_t>(period) * bytesPerFrame);
+    if (job_->fd < 0 && job_->frames != UINT64_MAX)
+      job_->output.reserve(static_cast<size_t>(job_->frames) * bytesPerFrame);
+    uint64_t offset = job_->offset;
+    while (job_->rendered < job_->frames && !sinfo_->renderStop.load(std::memory_order_relaxed))
+    {
+      const uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(period, job_->frames - job_->rendered));
+      WaitForVoices(n);
+      if (job_->untilEnd && MixEnded())
+      {
+        job_->ended = true;
+        break;
+      }
+      const double now = static_cast<double>(sinfo_->renderedFrames) / sinfo_->sampleRate;
+      const PaStreamCallbackTimeInfo timeInfo = {0.0, now, now};
+      RingCallback(nullptr, block.data(), n, &timeInfo, 0, sinfo_);
+      const size_t bytes = static_cast<size_t>(n) * bytesPerFrame;
+      if (job_->fd >= 0)
+      {
+        if (!WriteAt(block.data(), bytes, &offset))
+        {
+          job_->error = std::string("Render write failed: ") + strerror(errno);
+          break;
+        }
+      }
+      else
+      {
+        job_->output.insert(job_->output.end(), block.begin(), block.begin() + bytes);
+      }
+      job_->rendered += n;
+      sinfo_->renderedFrames += n;
+    }
+    if (!job_->ended)
+      job_->ended = MixEnded();
+    job_->renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+private:
+  // Wait until every voice that plays in the next `frames` has the source frames for
+  // them (or has ended), so the clock never outruns the producers. A voice that gets
+  // nothing for waitMs is rendered as it is (starved) until its producer moves again.
+  void WaitForVoices(uint32_t frames)
+  {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(job_->waitMs);
+    for (;;)
+    {
+      uint32_t waiting = 0;
+      for (int i = 0; i < kMaxVoices; ++i)
+      {
+        MixerVoice &v = sinfo_->mixer.Voice(i);
+        if (v.state.load(std::memory_order_acquire) != kVoiceActive || v.finished.load(std::memory_order_relaxed))
+          continue;
+        const uint32_t have = v.ring.ReadAvailable();
+        if (v.ring.EndOfStream())
+          continue;
+        if (idle_ & (1u << i))
+        {
+          if (have == idleLevel_[i])
+            continue;
+          idle_ &= ~(1u << i);
+        }
+        const double sourceRate = sinfo_->voices[i].sourceRate > 0 ? sinfo_->voices[i].sourceRate : sinfo_->sampleRate;
+        // Plus the resampler's read-ahead
+        const uint64_t needFrames = static_cast<uint64_t>(std::ceil(frames * sourceRate / sinfo_->sampleRate)) + 512;
+        if (have < std::min<uint64_t>(needFrames * sinfo_->bytesPerFrame, v.ring.Capacity() / 2))
+          waiting |= 1u << i;
+      }
+      if (waiting == 0 || sinfo_->renderStop.load(std::memory_order_relaxed))
+        return;
+      if (std::chrono::steady_clock::now() >= deadline)
+      {
+        for (int i = 0; i < kMaxVoices; ++i)
+        {
+          if (waiting & (1u << i))
+            idleLevel_[i] = sinfo_->mixer.Voice(i).ring.ReadAvailable();
+        }
+        idle_ |= waiting;
+        ++job_->stalls;
+        return;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+  }
+
+  // Nothing left to play: every voice has finished (or was removed)
+  bool MixEnded()
+  {
+    for (int i = 0; i < kMaxVoices; ++i)
+    {
+      MixerVoice &v = sinfo_->mixer.Voice(i);
+      if (v.state.load(std::memory_order_acquire) == kVoiceActive && !v.finished.load(std::memory_order_relaxed))
+        return false;
+    }
+    return true;
+  }
+
+  bool WriteAt(const uint8_t *data, size_t bytes, uint64_t *offset)
+  {
+    while (bytes > 0)
+    {
+      ssize_t n = pwrite(job_->fd, data, bytes, static_cast<off_t>(*offset));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      data += n;
+      bytes -= static_cast<size_t>(n);
+      *offset += static_cast<uint64_t>(n);
+    }
+    return true;
+  }
+
+  StreamInfo *sinfo_;
+  OfflineRenderJob *job_;
+  uint32_t idle_ = 0;
+  uint32_t idleLevel_[kMaxVoices] = {};
+};
+
+// Render an offline stream faster than real time:
+// renderStreamAsync(streamId, { frames, untilEnd = false, fd = -1, offset = 0, waitMs = 2000 }).
+// Runs the ring-mode pipeline (voices, crossfades, gain, DSP) for `frames` frames, or
+// until every voice has finished with untilEnd. Output in the stream's format is written
+// to fd at byte `offset` (the fd stays open, so several renders can fill one file at
+// their own offsets) or, without an fd, resolved as a Buffer. Resolves
+// { frames, ended, stalls, renderSeconds, buffer? }. Each render runs on a thread of its
+// own stream rather than the libuv pool (it may run for minutes and would starve the
+// other async calls), so renders of separate streams run in parallel.
+Napi::Value RenderStreamAsync(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  StreamInfo *sinfo = GetRingStream(info);
+  if (!sinfo)
+    return env.Null();
+  if (!sinfo->offline)
+  {
+    Napi::Error::New(env, "Only offline streams can be rendered").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (sinfo->renderJob)
+  {
+    Napi::Error::New(env, "The stream is already rendering").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Object opts = info.Length() > 1 && info[1].IsObject() ? info[1].As<Napi::Object>() : Napi::Object::New(env);
+  auto job = std::make_unique<OfflineRenderJob>(env);
+  job->untilEnd = opts.Has("untilEnd") && opts.Get("untilEnd").ToBoolean().Value();
+  job->frames = UINT64_MAX;
+  if (opts.Has("frames"))
+    job->frames = static_cast<uint64_t>(std::max(opts.Get("frames").As<Napi::Number>().DoubleValue(), 0.0));
+  else if (!job->untilEnd)
+  {
+    Napi::TypeError::New(env, "Expected frames or untilEnd").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  job->fd = opts.Has("fd") ? opts.Get("fd").As<Napi::Number>().Int32Value() : -1;
+  job->offset = opts.Has("offset") ? static_cast<uint64_t>(std::max(opts.Get("offset").As<Napi::Number>().DoubleValue(), 0.0)) : 0;
+  job->waitMs = opts.Has("waitMs") ? opts.Get("waitMs").As<Napi::Number>().Uint32Value() : 2000;
+  if (!sinfo->renderTsfn)
+  {
+    Napi::Function noop = Napi::Function::New(env, [](const Napi::CallbackInfo &) {});
+    sinfo->renderTsfn = std::make_unique<Napi::ThreadSafeFunction>(
+        Napi::ThreadSafeFunction::New(env, noop, "OfflineRender", 0, 1));
+  }
+  // Reclaim before the thread owns the callback, while no period is in flight
+  ReclaimRetiredVoices(sinfo);
+  Napi::Promise promise = job->deferred.Promise();
+  OfflineRenderJob *running = job.get();
+  sinfo->renderJob = std::move(job);
+  sinfo->rendering.store(true, std::memory_order_release);
+  // The TSFN is released only after the thread is joined, so the pointer stays valid
+  Napi::ThreadSafeFunction *tsfn = sinfo->renderTsfn.get();
+  const uint32_t streamId = sinfo->id;
+  sinfo->renderThread = std::thread([sinfo, running, tsfn, streamId]()
+                                    {
+    OfflineRenderLoop(sinfo, running).Run();
+    // Last touch of the callback state: voices may be reclaimed from here on
+    sinfo->rendering.store(false, std::memory_order_release);
+    tsfn->NonBlockingCall([streamId](Napi::Env env, Napi::Function)
+                          {
+      // Gone if the stream was closed (which settled the job) meanwhile
+      if (StreamInfo *stream = GetStreamInfoById(env, streamId))
+        SettleOfflineRender(env, stream); }); });
+  return promise;
+}
+
+// Play a PCM cache file through a voice: attachFile(streamId, path, voiceId = 0, startFrame = 0).
+// The file is memory-mapped and a native thread copies its pages into the ring, so repeat
+// plays need no decoder and share the OS page cache with other processes. The file's
+// format must match the voice (see pcm_cache.h). Returns { frames, sampleRate }.
+Napi::Value AttachFile(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsString())
+  {
+    Napi::TypeError::New(env, "Expected stream ID and file path").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  int voice = 0;
+  StreamInfo *sinfo = GetRingStreamArg(info, 2, &voice);
+  if (!sinfo)
+    return env.Null();
+  VoiceResources &res = sinfo->voices[voice];
+  if (res.pipeThread.joinable() || res.fanOut)
+  {
+    Napi::Error::New(env, "A producer is already attached to this voice").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  std::string path = info[1].As<Napi::String>().Utf8Value();
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    Napi::Error::New(env, "Cannot open " + path + ": " + strerror(errno)).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(kPcmCacheHeaderBytes))
+  {
+    close(fd);
+    Napi::Error::New(env, "Not a PCM cache file: " + path).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  size_t mapBytes = static_cast<size_t>(st.st_size);
+  void *map = mmap(nullptr, mapBytes, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    Napi::Error::New(env, std::string("mmap() failed: ") + strerror(errno)).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  uint8_t *data = static_cast<uint8_t *>(map);
+  PcmCacheHeader header;
+  const char *mismatch = nullptr;
+  if (!ParsePcmCacheHeader(data, mapBytes, &header))
+    mismatch = "Not a complete PCM cache file";
+  else if (static_cast<int>(header.channels) != sinfo->channels || header.sampleFormat != sinfo->sampleFormat)
+    mismatch = "PCM cache file does not match the stream format";
+  else if (header.sampleRate != res.sourceRate)
+    mismatch = "PCM cache file does not match the voice sample rate";
+  if (mismatch)
+  {
+    munmap(map, mapBytes);
+    Napi::Error::New(env, mismatch).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  uint64_t startFrame = info.Length() > 3 && info[3].IsNumber() ? static_cast<uint64_t>(std::max(info[3].As<Napi::Number>().DoubleValue(), 0.0)) : 0;
+  startFrame = std::min(startFrame, header.frames);
+  const size_t offset = kPcmCacheHeaderBytes + static_cast<size_t>(startFrame) * sinfo->bytesPerFrame;
+  const size_t end = kPcmCacheHeaderBytes + static_cast<size_t>(header.frames) * sinfo->bytesPerFrame;
+  // Read ahead sequentially; the page cache is shared with every process playing this file
+  size_t pageStart = offset & ~(static_cast<size_t>(sysconf(_SC_PAGESIZE)) - 1);
+  madvise(data + pageStart, end - pageStart, MADV_SEQUENTIAL);
+  madvise(data + pageStart, end - pageStart, MADV_WILLNEED);
+  res.pipeStop.store(false, std::memory_order_relaxed);
+  res.pipeThread = StartFeederThread(sinfo, MappedFileFeederLoop, &sinfo->mixer.Voice(voice).ring, &res.pipeStop, data, mapBytes, offset, end);
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("frames", Napi::Number::New(env, static_cast<double>(header.frames)));
+  result.Set("sampleRate", Napi::Number::New(env, header.sampleRate));
+  return result;
+}
+#endif
+
+// Main thread: hand a stream's newest analysis result to its JS callback
+static void DeliverAnalysis(Napi::Function callback, uint32_t streamId)
+{
+  StreamInfo *sinfo = GetStreamInfoById(callback.Env(), streamId);
+  if (!sinfo || sinfo->analysisBuffer.IsEmpty())
+    return;
+  sinfo->analysisPending.store(false, std::memory_order_relaxed);
+  Napi::Float32Array buffer = sinfo->analysisBuffer.Value().As<Napi::Float32Array>();
+  if (sinfo->analysis.TakeLatest(buffer.Data()))
+    callback.Call({sinfo->analysisResult.Value()});
+}
+
+// Analyse a stream's output for visualization: setAnalysisTap(streamId, callback, options).
+// A background thread computes per-channel peak and RMS (linear) and a Hann-windowed FFT
+// folded into log-spaced bands (dBFS), and calls callback({ peak, rms, bands }) at
+// options.rate Hz (default 30). The Float32Arrays are reused for every call. Options:
+// fftSize (power of two, default 2048) and bands (default 64). Pass a null callback to
+// stop. Works in every stream mode, including bit-perfect (the samples are only read).
+Napi::Value SetAnalysisTap(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 2 || !info[0].IsNumber() || !(info[1].IsFunction() || info[1].IsNull() || info[1].IsUndefined()))
+  {
+    Napi::TypeError::New(env, "Expected stream ID and callback (or null)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  const uint32_t streamId = info[0].As<Napi::Number>().Uint32Value();
+  StreamInfo *sinfo = GetStreamInfoById(env, streamId);
+  if (!sinfo)
+  {
+    Napi::Error::New(env, "Stream not open").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (!info[1].IsFunction())
+  {
+    StopAnalysisTap(sinfo);
+    return env.Undefined();
+  }
+  AnalysisConfig config;
+  if (info.Length() > 2 && info[2].IsObject())
+  {
+    Napi::Object opts = info[2].As<Napi::Object>();
+    if (opts.Has("fftSize"))
+      config.fftSize = opts.Get("fftSize").As<Napi::Number>().Uint32Value();
+    if (opts.Has("bands"))
+      config.bands = opts.Get("bands").As<Napi::Number>().Uint32Value();
+    if (opts.Has("rate"))
+      config.rateHz = opts.Get("rate").As<Napi::Number>().DoubleValue();
+  }
+  if (config.fftSize < kAnalysisMinFftSize || config.fftSize > kAnalysisMaxFftSize || (config.fftSize & (config.fftSize - 1)) != 0)
+  {
+    Napi::RangeError::New(env, "fftSize must be a power of two between 64 and 16384").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (config.bands == 0 || config.bands > std::min(kAnalysisMaxBands, config.fftSize / 2))
+  {
+    Napi::RangeError::New(env, "bands must be between 1 and min(1024, fftSize / 2)").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (!(config.rateHz >= 1.0 && config.rateHz <= 240.0))
+  {
+    Napi::RangeError::New(env, "rate must be between 1 and 240 Hz").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  StopAnalysisTap(sinfo);
+  const size_t channels = static_cast<size_t>(sinfo->channels);
+  Napi::Float32Array buffer = Napi::Float32Array::New(env, 2 * channels + config.bands);
+  Napi::ArrayBuffer storage = buffer.ArrayBuffer();
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("peak", Napi::Float32Array::New(env, channels, storage, 0));
+  result.Set("rms", Napi::Float32Array::New(env, channels, storage, channels * sizeof(float)));
+  result.Set("bands", Napi::Float32Array::New(env, config.bands, storage, 2 * channels * sizeof(float)));
+  sinfo->analysisBuffer = Napi::Persistent(buffer.As<Napi::Object>());
+  sinfo->analysisResult = Napi::Persistent(result);
+  sinfo->analysisTsfn = std::make_unique<Napi::ThreadSafeFunction>(
+      Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(), "AnalysisTap", 0, 1));
+  // The tap thread is joined before the TSFN is released (StopAnalysisTap)
+  Napi::ThreadSafeFunction *tsfn = sinfo->analysisTsfn.get();
+  std::atomic<bool> *pending = &sinfo->analysisPending;
+  sinfo->analysis.Start(sinfo->channels, sinfo->sampleFormat, sinfo->sampleRate, config, [tsfn, pending, streamId]()
+                        {
+    // At most one delivery queued: a stalled event loop gets the newest result, not a backlog
+    if (!pending->exchange(true, std::memory_order_acq_rel))
+      tsfn->NonBlockingCall([streamId](Napi::Env, Napi::Function callback)
+                            { DeliverAnalysis(callback, streamId); }); });
+  return env.Undefined();
+}
+
+static bool ParseBiquadType(const std::string &name, BiquadType *type)
+{
+  static const std::pair<const char *, BiquadType> kTypes[] = {
+      {"peaking", kBiquadPeaking}, {"lowshelf", kBiquadLowShelf}, {"highshelf", kBiquadHighShelf}, {"lowpass", kBiquadLowPass}, {"highpass", kBiquadHighPass}};
+  for (const auto &t : kTypes)
+  {
+    if (name == t.first)
+    {
+      *type = t.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Replace a stream's output DSP: setStreamDsp(streamId, { eq, matrix, limiter }).
+//   eq:      [{ type: 'peaking'|'lowshelf'|'highshelf'|'lowpass'|'highpass', frequency, q, gain (dB) }]
+//   matrix:  channels x channels gains, out[o] = sum(matrix[o][i] * in[i])
+//   limiter: { ceiling (dBFS, default -1), lookaheadMs (default 5), releaseMs (default 50) }
+// Missing or null sections are off. The callback picks the new parameters up at its next
+// buffer without locking; bit-perfect streams have no DSP.
+Napi::Value SetStreamDsp(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsObject())
+  {
+    Napi::TypeError::New(env, "Expected stream ID and DSP config").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  StreamInfo *sinfo = GetStreamInfoById(env, info[0].As<Napi::Number>().Uint32Value());
+  if (!sinfo)
+  {
+    Napi::Error::New(env, "Stream not open").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (sinfo->bitPerfect)
+  {
+    Napi::Error::New(env, "Bit-perfect streams cannot apply DSP").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (!sinfo->ringMode && !sinfo->audioTsfn)
+  {
+    Napi::Error::New(env, "DSP requires a ring-mode or callback-mode stream").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (sinfo->channels > kDspMaxChannels)
+  {
+    Napi::RangeError::New(env, "DSP supports at most 8 channels").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Object config = info[1].As<Napi::Object>();
+  DspSettings settings;
+  Napi::Value eq = config.Get("eq");
+  if (eq.IsArray())
+  {
+    Napi::Array bands = eq.As<Napi::Array>();
+    if (bands.Length() > static_cast<uint32_t>(kDspMaxEqBands))
+    {
+      Napi::RangeError::New(env, "At most 16 EQ bands").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    for (uint32_t b = 0; b < bands.Length(); ++b)
+    {
+      Napi::Value item = bands.Get(b);
+      if (!item.IsObject())
+      {
+        Napi::TypeError::New(env, "EQ bands must be objects").ThrowAsJavaScriptException();
+        return env.Null();
+      }
+      Napi::Object band = item.As<Napi::Object>();
+      DspSettings::Band &dst = settings.eq[b];
+      if (band.Has("type") && !ParseBiquadType(band.Get("type").ToString().Utf8Value(), &dst.type))
+      {
+        Napi::RangeError::New(env, "Unknown EQ band type").ThrowAsJavaScriptException();
+        return env.Null();
+      }
+      if (band.Has("frequency"))
+        dst.frequency = band.Get("frequency").ToNumber().DoubleValue();
+      if (band.Has("q"))
+        dst.q = band.Get("q").ToNumber().DoubleValue();
+      if (band.Has("gain"))
+        dst.gainDb = band.Get("gain").ToNumber().DoubleValue();
+      if (!(dst.frequency > 0.0) || !(dst.q > 0.0) || !std::isfinite(dst.gainDb) || std::fabs(dst.gainDb) > 48.0)
+      {
+        Napi::RangeError::New(env, "EQ bands need frequency > 0, q > 0 and |gain| <= 48 dB").ThrowAsJavaScriptException();
+        return env.Null();
+      }
+    }
+    settings.eqBands = static_cast<int>(bands.Length());
+  }
+  Napi::Value matrix = config.Get("matrix");
+  if (matrix.IsArray())
+  {
+    Napi::Array rows = matrix.As<Napi::Array>();
+    const uint32_t ch = static_cast<uint32_t>(sinfo->channels);
+    if (rows.Length() != ch)
+    {
+      Napi::RangeError::New(env, "Matrix must have one row per channel").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    for (uint32_t o = 0; o < ch; ++o)
+    {
+      Napi::Value row = rows.Get(o);
+      if (!row.IsArray() || row.As<Napi::Array>().Length() != ch)
+      {
+        Napi::RangeError::New(env, "Matrix must have one column per channel").ThrowAsJavaScriptException();
+        return env.Null();
+      }
+      for (uint32_t i = 0; i < ch; ++i)
+        settings.matrix[o * ch + i] = row.As<Napi::Array>().Get(i).ToNumber().FloatValue();
+    }
+    settings.matrixEnabled = true;
+  }
+  Napi::Value limiter = config.Get("limiter");
+  if (limiter.IsObject())
+  {
+    Napi::Object opts = limiter.As<Napi::Object>();
+    if (opts.Has("ceiling"))
+      settings.ceilingDb = opts.Get("ceiling").ToNumber().DoubleValue();
+    if (opts.Has("lookaheadMs"))
+      settings.lookaheadMs = opts.Get("lookaheadMs").ToNumber().DoubleValue();
+    if (opts.Has("releaseMs"))
+      settings.releaseMs = opts.Get("releaseMs").ToNumber().DoubleValue();
+    if (!(settings.ceilingDb <= 0.0 && settings.ceilingDb >= -60.0) || !(settings.lookaheadMs >= 0.0 && settings.lookaheadMs <= kLimiterMaxLookaheadMs) || !(settings.releaseMs > 0.0))
+    {
+      Napi::RangeError::New(env, "Limiter needs ceiling in [-60, 0] dB, lookaheadMs in [0, 20] and releaseMs > 0").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    settings.limiterEnabled = true;
+  }
+  if (!sinfo->dsp)
+  {
+    // Sized for the stream before the callback can see it
+    sinfo->dsp = std::make_unique<DspChain>();
+    sinfo->dsp->Configure(sinfo->channels, sinfo->sampleRate);
+    sinfo->dsp->Apply(settings);
+    sinfo->dspActive.store(sinfo->dsp.get(), std::memory_order_release);
+  }
+  else
+  {
+    sinfo->dsp->Apply(settings);
+  }
+  return env.Undefined();
+}
+
+// DSP state of a stream: { latencyFrames, limiterGain }, or null when no DSP was set
+Napi::Value GetStreamDsp(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsNumber())
+  {
+    Napi::TypeError::New(env, "Expected stream ID").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  StreamInfo *sinfo = GetStreamInfoById(env, info[0].As<Napi::Number>().Uint32Value());
+  if (!sinfo)
+  {
+    Napi::Error::New(env, "Stream not open").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (!sinfo->dsp)
+    return env.Null();
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("latencyFrames", Napi::Number::New(env, sinfo->dsp->LatencyFrames()));
+  result.Set("limiterGain", Napi::Number::New(env, sinfo->dsp->LimiterGain()));
+  return result;
+}
+
+// Pause/unpause a ring-mode stream; while paused the callback outputs silence without consuming
+Napi::Value SetStreamPaused(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsBoolean())
+  {
+    Napi::TypeError::New(env, "Expected stream ID and paused flag").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  StreamInfo *sinfo = GetStreamInfoById(env, info[0].As<Napi::Number>().Uint32Value());
+  if (!sinfo)
+  {
+    Napi::Error::New(env, "Stream not open").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  sinfo->paused.store(info[1].As<Napi::Boolean>().Value(), std::memory_order_relaxed);
+  return env.Undefined();
+}
+
+// Check if output format is supported for a device:
+// isOutputFormatSupported(deviceIndex, sampleRate, channels, sampleFormat = 'float32')
+Napi::Value IsOutputFormatSupported(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 3 || !info[0].IsNumber() || !info[1].IsNumber() || !info[2].IsNumber())
+  {
+    Napi::TypeError::New(env, "Expected device index, sample rate, channels").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  int deviceIndex = info[0].As<Napi::Number>().Int32Value();
+  double sampleRate = info[1].As<Napi::Number>().DoubleValue();
+  int channels = info[2].As<Napi::Number>().Int32Value();
+  PaSampleFormat sampleFormat = info.Length() > 3 && info[3].IsString() ? ParseSampleFormat(info[3].As<Napi::String>().Utf8Value()) : paFloat32;
+  if (sampleFormat == 0)
+    return Napi::Boolean::New(env, false);
+
+  // Held across the probe: a rescan must not free the device tables under it
+  std::shared_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+  const PaDeviceInfo *devInfo = Pa_GetDeviceInfo(deviceIndex);
+  if (!devInfo)
+    return Napi::Boolean::New(env, false);
+  // Answers are cached with the device's capabilities
+  const std::string identity = DeviceIdentity(devInfo);
+  const uint64_t key = FormatKey(sampleRate, channels, sampleFormat);
+  bool supported = false;
+  if (!g_capabilityCache.GetFormat(identity, key, &supported))
+  {
+    std::lock_guard<std::mutex> probeLock(g_capabilityCache.ProbeMutex());
+    supported = ProbeOutputFormat(deviceIndex, devInfo, sampleRate, channels, sampleFormat);
+    g_capabilityCache.PutFormat(identity, key, supported);
+  }
+  return Napi::Boolean::New(env, supported);
+}
+
+// Set stream volume: setStreamVolume(streamId, volume, rampMs = stream's volumeRampMs).
+// The output ramps to the new level per sample instead of jumping
+Napi::Value SetStreamVolume(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 2 || !info[0].IsNumber() || !info[1].IsNumber())
+  {
+    Napi::TypeError::New(env, "Expected stream ID and volume").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  uint32_t streamId = info[0].As<Napi::Number>().Uint32Value();
+  float volume = info[1].As<Napi::Number>().FloatValue();
+  if (volume < 0.0f)
+    volume = 0.0f;
+  if (volume > 2.0f)
+    volume = 2.0f;
+  StreamInfo *sinfo = GetStreamInfoById(env, streamId);
+  if (!sinfo)
+  {
+    Napi::Error::New(env, "Stream not open").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  double rampMs = info.Length() > 2 && info[2].IsNumber() ? std::max(info[2].As<Napi::Number>().DoubleValue(), 0.0) : sinfo->volumeRampMs;
+  sinfo->volume.Set(volume, static_cast<uint32_t>(rampMs * sinfo->sampleRate / 1000.0));
+  return env.Undefined();
+}
+
+// Capabilities of a device from the cache, probing (and caching) them on a miss
+static DeviceCapabilities LookupDeviceCapabilities(int deviceIndex, const PaDeviceInfo *devInfo)
+{
+  const std::string identity = DeviceIdentity(devInfo);
+  DeviceCapabilities caps;
+  if (g_capabilityCache.Get(identity, &caps))
+    return caps;
+  std::lock_guard<std::mutex> probeLock(g_capabilityCache.ProbeMutex());
+  // A startup probe may have filled it while we waited
+  if (g_capabilityCache.Get(identity, &caps))
+    return caps;
+  caps = ProbeDeviceCapabilities(deviceIndex, devInfo);
+  g_capabilityCache.Put(identity, caps);
+  return caps;
+}
+
+static Napi::Object DeviceCapabilitiesToObject(Napi::Env env, int deviceIndex, const PaDeviceInfo *devInfo, const DeviceCapabilities &caps)
+{
+  const PaHostApiInfo *hostApiInfo = Pa_GetHostApiInfo(devInfo->hostApi);
+  Napi::Array supportedRates = Napi::Array::New(env, caps.sampleRates.size());
+  for (size_t i = 0; i < caps.sampleRates.size(); ++i)
+    supportedRates.Set(static_cast<uint32_t>(i), Napi::Number::New(env, caps.sampleRates[i]));
+  Napi::Array supportedChannels = Napi::Array::New(env, caps.channels.size());
+  for (size_t i = 0; i < caps.channels.size(); ++i)
+    supportedChannels.Set(static_cast<uint32_t>(i), Napi::Number::New(env, caps.channels[i]));
+  Napi::Array supportedBitDepths = Napi::Array::New(env, caps.bitDepths.size());
+  for (size_t i = 0; i < caps.bitDepths.size(); ++i)
+    supportedBitDepths.Set(static_cast<uint32_t>(i), Napi::Number::New(env, caps.bitDepths[i]));
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("index", deviceIndex);
+  result.Set("name", devInfo->name ? devInfo->name : "");
+  result.Set("maxInputChannels", devInfo->maxInputChannels);
+  result.Set("maxOutputChannels", devInfo->maxOutputChannels);
+  result.Set("defaultSampleRate", devInfo->defaultSampleRate);
+  result.Set("supportedSampleRates", supportedRates);
+  result.Set("supportedChannels", supportedChannels);
+  result.Set("supportedBitDepths", supportedBitDepths);
+  result.Set("hostApi", devInfo->hostApi);
+  result.Set("hostApiName", hostApiInfo ? hostApiInfo->name : "");
+  result.Set("isDefaultOutput", deviceIndex == Pa_GetDefaultOutputDevice());
+  return result;
+}
+
+// Enumerate device capabilities (sample rates, channels, host API info); served from
+// the capability cache once the device has been probed
+Napi::Value GetDeviceCapabilities(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  std::shared_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+  int deviceIndex = Pa_GetDefaultOutputDevice();
+  if (info.Length() > 0 && info[0].IsNumber())
+  {
+    deviceIndex = info[0].As<Napi::Number>().Int32Value();
+  }
+  const PaDeviceInfo *devInfo = Pa_GetDeviceInfo(deviceIndex);
+  if (!devInfo)
+  {
+    Napi::Error::New(env, "Invalid device index").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  return DeviceCapabilitiesToObject(env, deviceIndex, devInfo, LookupDeviceCapabilities(deviceIndex, devInfo));
+}
+
+// Probes every output device not yet in the capability cache, off the main thread
+class CapabilityProbeWorker : public Napi::AsyncWorker
+{
+public:
+  CapabilityProbeWorker(Napi::Env env, Napi::Promise::Deferred deferred)
+      : Napi::AsyncWorker(env, "CapabilityProbe"), deferred_(deferred) {}
+
+protected:
+  void Execute() override
+  {
+    // Device list before the probe mutex, in the order rescans take them
+    std::shared_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+    std::lock_guard<std::mutex> probeLock(g_capabilityCache.ProbeMutex());
+    const int count = Pa_GetDeviceCount();
+    if (count < 0)
+    {
+      SetError(Pa_GetErrorText(count));
+      return;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+      const PaDeviceInfo *dev = Pa_GetDeviceInfo(i);
+      if (!dev || dev->maxOutputChannels <= 0)
+        continue;
+      const std::string identity = DeviceIdentity(dev);
+      DeviceCapabilities caps;
+      if (!g_capabilityCache.Get(identity, &caps))
+        g_capabilityCache.Put(identity, ProbeDeviceCapabilities(i, dev));
+      devices_.push_back(i);
+      identities_.push_back(identity);
+    }
+  }
+
+  void OnOK() override
+  {
+    Napi::Env env = Env();
+    Napi::Array result = Napi::Array::New(env);
+    uint32_t n = 0;
+    std::shared_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+    for (size_t i = 0; i < devices_.size(); ++i)
+    {
+      // Indices found by the probe are stale if a rescan ran in between; skip anything
+      // that moved
+      const int index = devices_[i];
+      const PaDeviceInfo *dev = index < Pa_GetDeviceCount() ? Pa_GetDeviceInfo(index) : nullptr;
+      if (dev && DeviceIdentity(dev) == identities_[i])
+        result.Set(n++, DeviceCapabilitiesToObject(env, index, dev, LookupDeviceCapabilities(index, dev)));
+    }
+    deferred_.Resolve(result);
+  }
+
+  void OnError(const Napi::Error &error) override
+  {
+    deferred_.Reject(error.Value());
+  }
+
+private:
+  Napi::Promise::Deferred deferred_;
+  std::vector<int> devices_;
+  std::vector<std::string> identities_;
+};
+
+// Fill the capability cache for every output device on a worker thread:
+// probeDeviceCapabilitiesAsync() resolves with the capabilities of each output device
+Napi::Value ProbeDeviceCapabilitiesAsync(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  (new CapabilityProbeWorker(env, deferred))->Queue();
+  return deferred.Promise();
+}
+
+// Forget all probed capabilities (e.g. after a device was reconfigured externally)
+Napi::Value InvalidateDeviceCapabilities(const Napi::CallbackInfo &info)
+{
+  g_capabilityCache.Clear();
+  return info.Env().Undefined();
+}
+
+// --- Device hotplug ---
+
+// watchDevices(callback): call callback(reason) when an audio device is added or removed
+// or the default device changes, with reason "added", "removed", "state" or "default".
+// Notifications come in bursts and do not rescan anything by themselves; follow them
+// with refreshDevicesAsync(). Returns the notification source ("wasapi", "coreaudio",
+// "inotify"), or null if this platform has none. Watching does not keep the process alive.
+Napi::Value WatchDevices(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsFunction())
+  {
+    Napi::TypeError::New(env, "Expected callback function").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  AddonData *data = GetAddonData(env);
+  StopDeviceWatcher(data);
+  data->deviceTsfn = std::make_unique<Napi::ThreadSafeFunction>(
+      Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(), "DeviceWatcher", 0, 1));
+  data->deviceTsfn->Unref(env);
+  Napi::ThreadSafeFunction *tsfn = data->deviceTsfn.get();
+  const bool started = data->deviceWatcher.Start([tsfn](const char *reason) {
+    // Reasons are string literals, so they outlive the call
+    tsfn->NonBlockingCall(const_cast<char *>(reason), [](Napi::Env env, Napi::Function fn, char *reason) {
+      fn.Call({Napi::String::New(env, reason)});
+    });
+  });
+  if (!started)
+  {
+    StopDeviceWatcher(data);
+    return env.Null();
+  }
+  return Napi::String::New(env, data->deviceWatcher.Backend());
+}
+
+// unwatchDevices(): stop hotplug notifications
+Napi::Value UnwatchDevices(const Napi::CallbackInfo &info)
+{
+  StopDeviceWatcher(GetAddonData(info.Env()));
+  return info.Env().Undefined();
+}
+
+// Terminate and reinitialise PortAudio, which is the only way it enumerates devices
+// again. Caller holds g_portAudioMutex and g_deviceListMutex exclusively, with no
+// stream open
+static PaError RescanDevicesLocked()
+{
+  std::lock_guard<std::mutex> probeLock(g_capabilityCache.ProbeMutex());
+  PaError err = Pa_Terminate();
+  if (err != paNoError)
+    return err;
+  err = Pa_Initialize();
+  if (err != paNoError)
+    return err;
+  // Capabilities of devices that are still present stay cached
+  g_capabilityCache.Revalidate(DeviceListSignature());
+  return paNoError;
+}
+
+// Rescans the device list off the main thread, provided no stream is open anywhere
+class DeviceRescanWorker : public Napi::AsyncWorker
+{
+public:
+  DeviceRescanWorker(Napi::Env env, Napi::Promise::Deferred deferred)
+      : Napi::AsyncWorker(env, "DeviceRescan"), deferred_(deferred) {}
+
+protected:
+  void Execute() override
+  {
+    std::lock_guard<std::mutex> lock(g_portAudioMutex);
+    if (g_portAudioUsers == 0)
+    {
+      SetError("PortAudio is not initialized");
+      return;
+    }
+    // Waits for device queries and stream opens in progress
+    std::unique_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+    if (g_liveStreams.load(std::memory_order_relaxed) > 0)
+      return;
+    PaError err = RescanDevicesLocked();
+    if (err != paNoError)
+    {
+      SetError(std::string("Device rescan failed: ") + Pa_GetErrorText(err));
+      return;
+    }
+    rescanned_ = true;
+  }
+
+  void OnOK() override
+  {
+    deferred_.Resolve(Napi::Boolean::New(Env(), rescanned_));
+  }
+
+  void OnError(const Napi::Error &error) override
+  {
+    deferred_.Reject(error.Value());
+  }
+
+private:
+  Napi::Promise::Deferred deferred_;
+  bool rescanned_ = false;
+};
+
+// refreshDevicesAsync(): rescan the device list on a worker thread, so getDevices() sees
+// devices plugged in or removed since init(). Resolves with true once rescanned, or false
+// without doing anything while a stream is open in any environment (device indices
+// would change under it); refreshDevices() handles that case. Device indices obtained
+// before a rescan are invalid after it.
+Napi::Value RefreshDevicesAsync(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  (new DeviceRescanWorker(env, deferred))->Queue();
+  return deferred.Promise();
+}
+
+static int FindDeviceByIdentity(const std::string &identity)
+{
+  const int count = Pa_GetDeviceCount();
+  for (int i = 0; i < count; ++i)
+  {
+    const PaDeviceInfo *dev = Pa_GetDeviceInfo(i);
+    if (dev && DeviceIdentity(dev) == identity)
+      return i;
+  }
+  return paNoDevice;
+}
+
+static std::string DeviceIdentityAt(int device)
+{
+  const PaDeviceInfo *dev = device >= 0 ? Pa_GetDeviceInfo(device) : nullptr;
+  return dev ? DeviceIdentity(dev) : std::string();
+}
+
+// refreshDevices(): reinitialise PortAudio under a unique g_deviceListMutex; open streams keep
+// their IDs and state and are reopened on their devices. Returns { moved, closed } stream IDs.
+Napi::Value RefreshDevices(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  AddonData *data = GetAddonData(env);
+  std::lock_guard<std::mutex> lock(g_portAudioMutex);
+  if (!data->portAudioHeld)
+  {
+    Napi::Error::New(env, "PortAudio is not initialized").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  std::unique_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+  // Offline streams have no device and are left alone
+  const int deviceStreams = static_cast<int>(std::count_if(data->streams.begin(), data->streams.end(), [](const auto &kv)
+                                                           { return !kv.second->offline; }));
+  if (g_liveStreams.load(std::memory_order_relaxed) != deviceStreams)
+  {
+    Napi::Error::New(env, "Streams of another environment are open").ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  for (auto &kv : data->streams)
+  {
+    StreamInfo *sinfo = kv.second.get();
+    if (!sinfo->offline && !sinfo->ringMode && !sinfo->audioTsfn && sinfo->inputChannels == 0)
+    {
+      Napi::Error::New(env, "Blocking-mode streams must be closed before refreshing devices").ThrowAsJavaScriptException();
+      return env.Null();
+    }
+  }
+  struct Identities
+  {
+    std::string output;
+    std::string input;
+  };
+  std::map<uint32_t, Identities> identities;
+  for (auto &kv : data->streams)
+  {
+    StreamInfo *sinfo = kv.second.get();
+    if (sinfo->offline)
+      continue;
+    identities[kv.first] = {DeviceIdentityAt(sinfo->device), DeviceIdentityAt(sinfo->inputDevice)};
+    // Queued buffers play out; afterwards no callback touches the stream's state
+    Pa_StopStream(sinfo->stream);
+    Pa_CloseStream(sinfo->stream);
+    sinfo->stream = nullptr;
+  }
+  PaError err = RescanDevicesLocked();
+  Napi::Object result = Napi::Object::New(env);
+  Napi::Array moved = Napi::Array::New(env);
+  Napi::Array closed = Napi::Array::New(env);
+  result.Set("moved", moved);
+  result.Set("closed", closed);
+  std::vector<uint32_t> failed;
+  if (err == paNoError)
+  {
+    for (auto &kv : data->streams)
+    {
+      StreamInfo *sinfo = kv.second.get();
+      if (sinfo->offline)
+        continue;
+      const Identities &ids = identities[kv.first];
+      const bool output = sinfo->ringMode || sinfo->audioTsfn;
+      if (output)
+      {
+        int device = FindDeviceByIdentity(ids.output);
+        if (device == paNoDevice)
+        {
+          device = Pa_GetDefaultOutputDevice();
+          moved.Set(moved.Length(), kv.first);
+        }
+        sinfo->device = device;
+      }
+      if (sinfo->inputChannels > 0)
+      {
+        int device = FindDeviceByIdentity(ids.input);
+        if (device == paNoDevice && !output)
+          device = Pa_GetDefaultInputDevice();
+        if (device == paNoDevice)
+        {
+          sinfo->inputChannels = 0;
+          sinfo->captureSource = sinfo->captureSource == kCaptureInput ? kCaptureNone : sinfo->captureSource;
+        }
+        sinfo->inputDevice = device;
+      }
+      std::string error;
+      if ((output && sinfo->device == paNoDevice) || (!output && sinfo->inputDevice == paNoDevice) ||
+          ReopenStream(sinfo, &error) != paNoError)
+        failed.push_back(kv.first);
+    }
+  }
+  else
+  {
+    for (auto &kv : data->streams)
+    {
+      if (!kv.second->offline)
+        failed.push_back(kv.first);
+    }
+  }
+  for (uint32_t streamId : failed)
+  {
+    StreamInfo *sinfo = data->streams[streamId].get();
+    ReleaseAllVoices(sinfo);
+    ReleaseStreamCallbacks(sinfo);
+    data->streams.erase(streamId);
+    closed.Set(closed.Length(), streamId);
+  }
+  if (err != paNoError)
+  {
+    Napi::Error::New(env, std::string("Device rescan failed: ") + Pa_GetErrorText(err)).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  return result;
+}
+
+// getLostStreams(stallMs = 500): IDs of this environment's device streams that lost their
+// device: PortAudio stopped them, or they had callbacks before and none for stallMs. Lets
+// a hotplug watcher tell whether a removal hit an open stream, since refreshDevices()
+// has to stop and reopen every stream whether its device changed or not.
+Napi::Value GetLostStreams(const Napi::CallbackInfo &info)
+{
+  Napi::Env env = info.Env();
+  AddonData *data = GetAddonData(env);
+  const double stallMs = info.Length() > 0 && info[0].IsNumber() ? std::max(info[0].As<Napi::Number>().DoubleValue(), 0.0) : 500.0;
+  const int64_t now = SteadyMicros(std::chrono::steady_clock::now());
+  std::shared_lock<std::shared_mutex> deviceLock(g_deviceListMutex);
+  Napi::Array lost = Napi::Array::New(env);
+  for (auto &kv : data->streams)
+  {
+    StreamInfo *sinfo = kv.second.get();
+    // Blocking-mode streams have no callback to watch
+    if (sinfo->offline || !sinfo->stream || (!sinfo->ringMode && !sinfo->audioTsfn && sinfo->inputChannels == 0))
+      continue;
+    const int64_t last = sinfo->stats.lastCallbackUs.load(std::memory_order_relaxed);
+    if (Pa_IsStreamActive(sinfo->stream) != 1 || (last > 0 && now - last > stallMs * 1000.0))
+      lost.Set(lost.Length(), kv.first);
+  }
+  return lost;
 }
 
 Napi::Object InitAll(Napi::Env env, Napi::Object exports)
@@ -634,12 +4458,69 @@ Napi::Object InitAll(Napi::Env env, Napi::Object exports)
   exports.Set(Napi::String::New(env, "openDefaultStream"), Napi::Function::New(env, OpenDefaultStream));
   exports.Set(Napi::String::New(env, "openStream"), Napi::Function::New(env, OpenStream));
   exports.Set(Napi::String::New(env, "writeStream"), Napi::Function::New(env, WriteStream));
+  exports.Set(Napi::String::New(env, "writeStreamAsync"), Napi::Function::New(env, WriteStreamAsync));
+  exports.Set(Napi::String::New(env, "getStreamWriteState"), Napi::Function::New(env, GetStreamWriteState));
+  exports.Set(Napi::String::New(env, "getStreamStats"), Napi::Function::New(env, GetStreamStats));
+  exports.Set(Napi::String::New(env, "switchStreamDevice"), Napi::Function::New(env, SwitchStreamDevice));
+  exports.Set(Napi::String::New(env, "getStreamClock"), Napi::Function::New(env, GetStreamClock));
+  exports.Set(Napi::String::New(env, "getStreamTime"), Napi::Function::New(env, GetStreamTime));
   exports.Set(Napi::String::New(env, "closeStream"), Napi::Function::New(env, CloseStream));
   exports.Set(Napi::String::New(env, "openStreamAsync"), Napi::Function::New(env, OpenStreamAsync));
   exports.Set(Napi::String::New(env, "setStreamEventCallback"), Napi::Function::New(env, SetStreamEventCallback));
   exports.Set(Napi::String::New(env, "setStreamVolume"), Napi::Function::New(env, SetStreamVolume));
+  exports.Set(Napi::String::New(env, "setAnalysisTap"), Napi::Function::New(env, SetAnalysisTap));
+  exports.Set(Napi::String::New(env, "setStreamDsp"), Napi::Function::New(env, SetStreamDsp));
+  exports.Set(Napi::String::New(env, "getStreamDsp"), Napi::Function::New(env, GetStreamDsp));
   exports.Set(Napi::String::New(env, "isOutputFormatSupported"), Napi::Function::New(env, IsOutputFormatSupported));
   exports.Set(Napi::String::New(env, "getDeviceCapabilities"), Napi::Function::New(env, GetDeviceCapabilities));
+  exports.Set(Napi::String::New(env, "probeDeviceCapabilitiesAsync"), Napi::Function::New(env, ProbeDeviceCapabilitiesAsync));
+  exports.Set(Napi::String::New(env, "watchDevices"), Napi::Function::New(env, WatchDevices));
+  exports.Set(Napi::String::New(env, "unwatchDevices"), Napi::Function::New(env, UnwatchDevices));
+  exports.Set(Napi::String::New(env, "refreshDevicesAsync"), Napi::Function::New(env, RefreshDevicesAsync));
+  exports.Set(Napi::String::New(env, "refreshDevices"), Napi::Function::New(env, RefreshDevices));
+  exports.Set(Napi::String::New(env, "getLostStreams"), Napi::Function::New(env, GetLostStreams));
+  exports.Set(Napi::String::New(env, "invalidateDeviceCapabilities"), Napi::Function::New(env, InvalidateDeviceCapabilities));
+  exports.Set(Napi::String::New(env, "getStreamRing"), Napi::Function::New(env, GetStreamRing));
+  exports.Set(Napi::String::New(env, "openCaptureStream"), Napi::Function::New(env, OpenCaptureStream));
+  exports.Set(Napi::String::New(env, "getCaptureRing"), Napi::Function::New(env, GetCaptureRing));
+  exports.Set(Napi::String::New(env, "setDuplex"), Napi::Function::New(env, SetDuplex));
+  exports.Set(Napi::String::New(env, "getDuplexState"), Napi::Function::New(env, GetDuplexState));
+  exports.Set(Napi::String::New(env, "setStreamPaused"), Napi::Function::New(env, SetStreamPaused));
+  exports.Set(Napi::String::New(env, "addVoice"), Napi::Function::New(env, AddVoice));
+  exports.Set(Napi::String::New(env, "removeVoice"), Napi::Function::New(env, RemoveVoice));
+  exports.Set(Napi::String::New(env, "setVoiceGain"), Napi::Function::New(env, SetVoiceGain));
+  exports.Set(Napi::String::New(env, "setVoiceTrim"), Napi::Function::New(env, SetVoiceTrim));
+  exports.Set(Napi::String::New(env, "getVoiceState"), Napi::Function::New(env, GetVoiceState));
+  exports.Set(Napi::String::New(env, "seekVoice"), Napi::Function::New(env, SeekVoice));
+  exports.Set(Napi::String::New(env, "createPrebuffer"), Napi::Function::New(env, CreatePrebuffer));
+  exports.Set(Napi::String::New(env, "prebufferWrite"), Napi::Function::New(env, PrebufferWrite));
+  exports.Set(Napi::String::New(env, "prebufferRead"), Napi::Function::New(env, PrebufferRead));
+  exports.Set(Napi::String::New(env, "prebufferToVoice"), Napi::Function::New(env, PrebufferToVoice));
+  exports.Set(Napi::String::New(env, "getPrebufferState"), Napi::Function::New(env, GetPrebufferState));
+  exports.Set(Napi::String::New(env, "destroyPrebuffer"), Napi::Function::New(env, DestroyPrebuffer));
+#ifndef _WIN32
+  exports.Set(Napi::String::New(env, "createPipe"), Napi::Function::New(env, CreatePipe));
+  exports.Set(Napi::String::New(env, "attachPipe"), Napi::Function::New(env, AttachPipe));
+  exports.Set(Napi::String::New(env, "attachFanOut"), Napi::Function::New(env, AttachFanOut));
+  exports.Set(Napi::String::New(env, "getFanOutState"), Napi::Function::New(env, GetFanOutState));
+  exports.Set(Napi::String::New(env, "renderStreamAsync"), Napi::Function::New(env, RenderStreamAsync));
+  exports.Set(Napi::String::New(env, "attachFile"), Napi::Function::New(env, AttachFile));
+  exports.Set(Napi::String::New(env, "attachDecoder"), Napi::Function::New(env, AttachDecoder));
+  exports.Set(Napi::String::New(env, "probeAudioFile"), Napi::Function::New(env, ProbeAudioFile));
+  exports.Set(Napi::String::New(env, "analyzeLoudnessAsync"), Napi::Function::New(env, AnalyzeLoudnessAsync));
+#endif
+#ifdef ZEAKER_BENCH
+  exports.Set(Napi::String::New(env, "configureNullDevice"), Napi::Function::New(env, ConfigureNullDevice));
+  exports.Set(Napi::String::New(env, "getBenchReport"), Napi::Function::New(env, GetBenchReport));
+#endif
+  // Per-environment state, so the addon can be loaded by worker_threads as well
+  AddonData *data = new AddonData();
+  env.SetInstanceData(data);
+  // Release streams (and the ring storage they reference) and this environment's
+  // PortAudio reference before the env goes away
+  env.AddCleanupHook([](AddonData *data)
+                     { ShutdownAddon(data); },
+                     data);
   return exports;
 }
 
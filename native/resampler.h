@@ -0,0 +1,336 @@
+// Polyphase windowed-sinc sample-rate converter for mixer voices.
+//
+// Lets one decoded stream feed a device running at any rate: each voice converts
+// from its source rate to the stream rate while it is mixed, so switching to a
+// device with a different rate does not require restarting the decoder.
+//
+// The filter is a Kaiser-windowed sinc evaluated at a fixed number of fractional
+// phases; output samples interpolate linearly between the two nearest phases (except
+// at the lowest quality). History is kept planar per channel so every tap sum is one
+// contiguous dot product, vectorised like ApplyGain() in gain.h.
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "gain.h"
+#include "math_constants.h"
+
+enum ResamplerQuality : int32_t
+{
+  kResampleLow = 0,
+  kResampleMedium = 1,
+  kResampleHigh = 2,
+  kResampleBest = 3
+};
+
+// Parse a quality name ("low", "medium", "high", "best"); returns -1 for unknown names
+inline int32_t ParseResamplerQuality(const std::string &name)
+{
+  if (name == "low")
+    return kResampleLow;
+  if (name == "medium")
+    return kResampleMedium;
+  if (name == "high")
+    return kResampleHigh;
+  if (name == "best")
+    return kResampleBest;
+  return -1;
+}
+
+inline float DotProduct(const float *a, const float *b, size_t count)
+{
+  size_t i = 0;
+  float sum = 0.0f;
+#if defined(__AVX__)
+  __m256 acc = _mm256_setzero_ps();
+  for (; i + 8 <= count; i += 8)
+    acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+  __m128 v = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+  sum = _mm_cvtss_f32(v);
+#elif defined(ZEAKER_GAIN_SSE2)
+  __m128 acc = _mm_setzero_ps();
+  for (; i + 4 <= count; i += 4)
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+  acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+  sum = _mm_cvtss_f32(acc);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+  float32x4_t acc = vdupq_n_f32(0.0f);
+  for (; i + 4 <= count; i += 4)
+    acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+  float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+  sum = vget_lane_f32(vpadd_f32(half, half), 0);
+#endif
+  for (; i < count; ++i)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+class Resampler
+{
+public:
+  // Main thread, only while the callback cannot run this voice: set up a fresh
+  // conversion (no input buffered). Equal rates turn the resampler off, unless it is
+  // varispeed: then it always runs, so SetSpeed() can trim the ratio.
+  void Configure(int channels, double inRate, double outRate, int32_t quality, bool varispeed = false)
+  {
+    channels_ = channels;
+    inRate_ = inRate;
+    quality_ = quality;
+    speed_.store(1.0, std::memory_order_relaxed);
+    appliedSpeed_ = 1.0;
+    active_ = inRate > 0 && outRate > 0 && (inRate != outRate || varispeed);
+    if (active_)
+      Build(outRate, false);
+  }
+
+  // Main thread, only while the callback cannot run this voice: change the output rate
+  // (device switch). Input already buffered is kept so no samples are dropped; an
+  // active resampler therefore stays active even if the rates now match.
+  void Retune(double outRate)
+  {
+    if (active_)
+      Build(outRate, true);
+    else if (inRate_ > 0 && outRate > 0 && inRate_ != outRate)
+      Configure(channels_, inRate_, outRate, quality_);
+  }
+
+  bool Active() const { return active_; }
+
+  // Any thread: play the input `speed` times faster than nominal (clock drift
+  // compensation, within a fraction of a percent); the next Render picks it up.
+  // Only affects an active resampler.
+  void SetSpeed(double speed) { speed_.store(speed, std::memory_order_relaxed); }
+  double Speed() const { return speed_.load(std::memory_order_relaxed); }
+
+  // Main thread or callback (before first use): start from silence with no input buffered
+  void Reset()
+  {
+    std::fill(history_.begin(), history_.end(), 0.0f);
+    // Prime with half a window of zeros so the first output is centred on the first input
+    valid_ = static_cast<uint32_t>(taps_ / 2 - 1);
+    pos_ = static_cast<double>(valid_);
+    tailPadded_ = false;
+  }
+
+  // Callback: produce up to `frames` interleaved output frames. `pull(dst, max)` must copy
+  // at most `max` interleaved float frames of input and return how many it wrote; `eos`
+  // says the source will produce nothing more once it runs dry. Returns frames written;
+  // fewer than requested means the input ran out (check Drained() for end of stream).
+  template <typename Pull>
+  uint32_t Render(float *out, uint32_t frames, Pull &&pull, bool eos)
+  {
+    const double speed = speed_.load(std::memory_order_relaxed);
+    if (speed != appliedSpeed_)
+    {
+      // Small trims need no new filter; cutoff and length stay those of the nominal ratio
+      appliedSpeed_ = speed;
+      step_ = baseStep_ * speed;
+    }
+    const int half = taps_ / 2;
+    uint32_t produced = 0;
+    while (produced < frames)
+    {
+      uint32_t base = static_cast<uint32_t>(pos_);
+      if (base + half >= valid_)
+      {
+        if (!Refill(pull, eos))
+          break;
+        continue;
+      }
+      const uint32_t start = base + 1 - half;
+      const double phase = (pos_ - base) * phases_;
+      int p = static_cast<int>(phase);
+      float t = static_cast<float>(phase - p);
+      if (!interpolate_ && t >= 0.5f)
+        ++p;
+      const float *h0 = &table_[static_cast<size_t>(p) * taps_];
+      const float *h1 = h0 + taps_;
+      float *dst = out + static_cast<size_t>(produced) * channels_;
+      for (int c = 0; c < channels_; ++c)
+      {
+        const float *x = &history_[static_cast<size_t>(c) * capacity_ + start];
+        float y = DotProduct(h0, x, taps_);
+        if (interpolate_ && t > 0.0f)
+          y += t * (DotProduct(h1, x, taps_) - y);
+        dst[c] = y;
+      }
+      pos_ += step_;
+      ++produced;
+    }
+    return produced;
+  }
+
+  // Callback: true once end of stream was reached and the filter tail has been played
+  bool Drained() const
+  {
+    return tailPadded_ && static_cast<uint32_t>(pos_) + taps_ / 2 >= valid_;
+  }
+
+private:
+  static constexpr uint32_t kPullFrames = 256;
+
+  void Build(double outRate, bool keepHistory)
+  {
+    static const struct
+    {
+      int taps;
+      int phases;
+      float cutoff;
+      double beta;
+      bool interpolate;
+    } kQuality[] = {
+        {8, 32, 0.85f, 5.0, false},
+        {16, 64, 0.90f, 6.0, true},
+        {32, 128, 0.94f, 8.0, true},
+        {64, 256, 0.97f, 10.0, true},
+    };
+    const auto &q = kQuality[std::min(std::max(quality_, 0), 3)];
+    baseStep_ = inRate_ / outRate;
+    step_ = baseStep_ * appliedSpeed_;
+    // Downsampling lowers the cutoff below the output Nyquist and widens the filter
+    // by the same factor so the transition band keeps its shape
+    const double scale = std::min(baseStep_ > 1.0 ? baseStep_ : 1.0, 8.0);
+    const int taps = std::min(static_cast<int>(std::ceil(q.taps * scale / 8.0)) * 8, 256);
+    const double cutoff = q.cutoff / (baseStep_ > 1.0 ? baseStep_ : 1.0);
+    interpolate_ = q.interpolate;
+    phases_ = q.phases;
+    const uint32_t capacity = static_cast<uint32_t>(taps) + 2 * kPullFrames;
+    std::vector<float> old;
+    old.swap(history_);
+    const uint32_t oldCapacity = capacity_;
+    const int64_t oldValid = valid_;
+    taps_ = taps;
+    capacity_ = capacity;
+    history_.assign(static_cast<size_t>(capacity) * channels_, 0.0f);
+    pull_.assign(static_cast<size_t>(kPullFrames) * channels_, 0.0f);
+    BuildTable(cutoff, q.beta);
+    if (!keepHistory || old.empty())
+    {
+      Reset();
+      return;
+    }
+    // Re-centre the buffered input on the new filter length: new index j holds old
+    // index j + shift (zeros where the old history has nothing)
+    const int64_t shift = static_cast<int64_t>(pos_) + 1 - taps / 2;
+    const int64_t newValid = std::min<int64_t>(oldValid - shift, capacity);
+    for (int c = 0; c < channels_; ++c)
+    {
+      for (int64_t j = std::max<int64_t>(0, -shift); j < newValid; ++j)
+        history_[static_cast<size_t>(c) * capacity + j] = old[static_cast<size_t>(c) * oldCapacity + j + shift];
+    }
+    pos_ -= static_cast<double>(shift);
+    valid_ = static_cast<uint32_t>(std::max<int64_t>(newValid, taps / 2));
+  }
+
+  // Row p holds the taps for fractional position p / phases (phases + 1 rows, so the
+  // interpolation partner of the last phase exists); each row is normalised to unity DC gain
+  void BuildTable(double cutoff, double beta)
+  {
+    table_.assign(static_cast<size_t>(phases_ + 1) * taps_, 0.0f);
+    const int half = taps_ / 2;
+    const double i0Beta = BesselI0(beta);
+    for (int p = 0; p <= phases_; ++p)
+    {
+      const double frac = static_cast<double>(p) / phases_;
+      double sum = 0.0;
+      float *row = &table_[static_cast<size_t>(p) * taps_];
+      for (int k = 0; k < taps_; ++k)
+      {
+        const double x = k - (half - 1) - frac;
+        const double r = x / half;
+        const double window = r <= -1.0 || r >= 1.0 ? 0.0 : BesselI0(beta * std::sqrt(1.0 - r * r)) / i0Beta;
+        const double arg = kPi * cutoff * x;
+        const double sinc = x == 0.0 ? 1.0 : std::sin(arg) / arg;
+        row[k] = static_cast<float>(cutoff * sinc * window);
+        sum += row[k];
+      }
+      if (sum != 0.0)
+      {
+        for (int k = 0; k < taps_; ++k)
+          row[k] = static_cast<float>(row[k] / sum);
+      }
+    }
+  }
+
+  static double BesselI0(double x)
+  {
+    double sum = 1.0;
+    double term = 1.0;
+    const double q = x * x / 4.0;
+    for (int k = 1; k < 64 && term > sum * 1e-12; ++k)
+    {
+      term *= q / (static_cast<double>(k) * k);
+      sum += term;
+    }
+    return sum;
+  }
+
+  // Drop history the filter no longer needs and append more input. Returns false when
+  // nothing could be added (starved, or the tail is already padded).
+  template <typename Pull>
+  bool Refill(Pull &pull, bool eos)
+  {
+    const int half = taps_ / 2;
+    uint32_t drop = static_cast<uint32_t>(pos_) + 1 - half;
+    if (drop > 0)
+    {
+      for (int c = 0; c < channels_; ++c)
+      {
+        float *h = &history_[static_cast<size_t>(c) * capacity_];
+        std::memmove(h, h + drop, (valid_ - drop) * sizeof(float));
+      }
+      valid_ -= drop;
+      pos_ -= drop;
+    }
+    uint32_t space = std::min(capacity_ - valid_, kPullFrames);
+    uint32_t n = space > 0 ? pull(pull_.data(), space) : 0;
+    if (n == 0)
+    {
+      if (!eos || tailPadded_)
+        return false;
+      // Flush the filter with half a window of silence after the last input sample
+      for (int c = 0; c < channels_; ++c)
+        std::fill_n(&history_[static_cast<size_t>(c) * capacity_ + valid_], half, 0.0f);
+      valid_ += half;
+      tailPadded_ = true;
+      return true;
+    }
+    for (uint32_t f = 0; f < n; ++f)
+    {
+      for (int c = 0; c < channels_; ++c)
+        history_[static_cast<size_t>(c) * capacity_ + valid_ + f] = pull_[static_cast<size_t>(f) * channels_ + c];
+    }
+    valid_ += n;
+    return true;
+  }
+
+  bool active_ = false;
+  bool interpolate_ = true;
+  int channels_ = 0;
+  double inRate_ = 0.0;
+  int32_t quality_ = kResampleHigh;
+  int taps_ = 0;
+  int phases_ = 1;
+  double step_ = 1.0;
+  double baseStep_ = 1.0;
+  std::atomic<double> speed_{1.0};
+  // Callback-owned: speed step_ was last derived for
+  double appliedSpeed_ = 1.0;
+  std::vector<float> table_;
+  // Planar input history, capacity_ frames per channel; frames [0, valid_) are filled
+  std::vector<float> history_;
+  std::vector<float> pull_;
+  uint32_t capacity_ = 0;
+  uint32_t valid_ = 0;
+  // Input position of the next output frame, relative to history_ index 0
+  double pos_ = 0.0;
+  bool tailPadded_ = false;
+};
@@ -0,0 +1,190 @@
+// Lock-free single-producer/single-consumer PCM ring shared with JavaScript.
+//
+// The ring lives in one ArrayBuffer so that JS can write samples into it
+// directly and publish them with Atomics, while the PortAudio callback only
+// ever memcpy's out of it. Keep the layout in sync with src/utils/RingBuffer.js.
+//
+//   byte 0    write index (uint32, free running, owned by the producer)
+//   byte 64   read index  (uint32, free running, owned by the consumer)
+//   byte 128  flags       (uint32, see kRingFlag*)
+//   byte 192  retain      (uint32, bytes behind the read index the producer must not
+//                          overwrite, so the consumer can seek back; set before use)
+//   byte 256  sample data (capacity bytes, capacity is a power of two)
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+static const uint32_t kRingHeaderBytes = 256;
+static const uint32_t kRingWriteIndexOffset = 0;
+static const uint32_t kRingReadIndexOffset = 64;
+static const uint32_t kRingFlagsOffset = 128;
+static const uint32_t kRingRetainOffset = 192;
+
+// Set by the producer once no more data will be written
+static const uint32_t kRingFlagEndOfStream = 1u << 0;
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "atomic<uint32_t> must be layout compatible with uint32_t");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "atomic<uint32_t> must be lock free");
+
+// Round up to the next power of two (values above 2^31 are clamped)
+inline uint32_t RingCapacityFor(uint64_t bytes)
+{
+  uint32_t capacity = 1024;
+  while (capacity < bytes && capacity < (1u << 31))
+    capacity <<= 1;
+  return capacity;
+}
+
+class PcmRing
+{
+public:
+  // Bind the ring to caller-owned memory of kRingHeaderBytes + capacity bytes
+  void Attach(uint8_t *base, uint32_t capacity)
+  {
+    writeIndex_ = reinterpret_cast<std::atomic<uint32_t> *>(base + kRingWriteIndexOffset);
+    readIndex_ = reinterpret_cast<std::atomic<uint32_t> *>(base + kRingReadIndexOffset);
+    flags_ = reinterpret_cast<std::atomic<uint32_t> *>(base + kRingFlagsOffset);
+    data_ = base + kRingHeaderBytes;
+    capacity_ = capacity;
+    mask_ = capacity - 1;
+    retain_ = 0;
+  }
+
+  // Main thread, before the ring is used: keep `bytes` of consumed data readable behind
+  // the read index (published in the header for JS producers)
+  void SetRetain(uint32_t bytes)
+  {
+    retain_ = bytes < capacity_ ? bytes : 0;
+    std::memcpy(data_ - kRingHeaderBytes + kRingRetainOffset, &retain_, sizeof(retain_));
+  }
+
+  void Detach()
+  {
+    writeIndex_ = readIndex_ = flags_ = nullptr;
+    data_ = nullptr;
+    capacity_ = mask_ = retain_ = 0;
+  }
+
+  bool IsAttached() const { return data_ != nullptr; }
+  uint32_t Capacity() const { return capacity_; }
+  uint32_t Retain() const { return retain_; }
+
+  uint32_t ReadAvailable() const
+  {
+    return writeIndex_->load(std::memory_order_acquire) - readIndex_->load(std::memory_order_relaxed);
+  }
+
+  uint32_t WriteAvailable() const
+  {
+    return Space(writeIndex_->load(std::memory_order_relaxed));
+  }
+
+  // Most bytes the producer can ever have free at once: the ring less its retained history
+  uint32_t MaxWriteAvailable() const
+  {
+    return capacity_ > retain_ ? capacity_ - retain_ : 0;
+  }
+
+  // Consumer side: bytes behind the read index that still hold consumed data (not yet
+  // overwritten), capped at the retain size. After a backward Skip() the producer may
+  // still be filling up to the old read index, so callers must also discount how far
+  // the index went back (see Mixer::ApplySeek).
+  uint32_t HistoryAvailable() const
+  {
+    uint32_t free = capacity_ - ReadAvailable();
+    return free < retain_ ? free : retain_;
+  }
+
+  // Consumer side: move the read index by `bytes` (negative seeks back into retained
+  // history). The caller keeps it within [-HistoryAvailable(), ReadAvailable()].
+  void Skip(int32_t bytes)
+  {
+    uint32_t r = readIndex_->load(std::memory_order_relaxed);
+    readIndex_->store(r + static_cast<uint32_t>(bytes), std::memory_order_release);
+  }
+
+  // Consumer side: copy up to `bytes` out of the ring, returns bytes copied
+  uint32_t Read(void *dst, uint32_t bytes)
+  {
+    uint32_t r = readIndex_->load(std::memory_order_relaxed);
+    uint32_t avail = writeIndex_->load(std::memory_order_acquire) - r;
+    uint32_t n = bytes < avail ? bytes : avail;
+    CopyOut(r, static_cast<uint8_t *>(dst), n);
+    readIndex_->store(r + n, std::memory_order_release);
+    return n;
+  }
+
+  // Producer side: copy up to `bytes` into the ring, returns bytes copied
+  uint32_t Write(const void *src, uint32_t bytes)
+  {
+    uint32_t w = writeIndex_->load(std::memory_order_relaxed);
+    uint32_t space = Space(w);
+    uint32_t n = bytes < space ? bytes : space;
+    CopyIn(w, static_cast<const uint8_t *>(src), n);
+    writeIndex_->store(w + n, std::memory_order_release);
+    return n;
+  }
+
+  // Producer side: contiguous free region at the write position, for read()-style fills
+  uint32_t WriteRegion(uint8_t **region) const
+  {
+    uint32_t w = writeIndex_->load(std::memory_order_relaxed);
+    uint32_t space = Space(w);
+    uint32_t pos = w & mask_;
+    *region = data_ + pos;
+    return capacity_ - pos < space ? capacity_ - pos : space;
+  }
+
+  // Producer side: publish bytes filled in through WriteRegion()
+  void CommitWrite(uint32_t bytes)
+  {
+    writeIndex_->store(writeIndex_->load(std::memory_order_relaxed) + bytes, std::memory_order_release);
+  }
+
+  void MarkEndOfStream()
+  {
+    flags_->fetch_or(kRingFlagEndOfStream, std::memory_order_release);
+  }
+
+  bool EndOfStream() const
+  {
+    return (flags_->load(std::memory_order_acquire) & kRingFlagEndOfStream) != 0;
+  }
+
+private:
+  // Producer side: free bytes at write index w, leaving the retained history alone.
+  // A backward seek can leave less than the retain size free, hence the clamp.
+  uint32_t Space(uint32_t w) const
+  {
+    uint32_t used = w - readIndex_->load(std::memory_order_acquire) + retain_;
+    return used < capacity_ ? capacity_ - used : 0;
+  }
+
+  void CopyOut(uint32_t index, uint8_t *dst, uint32_t n) const
+  {
+    uint32_t pos = index & mask_;
+    uint32_t first = capacity_ - pos < n ? capacity_ - pos : n;
+    std::memcpy(dst, data_ + pos, first);
+    if (n > first)
+      std::memcpy(dst + first, data_, n - first);
+  }
+
+  void CopyIn(uint32_t index, const uint8_t *src, uint32_t n)
+  {
+    uint32_t pos = index & mask_;
+    uint32_t first = capacity_ - pos < n ? capacity_ - pos : n;
+    std::memcpy(data_ + pos, src, first);
+    if (n > first)
+      std::memcpy(data_, src + first, n - first);
+  }
+
+  std::atomic<uint32_t> *writeIndex_ = nullptr;
+  std::atomic<uint32_t> *readIndex_ = nullptr;
+  std::atomic<uint32_t> *flags_ = nullptr;
+  uint8_t *data_ = nullptr;
+  uint32_t capacity_ = 0;
+  uint32_t retain_ = 0;
+  uint32_t mask_ = 0;
+};
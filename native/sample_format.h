@@ -0,0 +1,159 @@
+// Sample formats supported end to end (openStream/openStreamAsync `sampleFormat`).
+//
+// Streams carry samples in the device format all the way from the decoder to
+// PortAudio. Only stages that actually change samples (mixing, gain ramps) convert
+// to float, one block at a time. Ring-mode voices are always mixed in float, so only
+// bitPerfect streams (voice 0 copied through) and unity-gain writes (ProcessVolume
+// passes them through) reach the device bit-exact.
+#pragma once
+
+#include <portaudio.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "gain.h"
+
+// Parse a format name; accepts PortAudio-style ("int16") and ffmpeg-style ("s16le")
+// names. Returns 0 for unknown names.
+inline PaSampleFormat ParseSampleFormat(const std::string &name)
+{
+  if (name == "float32" || name == "f32le" || name == "float")
+    return paFloat32;
+  if (name == "int16" || name == "s16le")
+    return paInt16;
+  if (name == "int24" || name == "s24le")
+    return paInt24;
+  if (name == "int32" || name == "s32le")
+    return paInt32;
+  return 0;
+}
+
+inline const char *SampleFormatName(PaSampleFormat format)
+{
+  switch (format)
+  {
+  case paInt16:
+    return "int16";
+  case paInt24:
+    return "int24";
+  case paInt32:
+    return "int32";
+  default:
+    return "float32";
+  }
+}
+
+// Bytes per sample; int24 is packed little-endian (3 bytes)
+inline uint32_t BytesPerSample(PaSampleFormat format)
+{
+  switch (format)
+  {
+  case paInt16:
+    return 2;
+  case paInt24:
+    return 3;
+  default:
+    return 4;
+  }
+}
+
+// Decode `count` little-endian samples to float in [-1, 1)
+inline void SamplesToFloat(PaSampleFormat format, const uint8_t *src, float *dst, size_t count)
+{
+  switch (format)
+  {
+  case paInt16:
+    for (size_t i = 0; i < count; ++i)
+    {
+      int16_t v;
+      std::memcpy(&v, src + i * 2, 2);
+      dst[i] = v * (1.0f / 32768.0f);
+    }
+    break;
+  case paInt24:
+    for (size_t i = 0; i < count; ++i)
+    {
+      const uint8_t *p = src + i * 3;
+      int32_t v = static_cast<int32_t>(static_cast<uint32_t>(p[0]) << 8 | static_cast<uint32_t>(p[1]) << 16 | static_cast<uint32_t>(p[2]) << 24) >> 8;
+      dst[i] = v * (1.0f / 8388608.0f);
+    }
+    break;
+  case paInt32:
+    for (size_t i = 0; i < count; ++i)
+    {
+      int32_t v;
+      std::memcpy(&v, src + i * 4, 4);
+      dst[i] = static_cast<float>(v * (1.0 / 2147483648.0));
+    }
+    break;
+  default:
+    std::memcpy(dst, src, count * sizeof(float));
+  }
+}
+
+// Encode `count` floats to the target format, clipping to its range
+inline void FloatToSamples(PaSampleFormat format, const float *src, uint8_t *dst, size_t count)
+{
+  switch (format)
+  {
+  case paInt16:
+    for (size_t i = 0; i < count; ++i)
+    {
+      float s = src[i] * 32768.0f;
+      int16_t v = static_cast<int16_t>(s >= 32767.0f ? 32767 : s <= -32768.0f ? -32768 : static_cast<int32_t>(s));
+      std::memcpy(dst + i * 2, &v, 2);
+    }
+    break;
+  case paInt24:
+    for (size_t i = 0; i < count; ++i)
+    {
+      float s = src[i] * 8388608.0f;
+      int32_t v = s >= 8388607.0f ? 8388607 : s <= -8388608.0f ? -8388608 : static_cast<int32_t>(s);
+      uint8_t *p = dst + i * 3;
+      p[0] = static_cast<uint8_t>(v);
+      p[1] = static_cast<uint8_t>(v >> 8);
+      p[2] = static_cast<uint8_t>(v >> 16);
+    }
+    break;
+  case paInt32:
+    for (size_t i = 0; i < count; ++i)
+    {
+      double s = src[i] * 2147483648.0;
+      int32_t v = s >= 2147483647.0 ? 2147483647 : s <= -2147483648.0 ? INT32_MIN : static_cast<int32_t>(s);
+      std::memcpy(dst + i * 4, &v, 4);
+    }
+    break;
+  default:
+    std::memcpy(dst, src, count * sizeof(float));
+  }
+}
+
+// Apply a volume ramp to interleaved samples of any format. Integer data is passed
+// through untouched at unity gain; otherwise it is converted through `scratch`
+// (at least scratchFrames * channels floats) one block at a time.
+inline void ProcessVolume(VolumeRamp &volume, PaSampleFormat format, const uint8_t *src, uint8_t *dst,
+                          uint32_t frames, int channels, float *scratch, uint32_t scratchFrames)
+{
+  if (format == paFloat32)
+  {
+    volume.Process(reinterpret_cast<const float *>(src), reinterpret_cast<float *>(dst), frames, channels);
+    return;
+  }
+  const size_t frameBytes = static_cast<size_t>(BytesPerSample(format)) * channels;
+  if (volume.IsUnity())
+  {
+    if (src != dst)
+      std::memcpy(dst, src, frames * frameBytes);
+    return;
+  }
+  while (frames > 0)
+  {
+    uint32_t n = frames < scratchFrames ? frames : scratchFrames;
+    SamplesToFloat(format, src, scratch, static_cast<size_t>(n) * channels);
+    volume.Process(scratch, scratch, n, channels);
+    FloatToSamples(format, scratch, dst, static_cast<size_t>(n) * channels);
+    src += n * frameBytes;
+    dst += n * frameBytes;
+    frames -= n;
+  }
+}
@@ -0,0 +1,89 @@
+// Sample-accurate playback clock shared with JavaScript.
+//
+// The audio callback publishes how many frames it has handed to the device and when
+// the first frame of the latest buffer reaches the DAC, into a small ArrayBuffer that
+// JS reads directly (BigUint64Array/Float64Array views) without calling into native
+// code. Writes are wrapped in a seqlock so a reader never sees a torn update. Keep the
+// layout in sync with src/utils/StreamClock.js.
+//
+//   slot 0  sequence        (odd while an update is in progress)
+//   slot 1  framesRendered  device frames written, including silence
+//   slot 2  framesDelivered frames that carried source audio (not paused or underrun padding)
+//   slot 3  framesAtDac     framesDelivered before the latest buffer
+//   slot 4  dacTime         outputBufferDacTime of the latest buffer (float64, stream time)
+//   slot 5  callbackTime    currentTime of the latest callback (float64, stream time)
+//   slot 6  sampleRate      (float64)
+//   slot 7  callbacks
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+static const uint32_t kClockSlots = 8;
+static const uint32_t kClockBytes = kClockSlots * sizeof(uint64_t);
+
+enum ClockSlot : uint32_t
+{
+  kClockSequence = 0,
+  kClockFramesRendered,
+  kClockFramesDelivered,
+  kClockFramesAtDac,
+  kClockDacTime,
+  kClockCallbackTime,
+  kClockSampleRate,
+  kClockCallbacks
+};
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "atomic<uint64_t> must be layout compatible with uint64_t");
+
+class StreamClock
+{
+public:
+  // Bind the clock to caller-owned memory of kClockBytes bytes (8-byte aligned)
+  void Attach(uint8_t *base, double sampleRate)
+  {
+    slots_ = reinterpret_cast<std::atomic<uint64_t> *>(base);
+    rendered_ = delivered_ = callbacks_ = 0;
+    for (uint32_t i = 0; i < kClockSlots; ++i)
+      slots_[i].store(0, std::memory_order_relaxed);
+    StoreDouble(kClockSampleRate, sampleRate);
+  }
+
+  void Detach() { slots_ = nullptr; }
+
+  // Callback: publish a buffer of `frames` device frames, `delivered` of which held audio
+  void Update(uint64_t frames, uint64_t delivered, double dacTime, double callbackTime)
+  {
+    if (!slots_)
+      return;
+    const uint64_t atDac = delivered_;
+    rendered_ += frames;
+    delivered_ += delivered;
+    ++callbacks_;
+    uint64_t seq = slots_[kClockSequence].load(std::memory_order_relaxed);
+    slots_[kClockSequence].store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slots_[kClockFramesRendered].store(rendered_, std::memory_order_relaxed);
+    slots_[kClockFramesDelivered].store(delivered_, std::memory_order_relaxed);
+    slots_[kClockFramesAtDac].store(atDac, std::memory_order_relaxed);
+    StoreDouble(kClockDacTime, dacTime);
+    StoreDouble(kClockCallbackTime, callbackTime);
+    slots_[kClockCallbacks].store(callbacks_, std::memory_order_relaxed);
+    slots_[kClockSequence].store(seq + 2, std::memory_order_release);
+  }
+
+private:
+  void StoreDouble(uint32_t slot, double value)
+  {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    slots_[slot].store(bits, std::memory_order_relaxed);
+  }
+
+  std::atomic<uint64_t> *slots_ = nullptr;
+  // Callback-owned running totals
+  uint64_t rendered_ = 0;
+  uint64_t delivered_ = 0;
+  uint64_t callbacks_ = 0;
+};
@@ -0,0 +1,88 @@
+// Lock-free stream telemetry collected inside the audio callback.
+//
+// Everything here is a relaxed atomic so the callback can record without locks or
+// allocation; getStreamStats() reads a (slightly racy but monotonic) snapshot.
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Upper bounds (exclusive, microseconds) of the histogram buckets; the last bucket
+// collects everything slower
+static const uint32_t kStatsBucketBoundsUs[] = {50, 100, 250, 500, 1000, 2000, 5000, 10000, 20000};
+static const int kStatsBucketCount = sizeof(kStatsBucketBoundsUs) / sizeof(kStatsBucketBoundsUs[0]) + 1;
+
+class TimingHistogram
+{
+public:
+  void Record(uint64_t us)
+  {
+    int bucket = 0;
+    while (bucket < kStatsBucketCount - 1 && us >= kStatsBucketBoundsUs[bucket])
+      ++bucket;
+    counts_[bucket].fetch_add(1, std::memory_order_relaxed);
+    totalUs_.fetch_add(us, std::memory_order_relaxed);
+    samples_.fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = maxUs_.load(std::memory_order_relaxed);
+    while (us > max && !maxUs_.compare_exchange_weak(max, us, std::memory_order_relaxed))
+    {
+    }
+  }
+
+  uint64_t Count(int bucket) const { return counts_[bucket].load(std::memory_order_relaxed); }
+  uint64_t Samples() const { return samples_.load(std::memory_order_relaxed); }
+  uint64_t MaxUs() const { return maxUs_.load(std::memory_order_relaxed); }
+  double MeanUs() const
+  {
+    uint64_t n = Samples();
+    return n ? static_cast<double>(totalUs_.load(std::memory_order_relaxed)) / n : 0.0;
+  }
+
+private:
+  std::atomic<uint64_t> counts_[kStatsBucketCount] = {};
+  std::atomic<uint64_t> totalUs_{0};
+  std::atomic<uint64_t> samples_{0};
+  std::atomic<uint64_t> maxUs_{0};
+};
+
+struct StreamStats
+{
+  std::atomic<uint64_t> callbacks{0};
+  std::atomic<uint64_t> underflows{0};
+  std::atomic<uint64_t> overflows{0};
+  // Duplex streams: input the device dropped, and captured frames the capture ring had no
+  // room for (JS drained it too slowly)
+  std::atomic<uint64_t> inputOverflows{0};
+  std::atomic<uint64_t> captureDroppedFrames{0};
+  // Frames of silence substituted because a source had no data ready (ring mode)
+  std::atomic<uint64_t> starvedFrames{0};
+  // Callbacks that substituted any silence, i.e. audible dropouts
+  std::atomic<uint64_t> starvedCallbacks{0};
+  // Frames in the most recent callback (the host's period when framesPerBuffer is unspecified)
+  std::atomic<uint32_t> lastFrameCount{0};
+  // Steady-clock time the most recent callback started (SteadyMicros), 0 before the first
+  std::atomic<int64_t> lastCallbackUs{0};
+  // Wall time of each callback
+  TimingHistogram callbackTime;
+  // Time each callback spent waiting for its data (the JS round trip in callback mode)
+  TimingHistogram waitTime;
+};
+
+inline void RecordStarved(StreamStats &stats, uint64_t frames)
+{
+  stats.starvedFrames.fetch_add(frames, std::memory_order_relaxed);
+  stats.starvedCallbacks.fetch_add(1, std::memory_order_relaxed);
+}
+
+// A steady-clock time point in microseconds, for publishing through an atomic
+inline int64_t SteadyMicros(std::chrono::steady_clock::time_point t)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+
+// Microseconds elapsed since `start`, using the monotonic clock (no syscalls on common platforms)
+inline uint64_t ElapsedUs(std::chrono::steady_clock::time_point start)
+{
+  return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+}
@@ -0,0 +1,220 @@
+// Background writer for blocking-API streams.
+//
+// writeStreamAsync() copies samples (in the stream's sample format) into this queue on the main thread and returns;
+// a dedicated thread moves them to the device in pieces no larger than
+// Pa_GetStreamWriteAvailable(), so Pa_WriteStream never blocks the event loop.
+// The queue has a Writable-style high-water mark: once it is exceeded the producer
+// is told to wait, and the drain callback fires when the queue falls below it again.
+#pragma once
+
+#include <portaudio.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "analysis.h"
+#include "gain.h"
+#include "sample_format.h"
+
+class StreamWriter
+{
+public:
+  // Called on the writer thread when the queue falls below the high-water mark after a
+  // producer was told to wait, and when the device reports a fatal error
+  using Notify = std::function<void()>;
+
+  ~StreamWriter() { Stop(); }
+
+  // threadStart, if given, runs first on the writer thread (e.g. to raise its priority)
+  void Start(PaStream *stream, int channels, PaSampleFormat format, VolumeRamp *volume, AnalysisTap *tap,
+             size_t highWaterMarkBytes, Notify notify, Notify threadStart = nullptr)
+  {
+    stream_ = stream;
+    channels_ = channels;
+    format_ = format;
+    bytesPerFrame_ = channels * BytesPerSample(format);
+    volume_ = volume;
+    tap_ = tap;
+    highWaterMark_ = highWaterMarkBytes;
+    notify_ = std::move(notify);
+    threadStart_ = std::move(threadStart);
+    stop_ = false;
+    thread_ = std::thread(&StreamWriter::Run, this);
+  }
+
+  // Stop the thread; samples that have not been written yet are discarded
+  void Stop()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable())
+      thread_.join();
+    chunks_.clear();
+    queuedBytes_ = 0;
+  }
+
+  bool Running() const { return thread_.joinable(); }
+
+  // Main thread: queue interleaved sample bytes. Returns true while the queue is below
+  // the high-water mark; false means the producer should wait for the drain callback
+  bool Enqueue(const uint8_t *data, size_t bytes)
+  {
+    bool below;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      chunks_.emplace_back(data, data + bytes);
+      queuedBytes_ += bytes;
+      below = queuedBytes_ < highWaterMark_;
+      if (!below)
+        needDrain_ = true;
+    }
+    cv_.notify_one();
+    return below;
+  }
+
+  size_t QueuedBytes() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queuedBytes_;
+  }
+
+  bool NeedDrain() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return needDrain_;
+  }
+
+  size_t HighWaterMark() const { return highWaterMark_; }
+
+  // Last fatal PortAudio error, paNoError while the writer is healthy
+  PaError Error() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+  }
+
+private:
+  void Run()
+  {
+    if (threadStart_)
+      threadStart_();
+    const size_t scratchFrames = 4096;
+    std::vector<uint8_t> scratch(scratchFrames * bytesPerFrame_);
+    std::vector<float> floatScratch(scratchFrames * channels_);
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]
+                 { return stop_ || queuedBytes_ > 0; });
+        if (stop_)
+          return;
+      }
+      signed long writable = Pa_GetStreamWriteAvailable(stream_);
+      if (writable < 0)
+      {
+        Fail(static_cast<PaError>(writable));
+        return;
+      }
+      if (writable == 0)
+      {
+        // Device buffer is full; it drains at the hardware rate
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        continue;
+      }
+      size_t frames = std::min<size_t>(static_cast<size_t>(writable), scratchFrames);
+      bool drained = false;
+      bool partialFrame = false;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frames = std::min(frames, queuedBytes_ / bytesPerFrame_);
+        TakeLocked(scratch.data(), frames * bytesPerFrame_);
+        partialFrame = frames == 0;
+        if (needDrain_ && queuedBytes_ < highWaterMark_)
+        {
+          needDrain_ = false;
+          drained = true;
+        }
+      }
+      if (frames > 0)
+      {
+        ProcessVolume(*volume_, format_, scratch.data(), scratch.data(), static_cast<uint32_t>(frames), channels_,
+                      floatScratch.data(), static_cast<uint32_t>(scratchFrames));
+        if (tap_)
+          tap_->Feed(scratch.data(), static_cast<uint32_t>(frames));
+        PaError err = Pa_WriteStream(stream_, scratch.data(), static_cast<unsigned long>(frames));
+        // Underflow is reported but not fatal: the device simply played silence
+        if (err != paNoError && err != paOutputUnderflowed)
+        {
+          Fail(err);
+          return;
+        }
+      }
+      else if (partialFrame)
+      {
+        // Less than one frame queued; wait for the rest of it
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      if (drained && notify_)
+        notify_();
+    }
+  }
+
+  // Copy `count` bytes off the front of the queue (mutex held)
+  void TakeLocked(uint8_t *dst, size_t count)
+  {
+    while (count > 0)
+    {
+      std::vector<uint8_t> &front = chunks_.front();
+      size_t n = std::min(count, front.size() - headOffset_);
+      std::memcpy(dst, front.data() + headOffset_, n);
+      dst += n;
+      count -= n;
+      queuedBytes_ -= n;
+      headOffset_ += n;
+      if (headOffset_ == front.size())
+      {
+        chunks_.pop_front();
+        headOffset_ = 0;
+      }
+    }
+  }
+
+  void Fail(PaError err)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      error_ = err;
+    }
+    if (notify_)
+      notify_();
+  }
+
+  PaStream *stream_ = nullptr;
+  int channels_ = 2;
+  PaSampleFormat format_ = paFloat32;
+  size_t bytesPerFrame_ = 2 * sizeof(float);
+  VolumeRamp *volume_ = nullptr;
+  AnalysisTap *tap_ = nullptr;
+  size_t highWaterMark_ = 0;
+  Notify notify_;
+  Notify threadStart_;
+  std::thread thread_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::vector<uint8_t>> chunks_;
+  size_t headOffset_ = 0;
+  size_t queuedBytes_ = 0;
+  bool needDrain_ = false;
+  bool stop_ = false;
+  PaError error_ = paNoError;
+};
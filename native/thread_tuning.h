@@ -0,0 +1,164 @@
+// Real-time scheduling, CPU pinning and page locking for the audio path (the realtime,
+// realtimePriority, cpu and lockMemory stream options).
+//
+// PortAudio owns the callback thread, so the stream promotes it from inside its first
+// callback; feeder threads (decoder readers, the blocking writer) promote themselves as
+// they start, one step below the callback. Linux uses SCHED_FIFO, Windows MMCSS "Pro
+// Audio" and macOS the time-constraint policy. Everything is best effort: a refused
+// request leaves the thread as it was and is reported, never fatal.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#if defined(_WIN32)
+#include <windows.h>
+#include <avrt.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+static const int kDefaultRealtimePriority = 70;
+// Feeder threads run this many SCHED_FIFO steps below the callback
+static const int kFeederPriorityOffset = 10;
+
+struct ThreadTuning
+{
+  bool realtime = false;
+  // SCHED_FIFO priority of the callback thread on Linux (1-99)
+  int priority = kDefaultRealtimePriority;
+  // CPU the audio threads are pinned to, or -1
+  int cpu = -1;
+  bool lockMemory = false;
+  // Callback period, the basis of the macOS time constraint
+  double periodSeconds = 0.005;
+
+  bool Requested() const { return realtime || cpu >= 0; }
+};
+
+enum ThreadTuningStatus
+{
+  kTuningOff = 0,
+  kTuningPending,
+  kTuningApplied,
+  kTuningDenied
+};
+
+inline const char *ThreadTuningStatusName(int status)
+{
+  switch (status)
+  {
+  case kTuningPending:
+    return "pending";
+  case kTuningApplied:
+    return "applied";
+  case kTuningDenied:
+    return "denied";
+  default:
+    return "off";
+  }
+}
+
+// Apply the tuning to the calling thread; feeders get a lower priority and a looser
+// time constraint. Returns false if any part was refused (typically for lack of
+// privileges: RLIMIT_RTPRIO on Linux)
+inline bool TuneCurrentThread(const ThreadTuning &tuning, bool feeder)
+{
+  bool ok = true;
+#if defined(_WIN32)
+  if (tuning.realtime)
+  {
+    DWORD taskIndex = 0;
+    // Reverted by the system when the thread exits
+    HANDLE task = AvSetMmThreadCharacteristicsW(L"Pro Audio", &taskIndex);
+    if (!task || !AvSetMmThreadPriority(task, feeder ? AVRT_PRIORITY_HIGH : AVRT_PRIORITY_CRITICAL))
+      ok = false;
+  }
+  if (tuning.cpu >= 0 && tuning.cpu < static_cast<int>(sizeof(DWORD_PTR) * 8))
+  {
+    if (SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << tuning.cpu) == 0)
+      ok = false;
+  }
+#elif defined(__APPLE__)
+  const thread_port_t thread = pthread_mach_thread_np(pthread_self());
+  if (tuning.realtime)
+  {
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    const double ticksPerSecond = 1e9 * timebase.denom / timebase.numer;
+    // Feeders only have to keep the rings ahead, a few periods at a time
+    const double period = tuning.periodSeconds * (feeder ? 4.0 : 1.0);
+    thread_time_constraint_policy_data_t policy;
+    policy.period = static_cast<uint32_t>(period * ticksPerSecond);
+    policy.computation = static_cast<uint32_t>(period * (feeder ? 0.25 : 0.5) * ticksPerSecond);
+    policy.constraint = policy.period;
+    policy.preemptible = 1;
+    if (thread_policy_set(thread, THREAD_TIME_CONSTRAINT_POLICY, reinterpret_cast<thread_policy_t>(&policy),
+                          THREAD_TIME_CONSTRAINT_POLICY_COUNT) != KERN_SUCCESS)
+      ok = false;
+  }
+  if (tuning.cpu >= 0)
+  {
+    // macOS cannot pin threads; an affinity tag only asks for the audio threads to share
+    // a cache, and is unsupported on Apple silicon, so it is not treated as refused
+    thread_affinity_policy_data_t affinity = {tuning.cpu + 1};
+    thread_policy_set(thread, THREAD_AFFINITY_POLICY, reinterpret_cast<thread_policy_t>(&affinity), THREAD_AFFINITY_POLICY_COUNT);
+  }
+#else
+  if (tuning.realtime)
+  {
+    sched_param param = {};
+    const int offset = feeder ? kFeederPriorityOffset : 0;
+    param.sched_priority = std::max(std::min(tuning.priority - offset, sched_get_priority_max(SCHED_FIFO)), sched_get_priority_min(SCHED_FIFO));
+    int policy = SCHED_FIFO;
+#ifdef SCHED_RESET_ON_FORK
+    // Processes spawned from the thread (none today) must not inherit real-time priority
+    policy |= SCHED_RESET_ON_FORK;
+#endif
+    // pid 0 is the calling thread
+    if (sched_setscheduler(0, policy, &param) != 0)
+      ok = false;
+  }
+  if (tuning.cpu >= 0 && tuning.cpu < CPU_SETSIZE)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(tuning.cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+      ok = false;
+  }
+#endif
+  return ok;
+}
+
+// Keep a buffer's pages resident so the callback never faults on them (limited by
+// RLIMIT_MEMLOCK, or the working set size on Windows)
+inline bool LockPages(const void *data, size_t bytes)
+{
+  if (!data || bytes == 0)
+    return true;
+#if defined(_WIN32)
+  return VirtualLock(const_cast<void *>(data), bytes) != 0;
+#else
+  return mlock(data, bytes) == 0;
+#endif
+}
+
+inline void UnlockPages(const void *data, size_t bytes)
+{
+  if (!data || bytes == 0)
+    return;
+#if defined(_WIN32)
+  VirtualUnlock(const_cast<void *>(data), bytes);
+#else
+  munlock(data, bytes);
+#endif
+}
@@ -0,0 +1,226 @@
+// In-process decoding of RIFF/WAVE files (see AttachDecoder in portaudio.cc).
+//
+// WAV is the one common format whose samples can be read without a codec, so it is
+// decoded natively instead of through an ffmpeg process: no spawn or probe before the
+// first sample, and no pipe. Everything else still goes to ffmpeg.
+//
+// Supported: PCM 8/16/24/32-bit and IEEE float 32/64-bit, including
+// WAVE_FORMAT_EXTENSIBLE. When the file already holds the stream's sample format and
+// channel count the data is copied untouched, so bit-perfect playback stays exact.
+#pragma once
+
+#include <portaudio.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#ifndef _WIN32
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#endif
+#include "pcm_cache.h"
+#include "ring_buffer.h"
+#include "sample_format.h"
+
+// Bytes read from the start of the file when looking for the fmt and data chunks
+static const uint32_t kWavProbeBytes = 64 * 1024;
+
+struct WavFormat
+{
+  uint32_t sampleRate = 0;
+  uint32_t channels = 0;
+  uint32_t bitsPerSample = 0;
+  // Bytes per sample in the file (container size; 24-bit is packed)
+  uint32_t sampleBytes = 0;
+  bool isFloat = false;
+  uint64_t dataOffset = 0;
+  uint64_t frames = 0;
+
+  uint32_t FrameBytes() const { return sampleBytes * channels; }
+};
+
+inline uint16_t ReadLE16(const uint8_t *p)
+{
+  return static_cast<uint16_t>(p[0] | p[1] << 8);
+}
+
+// Parse the header of a WAVE file from its first `size` bytes. `fileSize` bounds the
+// data chunk (streamed files often leave its size unset). False if the file is not a
+// WAVE file this decoder handles, or its data chunk starts beyond `size`.
+inline bool ParseWavHeader(const uint8_t *data, size_t size, uint64_t fileSize, WavFormat *format)
+{
+  if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0)
+    return false;
+  bool haveFmt = false;
+  uint16_t tag = 0;
+  size_t pos = 12;
+  while (pos + 8 <= size)
+  {
+    const uint8_t *chunk = data + pos;
+    const uint32_t chunkBytes = ReadLE32(chunk + 4);
+    if (std::memcmp(chunk, "fmt ", 4) == 0)
+    {
+      if (chunkBytes < 16 || pos + 8 + 16 > size)
+        return false;
+      const uint8_t *fmt = chunk + 8;
+      tag = ReadLE16(fmt);
+      format->channels = ReadLE16(fmt + 2);
+      format->sampleRate = ReadLE32(fmt + 4);
+      const uint16_t blockAlign = ReadLE16(fmt + 12);
+      format->bitsPerSample = ReadLE16(fmt + 14);
+      // WAVE_FORMAT_EXTENSIBLE: the real format is the first two bytes of the sub-format GUID
+      if (tag == 0xFFFE)
+      {
+        if (chunkBytes < 40 || pos + 8 + 40 > size)
+          return false;
+        tag = ReadLE16(fmt + 24);
+      }
+      if (format->channels == 0 || format->sampleRate == 0 || blockAlign % format->channels != 0)
+        return false;
+      format->sampleBytes = blockAlign / format->channels;
+      haveFmt = true;
+    }
+    else if (std::memcmp(chunk, "data", 4) == 0)
+    {
+      if (!haveFmt)
+        return false;
+      format->dataOffset = pos + 8;
+      if (format->dataOffset > fileSize)
+        return false;
+      uint64_t dataBytes = std::min<uint64_t>(chunkBytes, fileSize - format->dataOffset);
+      // A size of 0 or ~0 marks a stream written before its length was known
+      if (chunkBytes == 0 || chunkBytes == 0xFFFFFFFFu)
+        dataBytes = fileSize - format->dataOffset;
+      // 1 = PCM, 3 = IEEE float
+      if (tag == 1)
+        format->isFloat = false;
+      else if (tag == 3)
+        format->isFloat = true;
+      else
+        return false;
+      const uint32_t bits = format->bitsPerSample;
+      const bool pcmOk = !format->isFloat && (bits == 8 || bits == 16 || bits == 24 || bits == 32) && format->sampleBytes == bits / 8;
+      const bool floatOk = format->isFloat && (bits == 32 || bits == 64) && format->sampleBytes == bits / 8;
+      if (!pcmOk && !floatOk)
+        return false;
+      format->frames = dataBytes / format->FrameBytes();
+      return true;
+    }
+    // Chunks are padded to an even size
+    pos += 8 + static_cast<size_t>(chunkBytes) + (chunkBytes & 1);
+  }
+  return false;
+}
+
+// The stream sample format matching the file's samples byte for byte, or 0
+inline PaSampleFormat WavNativeFormat(const WavFormat &format)
+{
+  if (format.isFloat)
+    return format.bitsPerSample == 32 ? paFloat32 : 0;
+  switch (format.bitsPerSample)
+  {
+  case 16:
+    return paInt16;
+  case 24:
+    return paInt24;
+  case 32:
+    return paInt32;
+  default:
+    return 0;
+  }
+}
+
+// Whether frames of this file can be converted for a stream with `channels` channels
+// (same layout, or mono spread to every channel)
+inline bool WavCanConvert(const WavFormat &format, int channels)
+{
+  return static_cast<int>(format.channels) == channels || format.channels == 1;
+}
+
+// Convert `frames` frames of file data to the stream format. `scratch` holds at least
+// frames * channels floats and is only used when the samples need converting.
+inline void ConvertWavFrames(const WavFormat &format, const uint8_t *src, PaSampleFormat dstFormat, int channels,
+                             uint8_t *dst, size_t frames, float *scratch)
+{
+  const PaSampleFormat srcFormat = WavNativeFormat(format);
+  const size_t srcSamples = frames * format.channels;
+  if (srcFormat == dstFormat && static_cast<int>(format.channels) == channels)
+  {
+    std::memcpy(dst, src, srcSamples * format.sampleBytes);
+    return;
+  }
+  if (srcFormat != 0)
+  {
+    SamplesToFloat(srcFormat, src, scratch, srcSamples);
+  }
+  else if (format.isFloat)
+  {
+    for (size_t i = 0; i < srcSamples; ++i)
+    {
+      double v;
+      std::memcpy(&v, src + i * 8, 8);
+      scratch[i] = static_cast<float>(v);
+    }
+  }
+  else
+  {
+    // 8-bit WAV is unsigned
+    for (size_t i = 0; i < srcSamples; ++i)
+      scratch[i] = (static_cast<int>(src[i]) - 128) * (1.0f / 128.0f);
+  }
+  if (static_cast<int>(format.channels) != channels)
+  {
+    // Mono: spread in place, back to front so no sample is overwritten before it is read
+    for (size_t f = frames; f-- > 0;)
+    {
+      const float s = scratch[f];
+      for (int c = channels; c-- > 0;)
+        scratch[f * channels + c] = s;
+    }
+  }
+  FloatToSamples(dstFormat, scratch, dst, frames * channels);
+}
+
+#ifndef _WIN32
+// Decodes a WAVE file into a voice ring, one block of frames at a time, then closes it
+inline void WavDecoderLoop(PcmRing *ring, std::atomic<bool> *stop, int fd, WavFormat format, uint64_t frame,
+                           PaSampleFormat dstFormat, int channels)
+{
+  const uint32_t kDecodeFrames = 4096;
+  const uint32_t srcFrameBytes = format.FrameBytes();
+  const uint32_t dstFrameBytes = channels * BytesPerSample(dstFormat);
+  // A small ring never has a whole block free, so blocks shrink to what it can hold
+  const uint32_t blockFrames = std::max<uint32_t>(1, std::min(kDecodeFrames, ring->MaxWriteAvailable() / dstFrameBytes));
+  std::vector<uint8_t> src(static_cast<size_t>(blockFrames) * srcFrameBytes);
+  std::vector<uint8_t> dst(static_cast<size_t>(blockFrames) * dstFrameBytes);
+  std::vector<float> scratch(static_cast<size_t>(blockFrames) * std::max<uint32_t>(channels, format.channels));
+  while (frame < format.frames && !stop->load(std::memory_order_relaxed))
+  {
+    uint32_t frames = static_cast<uint32_t>(std::min<uint64_t>({ring->WriteAvailable() / dstFrameBytes, blockFrames, format.frames - frame}));
+    // Wait for room for a whole block (or the tail) rather than decoding in slivers
+    if (frames < std::min<uint64_t>(blockFrames, format.frames - frame))
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      continue;
+    }
+    const off_t offset = static_cast<off_t>(format.dataOffset + frame * srcFrameBytes);
+    ssize_t n = pread(fd, src.data(), static_cast<size_t>(frames) * srcFrameBytes, offset);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break; // truncated file or read error: play what we have
+    frames = static_cast<uint32_t>(n / srcFrameBytes);
+    if (frames == 0)
+      break;
+    ConvertWavFrames(format, src.data(), dstFormat, channels, dst.data(), frames, scratch.data());
+    ring->Write(dst.data(), frames * dstFrameBytes);
+    frame += frames;
+  }
+  close(fd);
+  ring->MarkEndOfStream();
+}
+#endif
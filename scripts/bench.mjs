@@ -0,0 +1,239 @@
+/**
+ * @file Latency and throughput benchmarks for the native binding, against the null device.
+ * @author zevinDev
+ *
+ * Build the portaudio_bench target first (npm run rebuild builds both addons), then:
+ *   node scripts/bench.mjs [--duration=2] [--json]
+ *
+ * The bench addon is portaudio.cc linked against a simulated output device (see
+ * native/bench/null_device.h), so results do not depend on audio hardware. It reports:
+ *   - callback and ring-mode streams: time to fill each period (p50/p99/p999), callback
+ *     start jitter, late callbacks and starved frames, with the event loop idle and busy
+ *   - blocking streams: writeStream() throughput per sample format and buffer size
+ */
+
+import { createRequire } from 'module';
+import path from 'path';
+import { fileURLToPath } from 'url';
+import { PcmRingWriter } from '../src/utils/RingBuffer.js';
+
+const require = createRequire(import.meta.url);
+const __dirname = path.dirname(fileURLToPath(import.meta.url));
+const ADDON_PATH = path.join(__dirname, '../build/Release/bench/portaudio_bench.node');
+
+const SAMPLE_RATE = 48000;
+const CHANNELS = 2;
+const BUFFER_SIZES = [64, 128, 256, 512, 1024];
+// Share of every 10 ms the event loop spends busy (synthetic application load)
+const LOAD_LEVELS = [0, 0.5, 0.9];
+const SAMPLE_FORMATS = [
+  { name: 'float32', bytes: 4 },
+  { name: 'int16', bytes: 2 },
+  { name: 'int24', bytes: 3 },
+  { name: 'int32', bytes: 4 }
+];
+
+const args = Object.fromEntries(process.argv.slice(2).map(arg => {
+  const [key, value = 'true'] = arg.replace(/^--/, '').split('=');
+  return [key, value];
+}));
+const durationSec = Number(args.duration) > 0 ? Number(args.duration) : 2;
+
+/**
+ * Block the event loop for `load` of every 10 ms until stopped.
+ *
+ * @param {number} load - Busy share, 0 to 1.
+ * @returns {Function} Stops the load.
+ * @author zevinDev
+ */
+function startEventLoopLoad(load) {
+  if (load <= 0) return () => {};
+  const timer = setInterval(() => {
+    const until = performance.now() + 10 * load;
+    while (performance.now() < until) {
+      // Busy
+    }
+  }, 10);
+  return () => clearInterval(timer);
+}
+
+const sleep = ms => new Promise(resolve => setTimeout(resolve, ms));
+
+/**
+ * Play a sine through a callback-mode stream under event-loop load.
+ *
+ * @param {object} portaudio - Bench binding.
+ * @param {number} framesPerBuffer - Period size.
+ * @param {number} load - Event-loop load.
+ * @returns {Promise<object>} Result row.
+ * @author zevinDev
+ */
+async function benchCallback(portaudio, framesPerBuffer, load) {
+  let phase = 0;
+  const step = 2 * Math.PI * 440 / SAMPLE_RATE;
+  const callback = (buffer, frames) => {
+    for (let i = 0; i < frames * CHANNELS; i += CHANNELS) {
+      const sample = 0.25 * Math.sin(phase);
+      phase += step;
+      for (let c = 0; c < CHANNELS; ++c) buffer[i + c] = sample;
+    }
+    return frames;
+  };
+  portaudio.configureNullDevice({ realtime: true });
+  const streamId = await portaudio.openStreamAsync({ device: 0, channels: CHANNELS, sampleRate: SAMPLE_RATE, framesPerBuffer }, callback);
+  return measureStream(portaudio, streamId, 'callback', framesPerBuffer, load);
+}
+
+/**
+ * Play a sine through a ring-mode stream fed by a timer, under event-loop load.
+ *
+ * @param {object} portaudio - Bench binding.
+ * @param {number} framesPerBuffer - Period size.
+ * @param {number} load - Event-loop load.
+ * @returns {Promise<object>} Result row.
+ * @author zevinDev
+ */
+async function benchRing(portaudio, framesPerBuffer, load) {
+  portaudio.configureNullDevice({ realtime: true });
+  const streamId = await portaudio.openStreamAsync({ device: 0, channels: CHANNELS, sampleRate: SAMPLE_RATE, framesPerBuffer });
+  const ring = new PcmRingWriter(portaudio.getStreamRing(streamId, 0), CHANNELS * 4);
+  const chunk = new Float32Array(SAMPLE_RATE / 10 * CHANNELS);
+  for (let i = 0; i < chunk.length; i += CHANNELS) {
+    chunk[i] = chunk[i + 1] = 0.25 * Math.sin(2 * Math.PI * 440 * (i / CHANNELS) / SAMPLE_RATE);
+  }
+  // Like pipeToRing: top the ring up from the event loop
+  const pump = setInterval(() => {
+    const frames = Math.min(ring.writeAvailable(), chunk.length / CHANNELS);
+    if (frames > 0) ring.write(chunk.subarray(0, frames * CHANNELS));
+  }, 5);
+  try {
+    return await measureStream(portaudio, streamId, 'ring', framesPerBuffer, load);
+  } finally {
+    clearInterval(pump);
+  }
+}
+
+/**
+ * Let a started stream settle, run it under load for the duration and close it.
+ *
+ * @param {object} portaudio - Bench binding.
+ * @param {number} streamId - Open stream.
+ * @param {string} mode - Label.
+ * @param {number} framesPerBuffer - Period size.
+ * @param {number} load - Event-loop load.
+ * @returns {Promise<object>} Result row.
+ * @author zevinDev
+ */
+async function measureStream(portaudio, streamId, mode, framesPerBuffer, load) {
+  try {
+    await sleep(200);
+    portaudio.getBenchReport(streamId);
+    const starvedBefore = portaudio.getStreamStats(streamId).starvedFrames;
+    const stopLoad = startEventLoopLoad(load);
+    await sleep(durationSec * 1000);
+    stopLoad();
+    const report = portaudio.getBenchReport(streamId);
+    const stats = portaudio.getStreamStats(streamId);
+    const starvedFrames = stats.starvedFrames - starvedBefore;
+    const playedFrames = report.callbacks * framesPerBuffer;
+    return {
+      mode,
+      framesPerBuffer,
+      load,
+      budgetUs: Math.round(stats.bufferBudgetUs),
+      fillP50: report.fillUs.p50,
+      fillP99: report.fillUs.p99,
+      fillP999: report.fillUs.p999,
+      jitterP99: report.jitterUs.p99,
+      late: report.lateCallbacks,
+      callbacks: report.callbacks,
+      underrunRate: playedFrames > 0 ? starvedFrames / playedFrames : 0
+    };
+  } finally {
+    portaudio.closeStream(streamId);
+  }
+}
+
+/**
+ * Write silence to a blocking stream as fast as the device accepts it.
+ *
+ * @param {object} portaudio - Bench binding.
+ * @param {object} format - Sample format entry.
+ * @param {number} framesPerBuffer - Frames per writeStream() call.
+ * @returns {object} Result row.
+ * @author zevinDev
+ */
+function benchWrite(portaudio, format, framesPerBuffer) {
+  portaudio.configureNullDevice({ realtime: false });
+  const streamId = portaudio.openStream(0, SAMPLE_RATE, CHANNELS, framesPerBuffer, { sampleFormat: format.name });
+  try {
+    const buffer = Buffer.alloc(framesPerBuffer * CHANNELS * format.bytes);
+    portaudio.writeStream(buffer, streamId);
+    portaudio.getBenchReport(streamId);
+    const start = performance.now();
+    let calls = 0;
+    while (performance.now() - start < durationSec * 250) {
+      for (let i = 0; i < 64; ++i) portaudio.writeStream(buffer, streamId);
+      calls += 64;
+    }
+    const seconds = (performance.now() - start) / 1000;
+    const framesPerSecond = calls * framesPerBuffer / seconds;
+    return {
+      mode: 'blocking',
+      sampleFormat: format.name,
+      framesPerBuffer,
+      callsPerSecond: Math.round(calls / seconds),
+      realtimeFactor: Math.round(framesPerSecond / SAMPLE_RATE),
+      MBps: Math.round(framesPerSecond * CHANNELS * format.bytes / 1e6)
+    };
+  } finally {
+    portaudio.closeStream(streamId);
+  }
+}
+
+/**
+ * Run every benchmark and print the tables.
+ *
+ * @returns {Promise<void>}
+ * @author zevinDev
+ */
+async function main() {
+  let portaudio;
+  try {
+    portaudio = require(ADDON_PATH);
+  } catch (error) {
+    console.error(`Cannot load ${ADDON_PATH}: ${error.message}\nBuild it with: npm run rebuild`);
+    process.exit(1);
+  }
+  await portaudio.init();
+  const streaming = [];
+  const blocking = [];
+  try {
+    for (const framesPerBuffer of BUFFER_SIZES) {
+      for (const load of LOAD_LEVELS) {
+        streaming.push(await benchCallback(portaudio, framesPerBuffer, load));
+        streaming.push(await benchRing(portaudio, framesPerBuffer, load));
+      }
+    }
+    for (const format of SAMPLE_FORMATS) {
+      for (const framesPerBuffer of BUFFER_SIZES) {
+        blocking.push(benchWrite(portaudio, format, framesPerBuffer));
+      }
+    }
+  } finally {
+    portaudio.terminate();
+  }
+  if (args.json) {
+    console.log(JSON.stringify({ durationSec, streaming, blocking }, null, 2));
+    return;
+  }
+  console.log(`Streaming (${SAMPLE_RATE} Hz, ${CHANNELS} ch, ${durationSec} s per row; times in us)`);
+  console.table(streaming);
+  console.log('Blocking writeStream() throughput (null device, unpaced)');
+  console.table(blocking);
+}
+
+main().catch(error => {
+  console.error(error);
+  process.exit(1);
+});
@@ -8,6 +8,15 @@ import { spawn } from 'node:child_process';
 import { buildFFmpegArgs, createFFmpegProcess, killFFmpegProcess } from '../utils/FFmpegUtils.js';
 import { mixCrossfade, validateCrossfadeCurve, durationToFrames } from '../utils/AudioUtils.js';
 import { handleError } from '../utils/ErrorHandler.js';
+import { PcmPrebuffer, pipeToPrebuffer } from '../utils/Prebuffer.js';
+
+// Decoded audio held ahead for the next track unless a cap is given
+const DEFAULT_PREBUFFER_SECONDS = 30;
+const BYTES_PER_SAMPLE = { f32le: 4, s16le: 2, s24le: 3, s32le: 4 };
+// Native DSP chain limits (see native/dsp.h)
+const EQ_BAND_TYPES = ['peaking', 'lowshelf', 'highshelf', 'lowpass', 'highpass'];
+const MAX_EQ_BANDS = 16;
+const MAX_DSP_CHANNELS = 8;
 
 /**
  * AudioEffects handles advanced audio processing features.
@@ -21,13 +30,20 @@ export class AudioEffects {
     this._bitPerfect = false;
     this._bitPerfectSampleRate = undefined;
     this._bitPerfectBitDepth = undefined;
+    this._bitPerfectExclusive = true;
     this._crossfadeDuration = 3; // Default crossfade duration in seconds
     this._crossfadeCurve = 'linear'; // Default crossfade curve
     
     // Gapless playback state
     this._gaplessNextFfmpeg = null;
-    this._gaplessNextPcmBuffers = null;
+    this._gaplessNextPrebuffer = null;
+    this._gaplessNextPump = null;
     this._gaplessNextTrackReady = false;
+
+    // Native output DSP: EQ bands, channel matrix and limiter (null = off)
+    this._eqBands = [];
+    this._channelMatrix = null;
+    this._limiter = null;
   }
 
   /**
@@ -35,7 +51,10 @@ export class AudioEffects {
    * When enabled, disables all PCM manipulation (volume, crossfade, gapless, visualization, etc.).
    * 
    * @param {boolean|object} options - Pass `true` to enable, `false` to disable, or an object:
-   *   { enable: boolean, sampleRate?: number, bitDepth?: number }
+   *   { enable: boolean, sampleRate?: number, bitDepth?: number, exclusive?: boolean }.
+   *   `exclusive` (default true) asks for exclusive device access where the host API
+   *   has it (WASAPI exclusive mode, CoreAudio device format changes), bypassing the
+   *   system mixer.
    * @returns {object} Configuration result
    * @throws {Error} If configuration fails
    * @author zevinDev
@@ -43,16 +62,19 @@ export class AudioEffects {
   setBitPerfect(options = true) {
     try {
       let enable, sampleRate, bitDepth;
+      let exclusive = true;
       
       if (typeof options === 'object') {
         enable = !!options.enable;
         sampleRate = options.sampleRate;
         bitDepth = options.bitDepth;
+        exclusive = options.exclusive !== false;
       } else {
         enable = !!options;
       }
       
       this._bitPerfect = enable;
+      this._bitPerfectExclusive = exclusive;
       
       if (enable) {
         if (sampleRate) this._bitPerfectSampleRate = sampleRate;
@@ -66,6 +88,7 @@ export class AudioEffects {
         enabled: this._bitPerfect,
         sampleRate: this._bitPerfectSampleRate,
         bitDepth: this._bitPerfectBitDepth,
+        exclusive: this._bitPerfectExclusive,
         requiresRestart: true
       };
     } catch (error) {
@@ -84,6 +107,16 @@ export class AudioEffects {
     return this._bitPerfect;
   }
 
+  /**
+   * Check if bit-perfect streams should take exclusive access to the device.
+   *
+   * @returns {boolean} True if bit-perfect mode is enabled with exclusive access
+   * @author zevinDev
+   */
+  isExclusiveBitPerfect() {
+    return this._bitPerfect && this._bitPerfectExclusive;
+  }
+
   /**
    * Set the crossfade duration for crossfade transitions.
    * 
@@ -132,64 +165,169 @@ export class AudioEffects {
     };
   }
 
+  /**
+   * Set the parametric EQ run by the native output DSP chain. Replaces all bands.
+   * 
+   * @param {object[]} bands - Up to 16 bands: { type?: 'peaking'|'lowshelf'|'highshelf'|'lowpass'|'highpass', frequency: number, q?: number, gain?: number (dB) }; [] for none
+   * @throws {Error} If a band is invalid or in bit-perfect mode
+   * @author zevinDev
+   */
+  setEqualizer(bands = []) {
+    if (this._bitPerfect) {
+      throw new Error('EQ is not supported in bit-perfect mode.');
+    }
+    if (!Array.isArray(bands) || bands.length > MAX_EQ_BANDS) {
+      throw new Error(`EQ bands must be an array of at most ${MAX_EQ_BANDS} bands.`);
+    }
+    this._eqBands = bands.map(band => {
+      const { type = 'peaking', frequency, q = 0.7071, gain = 0 } = band ?? {};
+      if (!EQ_BAND_TYPES.includes(type)) {
+        throw new Error(`EQ band type must be one of: ${EQ_BAND_TYPES.join(', ')}.`);
+      }
+      if (!(frequency > 0) || !(q > 0) || !Number.isFinite(gain) || Math.abs(gain) > 48) {
+        throw new Error('EQ bands need frequency > 0, q > 0 and |gain| <= 48 dB.');
+      }
+      return { type, frequency, q, gain };
+    });
+  }
+
+  /**
+   * Set the brickwall look-ahead limiter at the end of the native output DSP chain.
+   * The look-ahead delays the output by that much.
+   * 
+   * @param {object|null} options - { ceiling?: number (dBFS, default -1), lookaheadMs?: number (0-20, default 5), releaseMs?: number (default 50) }; null to disable
+   * @throws {Error} If options are invalid or in bit-perfect mode
+   * @author zevinDev
+   */
+  setLimiter(options) {
+    if (this._bitPerfect) {
+      throw new Error('Limiter is not supported in bit-perfect mode.');
+    }
+    if (!options) {
+      this._limiter = null;
+      return;
+    }
+    const { ceiling = -1, lookaheadMs = 5, releaseMs = 50 } = options;
+    if (!(ceiling <= 0 && ceiling >= -60) || !(lookaheadMs >= 0 && lookaheadMs <= 20) || !(releaseMs > 0)) {
+      throw new Error('Limiter needs ceiling in [-60, 0] dB, lookaheadMs in [0, 20] and releaseMs > 0.');
+    }
+    this._limiter = { ceiling, lookaheadMs, releaseMs };
+  }
+
+  /**
+   * Set the channel matrix applied first in the native output DSP chain
+   * (out[o] = sum of matrix[o][i] * in[i]), e.g. [[0.5, 0.5], [0.5, 0.5]] for mono.
+   * 
+   * @param {number[][]|null} matrix - Square matrix, one row per output channel; null to disable
+   * @throws {Error} If the matrix is invalid or in bit-perfect mode
+   * @author zevinDev
+   */
+  setChannelMatrix(matrix) {
+    if (this._bitPerfect) {
+      throw new Error('Channel matrix is not supported in bit-perfect mode.');
+    }
+    if (!matrix) {
+      this._channelMatrix = null;
+      return;
+    }
+    const square = Array.isArray(matrix) && matrix.length > 0 && matrix.length <= MAX_DSP_CHANNELS &&
+      matrix.every(row => Array.isArray(row) && row.length === matrix.length && row.every(Number.isFinite));
+    if (!square) {
+      throw new Error(`Channel matrix must be a square array of numbers, at most ${MAX_DSP_CHANNELS} channels.`);
+    }
+    this._channelMatrix = matrix.map(row => [...row]);
+  }
+
+  /**
+   * Get the native output DSP configuration, in the shape setStreamDsp() takes.
+   * 
+   * @returns {object} { eq, matrix, limiter, active }
+   * @author zevinDev
+   */
+  getDspConfig() {
+    return {
+      eq: this._eqBands.map(band => ({ ...band })),
+      matrix: this._channelMatrix ? this._channelMatrix.map(row => [...row]) : null,
+      limiter: this._limiter ? { ...this._limiter } : null,
+      active: !this._bitPerfect && (this._eqBands.length > 0 || !!this._channelMatrix || !!this._limiter)
+    };
+  }
+
   /**
    * Pre-buffer the next track's PCM data for gapless playback.
+   * At most `maxSeconds` (or `maxBytes`) of audio is held: the decoder is paused at the
+   * cap and resumed as the consumer drains the prebuffer, so memory stays constant
+   * however long the track is.
    * 
    * @param {string} nextTrack - Path to the next audio file
    * @param {string} ffmpegPath - Path to ffmpeg binary
-   * @param {object} [audioFormat] - Audio format settings
-   * @returns {Promise<object>} Prebuffering result with buffers and control functions
+   * @param {object} [audioFormat] - Audio format settings ({ sampleRate, channels, sampleFormat })
+   * @param {object} [options] - Prebuffer options
+   * @param {number} [options.maxSeconds=30] - Cap in seconds of audio
+   * @param {number} [options.maxBytes] - Cap in bytes (overrides maxSeconds)
+   * @param {object} [options.portaudio] - Native binding; keeps the samples in its block pool
+   * @returns {Promise<object>} Prebuffering result with the prebuffer and control functions
    * @throws {Error} If prebuffering fails
    * @author zevinDev
    */
-  async prebufferNextTrack(nextTrack, ffmpegPath, audioFormat = {}) {
+  async prebufferNextTrack(nextTrack, ffmpegPath, audioFormat = {}, options = {}) {
     if (this._bitPerfect) {
       throw new Error('Gapless playback is not supported in bit-perfect mode.');
     }
     
     try {
-      const { sampleRate = 44100, channels = 2 } = audioFormat;
+      const { sampleRate = 44100, channels = 2, sampleFormat = 'f32le' } = audioFormat;
+      const { maxSeconds = DEFAULT_PREBUFFER_SECONDS, maxBytes, portaudio } = options;
+      const bytesPerFrame = channels * (BYTES_PER_SAMPLE[sampleFormat] ?? 4);
+      const capacityBytes = maxBytes > 0
+        ? maxBytes
+        : Math.max(Math.round(maxSeconds * sampleRate), 1) * bytesPerFrame;
+      
+      // Replace a previous prebuffer rather than leaking its decoder
+      this.cleanupGapless();
       
       const ffmpegArgs = buildFFmpegArgs({
         input: nextTrack,
         sampleRate,
-        channels
+        channels,
+        sampleFormat
       });
       
       const nextFfmpeg = createFFmpegProcess(ffmpegPath, ffmpegArgs);
-      const nextPcmBuffers = [];
-      let nextTrackReady = false;
+      const prebuffer = new PcmPrebuffer({ capacityBytes, portaudio });
+      const pump = pipeToPrebuffer(nextFfmpeg.stdout, prebuffer);
+      let decoderDone = false;
       let error = null;
       
-      nextFfmpeg.stdout.on('data', chunk => {
-        nextPcmBuffers.push(chunk);
-      });
-      
       nextFfmpeg.stderr.on('data', data => {
         console.warn('[AudioEffects] FFmpeg stderr:', data.toString());
       });
       
       nextFfmpeg.on('close', code => {
-        nextTrackReady = true;
-        if (code !== 0) {
+        decoderDone = true;
+        if (code !== 0 && code !== null) {
           error = new Error(`FFmpeg exited with code ${code}`);
         }
       });
       
       nextFfmpeg.on('error', err => {
         error = err;
-        nextTrackReady = true;
+        decoderDone = true;
       });
       
+      // Ready once the cap is reached (the decoder is now paused) or the track is fully decoded
+      const ready = () => !error && (decoderDone || prebuffer.isFull() || pump.hasPending());
+      
       // Store reference for cleanup
       this._gaplessNextFfmpeg = nextFfmpeg;
-      this._gaplessNextPcmBuffers = nextPcmBuffers;
-      this._gaplessNextTrackReady = () => nextTrackReady;
+      this._gaplessNextPrebuffer = prebuffer;
+      this._gaplessNextPump = pump;
+      this._gaplessNextTrackReady = ready;
       
       return {
-        buffers: nextPcmBuffers,
+        prebuffer,
         ffmpeg: nextFfmpeg,
-        ready: () => nextTrackReady && !error,
+        ready,
         error: () => error,
         cleanup: () => this.cleanupGapless()
       };
@@ -254,30 +392,51 @@ export class AudioEffects {
   }
 
   /**
-   * Get gapless playback buffers if ready.
+   * Get the next track's prebuffer if it is ready.
    * 
-   * @returns {Buffer[]|null} PCM buffers or null if not ready
+   * @returns {PcmPrebuffer|null} Prebuffer (drain it with read() or drainToRing()) or null if not ready
    * @author zevinDev
    */
-  getGaplessBuffers() {
+  getGaplessPrebuffer() {
     if (this._gaplessNextTrackReady && this._gaplessNextTrackReady()) {
-      return this._gaplessNextPcmBuffers;
+      return this._gaplessNextPrebuffer;
     }
     return null;
   }
 
+  /**
+   * Take the PCM currently prebuffered for the next track, if it is ready.
+   * Draining lets the paused decoder resume, so call again until the prebuffer is drained.
+   * 
+   * @returns {Buffer[]|null} PCM buffers or null if not ready
+   * @author zevinDev
+   */
+  getGaplessBuffers() {
+    const prebuffer = this.getGaplessPrebuffer();
+    if (!prebuffer) return null;
+    const chunk = prebuffer.read();
+    return chunk.length > 0 ? [chunk] : [];
+  }
+
   /**
    * Clean up gapless playback resources.
    * 
    * @author zevinDev
    */
   cleanupGapless() {
+    if (this._gaplessNextPump) {
+      this._gaplessNextPump.stop();
+      this._gaplessNextPump = null;
+    }
     if (this._gaplessNextFfmpeg) {
       killFFmpegProcess(this._gaplessNextFfmpeg);
       this._gaplessNextFfmpeg = null;
     }
+    if (this._gaplessNextPrebuffer) {
+      this._gaplessNextPrebuffer.destroy();
+      this._gaplessNextPrebuffer = null;
+    }
     
-    this._gaplessNextPcmBuffers = null;
     this._gaplessNextTrackReady = false;
   }
 
@@ -295,6 +454,7 @@ export class AudioEffects {
       crossfade: available,
       volumeControl: available,
       visualization: available,
+      dsp: available,
       bitPerfect: this._bitPerfect
     };
   }
@@ -308,7 +468,7 @@ export class AudioEffects {
    */
   validateEffectAvailability(effectName) {
     if (this._bitPerfect) {
-      const restrictedEffects = ['gapless', 'crossfade', 'volume', 'visualization'];
+      const restrictedEffects = ['gapless', 'crossfade', 'volume', 'visualization', 'eq', 'limiter', 'dsp'];
       if (restrictedEffects.includes(effectName.toLowerCase())) {
         throw new Error(`${effectName} is not supported in bit-perfect mode.`);
       }
@@ -326,7 +486,8 @@ export class AudioEffects {
       bitPerfect: {
         enabled: this._bitPerfect,
         sampleRate: this._bitPerfectSampleRate,
-        bitDepth: this._bitPerfectBitDepth
+        bitDepth: this._bitPerfectBitDepth,
+        exclusive: this._bitPerfectExclusive
       },
       crossfade: {
         duration: this._crossfadeDuration,
@@ -335,8 +496,9 @@ export class AudioEffects {
       },
       gapless: {
         enabled: !this._bitPerfect,
-        hasBufferedTrack: !!this._gaplessNextPcmBuffers
-      }
+        hasBufferedTrack: this.getGaplessPrebuffer() !== null
+      },
+      dsp: this.getDspConfig()
     };
   }
 }
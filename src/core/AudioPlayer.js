@@ -5,12 +5,19 @@
  */
 
 import { EventEmitter } from 'events';
+import { closeSync, createWriteStream } from 'node:fs';
 import { DeviceManager } from './DeviceManager.js';
 import { PlaylistManager } from './PlaylistManager.js';
 import { AudioEffects } from './AudioEffects.js';
 import { StreamManager } from './StreamManager.js';
 import { locateFFmpeg, extractMetadata, getAudioInfo, buildFFmpegArgs, createFFmpegProcess, killFFmpegProcess } from '../utils/FFmpegUtils.js';
-import { negotiateAudioFormat, scalePCMVolume } from '../utils/AudioUtils.js';
+import { negotiateAudioFormat, bytesPerSample } from '../utils/AudioUtils.js';
+import { PcmRingWriter, PcmRingReader, pipeToRing } from '../utils/RingBuffer.js';
+import { StreamClock } from '../utils/StreamClock.js';
+import { AdaptiveBufferController } from '../utils/AdaptiveBuffer.js';
+import { PcmCache } from '../utils/PcmCache.js';
+import { LoudnessAnalyzer } from '../utils/LoudnessAnalyzer.js';
+import { canDecodeNatively, probeNativeAudio } from '../utils/NativeDecoder.js';
 import { handleError, validateParams } from '../utils/ErrorHandler.js';
 
 /**
@@ -26,9 +33,10 @@ import { handleError, validateParams } from '../utils/ErrorHandler.js';
  * @event trackEnd - Fired when a track finishes. Args: (track: string)
  * @event playlistEnd - Fired when playlist finishes. Args: (playlist: string[])
  * @event error - Fired on playback error. Args: (error: Error)
- * @event currentTime - Fired every 250ms with current playback time. Args: (seconds: number)
+ * @event currentTime - Fired periodically (250ms by default, see setCurrentTimeInterval) with current playback time. Args: (seconds: number)
  * @event duration - Fired when track duration is available. Args: (duration: number)
- * @event deviceChange, deviceError, streamError, streamReconnect, streamBuffering, bitPerfectChange, volumeChange, crossfadeConfigChange
+ * @event streamEvent - Coalesced native stream events (underflows, voice ends). Args: (event: { type, streamId, count, message })
+ * @event deviceChange, deviceListChange, deviceError, streamError, streamReconnect, streamBuffering, bitPerfectChange, volumeChange, crossfadeConfigChange
  *
  * @class
  * @extends EventEmitter
@@ -52,14 +60,45 @@ export class AudioPlayer extends EventEmitter {
     this._paused = false;
     this._volume = 1.0;
     this._bufferSize = null;
+    // Underrun-driven buffer sizing (see setAdaptiveBuffering) and its monitor timer
+    this._adaptiveBuffer = null;
+    this._adaptiveTimer = null;
+    this._adaptiveIntervalMs = 1000;
+    this._resampleQuality = 'high';
+    // Opt-in real-time scheduling of the native audio threads (see setRealtimeScheduling)
+    this._threadTuning = null;
+    // Host-API stream settings and clip/dither flags (see setHostApiOptions)
+    this._hostApiOptions = null;
+    // Duplex input of the output stream and its capture ring (see setInputMonitoring)
+    this._duplexOptions = null;
+    this._capture = null;
+    this._trackInfo = null;
+    // Optional decoded-PCM cache (see enablePcmCache)
+    this._pcmCache = null;
+    // Optional loudness normalisation (see enableLoudnessNormalization)
+    this._loudness = null;
+    this._loudnessOptions = null;
     
     // FFmpeg and PortAudio
     this._ffmpegPath = null;
-    this._ffmpegProcess = null;
     this._audioStream = null;
+    this._streamFormat = null;
+    // Mixer voice sources: the one playing and the one queued for gapless
+    this._source = null;
+    this._nextSource = null;
+    this._fadingSource = null;
+    this._crossfadeTimer = null;
+    // Sources being spliced out by seeks, freed once the mixer has faded them out
+    this._splicedSources = [];
+    this._spliceTimer = null;
+    // Decoded audio kept behind the play position so seeks back stay in place
+    this._seekRetentionSeconds = 5;
     
     // Visualization and callbacks
     this._visualizationCallback = null;
+    // Native output analysis (levels and spectrum), applied to every stream we open
+    this._analysisCallback = null;
+    this._analysisOptions = null;
     
     // Buffer state for async streaming
     this._audioBuffer = [];
@@ -81,6 +120,9 @@ export class AudioPlayer extends EventEmitter {
     this._framesPlayed = 0;
     this._currentSampleRate = 44100; // default, will be set on play
     this._currentTimeInterval = null;
+    this._currentTimeIntervalMs = 250;
+    // Native playback clock of the open stream (sample-accurate, DAC aligned)
+    this._clock = null;
 
     // Track duration (in seconds)
     this._currentDuration = null;
@@ -143,7 +185,8 @@ export class AudioPlayer extends EventEmitter {
       // Set _framesPlayed based on startPosition and sample rate (will be set below)
       this._framesPlayed = 0;
       this._currentDuration = null;
-      const trackInfo = await getAudioInfo(filePath);
+      // Files the addon decodes itself are probed natively too, without ffprobe
+      const trackInfo = probeNativeAudio(portaudio, filePath) ?? await getAudioInfo(filePath);
       if (trackInfo && typeof trackInfo.duration === 'number') {
         this._currentDuration = trackInfo.duration;
         this.emit('duration', this._currentDuration);
@@ -154,132 +197,68 @@ export class AudioPlayer extends EventEmitter {
         await this._deviceManager.setOutputDevice(defaultDevice.index);
       }
       const device = this._deviceManager.getCurrentDevice();
+      await this._deviceManager.whenCapabilitiesReady();
       const audioFormat = negotiateAudioFormat(trackInfo, device, portaudio);
-      this._currentSampleRate = audioFormat.sampleRate;
+      const bitPerfect = this._audioEffects.isBitPerfectMode();
+      // Carry integer PCM end to end (16-bit halves pipe and ring bandwidth); bit-perfect
+      // 32-bit sources stay integer, and visualization consumers expect float samples
+      if (this._visualizationCallback && !bitPerfect) {
+        audioFormat.sampleFormat = 'f32le';
+      } else if (bitPerfect && audioFormat.bitDepth === 32 &&
+        portaudio.isOutputFormatSupported?.(device.index, audioFormat.sampleRate, audioFormat.channels, 's32le')) {
+        audioFormat.sampleFormat = 's32le';
+      }
+      // With the native resampler, decode at the track's own rate and let the mixer
+      // convert, so a later device switch does not need a new decoder
+      const nativeResampler = typeof portaudio.switchStreamDevice === 'function' && !bitPerfect;
+      audioFormat.sourceSampleRate = nativeResampler && trackInfo?.sampleRate > 0
+        ? trackInfo.sampleRate
+        : audioFormat.sampleRate;
+      this._trackInfo = trackInfo;
+      this._currentSampleRate = audioFormat.sourceSampleRate;
       // Set _framesPlayed based on startPosition and sample rate
       this._framesPlayed = Math.floor(startPosition * this._currentSampleRate);
       
-      // Create FFmpeg process with fast startup flags
-      const ffmpegArgs = buildFFmpegArgs({
-        input: filePath,
-        sampleRate: audioFormat.sampleRate,
-        channels: audioFormat.channels,
-        seekPosition: startPosition,
-        // Fast startup flags to reduce FFmpeg pre-scan time
-        extra: [
-          '-nostdin',
-          '-hide_banner',
-          '-analyzeduration', '32k',
-          '-probesize', '32k',
-          '-read_ahead_limit', '0'
-        ]
-      });
-      
-      const ffmpeg = createFFmpegProcess(this._ffmpegPath, ffmpegArgs);
-      this._ffmpegProcess = ffmpeg;
-      
-      // Set up PCM streaming queue instead of prebuffering entire track
-      let pcmQueue = [];
-      let ffmpegEnded = false;
-
-      ffmpeg.stdout.on('data', chunk => {
-        pcmQueue.push(chunk);
-        if (this._visualizationCallback) {
-          try {
-            this._visualizationCallback(chunk);
-          } catch (error) {
-            console.warn('[AudioPlayer] Visualization callback error:', error.message);
-          }
-        }
-      });
-      
-      ffmpeg.stderr.on('data', data => {
-        // Log FFmpeg errors if needed
-        console.warn('[AudioPlayer] FFmpeg stderr:', data.toString());
-      });
-      
-      ffmpeg.on('close', code => {
-        ffmpegEnded = true;
-        this._ffmpegEnded = true;
-        if (code !== 0) {
-          console.warn('[AudioPlayer] FFmpeg exited with code:', code);
-        }
-      });
-      
-      ffmpeg.on('error', err => {
-        this._isPlaying = false;
-        this.emit('error', err);
-        handleError(err, 'play/ffmpeg', this);
-      });
-      
-      // Set up PortAudio stream
-      const framesPerBuffer = this._bufferSize ?? 2048;
+      // Set up PortAudio stream in ring mode: the native callback mixes PCM from
+      // lock-free voice rings we write into, so it never waits on the event loop
+      const adaptive = this._adaptiveBuffer;
+      const framesPerBuffer = adaptive?.unspecified ? 0 : this._periodFrames();
       const streamOpts = {
         device: device.index,
         channels: audioFormat.channels,
         sampleRate: audioFormat.sampleRate,
-        framesPerBuffer
+        sourceSampleRate: audioFormat.sourceSampleRate,
+        resampleQuality: this._resampleQuality,
+        sampleFormat: audioFormat.sampleFormat,
+        bitPerfect,
+        framesPerBuffer,
+        // Unspecified periods are sized through the latency the host is asked for
+        ...(adaptive?.unspecified && { suggestedLatency: adaptive.frames / audioFormat.sampleRate }),
+        seekRetentionFrames: bitPerfect ? 0 : Math.round(this._seekRetentionSeconds * audioFormat.sourceSampleRate),
+        // Delivered off the audio thread, coalesced per 100 ms
+        eventCallback: event => this.emit('streamEvent', event),
+        ...this._threadTuning,
+        ...this._hostStreamOptions(),
+        ...this._duplexStreamOptions(bitPerfect)
       };
-      
-      // Audio callback for PortAudio (new pattern: return buffer)
-      const audioCallback = () => {
-        const buffer = new Float32Array(framesPerBuffer * audioFormat.channels);
-        try {
-          if (!this._isPlaying || this._paused) {
-            buffer.fill(0);
-            return buffer;
-          }
-          // Stream PCM data from queue to buffer
-          let offset = 0;
-          while (pcmQueue.length && offset < buffer.length) {
-            const chunk = pcmQueue[0];
-            let toCopy = 0;
-            if (Buffer.isBuffer(chunk)) {
-              toCopy = Math.min(chunk.length / 4, buffer.length - offset);
-              for (let i = 0; i < toCopy; ++i) {
-                buffer[offset + i] = chunk.readFloatLE(i * 4);
-              }
-            } else if (chunk instanceof Float32Array) {
-              toCopy = Math.min(chunk.length, buffer.length - offset);
-              buffer.set(chunk.subarray(0, toCopy), offset);
-            } else {
-              // Unknown chunk type, skip
-              console.warn('[AudioPlayer] Unknown PCM chunk type:', typeof chunk);
-              pcmQueue.shift();
-              continue;
-            }
-            offset += toCopy;
-            if (toCopy < (Buffer.isBuffer(chunk) ? chunk.length / 4 : chunk.length)) {
-              if (Buffer.isBuffer(chunk)) {
-                pcmQueue[0] = chunk.slice(toCopy * 4); // bytes
-              } else {
-                pcmQueue[0] = chunk.subarray(toCopy);
-              }
-            } else {
-              pcmQueue.shift();
-            }
-          }
-          if (offset < buffer.length) {
-            buffer.fill(0, offset); // Zero-fill if underrun
-          }
-          // Apply volume if not in bit-perfect mode and volume is not 1.0
-          if (!this._audioEffects.isBitPerfectMode() && this._volume !== 1.0) {
-            const volumeBuffer = scalePCMVolume(buffer, this._volume);
-            buffer.set(volumeBuffer);
-          }
-          // Track frames played for currentTime
-          this._framesPlayed += framesPerBuffer;
-        } catch (err) {
-          // Robust: never throw from audio callback
-          buffer.fill(0);
-          console.error('[AudioPlayer] Exception in audioCallback:', err);
-        }
-        return buffer;
-      };
-      
-      // Open audio stream
-      const streamId = await portaudio.openStreamAsync(streamOpts, audioCallback);
+      const streamId = await this._openOutputStream(portaudio, streamOpts);
       this._audioStream = streamId;
+      this._startCapture(portaudio, streamId, audioFormat.sampleRate);
+      this._streamFormat = audioFormat;
+      this._clock = typeof portaudio.getStreamClock === 'function'
+        ? new StreamClock(portaudio.getStreamClock(streamId), () => portaudio.getStreamTime(streamId))
+        : null;
+      if (!bitPerfect) {
+        // Start at the current level; later setVolume() calls ramp natively
+        portaudio.setStreamVolume(streamId, this._volume, 0);
+        if (this._audioEffects.getDspConfig().active) {
+          this._applyDsp(portaudio, streamId);
+        }
+      }
+      this._applyAnalysisTap(portaudio, streamId);
+      this._startAdaptiveBuffering(portaudio, streamId);
+      // Voice 0 is created with the stream
+      this._source = this._startSource(portaudio, streamId, 0, filePath, startPosition);
       
       this.emit('play', filePath);
       // Emit resampleInfo event with original and playback sample rate/channels
@@ -290,29 +269,44 @@ export class AudioPlayer extends EventEmitter {
       });
       
       // Start currentTime event interval
-      if (this._currentTimeInterval) clearInterval(this._currentTimeInterval);
-      this._currentTimeInterval = setInterval(() => {
-        if (this._isPlaying && !this._paused) {
-          this.emit('currentTime', this.getCurrentTime());
-        }
-      }, 250);
+      this._startCurrentTimeUpdates();
       
-      // Monitor for track end
+      // Monitor for track end; follows whichever source is current after
+      // crossfades and gapless hand-offs
       const checkEnd = () => {
-        if (ffmpegEnded && pcmQueue.length === 0) {
+        if (this._audioStream !== streamId) return;
+        const source = this._source;
+        if (source && this._isSourceFinished(source)) {
+          if (this._nextSource) {
+            // Gapless: the mixer has already started the queued voice on the next sample
+            this._switchToNextSource(portaudio, streamId);
+            setTimeout(checkEnd, 100);
+            return;
+          }
           this._isPlaying = false;
+          this._releaseSource(portaudio, streamId, source, { removeVoice: false });
+          this._releaseSplicedSources(portaudio, streamId);
+          if (this._fadingSource) {
+            clearTimeout(this._crossfadeTimer);
+            this._crossfadeTimer = null;
+            this._releaseSource(portaudio, streamId, this._fadingSource, { removeVoice: false });
+            this._fadingSource = null;
+          }
           if (this._currentTimeInterval) {
             clearInterval(this._currentTimeInterval);
             this._currentTimeInterval = null;
           }
-          this.emit('trackEnd', filePath);
+          portaudio.closeStream(streamId);
+          this._audioStream = null;
+          this._clock = null;
+          this._source = null;
+          
+          this.emit('trackEnd', source.track);
           
           // Handle playlist continuation
           if (this._playlistManager.isPlaylistActive()) {
             this._handlePlaylistNext();
           }
-          
-          portaudio.closeStream(streamId);
         } else if (this._isPlaying) {
           setTimeout(checkEnd, 100);
         }
@@ -328,6 +322,239 @@ export class AudioPlayer extends EventEmitter {
     }
   }
 
+  /**
+   * Start decoding a file into one mixer voice of the current stream.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Ring-mode stream ID.
+   * @param {number} voiceId - Mixer voice to feed.
+   * @param {string} filePath - Audio file to decode.
+   * @param {number} [startPosition=0] - Position in seconds to start decoding from.
+   * @returns {object} Source handle ({ track, voiceId, ffmpeg, ring, pump, ended }).
+   * @author zevinDev
+   */
+  _startSource(portaudio, streamId, voiceId, filePath, startPosition = 0) {
+    const audioFormat = this._streamFormat;
+    const sourceRate = audioFormat.sourceSampleRate ?? audioFormat.sampleRate;
+    const ring = new PcmRingWriter(portaudio.getStreamRing(streamId, voiceId),
+      audioFormat.channels * bytesPerSample(audioFormat.sampleFormat));
+    const source = { track: filePath, voiceId, ffmpeg: null, ring, pump: null, ended: false, released: false, cacheEntry: null };
+    this._applyTrackGain(portaudio, streamId, voiceId, filePath);
+    
+    // Cached decodes are mapped and streamed natively; visualization consumers need the
+    // samples in JS, so they always go through the decoder
+    const cacheFormat = { sampleRate: sourceRate, channels: audioFormat.channels, sampleFormat: audioFormat.sampleFormat };
+    const useCache = this._pcmCache && !this._visualizationCallback && typeof portaudio.attachFile === 'function';
+    const cached = useCache ? this._pcmCache.lookup(filePath, cacheFormat) : null;
+    if (cached) {
+      try {
+        portaudio.attachFile(streamId, cached.path, voiceId, Math.round(startPosition * sourceRate));
+        source.ended = true;
+        return source;
+      } catch (error) {
+        console.warn('[AudioPlayer] PCM cache entry unusable, decoding instead:', error.message);
+      }
+    }
+    // WAV files are decoded in-process by a native thread, with no ffmpeg spawn
+    if (!this._visualizationCallback && canDecodeNatively(portaudio, filePath)) {
+      const decoded = portaudio.attachDecoder(streamId, filePath, voiceId, Math.round(startPosition * sourceRate));
+      if (decoded) {
+        source.ended = true;
+        return source;
+      }
+    }
+    // Fill the cache while playing, but only from whole-track decodes
+    if (this._pcmCache && startPosition === 0) {
+      source.cacheEntry = this._pcmCache.createEntry(filePath, cacheFormat);
+    }
+    
+    // Create FFmpeg process with fast startup flags
+    const ffmpegArgs = buildFFmpegArgs({
+      input: filePath,
+      sampleRate: sourceRate,
+      channels: audioFormat.channels,
+      sampleFormat: audioFormat.sampleFormat,
+      seekPosition: startPosition,
+      // Fast startup flags to reduce FFmpeg pre-scan time
+      extra: [
+        '-nostdin',
+        '-hide_banner',
+        '-analyzeduration', '32k',
+        '-probesize', '32k',
+        '-read_ahead_limit', '0'
+      ]
+    });
+    
+    // Without a visualization consumer, let a native thread read ffmpeg's stdout
+    // straight into the ring so sample data never passes through JS
+    const useNativePipe = typeof portaudio.attachPipe === 'function' && !this._visualizationCallback;
+    let cacheStream = null;
+    if (useNativePipe) {
+      const { readFd, writeFd } = portaudio.createPipe();
+      try {
+        source.ffmpeg = createFFmpegProcess(this._ffmpegPath, ffmpegArgs, {
+          stdio: ['ignore', writeFd, 'pipe']
+        });
+      } finally {
+        closeSync(writeFd);
+      }
+      try {
+        // The native reader tees into the cache entry and closes its fd
+        portaudio.attachPipe(streamId, readFd, voiceId, source.cacheEntry ? source.cacheEntry.fd : -1);
+        source.cacheEntry?.release();
+      } catch (error) {
+        closeSync(readFd);
+        killFFmpegProcess(source.ffmpeg);
+        source.cacheEntry?.abort();
+        throw error;
+      }
+    } else {
+      source.ffmpeg = createFFmpegProcess(this._ffmpegPath, ffmpegArgs);
+      source.pump = pipeToRing(source.ffmpeg.stdout, ring, {
+        onChunk: chunk => this._visualizationCallback?.(chunk)
+      });
+      if (source.cacheEntry) {
+        source.cacheEntry.release();
+        cacheStream = createWriteStream(null, { fd: source.cacheEntry.fd });
+        cacheStream.on('error', () => source.cacheEntry?.abort());
+        source.ffmpeg.stdout.on('data', chunk => cacheStream.write(chunk));
+      }
+    }
+    
+    source.ffmpeg.stderr.on('data', data => {
+      // Log FFmpeg errors if needed
+      console.warn('[AudioPlayer] FFmpeg stderr:', data.toString());
+    });
+    
+    source.ffmpeg.on('close', code => {
+      source.ended = true;
+      // JS pump: publish end-of-stream once the last pending chunk is in the ring
+      const markEnd = () => {
+        if (!source.pump) return;
+        if (source.pump.hasPending()) {
+          setTimeout(markEnd, 10);
+          return;
+        }
+        source.ring.end();
+      };
+      markEnd();
+      if (code !== 0 && code !== null) {
+        console.warn('[AudioPlayer] FFmpeg exited with code:', code);
+      }
+      this._finishCacheEntry(source, code === 0, cacheStream);
+    });
+    
+    source.ffmpeg.on('error', err => {
+      this._isPlaying = false;
+      this.emit('error', err);
+      handleError(err, 'play/ffmpeg', this);
+    });
+    
+    return source;
+  }
+
+  /**
+   * Publish or discard a source's PCM cache entry once its decoder has exited.
+   * The native reader closes the entry before it marks end-of-stream on the ring, so
+   * the entry is complete once that flag is up.
+   *
+   * @private
+   * @param {object} source - Source handle from _startSource().
+   * @param {boolean} succeeded - Whether the decoder finished the whole track.
+   * @param {WriteStream|null} cacheStream - JS tee stream, if the samples went through JS.
+   * @author zevinDev
+   */
+  _finishCacheEntry(source, succeeded, cacheStream) {
+    const entry = source.cacheEntry;
+    if (!entry) return;
+    if (!succeeded || source.released) {
+      source.cacheEntry = null;
+      cacheStream?.destroy();
+      entry.abort();
+      return;
+    }
+    if (cacheStream) {
+      cacheStream.end(() => {
+        source.cacheEntry = null;
+        entry.finalize();
+      });
+      return;
+    }
+    if (!source.ring.endOfStream()) {
+      setTimeout(() => this._finishCacheEntry(source, succeeded, null), 50);
+      return;
+    }
+    source.cacheEntry = null;
+    entry.finalize();
+  }
+
+  /**
+   * Whether a source's decoder has exited and the mixer has played all of its samples.
+   *
+   * @private
+   * @param {object} source - Source handle from _startSource().
+   * @returns {boolean} True once the source is exhausted.
+   * @author zevinDev
+   */
+  _isSourceFinished(source) {
+    return source.ended && source.ring.endOfStream() && source.ring.isDrained();
+  }
+
+  /**
+   * Stop a source's decoder and, unless told otherwise, free its mixer voice.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Ring-mode stream ID.
+   * @param {object} source - Source handle from _startSource().
+   * @param {object} [options] - Release options.
+   * @param {boolean} [options.removeVoice=true] - Remove the voice from the mixer.
+   * @author zevinDev
+   */
+  _releaseSource(portaudio, streamId, source, { removeVoice = true } = {}) {
+    // A decode cut short must not be published to the PCM cache
+    source.released = true;
+    if (source.cacheEntry && !source.ended) {
+      source.cacheEntry.abort();
+      source.cacheEntry = null;
+    }
+    if (source.pump) {
+      source.pump.stop();
+      source.pump = null;
+    }
+    if (!source.ended && source.ffmpeg) {
+      killFFmpegProcess(source.ffmpeg);
+    }
+    if (removeVoice) {
+      try {
+        portaudio.removeVoice(streamId, source.voiceId);
+      } catch (error) {
+        console.warn('[AudioPlayer] Error removing mixer voice:', error.message);
+      }
+    }
+  }
+
+  /**
+   * Promote the queued gapless source to the current one.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Ring-mode stream ID.
+   * @author zevinDev
+   */
+  _switchToNextSource(portaudio, streamId) {
+    const previous = this._source;
+    const next = this._nextSource;
+    this._nextSource = null;
+    this._releaseSource(portaudio, streamId, previous);
+    this._source = next;
+    this._currentTrack = next.track;
+    this._framesPlayed = 0;
+    this.emit('trackEnd', previous.track);
+    this.emit('play', next.track);
+  }
+
   /**
    * Handle automatic playlist progression.
    * Advances to the next track or emits playlistEnd if finished.
@@ -364,8 +591,9 @@ export class AudioPlayer extends EventEmitter {
       
       this._paused = true;
       
-      if (this._audioStream && typeof this._audioStream.pause === 'function') {
-        this._audioStream.pause();
+      if (this._audioStream) {
+        const portaudio = await this._deviceManager.getPortAudio();
+        portaudio.setStreamPaused(this._audioStream, true);
       }
       if (this._currentTimeInterval) {
         clearInterval(this._currentTimeInterval);
@@ -393,19 +621,12 @@ export class AudioPlayer extends EventEmitter {
       
       this._paused = false;
       
-      if (this._audioStream && typeof this._audioStream.resume === 'function') {
-        this._audioStream.resume();
+      if (this._audioStream) {
+        const portaudio = await this._deviceManager.getPortAudio();
+        portaudio.setStreamPaused(this._audioStream, false);
       }
       // Restart currentTime event interval after resume
-      if (this._currentTimeInterval) {
-        clearInterval(this._currentTimeInterval);
-        this._currentTimeInterval = null;
-      }
-      this._currentTimeInterval = setInterval(() => {
-        if (this._isPlaying && !this._paused) {
-          this.emit('currentTime', this.getCurrentTime());
-        }
-      }, 250);
+      this._startCurrentTimeUpdates();
       this.emit('resume', this._currentTrack);
     } catch (error) {
       this.emit('error', error);
@@ -439,10 +660,23 @@ export class AudioPlayer extends EventEmitter {
         this._currentTimeInterval = null;
       }
       
-      // Terminate ffmpeg process
-      if (this._ffmpegProcess) {
-        killFFmpegProcess(this._ffmpegProcess);
-        this._ffmpegProcess = null;
+      // Terminate ffmpeg processes; closing the stream frees their voices
+      if (this._crossfadeTimer) {
+        clearTimeout(this._crossfadeTimer);
+        this._crossfadeTimer = null;
+      }
+      if (this._source || this._nextSource || this._fadingSource) {
+        const portaudio = await this._deviceManager.getPortAudio();
+        for (const source of [this._source, this._nextSource, this._fadingSource]) {
+          if (source) this._releaseSource(portaudio, this._audioStream, source, { removeVoice: false });
+        }
+        this._source = null;
+        this._nextSource = null;
+        this._fadingSource = null;
+      }
+      if (this._splicedSources.length) {
+        const portaudio = await this._deviceManager.getPortAudio();
+        this._releaseSplicedSources(portaudio, this._audioStream);
       }
       
       // Close PortAudio stream
@@ -456,6 +690,7 @@ export class AudioPlayer extends EventEmitter {
           console.warn('[AudioPlayer] Error closing audio stream:', error.message);
         }
         this._audioStream = null;
+        this._clock = null;
       }
       
       // Clean up audio effects resources
@@ -474,6 +709,9 @@ export class AudioPlayer extends EventEmitter {
 
   /**
    * Seek to a specific position in the current track.
+   * Positions still buffered (ahead, or retained behind, see setSeekRetention) only move
+   * the native read position; anything else restarts the decoder in a new mixer voice
+   * that is spliced in with a short crossfade. The output stream stays open either way.
    *
    * @param {number} positionSeconds - Position in seconds to seek to.
    * @returns {Promise<void>} Resolves when seek is complete.
@@ -487,7 +725,9 @@ export class AudioPlayer extends EventEmitter {
       if (!this._currentTrack) {
         throw new Error('No track loaded.');
       }
-      await this.play(this._currentTrack, positionSeconds);
+      if (!(await this._seekInStream(positionSeconds))) {
+        await this.play(this._currentTrack, positionSeconds);
+      }
       this.emit('seek', { track: this._currentTrack, position: positionSeconds });
     } catch (error) {
       this.emit('error', error);
@@ -496,6 +736,141 @@ export class AudioPlayer extends EventEmitter {
     }
   }
 
+  /**
+   * Seek without reopening the output stream.
+   *
+   * @private
+   * @param {number} positionSeconds - Target position in seconds.
+   * @returns {Promise<boolean>} False if the stream cannot seek in place (the caller restarts playback).
+   * @author zevinDev
+   */
+  async _seekInStream(positionSeconds) {
+    const source = this._source;
+    if (!this._isPlaying || !this._audioStream || !source || this._audioEffects.isBitPerfectMode()) return false;
+    const portaudio = await this._deviceManager.getPortAudio();
+    if (typeof portaudio.seekVoice !== 'function') return false;
+    const streamId = this._audioStream;
+    // A finished voice means the track end is being handled and the stream will close
+    if (portaudio.getVoiceState(streamId, source.voiceId).finished) return false;
+    const frame = Math.round(positionSeconds * this._currentSampleRate);
+    if (!source.splicing) {
+      const { ring } = source;
+      const position = ring.consumedBytes() / ring.bytesPerFrame;
+      const target = frame - this._framesPlayed;
+      // Keep clear of the window edges: the callback keeps playing while the request is
+      // in flight, and the native seek fade needs a few hundred frames
+      const margin = 2 * this._periodFrames() + 256;
+      if (target >= position - ring.historyAvailable() / ring.bytesPerFrame + margin &&
+        target <= position + ring.readAvailable() / ring.bytesPerFrame - margin) {
+        // getCurrentTime() follows once the callback has moved the ring's read index
+        portaudio.seekVoice(streamId, source.voiceId, target);
+        return true;
+      }
+    }
+    this._spliceSource(portaudio, streamId, positionSeconds);
+    return true;
+  }
+
+  /**
+   * Restart the decoder at a new position in a mixer voice that replaces the current one.
+   * The mixer keeps the current voice playing until the new one has data, then crossfades.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Ring-mode stream ID.
+   * @param {number} positionSeconds - Position to decode from.
+   * @author zevinDev
+   */
+  _spliceSource(portaudio, streamId, positionSeconds) {
+    let replaced = this._source;
+    // A splice still waiting for its decoder is superseded; keep the voice it waits on
+    if (replaced.splicing && !portaudio.getVoiceState(streamId, replaced.voiceId).started) {
+      this._releaseSource(portaudio, streamId, replaced);
+      replaced = replaced.splicing;
+    }
+    const voiceId = portaudio.addVoice(streamId, {
+      replaces: replaced.voiceId,
+      sampleRate: this._streamFormat.sourceSampleRate
+    });
+    let next;
+    try {
+      next = this._startSource(portaudio, streamId, voiceId, this._currentTrack, positionSeconds);
+    } catch (error) {
+      portaudio.removeVoice(streamId, voiceId);
+      throw error;
+    }
+    next.splicing = replaced;
+    if (!this._splicedSources.includes(replaced)) this._splicedSources.push(replaced);
+    this._source = next;
+    this._framesPlayed = Math.round(positionSeconds * this._currentSampleRate);
+    this._reapSplicedSources(portaudio, streamId);
+  }
+
+  /**
+   * Poll spliced-out sources and free each once the mixer has faded it out.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Ring-mode stream ID.
+   * @author zevinDev
+   */
+  _reapSplicedSources(portaudio, streamId) {
+    if (this._spliceTimer) return;
+    const reap = () => {
+      this._spliceTimer = null;
+      if (this._audioStream !== streamId) return;
+      const current = this._source;
+      if (current?.splicing && portaudio.getVoiceState(streamId, current.voiceId).started) {
+        current.splicing = null;
+      }
+      this._splicedSources = this._splicedSources.filter(source => {
+        if (current?.splicing === source) return true;
+        let finished = true;
+        try {
+          finished = portaudio.getVoiceState(streamId, source.voiceId).finished;
+        } catch {
+          // Voice already gone
+        }
+        if (finished) this._releaseSource(portaudio, streamId, source);
+        return !finished;
+      });
+      if (this._splicedSources.length) this._spliceTimer = setTimeout(reap, 50);
+    };
+    this._spliceTimer = setTimeout(reap, 50);
+  }
+
+  /**
+   * Stop every spliced-out source (the stream is closing, which frees their voices).
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Ring-mode stream ID.
+   * @author zevinDev
+   */
+  _releaseSplicedSources(portaudio, streamId) {
+    clearTimeout(this._spliceTimer);
+    this._spliceTimer = null;
+    for (const source of this._splicedSources) {
+      this._releaseSource(portaudio, streamId, source, { removeVoice: false });
+    }
+    this._splicedSources = [];
+  }
+
+  /**
+   * Set how much already played audio is kept buffered so that seeking back within it
+   * does not restart the decoder. Applies from the next track.
+   *
+   * @param {number} seconds - Retention window in seconds (0 disables it).
+   * @returns {void}
+   * @author zevinDev
+   */
+  setSeekRetention(seconds) {
+    if (typeof seconds !== 'number' || isNaN(seconds) || seconds < 0) {
+      throw new Error('Seek retention must be a non-negative number of seconds');
+    }
+    this._seekRetentionSeconds = seconds;
+  }
+
   /**
    * Set playback volume.
    *
@@ -511,8 +886,9 @@ export class AudioPlayer extends EventEmitter {
       
       this._volume = level;
       
-      if (this._audioStream && typeof this._audioStream.setVolume === 'function') {
-        this._audioStream.setVolume(level);
+      if (this._audioStream) {
+        const portaudio = await this._deviceManager.getPortAudio();
+        portaudio.setStreamVolume(this._audioStream, level);
       }
       
       this.emit('volumeChange', level);
@@ -674,6 +1050,8 @@ export class AudioPlayer extends EventEmitter {
 
   /**
    * Enable gapless playback for the next track.
+   * The next track is decoded into its own mixer voice that the native mixer starts
+   * on the exact sample after the current track runs out.
    *
    * @param {string} nextTrack - Path to the next audio file.
    * @returns {Promise<void>} Resolves when gapless transition is set up.
@@ -683,48 +1061,34 @@ export class AudioPlayer extends EventEmitter {
   async playGapless(nextTrack) {
     try {
       this._audioEffects.validateEffectAvailability('gapless');
+      validateParams({ filePath: nextTrack });
       
       if (!this._isPlaying || !this._currentTrack) {
         await this.play(nextTrack);
         return;
       }
       
-      if (!this._audioStream) {
+      if (!this._audioStream || !this._source) {
         throw new Error('No active audio stream for gapless playback.');
       }
       
-      // Prebuffer the next track
-      const result = await this._audioEffects.prebufferNextTrack(
-        nextTrack, 
-        this._ffmpegPath,
-        { sampleRate: 44100, channels: 2 }
-      );
-      
-      // Wait for the current track to end and seamlessly transition
-      this._audioStream.once('finish', async () => {
-        const isReady = await this._audioEffects.waitForGaplessReady(2000);
-        
-        if (!isReady) {
-          handleError(new Error('Next track not ready for gapless playback.'), 'playGapless', this);
-          return;
-        }
-        
-        const buffers = this._audioEffects.getGaplessBuffers();
-        if (buffers) {
-          const portaudio = await this._deviceManager.getPortAudio();
-          for (const buf of buffers) {
-            if (this._visualizationCallback) {
-              try {
-                this._visualizationCallback(buf);
-              } catch (error) {}
-            }
-            portaudio.writeStream(buf, this._audioStream);
-          }
-        }
-        
-        this._currentTrack = nextTrack;
-        this.emit('play', nextTrack);
+      const portaudio = await this._deviceManager.getPortAudio();
+      const streamId = this._audioStream;
+      // Replace a previously queued track
+      if (this._nextSource) {
+        this._releaseSource(portaudio, streamId, this._nextSource);
+        this._nextSource = null;
+      }
+      const voiceId = portaudio.addVoice(streamId, {
+        follows: this._source.voiceId,
+        sampleRate: this._streamFormat.sourceSampleRate
       });
+      try {
+        this._nextSource = this._startSource(portaudio, streamId, voiceId, nextTrack);
+      } catch (error) {
+        portaudio.removeVoice(streamId, voiceId);
+        throw error;
+      }
       
     } catch (error) {
       handleError(error, 'playGapless', this);
@@ -734,33 +1098,77 @@ export class AudioPlayer extends EventEmitter {
 
   /**
    * Crossfade between the current and next track.
+   * Both tracks play through separate mixer voices whose gains are ramped natively
+   * with the configured crossfade curve, so the fade is sample accurate.
    *
    * @param {string} nextTrack - Path to the next audio file.
-   * @param {number} [duration=3] - Crossfade duration in seconds.
-   * @returns {Promise<void>} Resolves when crossfade is complete.
+   * @param {number} [duration] - Crossfade duration in seconds (uses configured duration if not specified).
+   * @returns {Promise<void>} Resolves once the crossfade has started.
    * @throws {Error} If bit-perfect mode is enabled or no active stream.
    * @author zevinDev
    */
-  async crossfadeTo(nextTrack, duration = 3) {
+  async crossfadeTo(nextTrack, duration) {
     try {
       this._audioEffects.validateEffectAvailability('crossfade');
+      validateParams({ filePath: nextTrack });
       
       if (!this._isPlaying || !this._currentTrack) {
         await this.play(nextTrack);
         return;
       }
       
-      if (!this._audioStream) {
+      if (!this._audioStream || !this._source) {
         throw new Error('No active audio stream for crossfade.');
       }
       
-      // This is a simplified version - full implementation would require
-      // more complex PCM buffer management and mixing
-      console.warn('[AudioPlayer] Crossfade implementation simplified in modular version');
+      const { duration: configuredDuration, curve } = this._audioEffects.getCrossfadeConfig();
+      const fadeSeconds = typeof duration === 'number' && duration >= 0 ? duration : configuredDuration;
+      // The gain ramp runs after resampling, so it counts frames at the device rate
+      const rampFrames = Math.round(fadeSeconds * this._streamFormat.sampleRate);
+      const portaudio = await this._deviceManager.getPortAudio();
+      const streamId = this._audioStream;
       
-      // For now, just stop current and play next
-      await this.stop();
-      await this.play(nextTrack);
+      // A crossfade supersedes any queued gapless track and any fade still running
+      if (this._nextSource) {
+        this._releaseSource(portaudio, streamId, this._nextSource);
+        this._nextSource = null;
+      }
+      if (this._crossfadeTimer) {
+        clearTimeout(this._crossfadeTimer);
+        this._crossfadeTimer = null;
+      }
+      if (this._fadingSource) {
+        this._releaseSource(portaudio, streamId, this._fadingSource);
+        this._fadingSource = null;
+      }
+      
+      const voiceId = portaudio.addVoice(streamId, { gain: 0, sampleRate: this._streamFormat.sourceSampleRate });
+      let next;
+      try {
+        next = this._startSource(portaudio, streamId, voiceId, nextTrack);
+      } catch (error) {
+        portaudio.removeVoice(streamId, voiceId);
+        throw error;
+      }
+      const previous = this._source;
+      portaudio.setVoiceGain(streamId, previous.voiceId, 0, rampFrames, curve);
+      portaudio.setVoiceGain(streamId, voiceId, 1, rampFrames, curve);
+      
+      this._fadingSource = previous;
+      this._source = next;
+      this._currentTrack = nextTrack;
+      this._framesPlayed = 0;
+      this.emit('trackEnd', previous.track);
+      this.emit('play', nextTrack);
+      
+      // Free the faded-out voice once its ramp has completed
+      this._crossfadeTimer = setTimeout(() => {
+        this._crossfadeTimer = null;
+        if (this._fadingSource === previous && this._audioStream === streamId) {
+          this._releaseSource(portaudio, streamId, previous);
+          this._fadingSource = null;
+        }
+      }, fadeSeconds * 1000 + 100);
       
     } catch (error) {
       handleError(error, 'crossfadeTo', this);
@@ -769,10 +1177,14 @@ export class AudioPlayer extends EventEmitter {
   }
 
   /**
-   * Play from a streaming source (e.g., internet radio).
+   * Play from a streaming source (e.g., internet radio). The stream gets its own
+   * output stream and plays from a jitter buffer in its native ring: playback starts
+   * at the high watermark, holds below the low watermark ('streamBuffering'), and the
+   * network is paused while the buffer is full.
    *
    * @param {string} url - Streaming source URL.
-   * @param {object} [options] - Streaming options.
+   * @param {object} [options] - Streaming options (lowWatermarkMs, highWatermarkMs,
+   *   maxBufferMs, maxRetries, backoffBaseMs; see StreamManager.playStream).
    * @returns {Promise<void>} Resolves when streaming starts.
    * @throws {Error} If streaming fails.
    * @author zevinDev
@@ -793,7 +1205,6 @@ export class AudioPlayer extends EventEmitter {
       const streamOptions = {
         ffmpegPath: this._ffmpegPath,
         portaudio,
-        audioStream: this._audioStream,
         outputDevice,
         bufferSize: this._bufferSize,
         visualizationCallback: this._visualizationCallback,
@@ -842,7 +1253,9 @@ export class AudioPlayer extends EventEmitter {
           name: result.device.name,
           info: result.device
         });
-        // If currently playing, restart with new device and keep seek position
+        // Move the open stream over natively when possible (voices, buffered PCM and
+        // decoders keep running); otherwise restart with new device and keep seek position
+        if (this._isPlaying && await this._switchStreamDevice(result.device)) return;
         if (this._isPlaying) {
           const track = this._currentTrack;
           const seekPosition = this.getCurrentTime();
@@ -857,6 +1270,417 @@ export class AudioPlayer extends EventEmitter {
     }
   }
 
+  /**
+   * Watch for audio devices being plugged in or removed, without re-initialising
+   * PortAudio (see DeviceManager.watchDevices). Emits 'deviceListChange' with the
+   * added and removed devices. If the output device goes away during playback the
+   * stream moves to the default device and 'deviceChange' follows.
+   *
+   * @param {object} [options] - Watch options (debounceMs, retryMs, reopenOnRemoval).
+   * @returns {Promise<string|null>} Notification source, or null if the platform has none.
+   * @fires AudioPlayer#deviceListChange
+   * @author zevinDev
+   */
+  async watchDevices(options = {}) {
+    return this._deviceManager.watchDevices(change => this._onDeviceListChange(change), options);
+  }
+
+  /**
+   * Stop watching for device changes.
+   *
+   * @returns {void}
+   * @author zevinDev
+   */
+  unwatchDevices() {
+    this._deviceManager.unwatchDevices();
+  }
+
+  /**
+   * Apply a rescanned device list to the open stream.
+   *
+   * @private
+   * @param {object} change - Result of DeviceManager.refreshDevices(), with reasons.
+   * @author zevinDev
+   */
+  async _onDeviceListChange(change) {
+    this.emit('deviceListChange', change);
+    const streamId = this._audioStream;
+    if (streamId === null) return;
+    if (change.closed.includes(streamId)) {
+      // Its device is gone and no other could take the stream
+      this.emit('deviceError', new Error('Output device was removed and playback could not move to another device'));
+      await this.stop();
+    } else if (change.moved.includes(streamId)) {
+      const device = change.devices.find(d => d.isDefault);
+      if (device) {
+        await this._deviceManager.setOutputDevice(device.index);
+        this.emit('deviceChange', { index: device.index, name: device.name, info: device });
+      }
+    }
+  }
+
+  /**
+   * Move the open ring stream to another device without restarting decoding.
+   * Only possible when the new device can take the stream's channel count and sample format;
+   * the native resampler absorbs any change in sample rate.
+   *
+   * @private
+   * @param {object} device - Device info of the new output device.
+   * @returns {Promise<boolean>} True if the stream was switched, false if a restart is needed.
+   * @author zevinDev
+   */
+  async _switchStreamDevice(device) {
+    const portaudio = await this._deviceManager.getPortAudio();
+    const format = this._streamFormat;
+    if (!this._audioStream || !format || typeof portaudio.switchStreamDevice !== 'function') return false;
+    let next;
+    try {
+      next = negotiateAudioFormat(this._trackInfo ?? {}, device, portaudio);
+    } catch {
+      return false;
+    }
+    // Bit-perfect output must keep the source rate, and a channel change needs a new decoder
+    if (next.channels !== format.channels ||
+      (this._audioEffects.isBitPerfectMode() && next.sampleRate !== format.sampleRate)) {
+      return false;
+    }
+    try {
+      portaudio.switchStreamDevice(this._audioStream, { device: device.index, sampleRate: next.sampleRate });
+    } catch (error) {
+      console.warn('[AudioPlayer] Native device switch failed, restarting playback:', error.message);
+      return false;
+    }
+    format.sampleRate = next.sampleRate;
+    this.emit('resampleInfo', {
+      sampleRate: [format.sourceSampleRate, format.sampleRate],
+      bitDepth: [this._trackInfo?.bitDepth, format.bitDepth],
+      channels: [this._trackInfo?.channels, format.channels]
+    });
+    return true;
+  }
+
+  /**
+   * Enable the on-disk cache of decoded PCM. Tracks decoded from the start are written to
+   * the cache as they play; later plays of the same file and format are memory-mapped
+   * and streamed natively without spawning ffmpeg. The cache can be shared between processes.
+   *
+   * @param {object} options - Cache options.
+   * @param {string} options.directory - Cache directory.
+   * @param {number} [options.maxBytes] - Size cap in bytes; least recently used entries are evicted.
+   * @returns {void}
+   * @author zevinDev
+   */
+  enablePcmCache(options) {
+    this._pcmCache = new PcmCache(options);
+    this._pcmCache.evict();
+  }
+
+  /**
+   * Normalise track loudness. Tracks are measured (EBU R128 integrated loudness and
+   * true peak) natively in the background, a few ahead of the playlist position, and
+   * the results are kept in a sidecar file; each track then plays with its stored gain
+   * applied by the native mixer. Tracks not measured yet play unchanged.
+   *
+   * @param {object} [options] - Normalisation options.
+   * @param {string} [options.cacheFile] - Sidecar file for results (in memory only if omitted).
+   * @param {number} [options.targetLufs=-18] - Target loudness (ReplayGain 2.0 reference).
+   * @param {boolean} [options.preventClipping=true] - Limit gain so true peaks stay at or below 0 dBTP.
+   * @param {number} [options.concurrency=2] - Maximum tracks analysed at once.
+   * @param {number} [options.lookahead=3] - Upcoming playlist tracks to pre-analyse.
+   * @returns {Promise<void>} Resolves once the analyzer is ready.
+   * @throws {Error} If the native binding cannot analyse loudness, or in bit-perfect mode.
+   * @author zevinDev
+   */
+  async enableLoudnessNormalization(options = {}) {
+    this._audioEffects.validateEffectAvailability('volume');
+    const { cacheFile, targetLufs = -18, preventClipping = true, concurrency = 2, lookahead = 3 } = options;
+    const portaudio = await this._deviceManager.getPortAudio();
+    if (!this._ffmpegPath) {
+      this._ffmpegPath = await locateFFmpeg();
+    }
+    this._loudness?.destroy();
+    this._loudness = new LoudnessAnalyzer({ portaudio, ffmpegPath: this._ffmpegPath, cacheFile, concurrency });
+    this._loudnessOptions = { targetLufs, preventClipping };
+    this._playlistManager.setLoudnessAnalyzer(this._loudness, lookahead);
+  }
+
+  /**
+   * Stop loudness normalisation. Tracks started afterwards play unchanged.
+   *
+   * @returns {void}
+   * @author zevinDev
+   */
+  disableLoudnessNormalization() {
+    this._playlistManager.setLoudnessAnalyzer(null);
+    this._loudness?.destroy();
+    this._loudness = null;
+    this._loudnessOptions = null;
+  }
+
+  /**
+   * Measure a track's loudness, or return its stored measurement.
+   *
+   * @param {string} filePath - Audio file.
+   * @returns {Promise<object>} { integrated (LUFS), range (LU), truePeak (dBTP), samplePeak (dBFS), duration }.
+   * @throws {Error} If normalisation is not enabled or the file cannot be decoded.
+   * @author zevinDev
+   */
+  async analyzeLoudness(filePath) {
+    if (!this._loudness) {
+      throw new Error('Loudness normalisation is not enabled.');
+    }
+    return this._loudness.analyze(filePath);
+  }
+
+  /**
+   * Set a voice's native track gain from the file's stored loudness.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Ring-mode stream ID.
+   * @param {number} voiceId - Voice about to play the file.
+   * @param {string} filePath - Audio file.
+   * @author zevinDev
+   */
+  _applyTrackGain(portaudio, streamId, voiceId, filePath) {
+    if (!this._loudness || typeof portaudio.setVoiceTrim !== 'function' || this._audioEffects.isBitPerfectMode()) return;
+    const gainDb = this._loudness.gainFor(filePath, this._loudnessOptions);
+    if (gainDb === null) {
+      // Measure it now so the next play is normalised
+      this._loudness.prefetch([filePath]);
+      return;
+    }
+    try {
+      portaudio.setVoiceTrim(streamId, voiceId, Math.pow(10, gainDb / 20));
+    } catch (error) {
+      handleError(error, 'applyTrackGain', this);
+    }
+  }
+
+  /**
+   * Stop using the PCM cache (existing entries stay on disk).
+   *
+   * @returns {void}
+   * @author zevinDev
+   */
+  disablePcmCache() {
+    this._pcmCache = null;
+  }
+
+  /**
+   * Run the native audio callback and decoder feeder threads at real-time priority
+   * (SCHED_FIFO on Linux, MMCSS "Pro Audio" on Windows, the time-constraint policy on
+   * macOS), optionally pinned to one CPU, with their buffers locked in memory. This is
+   * what makes small buffers (see setBufferSize) reliable on busy hosts. Applies to
+   * streams opened afterwards; whether the system granted it shows in
+   * getStreamStats().threadTuning. Pass false to turn it off.
+   *
+   * @param {boolean|object} options - true, false, or tuning options.
+   * @param {number} [options.priority=70] - SCHED_FIFO priority of the callback thread (1-99, Linux).
+   * @param {number} [options.cpu] - CPU to pin the audio threads to.
+   * @param {boolean} [options.lockMemory=true] - Lock stream and voice buffers in memory.
+   * @returns {void}
+   * @throws {Error} If the priority or CPU is out of range.
+   * @author zevinDev
+   */
+  setRealtimeScheduling(options = true) {
+    if (!options) {
+      this._threadTuning = null;
+      return;
+    }
+    const { priority = 70, cpu, lockMemory = true } = options === true ? {} : options;
+    if (!Number.isInteger(priority) || priority < 1 || priority > 99) {
+      throw new Error('Invalid realtime priority: must be an integer from 1 to 99');
+    }
+    if (cpu !== undefined && (!Number.isInteger(cpu) || cpu < 0)) {
+      throw new Error('Invalid CPU: must be a non-negative integer');
+    }
+    this._threadTuning = { realtime: true, realtimePriority: priority, cpu, lockMemory: Boolean(lockMemory) };
+  }
+
+  /**
+   * Set host-API-specific stream settings for streams opened afterwards. Only the entry
+   * for the host API of the output device is used, so one configuration can cover every
+   * platform. Pass null to go back to the defaults.
+   *
+   * @param {object|null} options - Host options.
+   * @param {object} [options.hostApi] - { wasapi: { exclusive, threadPriority, polling, autoConvert },
+   *   alsa: { device, realtime }, coreAudio: { changeDeviceParameters, failIfConversionRequired } }.
+   *   threadPriority is one of none, audio, capture, distribution, games, playback,
+   *   proAudio or windowManager; alsa.device is a device string such as 'hw:0,0'.
+   * @param {boolean} [options.clipOff] - Do not clip out-of-range samples (paClipOff).
+   * @param {boolean} [options.ditherOff] - Do not dither when converting formats (paDitherOff).
+   * @returns {void}
+   * @author zevinDev
+   */
+  setHostApiOptions(options) {
+    this._hostApiOptions = options ? { ...options } : null;
+  }
+
+  /**
+   * Open the output stream, falling back when an optional part of the request fails:
+   * without the duplex input, then in shared instead of exclusive mode.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {object} streamOpts - openStreamAsync() options.
+   * @returns {Promise<number>} Stream ID.
+   * @author zevinDev
+   */
+  async _openOutputStream(portaudio, streamOpts) {
+    try {
+      return await portaudio.openStreamAsync(streamOpts);
+    } catch (error) {
+      if (streamOpts.input || streamOpts.capture) {
+        // Playback goes on even if the input device is missing or busy
+        this.emit('streamEvent', { type: 'inputUnavailable', message: `Input unavailable: ${error.message}` });
+        const { input, capture, captureRingFrames, ...playback } = streamOpts;
+        return this._openOutputStream(portaudio, playback);
+      }
+      // The device may be held by another application: fall back to shared mode
+      if (!this._audioEffects.isExclusiveBitPerfect() || this._hostApiOptions?.hostApi || !streamOpts.hostApi) throw error;
+      this.emit('streamEvent', { type: 'exclusiveUnavailable', message: `Exclusive mode unavailable: ${error.message}` });
+      return portaudio.openStreamAsync({ ...streamOpts, hostApi: undefined });
+    }
+  }
+
+  /**
+   * Route an input device through the output stream natively: monitor it in the mix,
+   * duck the playback while it is active (talkover), and record it (or the output mix)
+   * into a capture ring. Monitoring latency is one device period, since the audio
+   * callback mixes the input itself. Gain and ducking change on the open stream; the
+   * device, channels and capture source apply from the next stream opened.
+   * Bit-perfect streams only capture.
+   *
+   * @param {object|null} options - Duplex options, or null to disable.
+   * @param {number} [options.device] - Input device index (default input device).
+   * @param {number} [options.channels] - Input channels (up to 2 by default).
+   * @param {number} [options.suggestedLatency] - Input latency in seconds.
+   * @param {number} [options.monitorGain=0] - Linear gain of the input in the output.
+   * @param {boolean|object} [options.duck=false] - Duck playback under the input:
+   *   true, or { gain, threshold, attackMs, releaseMs, holdMs }.
+   * @param {string} [options.capture='input'] - 'input', 'output' (loopback) or 'none'.
+   * @param {number} [options.captureRingFrames] - Capture ring size (default 2 s).
+   * @returns {void}
+   * @fires AudioPlayer#captureStart
+   * @author zevinDev
+   */
+  setInputMonitoring(options) {
+    this._duplexOptions = options ? { ...options } : null;
+    const portaudio = this._deviceManager.getLoadedPortAudio();
+    if (!this._capture?.duplex || this._capture.streamId !== this._audioStream || !portaudio) return;
+    try {
+      portaudio.setDuplex(this._audioStream, {
+        monitorGain: options?.monitorGain ?? 0,
+        duck: options?.duck ?? false
+      });
+    } catch (error) {
+      handleError(error, 'setInputMonitoring', this);
+    }
+  }
+
+  /**
+   * Reader for the open stream's capture ring; drain it every few hundred ms.
+   *
+   * @returns {PcmRingReader|null} Capture reader, or null when the stream does not capture.
+   * @author zevinDev
+   */
+  getCaptureReader() {
+    return this._capture && this._capture.streamId === this._audioStream ? this._capture.reader : null;
+  }
+
+  /**
+   * Duplex options for the next stream.
+   *
+   * @private
+   * @param {boolean} bitPerfect - Whether the stream is bit-perfect (capture only).
+   * @returns {object} Stream options.
+   * @author zevinDev
+   */
+  _duplexStreamOptions(bitPerfect) {
+    if (!this._duplexOptions) return {};
+    // The binding reads every key it is given, so leave unset ones out
+    const defined = object => Object.fromEntries(Object.entries(object).filter(([, value]) => value !== undefined));
+    const { capture = 'input', captureRingFrames, monitorGain, duck, ...device } = defined(this._duplexOptions);
+    // Bit-perfect output has nothing mixed into it, and never exists as float for loopback
+    const mixInput = !bitPerfect && (monitorGain > 0 || Boolean(duck));
+    if (capture === 'output' && bitPerfect) return {};
+    const input = capture === 'input' || mixInput ? defined({ ...device, monitorGain: mixInput ? monitorGain : undefined, duck: mixInput ? duck : undefined }) : undefined;
+    return defined({ input, capture, captureRingFrames });
+  }
+
+  /**
+   * Attach a reader to a new stream's capture ring and announce it.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Stream just opened.
+   * @param {number} sampleRate - Stream rate.
+   * @author zevinDev
+   */
+  _startCapture(portaudio, streamId, sampleRate) {
+    this._capture = null;
+    if (!this._duplexOptions || typeof portaudio.getDuplexState !== 'function') return;
+    let state;
+    try {
+      state = portaudio.getDuplexState(streamId);
+    } catch {
+      // Opened without its input (see _openOutputStream)
+      return;
+    }
+    const ring = state.capture !== 'none' ? portaudio.getCaptureRing(streamId) : null;
+    this._capture = {
+      streamId,
+      duplex: state.inputChannels > 0,
+      reader: ring ? new PcmRingReader(ring.buffer, ring.channels) : null
+    };
+    if (this._capture.reader) {
+      /**
+       * @event AudioPlayer#captureStart
+       * @type {object}
+       * @property {PcmRingReader} reader - Capture ring reader of the new stream.
+       * @property {string} source - 'input' or 'output'.
+       * @property {number} channels - Channels per frame.
+       * @property {number} sampleRate - Frames per second.
+       */
+      this.emit('captureStart', { reader: this._capture.reader, source: ring.source, channels: ring.channels, sampleRate });
+    }
+  }
+
+  /**
+   * Host options for the next stream: the user's, or exclusive access for bit-perfect.
+   *
+   * @private
+   * @returns {object} Stream options.
+   * @author zevinDev
+   */
+  _hostStreamOptions() {
+    if (this._hostApiOptions) return this._hostApiOptions;
+    if (!this._audioEffects.isExclusiveBitPerfect()) return {};
+    return {
+      hostApi: {
+        wasapi: { exclusive: true, threadPriority: 'proAudio' },
+        coreAudio: { changeDeviceParameters: true, failIfConversionRequired: true }
+      }
+    };
+  }
+
+  /**
+   * Set the quality of the native sample-rate converter used when the track and device
+   * rates differ. Applies to streams opened afterwards.
+   *
+   * @param {string} quality - 'low', 'medium', 'high' (default) or 'best'.
+   * @returns {void}
+   * @throws {Error} If the quality is unknown.
+   * @author zevinDev
+   */
+  setResampleQuality(quality) {
+    if (!['low', 'medium', 'high', 'best'].includes(quality)) {
+      throw new Error('Invalid resample quality: must be "low", "medium", "high", or "best"');
+    }
+    this._resampleQuality = quality;
+  }
+
   /**
    * Enable or disable bit-perfect output mode.
    *
@@ -894,6 +1718,123 @@ export class AudioPlayer extends EventEmitter {
     this._visualizationCallback = callback;
   }
 
+  /**
+   * Receive output levels and a spectrum computed natively at a fixed UI rate, instead
+   * of raw PCM. Unlike onVisualization(), samples stay native (cache, native decoding
+   * and the native pipe remain in use) and bit-perfect playback is unaffected.
+   *
+   * @param {Function|null} callback - Called with { peak, rms, bands } (Float32Arrays reused between calls: peak and RMS are linear per channel, bands are dBFS); null to stop.
+   * @param {object} [options] - Analysis options.
+   * @param {number} [options.fftSize=2048] - FFT size (power of two, 64-16384).
+   * @param {number} [options.bands=64] - Number of log-spaced bands.
+   * @param {number} [options.rate=30] - Results per second.
+   * @returns {void}
+   * @author zevinDev
+   * @example
+   * player.onAnalysis(({ rms, bands }) => draw(rms, bands), { bands: 32, rate: 60 });
+   */
+  onAnalysis(callback, options = {}) {
+    this._analysisCallback = callback;
+    this._analysisOptions = options;
+    const portaudio = this._deviceManager.getLoadedPortAudio();
+    if (portaudio && this._audioStream !== null) {
+      this._applyAnalysisTap(portaudio, this._audioStream);
+    }
+  }
+
+  /**
+   * Install (or remove) the native analysis tap on a stream.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Stream to analyse.
+   * @author zevinDev
+   */
+  _applyAnalysisTap(portaudio, streamId) {
+    if (typeof portaudio.setAnalysisTap !== 'function') return;
+    try {
+      portaudio.setAnalysisTap(streamId, this._analysisCallback, this._analysisOptions ?? {});
+    } catch (error) {
+      handleError(error, 'onAnalysis', this);
+    }
+  }
+
+  /**
+   * Set the parametric EQ. Runs natively in the output callback, so changes apply
+   * within one buffer without restarting the decoder.
+   *
+   * @param {object[]} bands - Up to 16 bands: { type?: 'peaking'|'lowshelf'|'highshelf'|'lowpass'|'highpass', frequency, q?, gain? (dB) }; [] for none.
+   * @returns {void}
+   * @throws {Error} If a band is invalid or in bit-perfect mode.
+   * @fires AudioPlayer#dspChange
+   * @author zevinDev
+   * @example
+   * player.setEqualizer([{ type: 'lowshelf', frequency: 100, gain: 4 }, { frequency: 3000, q: 1.4, gain: -2 }]);
+   */
+  setEqualizer(bands) {
+    this._audioEffects.setEqualizer(bands);
+    this._dspChanged();
+  }
+
+  /**
+   * Set the output limiter, the last stage of the native DSP chain.
+   *
+   * @param {object|null} options - { ceiling? (dBFS, default -1), lookaheadMs? (0-20, default 5), releaseMs? (default 50) }; null to disable.
+   * @returns {void}
+   * @throws {Error} If options are invalid or in bit-perfect mode.
+   * @fires AudioPlayer#dspChange
+   * @author zevinDev
+   */
+  setLimiter(options) {
+    this._audioEffects.setLimiter(options);
+    this._dspChanged();
+  }
+
+  /**
+   * Set the channel matrix applied before the EQ (out[o] = sum of matrix[o][i] * in[i]).
+   *
+   * @param {number[][]|null} matrix - Square matrix matching the stream's channel count; null to disable.
+   * @returns {void}
+   * @throws {Error} If the matrix is invalid or in bit-perfect mode.
+   * @fires AudioPlayer#dspChange
+   * @author zevinDev
+   */
+  setChannelMatrix(matrix) {
+    this._audioEffects.setChannelMatrix(matrix);
+    this._dspChanged();
+  }
+
+  /**
+   * Push the DSP configuration to the open stream and notify listeners.
+   *
+   * @private
+   * @author zevinDev
+   */
+  _dspChanged() {
+    const portaudio = this._deviceManager.getLoadedPortAudio();
+    if (portaudio && this._audioStream !== null && !this._audioEffects.isBitPerfectMode()) {
+      this._applyDsp(portaudio, this._audioStream);
+    }
+    this.emit('dspChange', this._audioEffects.getDspConfig());
+  }
+
+  /**
+   * Install the DSP configuration on a stream.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Stream to configure.
+   * @author zevinDev
+   */
+  _applyDsp(portaudio, streamId) {
+    if (typeof portaudio.setStreamDsp !== 'function') return;
+    try {
+      portaudio.setStreamDsp(streamId, this._audioEffects.getDspConfig());
+    } catch (error) {
+      handleError(error, 'applyDsp', this);
+    }
+  }
+
   /**
    * Set buffer size/latency for playback.
    *
@@ -905,6 +1846,110 @@ export class AudioPlayer extends EventEmitter {
     this._bufferSize = frames;
   }
 
+  /**
+   * Size the output buffer from observed underruns instead of a fixed value.
+   * Playback starts at a low-latency size; when device underflows or starved callbacks
+   * cross the threshold the open stream is reopened in place with the next larger buffer
+   * (voices and decoders keep running), and it steps back down after a stable stretch.
+   * The learned size carries over to later tracks. Overrides setBufferSize() while enabled,
+   * and takes effect from the next stream opened.
+   *
+   * @param {object|boolean} options - Sizing options (see AdaptiveBufferController), true for defaults, or false to disable.
+   * @param {number} [options.minFrames=128] - Smallest buffer in frames.
+   * @param {number} [options.maxFrames=4096] - Largest buffer in frames.
+   * @param {number} [options.initialFrames] - Starting buffer (defaults to minFrames).
+   * @param {number} [options.growThreshold=2] - Dropouts within windowMs that make the buffer grow.
+   * @param {number} [options.windowMs=10000] - Window dropouts are counted over.
+   * @param {number} [options.stableMs=60000] - Dropout-free time before the buffer shrinks.
+   * @param {boolean} [options.unspecified=false] - Let the host API choose the period
+   *   (paFramesPerBufferUnspecified) and adapt the suggested latency instead.
+   * @param {number} [options.intervalMs=1000] - How often the stream's counters are checked.
+   * @returns {void}
+   * @fires AudioPlayer#bufferSizeChange
+   * @author zevinDev
+   */
+  setAdaptiveBuffering(options) {
+    if (!options) {
+      this._adaptiveBuffer = null;
+      this._stopAdaptiveBuffering();
+      return;
+    }
+    const config = options === true ? {} : options;
+    this._adaptiveBuffer = new AdaptiveBufferController(config);
+    this._adaptiveIntervalMs = Math.max(100, config.intervalMs ?? 1000);
+    // Applies to the next stream; the open one keeps its size until then
+    this._stopAdaptiveBuffering();
+  }
+
+  /**
+   * Period of the streams we open: the adaptive size, or the fixed one.
+   *
+   * @private
+   * @returns {number} Frames per buffer.
+   * @author zevinDev
+   */
+  _periodFrames() {
+    return this._adaptiveBuffer ? this._adaptiveBuffer.frames : this._bufferSize ?? 2048;
+  }
+
+  /**
+   * Watch a new stream's xrun counters and resize it when the adaptive sizing asks to.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Ring-mode stream ID.
+   * @author zevinDev
+   */
+  _startAdaptiveBuffering(portaudio, streamId) {
+    this._stopAdaptiveBuffering();
+    const sizing = this._adaptiveBuffer;
+    if (!sizing || typeof portaudio.switchStreamDevice !== 'function') return;
+    sizing.reset();
+    this._adaptiveTimer = setInterval(() => {
+      if (this._audioStream !== streamId || this._adaptiveBuffer !== sizing) {
+        this._stopAdaptiveBuffering();
+        return;
+      }
+      // A paused stream has no callbacks to judge
+      if (this._paused) return;
+      let change;
+      try {
+        change = sizing.sample(portaudio.getStreamStats(streamId));
+        if (!change) return;
+        const sampleRate = this._streamFormat.sampleRate;
+        portaudio.switchStreamDevice(streamId, sizing.unspecified
+          ? { framesPerBuffer: 0, suggestedLatency: change.frames / sampleRate }
+          : { framesPerBuffer: change.frames });
+      } catch (error) {
+        if (change) sizing.revert(change);
+        handleError(error, 'adaptiveBuffering', this);
+        return;
+      }
+      /**
+       * @event AudioPlayer#bufferSizeChange
+       * @type {object}
+       * @property {number} frames - New buffer size in frames.
+       * @property {number} previous - Previous buffer size.
+       * @property {string} reason - 'underruns' or 'stable'.
+       * @property {number} dropouts - Dropouts in the window that caused a grow.
+       */
+      this.emit('bufferSizeChange', change);
+    }, this._adaptiveIntervalMs);
+  }
+
+  /**
+   * Stop the adaptive sizing monitor.
+   *
+   * @private
+   * @author zevinDev
+   */
+  _stopAdaptiveBuffering() {
+    if (this._adaptiveTimer) {
+      clearInterval(this._adaptiveTimer);
+      this._adaptiveTimer = null;
+    }
+  }
+
   /**
    * Set the crossfade duration.
    *
@@ -937,6 +1982,7 @@ export class AudioPlayer extends EventEmitter {
    * Get current playback status.
    *
    * @returns {object} Playback status object with isPlaying, isPaused, currentTrack, etc.
+   *   `stats` holds the open stream's telemetry (see getStreamStats) or null.
    * @author zevinDev
    */
   getStatus() {
@@ -946,13 +1992,37 @@ export class AudioPlayer extends EventEmitter {
       currentTrack: this._currentTrack,
       volume: this._volume,
       bufferSize: this._bufferSize,
+      adaptiveBuffer: this._adaptiveBuffer?.getState() ?? null,
       playlist: this._playlistManager.getPlaylistStatus(),
       effects: this._audioEffects.getConfiguration(),
       device: this._deviceManager.getCurrentDevice(),
-      streaming: this._streamManager.isStreaming()
+      streaming: this._streamManager.isStreaming(),
+      streamBuffer: this._streamManager.getBufferState(),
+      stats: this._getStreamStats()
     };
   }
 
+  /**
+   * Get telemetry for the open output stream: CPU load, latencies, underflow/overflow
+   * counts and callback timing histograms.
+   *
+   * @returns {object|null} Stream stats, or null when no stream is open.
+   * @author zevinDev
+   */
+  _getStreamStats() {
+    const portaudio = this._deviceManager.getLoadedPortAudio();
+    if (!this._audioStream || !portaudio || typeof portaudio.getStreamStats !== 'function') return null;
+    try {
+      const stats = portaudio.getStreamStats(this._audioStream);
+      if (stats && typeof portaudio.getStreamDsp === 'function') {
+        stats.dsp = portaudio.getStreamDsp(this._audioStream);
+      }
+      return stats;
+    } catch {
+      return null;
+    }
+  }
+
   /**
    * Get manager instances for advanced usage.
    *
@@ -997,21 +2067,20 @@ export class AudioPlayer extends EventEmitter {
     const dt = 1 / sampleRate;
     const totalFrames = sampleRate * durationSec;
     let framesPlayed = 0;
-    // New pattern: return a new buffer for each callback
-    const audioCallback = () => {
-      const buffer = new Float32Array(framesPerBuffer * channels);
-      for (let i = 0; i < buffer.length; i += channels) {
+    // Fill the stream's reused period buffer in place
+    const audioCallback = (buffer, frames) => {
+      for (let i = 0; i < frames * channels; i += channels) {
         const sample = Math.sin(2 * Math.PI * freq * t);
         for (let c = 0; c < channels; ++c) {
           buffer[i + c] = sample;
         }
         t += dt;
       }
-      framesPlayed += framesPerBuffer;
+      framesPlayed += frames;
       if (framesPlayed >= totalFrames) {
         buffer.fill(0);
       }
-      return buffer;
+      return frames;
     };
     const streamOpts = {
       device: device.index,
@@ -1032,6 +2101,54 @@ export class AudioPlayer extends EventEmitter {
    */
   getCurrentTime() {
     if (!this._isPlaying) return 0;
-    return this._framesPlayed / this._currentSampleRate;
+    // Count only frames the native callback actually consumed from the ring, minus
+    // those still queued in the device, so the time matches what is audible
+    const ring = this._source?.ring;
+    const consumedFrames = ring ? ring.consumedBytes() / ring.bytesPerFrame : 0;
+    // The clock counts device frames, which differ from source frames when resampling
+    const pendingSeconds = this._clock ? this._clock.pendingFrames() / (this._clock.snapshot().sampleRate || this._currentSampleRate) : 0;
+    const consumedSeconds = consumedFrames / this._currentSampleRate;
+    return this._framesPlayed / this._currentSampleRate + Math.max(consumedSeconds - pendingSeconds, 0);
+  }
+
+  /**
+   * Get the native playback clock of the open stream.
+   * Cheap enough to sample every animation frame (it reads shared memory only).
+   *
+   * @returns {StreamClock|null} Clock, or null when no stream is open.
+   * @author zevinDev
+   */
+  getPlaybackClock() {
+    return this._clock;
+  }
+
+  /**
+   * Set how often the 'currentTime' event fires.
+   *
+   * @param {number} intervalMs - Interval in milliseconds (minimum 10).
+   * @returns {void}
+   * @author zevinDev
+   */
+  setCurrentTimeInterval(intervalMs) {
+    if (typeof intervalMs !== 'number' || isNaN(intervalMs)) {
+      throw new Error('Interval must be a number of milliseconds');
+    }
+    this._currentTimeIntervalMs = Math.max(10, intervalMs);
+    if (this._currentTimeInterval) this._startCurrentTimeUpdates();
+  }
+
+  /**
+   * (Re)start the periodic 'currentTime' event.
+   *
+   * @private
+   * @author zevinDev
+   */
+  _startCurrentTimeUpdates() {
+    if (this._currentTimeInterval) clearInterval(this._currentTimeInterval);
+    this._currentTimeInterval = setInterval(() => {
+      if (this._isPlaying && !this._paused) {
+        this.emit('currentTime', this.getCurrentTime());
+      }
+    }, this._currentTimeIntervalMs);
   }
 }
@@ -9,6 +9,9 @@ import { handleError } from '../utils/ErrorHandler.js';
 import { createRequire } from 'module';
 const require = createRequire(import.meta.url);
 
+// Identity of a device across rescans, which renumber the devices
+const deviceKey = d => `${d.hostApi}\n${d.name}\n${d.maxInputChannels}\n${d.maxOutputChannels}`;
+
 /**
  * DeviceManager handles audio device discovery and selection.
  * Supports robust device selection across all PortAudio device types.
@@ -20,6 +23,10 @@ export class DeviceManager {
   constructor() {
     this._outputDevice = null;
     this._portaudio = null;
+    this._capabilityProbe = null;
+    // Hotplug watching (see watchDevices): last known device list, pending rescan state
+    this._deviceWatch = null;
+    this._knownDevices = null;
   }
 
   /**
@@ -42,10 +49,190 @@ export class DeviceManager {
         throw new Error('PortAudio binding or getDevices() not available. Make sure the Native Binding is built correctly.');
       }
       await this._portaudio.init();
+      // Probe every output device in the background so track start never does
+      this.probeCapabilities();
     }
     return this._portaudio;
   }
 
+  /**
+   * Fill the native device capability cache on a worker thread. Results stay cached
+   * until the device list changes, so getDeviceCapabilities() is a lookup afterwards.
+   *
+   * @returns {Promise<Array<object>>} Resolves with the capabilities of each output device (empty if unsupported or on failure).
+   * @author zevinDev
+   */
+  probeCapabilities() {
+    const portaudio = this._portaudio;
+    if (!portaudio || typeof portaudio.probeDeviceCapabilitiesAsync !== 'function') {
+      return Promise.resolve([]);
+    }
+    const probe = portaudio.probeDeviceCapabilitiesAsync().catch(error => {
+      handleError(error, 'probeCapabilities');
+      return [];
+    });
+    this._capabilityProbe = probe;
+    probe.finally(() => {
+      if (this._capabilityProbe === probe) this._capabilityProbe = null;
+    });
+    return probe;
+  }
+
+  /**
+   * Wait for a background capability probe, if one is running, so capability lookups
+   * do not block the event loop behind it.
+   *
+   * @returns {Promise<void>} Resolves once no probe is in flight.
+   * @author zevinDev
+   */
+  async whenCapabilitiesReady() {
+    if (this._capabilityProbe) await this._capabilityProbe;
+  }
+
+  /**
+   * Drop cached device capabilities and probe again (e.g. after a device was
+   * reconfigured outside the application).
+   *
+   * @returns {Promise<Array<object>>} Resolves with the fresh capabilities.
+   * @author zevinDev
+   */
+  refreshCapabilities() {
+    this._portaudio?.invalidateDeviceCapabilities?.();
+    return this.probeCapabilities();
+  }
+
+  /**
+   * Watch for audio devices being plugged in or removed. Platform notifications
+   * (WASAPI, CoreAudio, inotify on /dev/snd) are debounced, then the PortAudio device
+   * list is rescanned on a worker thread and onChange receives the difference.
+   * PortAudio can only rescan by reinitialising, which stops every open stream. So while
+   * streams are open the rescan waits (retried every retryMs) until playback stops, and
+   * a newly added device only shows up then. The exception is a removal that took away
+   * the device of an open stream (portaudio.getLostStreams()): that stream plays nothing
+   * anyway, so the rescan runs at once with refreshDevices({ reopenStreams: true }). Note
+   * that this briefly stops and reopens the other open streams too.
+   *
+   * @param {Function} onChange - Called with {reasons, added, removed, devices, moved, closed, selectedDeviceRemoved}.
+   * @param {object} [options] - Watch options.
+   * @param {number} [options.debounceMs=500] - Quiet time after the last notification before rescanning.
+   * @param {number} [options.retryMs=2000] - Retry interval for a rescan deferred by open streams.
+   * @param {boolean} [options.reopenOnRemoval=true] - Rescan under open streams when an open stream's device went away.
+   * @returns {Promise<string|null>} Notification source, or null if the platform has none.
+   * @author zevinDev
+   */
+  async watchDevices(onChange, { debounceMs = 500, retryMs = 2000, reopenOnRemoval = true } = {}) {
+    if (typeof onChange !== 'function') {
+      throw new TypeError('onChange must be a function');
+    }
+    const portaudio = await this._initPortAudio();
+    if (typeof portaudio.watchDevices !== 'function') return null;
+    this.unwatchDevices();
+    this._knownDevices = await portaudio.getDevices();
+    const watch = { onChange, debounceMs, retryMs, reopenOnRemoval, reasons: new Set(), timer: null };
+    const backend = portaudio.watchDevices(reason => {
+      watch.reasons.add(reason);
+      this._scheduleDeviceRefresh(watch, watch.debounceMs);
+    });
+    if (!backend) return null;
+    this._deviceWatch = watch;
+    return backend;
+  }
+
+  /**
+   * Stop watching for device changes.
+   *
+   * @returns {void}
+   * @author zevinDev
+   */
+  unwatchDevices() {
+    if (!this._deviceWatch) return;
+    clearTimeout(this._deviceWatch.timer);
+    this._deviceWatch = null;
+    this._portaudio?.unwatchDevices?.();
+  }
+
+  /**
+   * Rescan the PortAudio device list and work out what changed since the last scan.
+   * Without open streams this runs on a worker thread. With open streams it only
+   * happens if reopenStreams is set. In that case every open stream is stopped, including
+   * streams whose device did not change, and reopened on its device after the rescan.
+   * Output stops for the length of the rescan. The streams' rings, voices and DSP are
+   * kept, but anything the device had queued is lost, and a stream whose device is gone
+   * moves to the default device. The selected output device is followed to its new index.
+   *
+   * @param {object} [options] - Refresh options.
+   * @param {boolean} [options.reopenStreams=false] - Rescan even though streams are open.
+   * @returns {Promise<{rescanned: boolean, added: Array<object>, removed: Array<object>, devices: Array<object>, moved: number[], closed: number[], selectedDeviceRemoved: boolean}>}
+   *   The changes; rescanned is false (and nothing changed) when open streams prevented it.
+   * @author zevinDev
+   */
+  async refreshDevices({ reopenStreams = false } = {}) {
+    const portaudio = await this._initPortAudio();
+    const previous = this._knownDevices ?? await portaudio.getDevices();
+    let streams = { moved: [], closed: [] };
+    let rescanned = await portaudio.refreshDevicesAsync();
+    if (!rescanned && reopenStreams) {
+      streams = portaudio.refreshDevices();
+      rescanned = true;
+    }
+    if (!rescanned) {
+      return { rescanned, added: [], removed: [], devices: previous, moved: [], closed: [], selectedDeviceRemoved: false };
+    }
+    const devices = await portaudio.getDevices();
+    this._knownDevices = devices;
+    const previousKeys = new Set(previous.map(deviceKey));
+    const currentKeys = new Set(devices.map(deviceKey));
+    const added = devices.filter(d => !previousKeys.has(deviceKey(d)));
+    const removed = previous.filter(d => !currentKeys.has(deviceKey(d)));
+    // Indices shift on a rescan; keep the selection on the same physical device
+    let selectedDeviceRemoved = false;
+    if (this._outputDevice) {
+      const selected = devices.find(d => deviceKey(d) === deviceKey(this._outputDevice));
+      selectedDeviceRemoved = !selected;
+      this._outputDevice = selected ?? null;
+    }
+    this.probeCapabilities();
+    return { rescanned, added, removed, devices, ...streams, selectedDeviceRemoved };
+  }
+
+  /**
+   * Debounced rescan for watchDevices().
+   *
+   * @private
+   * @param {object} watch - Watch state.
+   * @param {number} delayMs - Delay before rescanning.
+   * @author zevinDev
+   */
+  _scheduleDeviceRefresh(watch, delayMs) {
+    clearTimeout(watch.timer);
+    watch.timer = setTimeout(async () => {
+      if (this._deviceWatch !== watch) return;
+      const reasons = [...watch.reasons];
+      // Only worth stopping every stream when one of them lost its device
+      const reopenStreams = watch.reopenOnRemoval && reasons.some(reason => reason !== 'added') &&
+        (this._portaudio?.getLostStreams?.() ?? []).length > 0;
+      let change;
+      try {
+        change = await this.refreshDevices({ reopenStreams });
+      } catch (error) {
+        // A blocking-mode stream or another environment's stream is open; wait for it
+        handleError(error, 'refreshDevices');
+        change = { rescanned: false };
+      }
+      if (this._deviceWatch !== watch) return;
+      if (!change.rescanned) {
+        this._scheduleDeviceRefresh(watch, watch.retryMs);
+        return;
+      }
+      watch.reasons.clear();
+      const { rescanned, ...diff } = change;
+      if (diff.added.length || diff.removed.length || diff.moved.length || diff.closed.length || reasons.includes('default')) {
+        try { watch.onChange({ reasons, ...diff }); } catch (error) { handleError(error, 'deviceListChange'); }
+      }
+    }, delayMs);
+    watch.timer.unref?.();
+  }
+
   /**
    * List available PortAudio output devices, optionally filtered by host API.
    *
@@ -225,4 +412,14 @@ export class DeviceManager {
   async getPortAudio() {
     return await this._initPortAudio();
   }
+
+  /**
+   * Get the PortAudio instance if it has already been initialized, without loading it.
+   * 
+   * @returns {object|null} PortAudio instance, or null before the first getPortAudio()
+   * @author zevinDev
+   */
+  getLoadedPortAudio() {
+    return this._portaudio;
+  }
 }
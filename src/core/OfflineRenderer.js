@@ -0,0 +1,357 @@
+/**
+ * @module OfflineRenderer
+ * @author zevinDev
+ * @description Faster-than-real-time rendering of crossfaded mixes to a file or buffer
+ */
+
+import { availableParallelism } from 'node:os';
+import { closeSync, ftruncateSync, openSync, writeSync } from 'node:fs';
+import { DeviceManager } from './DeviceManager.js';
+import { locateFFmpeg, getAudioInfo, buildFFmpegArgs, createFFmpegProcess, killFFmpegProcess } from '../utils/FFmpegUtils.js';
+import { bytesPerSample } from '../utils/AudioUtils.js';
+import { canDecodeNatively, probeNativeAudio } from '../utils/NativeDecoder.js';
+
+const WAV_HEADER_BYTES = 44;
+
+/**
+ * Renders playlists with crossfades through the same native pipeline as playback (voice
+ * rings, mixer, gain envelopes, stream volume and DSP), but on offline streams that have
+ * no device: the mixer runs on a native thread as fast as the decoders feed it.
+ * A mix is cut into segments at points where a single track plays alone, and segments
+ * render in parallel (each with its own decoder processes and render thread), writing
+ * straight to their place in the output file. Offline streams are POSIX-only: on
+ * Windows renderMix() rejects.
+ *
+ * @class
+ * @author zevinDev
+ * @example
+ * const renderer = new OfflineRenderer({ sampleRate: 44100, sampleFormat: 's16le' });
+ * const result = await renderer.renderMix(['a.flac', { path: 'insert.wav', gain: 0.8 }, 'b.mp3'], {
+ *   output: 'mix.wav', crossfade: { duration: 6, curve: 'equal-power' }
+ * });
+ */
+export class OfflineRenderer {
+  /**
+   * @param {object} [options] - Renderer options.
+   * @param {DeviceManager} [options.deviceManager] - Device manager that loads the binding.
+   * @param {number} [options.sampleRate=44100] - Output rate (tracks are decoded at it).
+   * @param {number} [options.channels=2] - Output channels.
+   * @param {string} [options.sampleFormat='f32le'] - 'f32le', 's16le', 's24le' or 's32le'.
+   * @param {number} [options.volume=1] - Master volume.
+   * @param {object} [options.dsp] - Output DSP, as for portaudio.setStreamDsp().
+   * @param {number} [options.concurrency] - Segments rendered at once (defaults to the core count).
+   * @param {number} [options.segmentSeconds=120] - Longest stretch of a solo track one segment renders.
+   */
+  constructor({
+    deviceManager,
+    sampleRate = 44100,
+    channels = 2,
+    sampleFormat = 'f32le',
+    volume = 1,
+    dsp = null,
+    concurrency = availableParallelism(),
+    segmentSeconds = 120
+  } = {}) {
+    this._deviceManager = deviceManager ?? new DeviceManager();
+    this._ffmpegPath = null;
+    this._sampleRate = sampleRate;
+    this._channels = channels;
+    this._sampleFormat = sampleFormat;
+    this._bytesPerFrame = channels * bytesPerSample(sampleFormat);
+    this._volume = volume;
+    this._dsp = dsp;
+    this._concurrency = Math.max(1, Math.floor(concurrency));
+    this._segmentFrames = Math.max(1, Math.round(segmentSeconds * sampleRate));
+    // Segment renders waiting for a slot (see _limit)
+    this._active = 0;
+    this._waiting = [];
+  }
+
+  /**
+   * Render tracks back to back, each crossfading into the next.
+   *
+   * @param {Array<string|{path: string, start?: number, end?: number, gain?: number}>} tracks - Files,
+   *   optionally trimmed to [start, end) seconds and with a fixed gain.
+   * @param {object} [options] - Mix options.
+   * @param {string} [options.output] - WAV file to write; without it the PCM is returned in a Buffer.
+   * @param {{duration?: number, curve?: string}} [options.crossfade] - Crossfade length in seconds
+   *   (default 5, 0 for gapless) and curve ('linear', 'log', 'exp', 'equal-power').
+   * @returns {Promise<{frames: number, duration: number, renderSeconds: number, segments: number, stalls: number, buffer?: Buffer}>} Render result.
+   * @throws {Error} If a track cannot be probed or decoded.
+   * @author zevinDev
+   */
+  async renderMix(tracks, { output, crossfade = {} } = {}) {
+    if (!Array.isArray(tracks) || tracks.length === 0) throw new Error('Nothing to render');
+    const portaudio = await this._deviceManager.getPortAudio();
+    if (typeof portaudio.renderStreamAsync !== 'function') {
+      throw new Error('Offline rendering is not supported on this platform');
+    }
+    const started = Date.now();
+    const timeline = await this._buildTimeline(portaudio, tracks, crossfade);
+    const segments = this._segment(timeline);
+    const fd = output ? openSync(output, 'w') : null;
+    try {
+      if (fd !== null) {
+        writeSync(fd, this._wavHeader(timeline.frames), 0, WAV_HEADER_BYTES, 0);
+        ftruncateSync(fd, WAV_HEADER_BYTES + timeline.frames * this._bytesPerFrame);
+      }
+      const results = await Promise.all(segments.map(segment =>
+        this._limit(() => this._renderSegment(portaudio, timeline, segment, fd))));
+      const result = {
+        frames: timeline.frames,
+        duration: timeline.frames / this._sampleRate,
+        renderSeconds: (Date.now() - started) / 1000,
+        segments: segments.length,
+        stalls: results.reduce((sum, segment) => sum + segment.stalls, 0)
+      };
+      if (fd === null) result.buffer = Buffer.concat(results.map(segment => segment.buffer));
+      return result;
+    } finally {
+      if (fd !== null) closeSync(fd);
+    }
+  }
+
+  /**
+   * Render several mixes at once, sharing the renderer's concurrency.
+   *
+   * @param {Array<{tracks: Array, output?: string, crossfade?: object}>} jobs - Mixes to render.
+   * @returns {Promise<object[]>} renderMix() results, in job order.
+   * @author zevinDev
+   */
+  renderBatch(jobs) {
+    return Promise.all(jobs.map(({ tracks, ...options }) => this.renderMix(tracks, options)));
+  }
+
+  /**
+   * Lay the tracks out on the output timeline, in frames.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {Array} tracks - renderMix() tracks.
+   * @param {{duration?: number, curve?: string}} crossfade - Crossfade settings.
+   * @returns {Promise<{entries: object[], frames: number, curve: string}>} Timeline.
+   * @author zevinDev
+   */
+  async _buildTimeline(portaudio, tracks, { duration = 5, curve = 'linear' }) {
+    const rate = this._sampleRate;
+    const entries = await Promise.all(tracks.map(async track => {
+      const entry = typeof track === 'string' ? { path: track } : { ...track };
+      const info = probeNativeAudio(portaudio, entry.path) ?? await getAudioInfo(entry.path);
+      const start = Math.max(entry.start ?? 0, 0);
+      const end = Math.min(entry.end ?? Infinity, info?.duration > 0 ? info.duration : Infinity);
+      if (!Number.isFinite(end) || end <= start) throw new Error(`Cannot determine the length of ${entry.path}`);
+      return { ...entry, start, trimmed: entry.end !== undefined, frames: Math.round((end - start) * rate) };
+    }));
+    let position = 0;
+    entries.forEach((entry, i) => {
+      const next = entries[i + 1];
+      // A fade never takes more than half of either track
+      entry.fadeOutFrames = next ? Math.min(Math.round(Math.max(duration, 0) * rate), Math.floor(entry.frames / 2), Math.floor(next.frames / 2)) : 0;
+      entry.fadeInFrames = i > 0 ? entries[i - 1].fadeOutFrames : 0;
+      entry.at = position;
+      position += entry.frames - entry.fadeOutFrames;
+    });
+    const last = entries[entries.length - 1];
+    return { entries, frames: last.at + last.frames, curve };
+  }
+
+  /**
+   * Cut the timeline where only one track plays: once in the middle of every track, and
+   * more often in long ones, so the pieces spread over the cores.
+   *
+   * @private
+   * @param {{entries: object[], frames: number}} timeline - Timeline from _buildTimeline().
+   * @returns {Array<{from: number, to: number}>} Segments in output frames.
+   * @author zevinDev
+   */
+  _segment(timeline) {
+    const cuts = [];
+    for (const entry of timeline.entries) {
+      const soloFrom = entry.at + entry.fadeInFrames;
+      const soloTo = entry.at + entry.frames - entry.fadeOutFrames;
+      const pieces = Math.max(timeline.entries.length > 1 ? 2 : 1, Math.ceil((soloTo - soloFrom) / this._segmentFrames));
+      for (let j = 1; j < pieces; j++) cuts.push(soloFrom + Math.round((soloTo - soloFrom) * j / pieces));
+    }
+    const bounds = [0, ...cuts.filter(cut => cut > 0 && cut < timeline.frames), timeline.frames];
+    const segments = [];
+    for (let i = 1; i < bounds.length; i++) {
+      if (bounds[i] > bounds[i - 1]) segments.push({ from: bounds[i - 1], to: bounds[i] });
+    }
+    return segments;
+  }
+
+  /**
+   * Render one segment on its own offline stream: start each track's voice at its frame,
+   * ramp the gains of a crossfade there, and render up to the next track start.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {object} timeline - Timeline from _buildTimeline().
+   * @param {{from: number, to: number}} segment - Segment to render.
+   * @param {number|null} fd - Output WAV file, or null to collect a Buffer.
+   * @returns {Promise<{stalls: number, buffer?: Buffer}>} Segment result.
+   * @author zevinDev
+   */
+  async _renderSegment(portaudio, timeline, segment, fd) {
+    const rate = this._sampleRate;
+    // Tracks sounding in the segment; the first may have started before it (solo there)
+    const entries = timeline.entries.filter(entry => entry.at < segment.to && entry.at + entry.frames > segment.from);
+    const streamId = await portaudio.openStreamAsync({
+      offline: true,
+      channels: this._channels,
+      sampleRate: rate,
+      sourceSampleRate: rate,
+      sampleFormat: this._sampleFormat,
+      framesPerBuffer: 1024,
+      ringBufferFrames: rate * 2
+    });
+    const decoders = [];
+    const buffers = [];
+    let stalls = 0;
+    try {
+      portaudio.setStreamVolume(streamId, this._volume, 0);
+      if (this._dsp) portaudio.setStreamDsp(streamId, this._dsp);
+      let cursor = segment.from;
+      let previousVoice = null;
+      for (const [i, entry] of entries.entries()) {
+        const startAt = Math.max(entry.at, segment.from);
+        if (startAt > cursor) {
+          stalls += await this._render(portaudio, streamId, cursor, startAt, fd, buffers);
+          cursor = startAt;
+        }
+        const fading = entry.at >= segment.from && entry.fadeInFrames > 0 && previousVoice !== null;
+        const voiceId = i === 0 ? 0 : portaudio.addVoice(streamId, { gain: fading ? 0 : 1 });
+        if (entry.gain !== undefined) portaudio.setVoiceTrim(streamId, voiceId, entry.gain);
+        decoders.push(this._startDecoder(portaudio, streamId, voiceId, entry, startAt - entry.at));
+        if (fading) {
+          portaudio.setVoiceGain(streamId, previousVoice, 0, entry.fadeInFrames, timeline.curve);
+          portaudio.setVoiceGain(streamId, voiceId, 1, entry.fadeInFrames, timeline.curve);
+        }
+        previousVoice = voiceId;
+      }
+      stalls += await this._render(portaudio, streamId, cursor, segment.to, fd, buffers);
+    } finally {
+      for (const decoder of decoders) killFFmpegProcess(decoder);
+      portaudio.closeStream(streamId);
+    }
+    return fd === null ? { stalls, buffer: Buffer.concat(buffers) } : { stalls };
+  }
+
+  /**
+   * Render output frames [from, to) of an offline stream into the sink.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Offline stream.
+   * @param {number} from - First output frame.
+   * @param {number} to - End output frame.
+   * @param {number|null} fd - Output WAV file, or null to collect buffers.
+   * @param {Buffer[]} buffers - Collected buffers.
+   * @returns {Promise<number>} Times the render waited in vain for a decoder.
+   * @author zevinDev
+   */
+  async _render(portaudio, streamId, from, to, fd, buffers) {
+    const result = await portaudio.renderStreamAsync(streamId, {
+      frames: to - from,
+      ...(fd !== null ? { fd, offset: WAV_HEADER_BYTES + from * this._bytesPerFrame } : {})
+    });
+    if (result.buffer) buffers.push(result.buffer);
+    return result.stalls;
+  }
+
+  /**
+   * Feed a voice from a track, `offsetFrames` into its trimmed range.
+   *
+   * @private
+   * @param {object} portaudio - Native binding.
+   * @param {number} streamId - Offline stream.
+   * @param {number} voiceId - Voice to feed.
+   * @param {object} entry - Timeline entry.
+   * @param {number} offsetFrames - Output frames of the entry already past.
+   * @returns {import('child_process').ChildProcess|null} The decoder process, if one was spawned.
+   * @author zevinDev
+   */
+  _startDecoder(portaudio, streamId, voiceId, entry, offsetFrames) {
+    const rate = this._sampleRate;
+    const startSeconds = entry.start + offsetFrames / rate;
+    const lengthSeconds = (entry.frames - offsetFrames) / rate;
+    // WAV files at the output rate are read in-process, when the track is not cut short
+    if (!entry.trimmed && canDecodeNatively(portaudio, entry.path) &&
+        portaudio.attachDecoder(streamId, entry.path, voiceId, Math.round(startSeconds * rate))) {
+      return null;
+    }
+    const args = buildFFmpegArgs({
+      input: entry.path,
+      sampleRate: rate,
+      channels: this._channels,
+      sampleFormat: this._sampleFormat,
+      seekPosition: startSeconds > 0 ? startSeconds : undefined
+    });
+    // Stop at the entry's end; inserted before the output URL
+    args.splice(args.length - 1, 0, '-t', String(lengthSeconds));
+    const { readFd, writeFd } = portaudio.createPipe();
+    let ffmpeg;
+    try {
+      ffmpeg = createFFmpegProcess(this._ffmpegPath ?? 'ffmpeg', ['-nostdin', ...args], { stdio: ['ignore', writeFd, 'ignore'] });
+    } catch (error) {
+      closeSync(readFd);
+      throw error;
+    } finally {
+      closeSync(writeFd);
+    }
+    portaudio.attachPipe(streamId, readFd, voiceId);
+    return ffmpeg;
+  }
+
+  /**
+   * Run `task` once fewer than `concurrency` segments are rendering.
+   *
+   * @private
+   * @param {Function} task - Returns a promise.
+   * @returns {Promise<any>} The task's result.
+   * @author zevinDev
+   */
+  async _limit(task) {
+    if (!this._ffmpegPath) this._ffmpegPath = await locateFFmpeg();
+    if (this._active >= this._concurrency) {
+      await new Promise(resolve => this._waiting.push(resolve));
+    }
+    this._active++;
+    try {
+      return await task();
+    } finally {
+      this._active--;
+      this._waiting.shift()?.();
+    }
+  }
+
+  /**
+   * Canonical 44-byte WAV header for the output format.
+   *
+   * @private
+   * @param {number} frames - Frames of audio data.
+   * @returns {Buffer} Header.
+   * @author zevinDev
+   */
+  _wavHeader(frames) {
+    const header = Buffer.alloc(WAV_HEADER_BYTES);
+    // RIFF sizes are 32-bit: longer files are still readable by tools that ignore them
+    const dataBytes = Math.min(frames * this._bytesPerFrame, 0xffffffff - WAV_HEADER_BYTES);
+    const bitsPerSample = bytesPerSample(this._sampleFormat) * 8;
+    header.write('RIFF', 0);
+    header.writeUInt32LE(dataBytes + WAV_HEADER_BYTES - 8, 4);
+    header.write('WAVE', 8);
+    header.write('fmt ', 12);
+    header.writeUInt32LE(16, 16);
+    // 3: IEEE float, 1: integer PCM
+    header.writeUInt16LE(this._sampleFormat === 'f32le' ? 3 : 1, 20);
+    header.writeUInt16LE(this._channels, 22);
+    header.writeUInt32LE(this._sampleRate, 24);
+    header.writeUInt32LE(this._sampleRate * this._bytesPerFrame, 28);
+    header.writeUInt16LE(this._bytesPerFrame, 32);
+    header.writeUInt16LE(bitsPerSample, 34);
+    header.write('data', 36);
+    header.writeUInt32LE(dataBytes, 40);
+    return header;
+  }
+}
@@ -22,6 +22,9 @@ export class PlaylistManager {
     this._playlistShuffle = false;
     this._playlistRepeat = 'off'; // 'off', 'one', 'all'
     this._playlistOrder = [];
+    // Optional LoudnessAnalyzer fed the upcoming tracks, and how many to look ahead
+    this._loudnessAnalyzer = null;
+    this._loudnessLookahead = 3;
   }
 
   /**
@@ -42,6 +45,7 @@ export class PlaylistManager {
       this._playlistIndex = 0;
       this._playlistActive = true;
       this._updatePlaylistOrder();
+      this._prefetchLoudness();
     } catch (error) {
       handleError(error, 'loadPlaylist');
       throw error;
@@ -76,6 +80,7 @@ export class PlaylistManager {
   setPlaylistShuffle(enable = true) {
     this._playlistShuffle = !!enable;
     this._updatePlaylistOrder();
+    this._prefetchLoudness();
   }
 
   /**
@@ -134,6 +139,7 @@ export class PlaylistManager {
     // Check if we can advance to next track
     if (this._playlistIndex < this._playlist.length - 1) {
       this._playlistIndex++;
+      this._prefetchLoudness();
       return { 
         hasNext: true, 
         track: this.getCurrentTrack(), 
@@ -149,6 +155,7 @@ export class PlaylistManager {
       if (this._playlistShuffle) {
         this._updatePlaylistOrder();
       }
+      this._prefetchLoudness();
       
       return { 
         hasNext: true, 
@@ -208,9 +215,63 @@ export class PlaylistManager {
     }
     
     this._playlistIndex = index;
+    this._prefetchLoudness();
     return this.getCurrentTrack();
   }
 
+  /**
+   * Tracks that will play after the current one, in play order.
+   * Wraps around when repeating the whole playlist.
+   * 
+   * @param {number} [count=1] - Maximum number of tracks
+   * @returns {string[]} Upcoming track paths
+   * @author zevinDev
+   */
+  getUpcomingTracks(count = 1) {
+    const upcoming = [];
+    if (!this._playlistActive || this._playlist.length === 0) {
+      return upcoming;
+    }
+    const length = this._playlist.length;
+    for (let step = 1; step <= count && step < length + 1; step++) {
+      let index = this._playlistIndex + step;
+      if (index >= length) {
+        if (this._playlistRepeat !== 'all') break;
+        index %= length;
+      }
+      upcoming.push(this._playlist[this._playlistOrder[index]]);
+    }
+    return upcoming;
+  }
+
+  /**
+   * Have a loudness analyzer measure upcoming tracks in the background as the
+   * playlist advances, so their gain is known before they play.
+   * 
+   * @param {LoudnessAnalyzer|null} analyzer - Analyzer, or null to stop
+   * @param {number} [lookahead=3] - Number of upcoming tracks to keep analysed
+   * @author zevinDev
+   */
+  setLoudnessAnalyzer(analyzer, lookahead = 3) {
+    this._loudnessAnalyzer = analyzer;
+    this._loudnessLookahead = Math.max(0, Math.floor(lookahead));
+    this._prefetchLoudness();
+  }
+
+  /**
+   * Queue the current and upcoming tracks for loudness analysis.
+   * 
+   * @private
+   * @author zevinDev
+   */
+  _prefetchLoudness() {
+    if (!this._loudnessAnalyzer || !this._playlistActive) return;
+    const current = this.getCurrentTrack();
+    const tracks = current ? [current] : [];
+    tracks.push(...this.getUpcomingTracks(this._loudnessLookahead));
+    this._loudnessAnalyzer.prefetch(tracks);
+  }
+
   /**
    * Get playlist status and information.
    * 
@@ -272,6 +333,7 @@ export class PlaylistManager {
     }
     
     this._updatePlaylistOrder();
+    this._prefetchLoudness();
   }
 
   /**
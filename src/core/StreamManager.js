@@ -5,8 +5,18 @@
  */
 
 import { spawn } from 'node:child_process';
+import { createReadStream } from 'node:fs';
+import http from 'node:http';
+import https from 'node:https';
 import { buildFFmpegArgs, createFFmpegProcess, killFFmpegProcess } from '../utils/FFmpegUtils.js';
 import { handleError, createUserFriendlyMessage } from '../utils/ErrorHandler.js';
+import { PcmRingWriter } from '../utils/RingBuffer.js';
+import { JitterBuffer } from '../utils/JitterBuffer.js';
+
+// Format ffmpeg decodes streams to (f32le)
+const STREAM_SAMPLE_RATE = 44100;
+const STREAM_CHANNELS = 2;
+const STREAM_BYTES_PER_FRAME = STREAM_CHANNELS * 4;
 
 /**
  * StreamManager handles streaming audio from HTTP/HTTPS URLs.
@@ -22,6 +32,13 @@ export class StreamManager {
     this._streamResponse = null;
     this._ffmpegProcess = null;
     this._stopStreaming = null;
+    // Ring-mode output stream opened for the stream, and the jitter buffer in its ring
+    this._portaudio = null;
+    this._outputStream = null;
+    this._jitterBuffer = null;
+    // Network input and the reasons it is paused ('jitter': ring full, 'decoder': ffmpeg stdin full)
+    this._inputSource = null;
+    this._inputHolds = new Set();
   }
 
   /**
@@ -31,12 +48,15 @@ export class StreamManager {
    * @param {object} options - Streaming options
    * @param {string} options.ffmpegPath - Path to ffmpeg binary
    * @param {object} options.portaudio - PortAudio instance
-   * @param {object} options.audioStream - Audio stream for output
+   * @param {object} [options.audioStream] - Blocking stream to write to; without one a
+   *   ring-mode stream is opened and decoded audio goes through the jitter buffer
    * @param {object} options.outputDevice - Output device info
    * @param {number} [options.bufferSize] - Buffer size for audio
    * @param {number} [options.maxRetries=5] - Maximum retry attempts
    * @param {number} [options.backoffBaseMs=500] - Base backoff time in ms
-   * @param {number} [options.bufferSizeBytes=128*1024] - Stream buffer size in bytes
+   * @param {number} [options.lowWatermarkMs=500] - Buffered audio below which playback holds
+   * @param {number} [options.highWatermarkMs=2000] - Buffered audio at which playback starts or resumes
+   * @param {number} [options.maxBufferMs=8000] - Jitter buffer size; the network is paused when it is full
    * @param {Function} [options.visualizationCallback] - Callback for PCM data
    * @param {Function} [options.emitter] - Event emitter for events
    * @returns {Promise<void>}
@@ -52,7 +72,9 @@ export class StreamManager {
       bufferSize,
       maxRetries = 5,
       backoffBaseMs = 500,
-      bufferSizeBytes = 128 * 1024,
+      lowWatermarkMs = 500,
+      highWatermarkMs = 2000,
+      maxBufferMs = 8000,
       visualizationCallback,
       emitter
     } = options;
@@ -60,8 +82,8 @@ export class StreamManager {
     let attempt = 0;
     let stopped = false;
     let lastError = null;
-    let lastByte = 0; // Track last streamed byte for resume
-    let canResume = false;
+    // Bytes received so far, kept across reconnects for Range requests
+    const position = { lastByte: 0 };
 
     this._streaming = true;
 
@@ -70,6 +92,7 @@ export class StreamManager {
 
     const cleanup = () => {
       this._streaming = false;
+      this._closeOutput();
       
       if (this._ffmpegProcess) {
         killFFmpegProcess(this._ffmpegProcess);
@@ -85,8 +108,24 @@ export class StreamManager {
         try { this._streamResponse.destroy(); } catch {}
         this._streamResponse = null;
       }
+      this._inputSource = null;
+      this._inputHolds.clear();
     };
 
+    // Decoded audio queues in the native ring of our own output stream, which keeps
+    // playing what is buffered while the network stalls or a reconnect is under way
+    const jitter = !audioStream && portaudio && typeof portaudio.openStreamAsync === 'function'
+      ? await this._openJitterOutput(portaudio, {
+        outputDevice, bufferSize, lowWatermarkMs, highWatermarkMs, maxBufferMs,
+        emitter,
+        onHealthy: () => { attempt = 0; },
+        onDrained: () => {
+          cleanup();
+          if (!stopped && emitter) emitter.emit('trackEnd', url);
+        }
+      })
+      : null;
+
     const tryStream = async () => {
       if (stopped) return;
       
@@ -96,8 +135,8 @@ export class StreamManager {
         // Prepare ffmpeg args
         const ffmpegArgs = buildFFmpegArgs({
           input: 'pipe:0',
-          sampleRate: 44100,
-          channels: 2
+          sampleRate: STREAM_SAMPLE_RATE,
+          channels: STREAM_CHANNELS
         });
 
         const ffmpeg = createFFmpegProcess(ffmpegPath, ffmpegArgs, {
@@ -105,20 +144,36 @@ export class StreamManager {
         });
         
         this._ffmpegProcess = ffmpeg;
-
-        // Buffering state
-        let buffering = true;
-        let buffer = Buffer.alloc(0);
-        let streamEnded = false;
+        // A hold from the previous decoder's stdin no longer applies
+        this._setInputHold('decoder', false);
+        // Input written as the decoder exits (killed for a reconnect, or crashed) fails
+        // with EPIPE; the exit itself is handled on 'close'
+        ffmpeg.stdin.on('error', () => {});
 
         // Handle PCM output from ffmpeg
-        ffmpeg.stdout.on('data', chunk => {
+        if (jitter) {
+          jitter.attach(ffmpeg.stdout, { onChunk: visualizationCallback });
+        } else ffmpeg.stdout.on('data', chunk => {
           if (visualizationCallback) {
             try { visualizationCallback(chunk); } catch {}
           }
           
           if (portaudio && audioStream) {
-            portaudio.writeStream(chunk, audioStream);
+            if (typeof portaudio.writeStreamAsync === 'function') {
+              // Queue natively and hold ffmpeg back until the queue drains below its
+              // high-water mark, instead of blocking the event loop in Pa_WriteStream
+              ffmpeg.stdout.pause();
+              portaudio.writeStreamAsync(chunk, audioStream).then(
+                () => ffmpeg.stdout.resume(),
+                err => {
+                  if (emitter) {
+                    emitter.emit('streamError', err);
+                  }
+                }
+              );
+            } else {
+              portaudio.writeStream(chunk, audioStream);
+            }
           }
         });
 
@@ -131,6 +186,8 @@ export class StreamManager {
         });
 
         ffmpeg.on('close', code => {
+          // Superseded by a reconnect, or torn down by cleanup()
+          if (this._ffmpegProcess !== ffmpeg) return;
           if (code !== 0 && !stopped) {
             lastError = new Error(`ffmpeg exited with code ${code}`);
             
@@ -152,6 +209,9 @@ export class StreamManager {
               }
               handleError(lastError, 'playStream', emitter);
             }
+          } else if (!stopped && jitter) {
+            // trackEnd follows once the buffered tail has played
+            jitter.end();
           } else if (!stopped && emitter) {
             emitter.emit('trackEnd', url);
           }
@@ -167,8 +227,7 @@ export class StreamManager {
         // Handle different stream types
         if (isHttp) {
           await this._handleHttpStream(url, ffmpeg, {
-            lastByte, canResume, buffering, buffer, bufferSizeBytes,
-            attempt, maxRetries, backoffBaseMs, emitter, cleanup
+            position, attempt, maxRetries, emitter, cleanup
           });
         } else if (isFile) {
           await this._handleFileStream(url, ffmpeg, emitter);
@@ -222,10 +281,7 @@ export class StreamManager {
    * @author zevinDev
    */
   async _handleHttpStream(url, ffmpeg, streamState) {
-    const { 
-      lastByte, canResume, buffering, buffer, bufferSizeBytes,
-      attempt, maxRetries, backoffBaseMs, emitter, cleanup 
-    } = streamState;
+    const { position, attempt, maxRetries, emitter, cleanup } = streamState;
 
     // Try to use 'got' library if available, fallback to node http/https
     let got = null;
@@ -234,6 +290,7 @@ export class StreamManager {
     } catch (error) {}
 
     const onStreamError = err => {
+      if (this._ffmpegProcess !== ffmpeg) return;
       if (emitter) {
         emitter.emit('streamError', err);
       }
@@ -243,7 +300,8 @@ export class StreamManager {
           emitter.emit('streamReconnect', { attempt, url });
         }
         console.warn(`[StreamManager] Network error, attempting reconnect #${attempt} to ${url}`);
-        // Retry will be handled by the caller
+        // The decoder exiting non-zero runs the retry; buffered audio keeps playing meanwhile
+        killFFmpegProcess(ffmpeg);
       } else {
         cleanup();
         const userMsg = createUserFriendlyMessage(err, 'stream');
@@ -254,11 +312,25 @@ export class StreamManager {
     };
 
     const headers = {};
-    if (lastByte > 0) {
-      headers['Range'] = `bytes=${lastByte}-`;
-      canResume = true;
+    const canResume = position.lastByte > 0;
+    if (canResume) {
+      headers['Range'] = `bytes=${position.lastByte}-`;
     }
 
+    const onResponse = res => {
+      this._streamResponse = res;
+      if (canResume && res.statusCode === 206) {
+        if (emitter) {
+          emitter.emit('streamResume', { attempt, url, fromByte: position.lastByte });
+        }
+      } else if (canResume && res.statusCode === 200) {
+        if (emitter) {
+          emitter.emit('streamPartial', { attempt, url, fromByte: 0 });
+        }
+        position.lastByte = 0;
+      }
+    };
+
     if (got) {
       this._streamRequest = got.stream(url, { 
         retry: 0, 
@@ -267,68 +339,24 @@ export class StreamManager {
       });
       
       this._streamRequest.on('error', onStreamError);
-      
-      this._streamRequest.on('response', res => {
-        this._streamResponse = res;
-        if (emitter) {
-          emitter.emit('streamBuffering', false);
-        }
-        
-        if (canResume && res.statusCode === 206) {
-          if (emitter) {
-            emitter.emit('streamResume', { attempt, url, fromByte: lastByte });
-          }
-        } else if (canResume && res.statusCode === 200) {
-          if (emitter) {
-            emitter.emit('streamPartial', { attempt, url, fromByte: 0 });
-          }
-          lastByte = 0;
-        }
-      });
-      
-      this._streamRequest.on('data', chunk => {
-        this._handleStreamData(chunk, ffmpeg, streamState);
-      });
-      
-      this._streamRequest.on('end', () => {
-        ffmpeg.stdin.end();
-      });
+      this._streamRequest.on('response', onResponse);
+      this._attachInput(this._streamRequest, ffmpeg, position);
       
     } else {
       // Fallback to native http/https
-      const proto = url.startsWith('https') ? require('https') : require('http');
+      const proto = url.startsWith('https') ? https : http;
       const reqOpts = { headers };
       
       this._streamRequest = proto.get(url, reqOpts, res => {
-        this._streamResponse = res;
-        if (emitter) {
-          emitter.emit('streamBuffering', false);
-        }
-        
-        if (canResume && res.statusCode === 206) {
-          if (emitter) {
-            emitter.emit('streamResume', { attempt, url, fromByte: lastByte });
-          }
-        } else if (canResume && res.statusCode === 200) {
-          if (emitter) {
-            emitter.emit('streamPartial', { attempt, url, fromByte: 0 });
-          }
-          lastByte = 0;
-        }
-        
-        res.on('data', chunk => {
-          this._handleStreamData(chunk, ffmpeg, streamState);
-        });
-        
-        res.on('end', () => {
-          ffmpeg.stdin.end();
-        });
+        onResponse(res);
+        res.on('error', onStreamError);
+        this._attachInput(res, ffmpeg, position);
       });
       
       this._streamRequest.on('error', onStreamError);
     }
 
-    if (emitter) {
+    if (emitter && !this._jitterBuffer) {
       emitter.emit('streamBuffering', true);
     }
   }
@@ -343,10 +371,10 @@ export class StreamManager {
    * @author zevinDev
    */
   async _handleFileStream(url, ffmpeg, emitter) {
-    const fs = require('fs');
     const filePath = url.replace(/^file:\/\//, '');
     
-    const readStream = fs.createReadStream(filePath);
+    const readStream = createReadStream(filePath);
+    this._streamRequest = readStream;
     
     readStream.on('error', err => {
       if (emitter) {
@@ -354,48 +382,144 @@ export class StreamManager {
       }
     });
     
-    readStream.on('open', () => {
-      if (emitter) {
-        emitter.emit('streamBuffering', false);
-      }
-    });
-    
-    readStream.on('data', chunk => {
-      ffmpeg.stdin.write(chunk);
+    this._attachInput(readStream, ffmpeg, null);
+  }
+
+  /**
+   * Feed a network or file input into ffmpeg, under the input backpressure holds.
+   * 
+   * @private
+   * @param {import('stream').Readable} source - Encoded input
+   * @param {ChildProcess} ffmpeg - FFmpeg process
+   * @param {{lastByte: number}|null} position - Byte position to advance, for Range resumes
+   * @author zevinDev
+   */
+  _attachInput(source, ffmpeg, position) {
+    this._inputSource = source;
+    // Holds placed while no input was attached (a full ring) apply to this one
+    if (this._inputHolds.size > 0) source.pause();
+    source.on('data', chunk => {
+      this._handleStreamData(chunk, ffmpeg, position);
     });
-    
-    readStream.on('end', () => {
+    source.on('end', () => {
       ffmpeg.stdin.end();
     });
   }
 
   /**
-   * Handle incoming stream data with buffering.
+   * Pass input data to ffmpeg; a full stdin pipe holds the input until it drains.
    * 
    * @private
    * @param {Buffer} chunk - Data chunk
    * @param {ChildProcess} ffmpeg - FFmpeg process
-   * @param {object} streamState - Stream state
+   * @param {{lastByte: number}|null} position - Byte position to advance
    * @author zevinDev
    */
-  _handleStreamData(chunk, ffmpeg, streamState) {
-    const { lastByte, buffering, buffer, bufferSizeBytes, emitter } = streamState;
-    
-    streamState.lastByte += chunk.length;
-    
-    if (streamState.buffering) {
-      streamState.buffer = Buffer.concat([streamState.buffer, chunk]);
-      if (streamState.buffer.length >= bufferSizeBytes) {
-        streamState.buffering = false;
-        if (emitter) {
-          emitter.emit('streamBuffering', false);
-        }
-        ffmpeg.stdin.write(streamState.buffer);
-        streamState.buffer = Buffer.alloc(0);
+  _handleStreamData(chunk, ffmpeg, position) {
+    // Input still arriving for a decoder that a reconnect or cleanup() replaced: dropped,
+    // and not counted, since the next request resumes from position.lastByte
+    if (this._ffmpegProcess !== ffmpeg) return;
+    if (position) position.lastByte += chunk.length;
+    if (!ffmpeg.stdin.writable) return;
+    if (!ffmpeg.stdin.write(chunk)) {
+      this._setInputHold('decoder', true);
+      ffmpeg.stdin.once('drain', () => {
+        if (this._ffmpegProcess === ffmpeg) this._setInputHold('decoder', false);
+      });
+    }
+  }
+
+  /**
+   * Pause or resume the input for one reason; it runs only while no reason holds it.
+   * 
+   * @private
+   * @param {string} reason - 'jitter' (ring full) or 'decoder' (ffmpeg stdin full)
+   * @param {boolean} held - Whether the reason applies
+   * @author zevinDev
+   */
+  _setInputHold(reason, held) {
+    const wasHeld = this._inputHolds.size > 0;
+    if (held) this._inputHolds.add(reason);
+    else this._inputHolds.delete(reason);
+    const isHeld = this._inputHolds.size > 0;
+    if (!this._inputSource || wasHeld === isHeld) return;
+    if (isHeld) this._inputSource.pause();
+    else this._inputSource.resume();
+  }
+
+  /**
+   * Open the ring-mode output stream a stream plays through, paused until the jitter
+   * buffer has reached its high watermark.
+   * 
+   * @private
+   * @param {object} portaudio - Native addon
+   * @param {object} options - Output and watermark options (see playStream)
+   * @returns {Promise<JitterBuffer|null>} The jitter buffer, or null if no stream could be opened
+   * @author zevinDev
+   */
+  async _openJitterOutput(portaudio, options) {
+    const { outputDevice, bufferSize, lowWatermarkMs, highWatermarkMs, maxBufferMs, emitter, onHealthy, onDrained } = options;
+    const bytesPerSecond = STREAM_SAMPLE_RATE * STREAM_BYTES_PER_FRAME;
+    let streamId;
+    try {
+      streamId = await portaudio.openStreamAsync({
+        ...(outputDevice ? { device: outputDevice.index } : {}),
+        channels: STREAM_CHANNELS,
+        sampleRate: STREAM_SAMPLE_RATE,
+        framesPerBuffer: bufferSize ?? 2048,
+        ringBufferFrames: Math.ceil(Math.max(maxBufferMs, highWatermarkMs * 1.25) / 1000 * STREAM_SAMPLE_RATE)
+      });
+      portaudio.setStreamPaused(streamId, true);
+      const ring = new PcmRingWriter(portaudio.getStreamRing(streamId), STREAM_BYTES_PER_FRAME);
+      this._portaudio = portaudio;
+      this._outputStream = streamId;
+      this._jitterBuffer = new JitterBuffer({
+        ring,
+        bytesPerSecond,
+        lowWatermarkMs,
+        highWatermarkMs,
+        onBuffering: buffering => {
+          try { portaudio.setStreamPaused(streamId, buffering); } catch {}
+          if (!buffering) onHealthy?.();
+          if (emitter) emitter.emit('streamBuffering', buffering);
+        },
+        onInputPause: paused => this._setInputHold('jitter', paused),
+        onDrained
+      });
+    } catch (error) {
+      if (streamId !== undefined) {
+        try { portaudio.closeStream(streamId); } catch {}
       }
-    } else {
-      ffmpeg.stdin.write(chunk);
+      if (emitter) emitter.emit('streamError', error);
+      return null;
     }
+    if (emitter) emitter.emit('streamBuffering', true);
+    return this._jitterBuffer;
+  }
+
+  /**
+   * Stop the jitter buffer and close the output stream opened for it.
+   * 
+   * @private
+   * @author zevinDev
+   */
+  _closeOutput() {
+    this._jitterBuffer?.stop();
+    this._jitterBuffer = null;
+    if (this._outputStream !== null) {
+      try { this._portaudio.closeStream(this._outputStream); } catch {}
+      this._outputStream = null;
+    }
+  }
+
+  /**
+   * Jitter buffer state of the current stream.
+   * 
+   * @returns {object|null} Fill level and watermarks, or null when not jitter-buffered
+   * @author zevinDev
+   */
+  getBufferState() {
+    return this._jitterBuffer ? this._jitterBuffer.getState() : null;
   }
 
   /**
@@ -427,6 +551,9 @@ export class StreamManager {
    */
   cleanup() {
     this.stopStream();
+    this._closeOutput();
+    this._inputSource = null;
+    this._inputHolds.clear();
     this._streaming = false;
     this._streamRequest = null;
     this._streamResponse = null;
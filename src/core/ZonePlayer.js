@@ -0,0 +1,307 @@
+/**
+ * @module ZonePlayer
+ * @author zevinDev
+ * @description Multi-zone playback: one decode fanned out to several output devices in sync
+ */
+
+import { EventEmitter } from 'events';
+import { closeSync } from 'node:fs';
+import { DeviceManager } from './DeviceManager.js';
+import { locateFFmpeg, buildFFmpegArgs, createFFmpegProcess, killFFmpegProcess } from '../utils/FFmpegUtils.js';
+import { PcmRingWriter } from '../utils/RingBuffer.js';
+
+// Format the zones' shared decode is in (f32le); each stream resamples it to its device
+const ZONE_CHANNELS = 2;
+const ZONE_BYTES_PER_FRAME = ZONE_CHANNELS * 4;
+
+/**
+ * Plays one track on several output devices ("zones", e.g. rooms) at once.
+ * The track is decoded once and a native thread copies the PCM into a ring-mode stream
+ * per zone (portaudio.attachFanOut). Every zone has its own volume and delay, and all
+ * zones but the first are continuously speed-trimmed by a few hundred ppm at most to
+ * follow the first one, so independent device clocks do not drift apart over a long
+ * session.
+ *
+ * Emits events: 'play', 'pause', 'resume', 'stop', 'trackEnd', 'error'.
+ *
+ * @class
+ * @author zevinDev
+ * @example
+ * const zones = new ZonePlayer();
+ * zones.addZone('kitchen', { device: 3 });
+ * zones.addZone('patio', { device: 5, volume: 0.6, delayMs: 40 });
+ * await zones.play('/music/track.flac');
+ */
+export class ZonePlayer extends EventEmitter {
+  /**
+   * @param {object} [options] - Player options.
+   * @param {DeviceManager} [options.deviceManager] - Device manager to share with an AudioPlayer.
+   * @param {number} [options.sampleRate=48000] - Rate the track is decoded at.
+   * @param {number} [options.bufferMs=1000] - Per-zone ring size.
+   * @param {number} [options.maxCorrectionPpm=500] - Largest speed trim applied to follow the first zone.
+   */
+  constructor({ deviceManager, sampleRate = 48000, bufferMs = 1000, maxCorrectionPpm = 500 } = {}) {
+    super();
+    this._deviceManager = deviceManager ?? new DeviceManager();
+    this._ffmpegPath = null;
+    this._sampleRate = sampleRate;
+    this._bufferMs = bufferMs;
+    this._maxCorrectionPpm = maxCorrectionPpm;
+    // name -> { device, volume, delayMs, sampleRate, framesPerBuffer, streamId, ring }
+    this._zones = new Map();
+    this._ffmpeg = null;
+    this._track = null;
+    this._paused = false;
+    this._endTimer = null;
+  }
+
+  /**
+   * Add or replace a zone. Zones take effect from the next play().
+   *
+   * @param {string} name - Zone name.
+   * @param {object} [options] - Zone options.
+   * @param {number} [options.device] - Output device index (default output device).
+   * @param {number} [options.volume=1] - Zone volume (0..2).
+   * @param {number} [options.delayMs=0] - Extra delay of this zone, e.g. for a speaker further away.
+   * @param {number} [options.sampleRate] - Device rate (defaults to the decode rate).
+   * @param {number} [options.framesPerBuffer=1024] - Device period in frames.
+   * @returns {void}
+   * @author zevinDev
+   */
+  addZone(name, { device, volume = 1, delayMs = 0, sampleRate, framesPerBuffer = 1024 } = {}) {
+    this._zones.set(name, { device, volume, delayMs, sampleRate, framesPerBuffer, streamId: null, ring: null });
+  }
+
+  /**
+   * Remove a zone; if it is playing, its output stops and the other zones carry on.
+   *
+   * @param {string} name - Zone name.
+   * @returns {boolean} Whether the zone existed.
+   * @author zevinDev
+   */
+  removeZone(name) {
+    const zone = this._zones.get(name);
+    if (!zone) return false;
+    this._closeZone(zone);
+    return this._zones.delete(name);
+  }
+
+  /**
+   * Set a zone's volume, applied immediately if it is playing.
+   *
+   * @param {string} name - Zone name.
+   * @param {number} volume - Volume (0..2).
+   * @returns {void}
+   * @author zevinDev
+   */
+  setZoneVolume(name, volume) {
+    const zone = this._zones.get(name);
+    if (!zone) throw new Error(`Unknown zone: ${name}`);
+    zone.volume = volume;
+    if (zone.streamId !== null) {
+      this._deviceManager.getLoadedPortAudio()?.setStreamVolume(zone.streamId, volume);
+    }
+  }
+
+  /**
+   * Play a file on every zone, starting them together once their rings are filled.
+   *
+   * @param {string} filePath - Audio file to play.
+   * @param {object} [options] - Play options.
+   * @param {number} [options.prefillMs=300] - Audio buffered in every zone before they start.
+   * @returns {Promise<void>}
+   * @throws {Error} If no zones are configured or a zone's output cannot be opened.
+   * @author zevinDev
+   */
+  async play(filePath, { prefillMs = 300 } = {}) {
+    if (this._zones.size === 0) throw new Error('No zones configured');
+    this.stop();
+    const portaudio = await this._deviceManager.getPortAudio();
+    if (typeof portaudio.attachFanOut !== 'function') {
+      throw new Error('Multi-zone playback is not supported on this platform');
+    }
+    if (!this._ffmpegPath) this._ffmpegPath = await locateFFmpeg();
+    const zones = [...this._zones.values()];
+    try {
+      for (const zone of zones) {
+        zone.streamId = await portaudio.openStreamAsync({
+          ...(zone.device !== undefined ? { device: zone.device } : {}),
+          channels: ZONE_CHANNELS,
+          sampleRate: zone.sampleRate ?? this._sampleRate,
+          sourceSampleRate: this._sampleRate,
+          framesPerBuffer: zone.framesPerBuffer,
+          ringBufferFrames: Math.ceil(this._bufferMs / 1000 * this._sampleRate),
+          // Keeps the resampler running at equal rates so the fan-out can trim its speed
+          varispeed: true
+        });
+        portaudio.setStreamPaused(zone.streamId, true);
+        portaudio.setStreamVolume(zone.streamId, zone.volume, 0);
+        zone.ring = new PcmRingWriter(portaudio.getStreamRing(zone.streamId), ZONE_BYTES_PER_FRAME);
+      }
+      const args = buildFFmpegArgs({ input: filePath, sampleRate: this._sampleRate, channels: ZONE_CHANNELS });
+      const { readFd, writeFd } = portaudio.createPipe();
+      try {
+        this._ffmpeg = createFFmpegProcess(this._ffmpegPath, args, { stdio: ['ignore', writeFd, 'pipe'] });
+      } catch (error) {
+        closeSync(readFd);
+        throw error;
+      } finally {
+        closeSync(writeFd);
+      }
+      try {
+        // The native fan-out thread owns readFd from here on
+        portaudio.attachFanOut(readFd, zones.map(zone => ({ streamId: zone.streamId, delayMs: zone.delayMs })),
+          { maxCorrectionPpm: this._maxCorrectionPpm });
+      } catch (error) {
+        closeSync(readFd);
+        throw error;
+      }
+    } catch (error) {
+      this.stop();
+      throw error;
+    }
+    const ffmpeg = this._ffmpeg;
+    ffmpeg.stderr.on('data', data => console.warn('[ZonePlayer] FFmpeg stderr:', data.toString()));
+    ffmpeg.on('error', error => this.emit('error', error));
+    this._track = filePath;
+    await this._waitForPrefill(zones, prefillMs);
+    if (this._ffmpeg !== ffmpeg) return;
+    // Back to back, so the zones start within microseconds of each other; the fan-out
+    // absorbs the rest (and the devices' differing latencies)
+    for (const zone of zones) {
+      if (zone.streamId !== null) portaudio.setStreamPaused(zone.streamId, false);
+    }
+    this._paused = false;
+    this._endTimer = setInterval(() => this._checkEnd(), 100);
+    this.emit('play', filePath);
+  }
+
+  /**
+   * Pause every zone.
+   *
+   * @returns {void}
+   * @author zevinDev
+   */
+  pause() {
+    this._setPaused(true);
+    this.emit('pause', this._track);
+  }
+
+  /**
+   * Resume every zone.
+   *
+   * @returns {void}
+   * @author zevinDev
+   */
+  resume() {
+    this._setPaused(false);
+    this.emit('resume', this._track);
+  }
+
+  /**
+   * Stop playback and close every zone's output.
+   *
+   * @returns {void}
+   * @author zevinDev
+   */
+  stop() {
+    clearInterval(this._endTimer);
+    this._endTimer = null;
+    killFFmpegProcess(this._ffmpeg);
+    this._ffmpeg = null;
+    const wasPlaying = this._track !== null;
+    for (const zone of this._zones.values()) this._closeZone(zone);
+    if (wasPlaying) this.emit('stop', this._track);
+    this._track = null;
+  }
+
+  /**
+   * Per-zone sync state. offsetMs is the zone's smoothed offset from the first zone
+   * (positive: ahead) and speedPpm the trim applied to close it.
+   *
+   * @returns {Array<{name: string, playing: boolean, volume: number, delayMs: number, bufferedMs: number, offsetMs: number, speedPpm: number}>} Zone states.
+   * @author zevinDev
+   */
+  getZoneStates() {
+    const portaudio = this._deviceManager.getLoadedPortAudio();
+    return [...this._zones].map(([name, zone]) => {
+      const sync = zone.streamId !== null ? portaudio?.getFanOutState?.(zone.streamId) : null;
+      return {
+        name,
+        playing: zone.streamId !== null,
+        volume: zone.volume,
+        delayMs: zone.delayMs,
+        bufferedMs: zone.ring ? Math.round(zone.ring.readAvailable() / ZONE_BYTES_PER_FRAME / this._sampleRate * 1000) : 0,
+        offsetMs: sync?.offsetMs ?? 0,
+        speedPpm: sync?.speedPpm ?? 0
+      };
+    });
+  }
+
+  /**
+   * Resolve once every zone has prefillMs buffered (or the decode ended early).
+   *
+   * @private
+   * @param {object[]} zones - Zones being started.
+   * @param {number} prefillMs - Audio to buffer.
+   * @returns {Promise<void>}
+   * @author zevinDev
+   */
+  _waitForPrefill(zones, prefillMs) {
+    const bytes = prefillMs / 1000 * this._sampleRate * ZONE_BYTES_PER_FRAME;
+    return new Promise(resolve => {
+      const check = () => {
+        const ready = zones.every(zone => !zone.ring || zone.ring.endOfStream() ||
+          zone.ring.readAvailable() >= Math.min(bytes, zone.ring.writeAvailable() + zone.ring.readAvailable()));
+        if (ready || !this._ffmpeg) resolve();
+        else setTimeout(check, 10);
+      };
+      check();
+    });
+  }
+
+  /**
+   * Finish the track once every zone has played out its ring.
+   *
+   * @private
+   * @author zevinDev
+   */
+  _checkEnd() {
+    const zones = [...this._zones.values()].filter(zone => zone.ring);
+    if (zones.length > 0 && !zones.every(zone => zone.ring.endOfStream() && zone.ring.isDrained())) return;
+    const track = this._track;
+    clearInterval(this._endTimer);
+    this._endTimer = null;
+    this._ffmpeg = null;
+    for (const zone of this._zones.values()) this._closeZone(zone);
+    this._track = null;
+    this.emit('trackEnd', track);
+  }
+
+  /**
+   * @private
+   * @param {boolean} paused - New state for every open zone.
+   * @author zevinDev
+   */
+  _setPaused(paused) {
+    const portaudio = this._deviceManager.getLoadedPortAudio();
+    for (const zone of this._zones.values()) {
+      if (zone.streamId !== null) portaudio?.setStreamPaused(zone.streamId, paused);
+    }
+    this._paused = paused;
+  }
+
+  /**
+   * Close a zone's output stream; the fan-out stops feeding it.
+   *
+   * @private
+   * @param {object} zone - Zone to close.
+   * @author zevinDev
+   */
+  _closeZone(zone) {
+    if (zone.streamId === null) return;
+    try { this._deviceManager.getLoadedPortAudio()?.closeStream(zone.streamId); } catch {}
+    zone.streamId = null;
+    zone.ring = null;
+  }
+}
@@ -9,6 +9,7 @@ export interface DeviceInfo {
   maxInputChannels: number;
   maxOutputChannels: number;
   defaultSampleRate: number;
+  isDefault?: boolean;
   [key: string]: any;
 }
 
@@ -28,10 +29,159 @@ export interface AudioPlayerStatus {
   currentTrack: string | null;
   volume: number;
   bufferSize: number | null;
+  adaptiveBuffer: AdaptiveBufferState | null;
   playlist: PlaylistStatus;
   effects: any;
   device: DeviceInfo | null;
   streaming: boolean;
+  streamBuffer: JitterBufferState | null;
+  stats: StreamStats | null;
+}
+
+export interface TimingHistogram {
+  bucketsUs: number[];
+  counts: number[];
+  maxUs: number;
+  meanUs: number;
+}
+
+export interface StreamStats {
+  cpuLoad: number;
+  inputLatency?: number;
+  outputLatency?: number;
+  sampleRate?: number;
+  callbacks: number;
+  underflows: number;
+  overflows: number;
+  starvedFrames: number;
+  starvedCallbacks: number;
+  inputOverflows: number;
+  captureDroppedFrames: number;
+  /** Requested period; 0 when left to the host API */
+  framesPerBuffer: number;
+  /** Frames in the most recent callback */
+  callbackFrames: number;
+  suggestedLatency: number;
+  bufferBudgetUs: number;
+  callbackTime: TimingHistogram;
+  waitTime: TimingHistogram;
+  threadTuning?: ThreadTuningStatus;
+}
+
+export interface DuckOptions {
+  /** Playback gain while the input is active (default 0.25) */
+  gain?: number;
+  /** Input peak that counts as active (default 0.01, about -40 dBFS) */
+  threshold?: number;
+  attackMs?: number;
+  releaseMs?: number;
+  holdMs?: number;
+}
+
+export interface InputMonitoringOptions {
+  device?: number;
+  channels?: number;
+  suggestedLatency?: number;
+  monitorGain?: number;
+  duck?: boolean | DuckOptions;
+  capture?: 'input' | 'output' | 'none';
+  captureRingFrames?: number;
+}
+
+/** Drains a native capture ring (PcmRingReader) */
+export interface CaptureReader {
+  readonly channels: number;
+  framesAvailable(): number;
+  read(maxFrames?: number): Float32Array;
+}
+
+export interface AdaptiveBufferOptions {
+  minFrames?: number;
+  maxFrames?: number;
+  initialFrames?: number;
+  growThreshold?: number;
+  windowMs?: number;
+  stableMs?: number;
+  unspecified?: boolean;
+  intervalMs?: number;
+}
+
+export interface AdaptiveBufferState {
+  frames: number;
+  minFrames: number;
+  maxFrames: number;
+  unspecified: boolean;
+  recentDropouts: number;
+}
+
+export interface JitterBufferState {
+  bufferedMs: number;
+  buffering: boolean;
+  inputPaused: boolean;
+  stalls: number;
+  lowWatermarkMs: number;
+  highWatermarkMs: number;
+  capacityMs: number;
+}
+
+export interface StreamPlaybackOptions {
+  maxRetries?: number;
+  backoffBaseMs?: number;
+  lowWatermarkMs?: number;
+  highWatermarkMs?: number;
+  maxBufferMs?: number;
+  [key: string]: any;
+}
+
+export interface BufferSizeChange {
+  frames: number;
+  previous: number;
+  reason: 'underruns' | 'stable';
+  dropouts: number;
+}
+
+export interface ThreadTuningStatus {
+  audioThread: 'off' | 'pending' | 'applied' | 'denied';
+  feederThreads: 'off' | 'pending' | 'applied' | 'denied';
+  lockedBytes: number;
+  lockFailures: number;
+}
+
+export interface HostApiOptions {
+  hostApi?: {
+    wasapi?: {
+      exclusive?: boolean;
+      threadPriority?: 'none' | 'audio' | 'capture' | 'distribution' | 'games' | 'playback' | 'proAudio' | 'windowManager';
+      polling?: boolean;
+      autoConvert?: boolean;
+    };
+    alsa?: { device?: string; realtime?: boolean };
+    coreAudio?: { changeDeviceParameters?: boolean; failIfConversionRequired?: boolean };
+  };
+  clipOff?: boolean;
+  ditherOff?: boolean;
+}
+
+export interface RealtimeOptions {
+  priority?: number;
+  cpu?: number;
+  lockMemory?: boolean;
+}
+
+export interface StreamClockSnapshot {
+  framesRendered: number;
+  framesDelivered: number;
+  framesAtDac: number;
+  dacTime: number;
+  callbackTime: number;
+  sampleRate: number;
+  callbacks: number;
+}
+
+export interface StreamClock {
+  snapshot(): StreamClockSnapshot;
+  audibleFrames(snapshot?: StreamClockSnapshot): number;
+  pendingFrames(): number;
 }
 
 export interface AudioMetadata {
@@ -39,13 +189,47 @@ export interface AudioMetadata {
   duration?: number | null;
 }
 
+export interface AnalysisFrame {
+  peak: Float32Array;
+  rms: Float32Array;
+  bands: Float32Array;
+}
+
+export interface LoudnessResult {
+  integrated: number;
+  range: number;
+  truePeak: number;
+  samplePeak: number;
+  duration: number;
+}
+
+export interface EqBand {
+  type?: 'peaking' | 'lowshelf' | 'highshelf' | 'lowpass' | 'highpass';
+  frequency: number;
+  q?: number;
+  gain?: number;
+}
+
+export interface LimiterOptions {
+  ceiling?: number;
+  lookaheadMs?: number;
+  releaseMs?: number;
+}
+
+export interface DspConfig {
+  eq: EqBand[];
+  matrix: number[][] | null;
+  limiter: LimiterOptions | null;
+  active: boolean;
+}
+
 export class AudioPlayer {
   constructor(options?: object);
   play(filePath: string, startPosition?: number): Promise<void>;
   playPlaylist(playlist: string[]): Promise<void>;
   playGapless(nextTrack: string): Promise<void>;
   crossfadeTo(nextTrack: string, duration?: number): Promise<void>;
-  playStream(url: string, options?: object): Promise<void>;
+  playStream(url: string, options?: StreamPlaybackOptions): Promise<void>;
   pause(): Promise<void>;
   resume(): Promise<void>;
   stop(): Promise<void>;
@@ -53,8 +237,11 @@ export class AudioPlayer {
   setVolume(level: number): Promise<void>;
   getVolume(): number;
   setOutputDevice(deviceIndex: number): Promise<void>;
+  watchDevices(options?: DeviceWatchOptions): Promise<string | null>;
+  unwatchDevices(): void;
   setBitPerfect(options?: boolean | object): Promise<void>;
   setBufferSize(frames: number): void;
+  setAdaptiveBuffering(options: AdaptiveBufferOptions | boolean): void;
   setCrossfadeDuration(duration: number): void;
   setCrossfadeCurve(curve: string): void;
   getMetadata(): Promise<AudioMetadata>;
@@ -66,11 +253,62 @@ export class AudioPlayer {
   };
   getStatus(): AudioPlayerStatus;
   getCurrentTime(): number;
+  /**
+   * Native sample-accurate playback clock of the open stream, or null.
+   */
+  getPlaybackClock(): StreamClock | null;
+  setCurrentTimeInterval(intervalMs: number): void;
+  setResampleQuality(quality: 'low' | 'medium' | 'high' | 'best'): void;
+  /**
+   * Real-time priority, CPU pinning and locked buffers for the native audio threads.
+   */
+  setRealtimeScheduling(options?: boolean | RealtimeOptions): void;
+  /**
+   * Host-API-specific settings (WASAPI exclusive, ALSA hw devices, CoreAudio) for new streams.
+   */
+  setHostApiOptions(options: HostApiOptions | null): void;
+  setInputMonitoring(options: InputMonitoringOptions | null): void;
+  getCaptureReader(): CaptureReader | null;
+  /**
+   * Seconds of played audio kept buffered so seeking back within them stays in place.
+   */
+  setSeekRetention(seconds: number): void;
+  /**
+   * Cache decoded PCM on disk and replay cached tracks natively via mmap.
+   */
+  enablePcmCache(options: { directory: string; maxBytes?: number }): void;
+  disablePcmCache(): void;
+  /**
+   * Measure tracks' loudness in the background (results kept in a sidecar file) and
+   * play each with its stored gain applied natively.
+   */
+  enableLoudnessNormalization(options?: {
+    cacheFile?: string;
+    targetLufs?: number;
+    preventClipping?: boolean;
+    concurrency?: number;
+    lookahead?: number;
+  }): Promise<void>;
+  disableLoudnessNormalization(): void;
+  analyzeLoudness(filePath: string): Promise<LoudnessResult>;
   /**
    * Get current track duration in seconds, or null if unknown.
    */
   getDuration(): number | null;
   onVisualization(callback: (pcm: Buffer | Float32Array) => void): void;
+  /**
+   * Native output levels (linear) and log-spaced spectrum bands (dBFS) at a fixed rate.
+   */
+  onAnalysis(
+    callback: ((frame: AnalysisFrame) => void) | null,
+    options?: { fftSize?: number; bands?: number; rate?: number }
+  ): void;
+  /**
+   * Native output DSP (channel matrix, parametric EQ, limiter); not available in bit-perfect mode.
+   */
+  setEqualizer(bands: EqBand[]): void;
+  setLimiter(options: LimiterOptions | null): void;
+  setChannelMatrix(matrix: number[][] | null): void;
   stopPlaylist(): void;
   setPlaylistShuffle(enable?: boolean): void;
   setPlaylistRepeat(mode?: RepeatMode): void;
@@ -92,10 +330,17 @@ export class AudioPlayer {
   on(event: "bitPerfectChange", handler: (config: any) => void): void;
   on(event: "volumeChange", handler: (level: number) => void): void;
   on(event: "crossfadeConfigChange", handler: (config: any) => void): void;
+  on(event: "dspChange", handler: (config: DspConfig) => void): void;
+  on(event: "bufferSizeChange", handler: (change: BufferSizeChange) => void): void;
+  on(
+    event: "captureStart",
+    handler: (info: { reader: CaptureReader; source: 'input' | 'output'; channels: number; sampleRate: number }) => void
+  ): void;
   on(
     event: "deviceChange",
     handler: (info: { index: number; name: string; info: DeviceInfo }) => void
   ): void;
+  on(event: "deviceListChange", handler: (change: DeviceListChange) => void): void;
   on(
     event: "resampleInfo",
     handler: (info: {
@@ -106,14 +351,56 @@ export class AudioPlayer {
   ): void;
 }
 
+export interface DeviceCapabilities {
+  index: number;
+  name: string;
+  maxInputChannels: number;
+  maxOutputChannels: number;
+  defaultSampleRate: number;
+  supportedSampleRates: number[];
+  supportedChannels: number[];
+  supportedBitDepths: number[];
+  hostApi: number;
+  hostApiName: string;
+  isDefaultOutput: boolean;
+}
+
+export interface DeviceWatchOptions {
+  debounceMs?: number;
+  retryMs?: number;
+  reopenOnRemoval?: boolean;
+}
+
+export interface DeviceRefreshResult {
+  rescanned: boolean;
+  added: DeviceInfo[];
+  removed: DeviceInfo[];
+  devices: DeviceInfo[];
+  /** Streams moved to the default device because theirs went away. */
+  moved: number[];
+  /** Streams that could not be reopened and were closed. */
+  closed: number[];
+  selectedDeviceRemoved: boolean;
+}
+
+export interface DeviceListChange extends Omit<DeviceRefreshResult, 'rescanned'> {
+  reasons: Array<'added' | 'removed' | 'state' | 'default'>;
+}
+
 export class DeviceManager {
   listOutputDevices(): Promise<DeviceInfo[]>;
+  watchDevices(onChange: (change: DeviceListChange) => void, options?: DeviceWatchOptions): Promise<string | null>;
+  unwatchDevices(): void;
+  refreshDevices(options?: { reopenStreams?: boolean }): Promise<DeviceRefreshResult>;
   getCurrentDevice(): DeviceInfo | null;
   getDefaultDevice(): Promise<DeviceInfo>;
   setOutputDevice(
     index: number
   ): Promise<{ changed: boolean; device: DeviceInfo }>;
   getPortAudio(): Promise<any>;
+  probeCapabilities(): Promise<DeviceCapabilities[]>;
+  whenCapabilitiesReady(): Promise<void>;
+  refreshCapabilities(): Promise<DeviceCapabilities[]>;
 }
 
 export class PlaylistManager {
@@ -127,32 +414,145 @@ export class PlaylistManager {
   stopPlaylist(): void;
   setPlaylistShuffle(enable: boolean): void;
   setPlaylistRepeat(mode: RepeatMode): void;
+  /**
+   * Tracks that play after the current one, in play order.
+   */
+  getUpcomingTracks(count?: number): string[];
+  /**
+   * Pre-analyse the current and upcoming tracks' loudness as the playlist advances.
+   */
+  setLoudnessAnalyzer(analyzer: { prefetch(filePaths: string[]): void } | null, lookahead?: number): void;
+}
+
+export interface PcmPrebuffer {
+  readonly queuedBytes: number;
+  readonly capacityBytes: number;
+  isFull(): boolean;
+  write(chunk: Uint8Array): number;
+  read(maxBytes?: number): Buffer;
+  drainToRing(ring: object, streamId?: number, voiceId?: number): number;
+  end(): void;
+  endOfStream(): boolean;
+  isDrained(): boolean;
+  destroy(): void;
 }
 
 export class AudioEffects {
   isBitPerfectMode(): boolean;
+  isExclusiveBitPerfect(): boolean;
   setBitPerfect(options?: boolean | object): any;
   validateEffectAvailability(effect: string): void;
   setCrossfadeDuration(duration: number): void;
   setCrossfadeCurve(curve: string): void;
   getCrossfadeConfig(): any;
+  setEqualizer(bands: EqBand[]): void;
+  setLimiter(options: LimiterOptions | null): void;
+  setChannelMatrix(matrix: number[][] | null): void;
+  getDspConfig(): DspConfig;
   getConfiguration(): any;
+  /**
+   * Decode the next track into a bounded prebuffer; the decoder pauses at the cap.
+   */
   prebufferNextTrack(
     nextTrack: string,
     ffmpegPath: string,
-    opts: object
-  ): Promise<any>;
+    audioFormat?: { sampleRate?: number; channels?: number; sampleFormat?: string },
+    options?: { maxSeconds?: number; maxBytes?: number; portaudio?: object }
+  ): Promise<{
+    prebuffer: PcmPrebuffer;
+    ffmpeg: any;
+    ready(): boolean;
+    error(): Error | null;
+    cleanup(): void;
+  }>;
   waitForGaplessReady(timeout: number): Promise<boolean>;
-  getGaplessBuffers(): Float32Array[] | null;
+  getGaplessPrebuffer(): PcmPrebuffer | null;
+  getGaplessBuffers(): Buffer[] | null;
   cleanupGapless(): void;
 }
 
 export class StreamManager {
-  playStream(url: string, options?: object): Promise<void>;
+  playStream(url: string, options?: StreamPlaybackOptions): Promise<void>;
   isStreaming(): boolean;
+  getBufferState(): JitterBufferState | null;
   cleanup(): void;
 }
 
+export interface ZonePlayerOptions {
+  deviceManager?: DeviceManager;
+  sampleRate?: number;
+  bufferMs?: number;
+  maxCorrectionPpm?: number;
+}
+
+export interface ZoneOptions {
+  device?: number;
+  volume?: number;
+  delayMs?: number;
+  sampleRate?: number;
+  framesPerBuffer?: number;
+}
+
+export interface ZoneState {
+  name: string;
+  playing: boolean;
+  volume: number;
+  delayMs: number;
+  bufferedMs: number;
+  offsetMs: number;
+  speedPpm: number;
+}
+
+export class ZonePlayer {
+  constructor(options?: ZonePlayerOptions);
+  addZone(name: string, options?: ZoneOptions): void;
+  removeZone(name: string): boolean;
+  setZoneVolume(name: string, volume: number): void;
+  play(filePath: string, options?: { prefillMs?: number }): Promise<void>;
+  pause(): void;
+  resume(): void;
+  stop(): void;
+  getZoneStates(): ZoneState[];
+  on(event: "play" | "pause" | "resume" | "stop" | "trackEnd", handler: (track: string | null) => void): void;
+  on(event: "error", handler: (error: Error) => void): void;
+}
+
+export interface OfflineRendererOptions {
+  deviceManager?: DeviceManager;
+  sampleRate?: number;
+  channels?: number;
+  sampleFormat?: "f32le" | "s16le" | "s24le" | "s32le";
+  volume?: number;
+  dsp?: any;
+  concurrency?: number;
+  segmentSeconds?: number;
+}
+
+export type OfflineTrack = string | { path: string; start?: number; end?: number; gain?: number };
+
+export interface OfflineMixOptions {
+  output?: string;
+  crossfade?: { duration?: number; curve?: string };
+}
+
+export interface OfflineRenderResult {
+  frames: number;
+  duration: number;
+  renderSeconds: number;
+  segments: number;
+  stalls: number;
+  buffer?: Buffer;
+}
+
+/**
+ * Not available on Windows: renderMix() and renderBatch() reject there.
+ */
+export class OfflineRenderer {
+  constructor(options?: OfflineRendererOptions);
+  renderMix(tracks: OfflineTrack[], options?: OfflineMixOptions): Promise<OfflineRenderResult>;
+  renderBatch(jobs: Array<{ tracks: OfflineTrack[] } & OfflineMixOptions>): Promise<OfflineRenderResult[]>;
+}
+
 export namespace AudioUtils {
   function negotiateAudioFormat(
     trackInfo: any,
@@ -9,4 +9,6 @@ export { AudioPlayer } from './core/AudioPlayer.js';
 export { DeviceManager } from './core/DeviceManager.js';
 export { PlaylistManager } from './core/PlaylistManager.js';
 export { AudioEffects } from './core/AudioEffects.js';
-export { StreamManager } from './core/StreamManager.js';
\ No newline at end of file
+export { StreamManager } from './core/StreamManager.js';
+export { ZonePlayer } from './core/ZonePlayer.js';
+export { OfflineRenderer } from './core/OfflineRenderer.js';
\ No newline at end of file
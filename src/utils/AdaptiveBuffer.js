@@ -0,0 +1,174 @@
+/**
+ * @module AdaptiveBuffer
+ * @author zevinDev
+ * @description Output buffer sizing driven by the stream's observed dropouts
+ */
+
+/**
+ * Chooses the output period from the native xrun counters (getStreamStats()).
+ * Starts small, steps up the ladder of sizes when dropouts in the window reach the
+ * threshold, and steps back down after a stable stretch. A size that had to be left
+ * needs twice as long to be retried each time it fails, so a machine settles on the
+ * smallest size it can actually sustain instead of oscillating around it.
+ *
+ * @class
+ * @author zevinDev
+ * @example
+ * const sizing = new AdaptiveBufferController({ minFrames: 128, maxFrames: 4096 });
+ * const change = sizing.sample(portaudio.getStreamStats(streamId));
+ * if (change) portaudio.switchStreamDevice(streamId, { framesPerBuffer: change.frames });
+ */
+export class AdaptiveBufferController {
+  /**
+   * @param {object} [options] - Sizing options.
+   * @param {number} [options.minFrames=128] - Smallest period in frames.
+   * @param {number} [options.maxFrames=4096] - Largest period in frames.
+   * @param {number} [options.initialFrames] - Period to start at (defaults to minFrames).
+   * @param {number} [options.growThreshold=2] - Dropouts within the window that trigger a step up.
+   * @param {number} [options.windowMs=10000] - Window the dropouts are counted over.
+   * @param {number} [options.stableMs=60000] - Dropout-free time before a step down.
+   * @param {boolean} [options.unspecified=false] - Leave the period to the host API
+   *   (paFramesPerBufferUnspecified) and size the suggested latency instead.
+   */
+  constructor({
+    minFrames = 128,
+    maxFrames = 4096,
+    initialFrames,
+    growThreshold = 2,
+    windowMs = 10000,
+    stableMs = 60000,
+    unspecified = false
+  } = {}) {
+    if (!(minFrames > 0) || !(maxFrames >= minFrames)) {
+      throw new Error('Adaptive buffering needs 0 < minFrames <= maxFrames');
+    }
+    // Doubling ladder from minFrames, capped at maxFrames
+    this._sizes = [];
+    for (let frames = Math.floor(minFrames); frames < maxFrames; frames *= 2) this._sizes.push(frames);
+    this._sizes.push(Math.floor(maxFrames));
+    const start = initialFrames > 0 ? initialFrames : minFrames;
+    this._index = this._sizes.findIndex(frames => frames >= start);
+    if (this._index < 0) this._index = this._sizes.length - 1;
+    this._growThreshold = Math.max(1, Math.floor(growThreshold));
+    this._windowMs = windowMs;
+    this._stableMs = stableMs;
+    this.unspecified = Boolean(unspecified);
+    // Times a size was left because of dropouts; doubles its stable time on retry
+    this._strikes = new Array(this._sizes.length).fill(0);
+    this._glitches = [];
+    this._baseline = null;
+    this._lastChange = 0;
+    this._lastGlitch = 0;
+  }
+
+  /**
+   * Period the stream should run at.
+   *
+   * @returns {number} Frames per buffer.
+   * @author zevinDev
+   */
+  get frames() {
+    return this._sizes[this._index];
+  }
+
+  /**
+   * Forget the counter baseline (a new stream was opened, or the stream was reopened).
+   *
+   * @returns {void}
+   * @author zevinDev
+   */
+  reset() {
+    this._baseline = null;
+    this._glitches = [];
+  }
+
+  /**
+   * Feed a stats snapshot; returns the new size when the stream should be resized.
+   * Device underflows and callbacks that had to substitute silence both count as dropouts.
+   *
+   * @param {object} stats - Result of portaudio.getStreamStats().
+   * @param {number} [now=Date.now()] - Current time in milliseconds.
+   * @returns {{frames: number, previous: number, reason: string, dropouts: number}|null} Resize, or null to keep the size.
+   * @author zevinDev
+   */
+  sample(stats, now = Date.now()) {
+    const counters = {
+      underflows: stats?.underflows ?? 0,
+      starved: stats?.starvedCallbacks ?? 0
+    };
+    const baseline = this._baseline;
+    this._baseline = counters;
+    if (!baseline || counters.underflows < baseline.underflows || counters.starved < baseline.starved) {
+      // First sample after a (re)open only establishes the baseline
+      if (!this._lastChange) this._lastChange = now;
+      return null;
+    }
+    const dropouts = counters.underflows - baseline.underflows + counters.starved - baseline.starved;
+    if (dropouts > 0) {
+      this._glitches.push({ time: now, count: dropouts });
+      this._lastGlitch = now;
+    }
+    this._glitches = this._glitches.filter(glitch => now - glitch.time < this._windowMs);
+    const recent = this._glitches.reduce((sum, glitch) => sum + glitch.count, 0);
+    if (recent >= this._growThreshold && this._index < this._sizes.length - 1) {
+      this._strikes[this._index] = Math.min(this._strikes[this._index] + 1, 6);
+      return this._move(this._index + 1, 'underruns', recent, now);
+    }
+    if (this._index > 0) {
+      // Retrying a size that failed before takes longer each time
+      const stableMs = this._stableMs * 2 ** this._strikes[this._index - 1];
+      if (now - Math.max(this._lastGlitch, this._lastChange) >= stableMs) {
+        return this._move(this._index - 1, 'stable', 0, now);
+      }
+    }
+    return null;
+  }
+
+  /**
+   * Go back to the size before the last change (the stream could not be resized).
+   *
+   * @param {{previous: number}} change - Change returned by sample().
+   * @returns {void}
+   * @author zevinDev
+   */
+  revert(change) {
+    const index = this._sizes.indexOf(change.previous);
+    if (index >= 0) this._index = index;
+  }
+
+  /**
+   * Snapshot for status reporting.
+   *
+   * @returns {{frames: number, minFrames: number, maxFrames: number, unspecified: boolean, recentDropouts: number}} Sizing state.
+   * @author zevinDev
+   */
+  getState() {
+    return {
+      frames: this.frames,
+      minFrames: this._sizes[0],
+      maxFrames: this._sizes[this._sizes.length - 1],
+      unspecified: this.unspecified,
+      recentDropouts: this._glitches.reduce((sum, glitch) => sum + glitch.count, 0)
+    };
+  }
+
+  /**
+   * Switch to another rung of the ladder.
+   *
+   * @private
+   * @param {number} index - New size index.
+   * @param {string} reason - 'underruns' or 'stable'.
+   * @param {number} dropouts - Dropouts that caused the change.
+   * @param {number} now - Current time in milliseconds.
+   * @returns {{frames: number, previous: number, reason: string, dropouts: number}} The change.
+   * @author zevinDev
+   */
+  _move(index, reason, dropouts, now) {
+    const previous = this.frames;
+    this._index = index;
+    this._lastChange = now;
+    // Reopening the stream glitches by itself; let the next sample re-baseline
+    this.reset();
+    return { frames: this.frames, previous, reason, dropouts };
+  }
+}
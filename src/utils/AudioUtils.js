@@ -88,7 +88,8 @@ export function negotiateAudioFormat(trackInfo, deviceInfo, portaudio) {
         supported = portaudio.isOutputFormatSupported(
           deviceInfo.index,
           outputSampleRate,
-          outputChannels
+          outputChannels,
+          sampleFormat
         );
       } catch {
         supported = false;
@@ -102,6 +103,7 @@ export function negotiateAudioFormat(trackInfo, deviceInfo, portaudio) {
     sampleRate: outputSampleRate,
     channels: outputChannels,
     bitDepth: outputBitDepth,
+    sampleFormat,
     needsResampling,
     needsRemixing,
     needsBitDepthConversion,
@@ -112,6 +114,24 @@ export function negotiateAudioFormat(trackInfo, deviceInfo, portaudio) {
   };
 }
 
+/**
+ * Size in bytes of one sample of a PCM sample format.
+ *
+ * @param {string} sampleFormat - 'f32le', 's16le', 's24le' or 's32le'.
+ * @returns {number} Bytes per sample (int24 is packed into 3 bytes).
+ * @throws {Error} If the sample format is unknown.
+ * @author zevinDev
+ * @example
+ * const frameBytes = bytesPerSample('s16le') * 2; // 4
+ */
+export function bytesPerSample(sampleFormat) {
+  const sizes = { f32le: 4, s16le: 2, s24le: 3, s32le: 4 };
+  if (!(sampleFormat in sizes)) {
+    throw new Error(`Unsupported sample format: ${sampleFormat}`);
+  }
+  return sizes[sampleFormat];
+}
+
 /**
  * Scale PCM float32le buffer by volume (software gain).
  *
@@ -165,6 +185,8 @@ export function mixCrossfade(currentBuffers, nextBuffers, crossfadeFrames, chann
   
   // Select curve function
   let curveFunc = (x) => x; // linear by default
+  // Fade-out shape; the complement of the fade-in except for equal-power
+  let fadeOutFunc = (x) => 1 - curveFunc(x);
   
   switch (curve.toLowerCase()) {
     case 'log':
@@ -175,6 +197,11 @@ export function mixCrossfade(currentBuffers, nextBuffers, crossfadeFrames, chann
     case 'exponential':
       curveFunc = (x) => x === 0 ? 0 : Math.pow(2, 10 * (x - 1)); // exponential curve
       break;
+    case 'equal-power':
+    case 'equalpower':
+      curveFunc = (x) => Math.sin(x * Math.PI / 2); // constant power across the fade
+      fadeOutFunc = (x) => Math.cos(x * Math.PI / 2);
+      break;
     case 'linear':
     default:
       curveFunc = (x) => x;
@@ -182,7 +209,7 @@ export function mixCrossfade(currentBuffers, nextBuffers, crossfadeFrames, chann
   
   for (let i = 0; i < crossfadeFrames; i++) {
     const t = i / crossfadeFrames;
-    const fadeOut = 1 - curveFunc(t);
+    const fadeOut = fadeOutFunc(t);
     const fadeIn = curveFunc(t);
     
     for (let ch = 0; ch < channels; ch++) {
@@ -232,15 +259,16 @@ export function shuffleArray(arr) {
  * const c = validateCrossfadeCurve('log');
  */
 export function validateCrossfadeCurve(curve) {
-  const valid = ['linear', 'log', 'logarithmic', 'exp', 'exponential'];
+  const valid = ['linear', 'log', 'logarithmic', 'exp', 'exponential', 'equal-power', 'equalpower'];
   
   if (typeof curve !== 'string' || !valid.includes(curve.toLowerCase())) {
-    throw new Error(`Invalid crossfade curve: ${curve}. Valid: linear, logarithmic, exponential.`);
+    throw new Error(`Invalid crossfade curve: ${curve}. Valid: linear, logarithmic, exponential, equal-power.`);
   }
   
   // Normalize curve name
   if (curve.toLowerCase().startsWith('log')) return 'logarithmic';
   if (curve.toLowerCase().startsWith('exp')) return 'exponential';
+  if (curve.toLowerCase().startsWith('equal')) return 'equal-power';
   return 'linear';
 }
 
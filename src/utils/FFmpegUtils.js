@@ -60,12 +60,14 @@ export async function locateFFprobe() {
  * @param {number} [options.channels=2] - Target number of channels.
  * @param {string} [options.format='f32le'] - Output format.
  * @param {string} [options.codec='pcm_f32le'] - Audio codec.
+ * @param {string} [options.sampleFormat] - PCM sample format ('f32le', 's16le', 's24le', 's32le'); sets format and codec together.
  * @param {number} [options.seekPosition] - Seek position in seconds.
  * @param {string[]} [options.extra] - Extra ffmpeg arguments.
  * @returns {string[]} FFmpeg arguments array.
  * @author zevinDev
  * @example
  * const args = buildFFmpegArgs({ input: 'track.flac', sampleRate: 48000 });
+ * const args16 = buildFFmpegArgs({ input: 'track.flac', sampleFormat: 's16le' });
  */
 export function buildFFmpegArgs({
   input,
@@ -74,10 +76,16 @@ export function buildFFmpegArgs({
   channels = 2,
   format = 'f32le',
   codec = 'pcm_f32le',
+  sampleFormat,
   seekPosition
 }) {
   const args = ['-hide_banner', '-loglevel', 'error'];
   
+  if (sampleFormat) {
+    format = sampleFormat;
+    codec = `pcm_${sampleFormat}`;
+  }
+  
   // Add seek position if specified
   if (seekPosition !== undefined) {
     args.push('-ss', String(seekPosition));
@@ -0,0 +1,193 @@
+/**
+ * @module JitterBuffer
+ * @author zevinDev
+ * @description Watermark-gated PCM buffer between a network decoder and a native ring
+ */
+
+import { pipeToRing } from './RingBuffer.js';
+
+/**
+ * Jitter buffer for network streams, kept in the native ring of a ring-mode stream.
+ * Playback holds (buffering) until the fill level reaches the high watermark and holds
+ * again whenever it falls below the low watermark, so a slow uplink costs a fixed delay
+ * instead of a stutter on every late packet. When the ring is full the input is paused
+ * and only resumed once playback has drained it below the high watermark, so the
+ * network is read in bursts rather than one chunk per callback.
+ * The ring outlives decoders: after a reconnect, attach() the new decoder's output and
+ * whatever is still buffered keeps playing meanwhile.
+ *
+ * @class
+ * @author zevinDev
+ * @example
+ * const jitter = new JitterBuffer({
+ *   ring, bytesPerSecond: 44100 * 8,
+ *   onBuffering: isBuffering => portaudio.setStreamPaused(streamId, isBuffering),
+ *   onInputPause: paused => (paused ? response.pause() : response.resume())
+ * });
+ * jitter.attach(ffmpeg.stdout);
+ */
+export class JitterBuffer {
+  /**
+   * @param {object} options - Buffer options.
+   * @param {import('./RingBuffer.js').PcmRingWriter} options.ring - Ring of the output stream.
+   * @param {number} options.bytesPerSecond - PCM bytes per second of audio.
+   * @param {number} [options.lowWatermarkMs=500] - Fill level below which playback holds.
+   * @param {number} [options.highWatermarkMs=2000] - Fill level at which playback (re)starts
+   *   and a paused input resumes.
+   * @param {number} [options.intervalMs=50] - How often the fill level is checked.
+   * @param {Function} [options.onBuffering] - Called with true when playback must hold, false when it may run.
+   * @param {Function} [options.onInputPause] - Called with true to pause the input, false to resume it.
+   * @param {Function} [options.onDrained] - Called once everything was played after end().
+   */
+  constructor({
+    ring,
+    bytesPerSecond,
+    lowWatermarkMs = 500,
+    highWatermarkMs = 2000,
+    intervalMs = 50,
+    onBuffering,
+    onInputPause,
+    onDrained
+  }) {
+    if (!ring || !(bytesPerSecond > 0)) {
+      throw new Error('Jitter buffer needs a ring and a positive byte rate');
+    }
+    this._ring = ring;
+    this._bytesPerMs = bytesPerSecond / 1000;
+    // The ring can hold no more than its capacity, so clamp the marks into it
+    const capacityMs = ring.writeAvailable() / this._bytesPerMs;
+    this._highMs = Math.min(Math.max(highWatermarkMs, 0), capacityMs * 0.9);
+    this._lowMs = Math.min(Math.max(lowWatermarkMs, 0), this._highMs);
+    this._capacityMs = capacityMs;
+    this._onBuffering = onBuffering;
+    this._onInputPause = onInputPause;
+    this._onDrained = onDrained;
+    this._pump = null;
+    this._buffering = true;
+    this._inputPaused = false;
+    this._ended = false;
+    this._stalls = 0;
+    this._timer = setInterval(() => this._check(), intervalMs);
+  }
+
+  /**
+   * Feed a decoder's PCM output into the ring, replacing the previous decoder.
+   *
+   * @param {import('stream').Readable} readable - Decoded PCM (e.g. ffmpeg stdout).
+   * @param {object} [options] - Pump options.
+   * @param {Function} [options.onChunk] - Called with every chunk (e.g. visualization).
+   * @returns {void}
+   * @author zevinDev
+   */
+  attach(readable, { onChunk } = {}) {
+    this._pump?.stop();
+    this._pump = pipeToRing(readable, this._ring, { onChunk });
+  }
+
+  /**
+   * Mark the end of the stream: what is buffered plays out, then onDrained fires.
+   *
+   * @returns {void}
+   * @author zevinDev
+   */
+  end() {
+    this._ended = true;
+    // The last chunk may still be waiting for space; the ring is ended once it is in
+    this._check();
+  }
+
+  /**
+   * Audio queued in the ring.
+   *
+   * @returns {number} Buffered milliseconds.
+   * @author zevinDev
+   */
+  bufferedMs() {
+    return this._ring.readAvailable() / this._bytesPerMs;
+  }
+
+  /**
+   * Snapshot for status reporting.
+   *
+   * @returns {{bufferedMs: number, buffering: boolean, inputPaused: boolean, stalls: number, lowWatermarkMs: number, highWatermarkMs: number, capacityMs: number}} Buffer state.
+   * @author zevinDev
+   */
+  getState() {
+    return {
+      bufferedMs: Math.round(this.bufferedMs()),
+      buffering: this._buffering,
+      inputPaused: this._inputPaused,
+      stalls: this._stalls,
+      lowWatermarkMs: this._lowMs,
+      highWatermarkMs: this._highMs,
+      capacityMs: Math.round(this._capacityMs)
+    };
+  }
+
+  /**
+   * Stop watching the ring and feeding it.
+   *
+   * @returns {void}
+   * @author zevinDev
+   */
+  stop() {
+    clearInterval(this._timer);
+    this._timer = null;
+    this._pump?.stop();
+    this._pump = null;
+  }
+
+  /**
+   * Apply the watermarks to the current fill level.
+   *
+   * @private
+   * @author zevinDev
+   */
+  _check() {
+    const bufferedMs = this.bufferedMs();
+    if (this._ended) {
+      if (this._pump?.hasPending()) return;
+      if (!this._ring.endOfStream()) this._ring.end();
+      // Play out the tail even though it is below the low watermark
+      this._setBuffering(false);
+      if (this._ring.isDrained()) {
+        this.stop();
+        this._onDrained?.();
+      }
+      return;
+    }
+    if (!this._buffering && bufferedMs < this._lowMs) {
+      this._stalls++;
+      this._setBuffering(true);
+    } else if (this._buffering && bufferedMs >= this._highMs) {
+      this._setBuffering(false);
+    }
+    // Full ring: stop the input until playback has made real room again
+    if (!this._inputPaused && this._pump?.hasPending()) {
+      this._setInputPaused(true);
+    } else if (this._inputPaused && !this._pump?.hasPending() && bufferedMs < this._highMs) {
+      this._setInputPaused(false);
+    }
+  }
+
+  /**
+   * @private
+   * @param {boolean} buffering - New buffering state.
+   * @author zevinDev
+   */
+  _setBuffering(buffering) {
+    if (this._buffering === buffering) return;
+    this._buffering = buffering;
+    this._onBuffering?.(buffering);
+  }
+
+  /**
+   * @private
+   * @param {boolean} paused - New input state.
+   * @author zevinDev
+   */
+  _setInputPaused(paused) {
+    this._inputPaused = paused;
+    this._onInputPause?.(paused);
+  }
+}
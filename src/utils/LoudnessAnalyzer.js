@@ -0,0 +1,295 @@
+/**
+ * @module LoudnessAnalyzer
+ * @author zevinDev
+ * @description Background EBU R128 loudness analysis with results persisted to a sidecar file
+ */
+
+import { createHash } from 'node:crypto';
+import { closeSync, mkdirSync, readFileSync, renameSync, statSync, writeFileSync } from 'node:fs';
+import { dirname, resolve } from 'node:path';
+import { buildFFmpegArgs, createFFmpegProcess, getAudioInfo, killFFmpegProcess } from './FFmpegUtils.js';
+import { canDecodeNatively } from './NativeDecoder.js';
+
+const CACHE_VERSION = 1;
+// Rate non-WAV tracks are decoded at for measuring (BS.1770 is rate independent)
+const ANALYSIS_SAMPLE_RATE = 48000;
+const MAX_ANALYSIS_CHANNELS = 8;
+// Coalesce sidecar writes while a batch of tracks finishes
+const SAVE_DELAY_MS = 1000;
+
+/**
+ * Measures tracks' integrated loudness, loudness range and true peak natively, at most
+ * `concurrency` at a time, and keeps the results in a compact JSON sidecar keyed by
+ * path, mtime and size. WAV files are read by the addon itself; other formats are
+ * decoded by ffmpeg into a pipe the addon reads, so no PCM passes through JS.
+ *
+ * @class
+ * @author zevinDev
+ * @example
+ * const analyzer = new LoudnessAnalyzer({ portaudio, ffmpegPath, cacheFile: '/var/cache/zeaker/loudness.json' });
+ * analyzer.prefetch(['a.flac', 'b.flac']);
+ * const gainDb = analyzer.gainFor('a.flac', { targetLufs: -18 });
+ */
+export class LoudnessAnalyzer {
+  /**
+   * @param {object} options - Analyzer options.
+   * @param {object} options.portaudio - Native binding (needs analyzeLoudnessAsync).
+   * @param {string} options.ffmpegPath - ffmpeg binary for formats the addon cannot read.
+   * @param {string} [options.cacheFile] - Sidecar file for results; in memory only if omitted.
+   * @param {number} [options.concurrency=2] - Maximum analyses running at once.
+   */
+  constructor({ portaudio, ffmpegPath, cacheFile, concurrency = 2 }) {
+    if (typeof portaudio?.analyzeLoudnessAsync !== 'function') {
+      throw new Error('Native loudness analysis is not available');
+    }
+    this._portaudio = portaudio;
+    this._ffmpegPath = ffmpegPath;
+    this._cacheFile = cacheFile ? resolve(cacheFile) : null;
+    this._concurrency = Math.max(1, Math.floor(concurrency));
+    this._entries = new Map();
+    this._pending = new Map();
+    this._queue = [];
+    this._running = new Set();
+    this._saveTimer = null;
+    this._destroyed = false;
+    this._load();
+  }
+
+  /**
+   * Read the sidecar file, ignoring a missing or unreadable one.
+   *
+   * @private
+   * @author zevinDev
+   */
+  _load() {
+    if (!this._cacheFile) return;
+    try {
+      const data = JSON.parse(readFileSync(this._cacheFile, 'utf8'));
+      if (data?.version !== CACHE_VERSION || typeof data.entries !== 'object') return;
+      for (const [key, value] of Object.entries(data.entries)) {
+        if (Array.isArray(value) && value.length === 5) this._entries.set(key, value);
+      }
+    } catch {
+      // Start empty; the file is rewritten on the next result
+    }
+  }
+
+  /**
+   * Write the sidecar file atomically (temp file and rename).
+   *
+   * @private
+   * @author zevinDev
+   */
+  _save() {
+    this._saveTimer = null;
+    if (!this._cacheFile) return;
+    try {
+      mkdirSync(dirname(this._cacheFile), { recursive: true });
+      const temp = `${this._cacheFile}.${process.pid}.tmp`;
+      writeFileSync(temp, JSON.stringify({ version: CACHE_VERSION, entries: Object.fromEntries(this._entries) }));
+      renameSync(temp, this._cacheFile);
+    } catch (error) {
+      console.warn('[LoudnessAnalyzer] Failed to save results:', error.message);
+    }
+  }
+
+  /**
+   * Schedule a sidecar write.
+   *
+   * @private
+   * @author zevinDev
+   */
+  _scheduleSave() {
+    if (!this._cacheFile || this._saveTimer) return;
+    this._saveTimer = setTimeout(() => this._save(), SAVE_DELAY_MS);
+    this._saveTimer.unref?.();
+  }
+
+  /**
+   * Cache key of a file's current contents, or null if it is missing.
+   *
+   * @private
+   * @param {string} filePath - Audio file.
+   * @returns {string|null} Key.
+   * @author zevinDev
+   */
+  _key(filePath) {
+    let info;
+    try {
+      info = statSync(filePath);
+    } catch {
+      return null;
+    }
+    return createHash('sha1').update([resolve(filePath), info.mtimeMs, info.size].join('\0')).digest('base64url');
+  }
+
+  /**
+   * Stored result for a file, without analysing it.
+   *
+   * @param {string} filePath - Audio file.
+   * @returns {{integrated: number, range: number, truePeak: number, samplePeak: number, duration: number}|null} Result (LUFS, LU, dBTP, dBFS, seconds), or null if not analysed yet.
+   * @author zevinDev
+   */
+  lookup(filePath) {
+    const key = this._key(filePath);
+    const entry = key && this._entries.get(key);
+    if (!entry) return null;
+    // Silence is stored as null (JSON has no -Infinity)
+    const [integrated, range, truePeak, samplePeak, duration] = entry.map(v => v ?? -Infinity);
+    return { integrated, range, truePeak, samplePeak, duration };
+  }
+
+  /**
+   * Gain that brings a file to the target loudness, from its stored result.
+   *
+   * @param {string} filePath - Audio file.
+   * @param {object} [options] - Gain options.
+   * @param {number} [options.targetLufs=-18] - Target integrated loudness (ReplayGain 2.0 reference).
+   * @param {boolean} [options.preventClipping=true] - Limit the gain so the true peak stays at or below 0 dBTP.
+   * @returns {number|null} Gain in dB, or null if the file has not been analysed.
+   * @author zevinDev
+   */
+  gainFor(filePath, { targetLufs = -18, preventClipping = true } = {}) {
+    const result = this.lookup(filePath);
+    if (!result || !Number.isFinite(result.integrated)) return result ? 0 : null;
+    let gain = targetLufs - result.integrated;
+    if (preventClipping && Number.isFinite(result.truePeak)) {
+      gain = Math.min(gain, -result.truePeak);
+    }
+    return gain;
+  }
+
+  /**
+   * Analyse a file, resolving immediately with a stored result.
+   *
+   * @param {string} filePath - Audio file.
+   * @returns {Promise<object>} Result as returned by lookup().
+   * @throws {Error} If the file cannot be decoded.
+   * @author zevinDev
+   */
+  analyze(filePath) {
+    const stored = this.lookup(filePath);
+    if (stored) return Promise.resolve(stored);
+    const key = this._key(filePath);
+    if (!key) return Promise.reject(new Error(`Cannot read ${filePath}`));
+    if (this._pending.has(key)) return this._pending.get(key);
+    const promise = new Promise((resolvePromise, reject) => {
+      this._queue.push({ filePath, key, resolve: resolvePromise, reject });
+    });
+    this._pending.set(key, promise);
+    promise.catch(() => {}).finally(() => this._pending.delete(key));
+    this._drain();
+    return promise;
+  }
+
+  /**
+   * Queue files for background analysis; failures are logged, not thrown.
+   *
+   * @param {string[]} filePaths - Audio files, most urgent first.
+   * @returns {void}
+   * @author zevinDev
+   */
+  prefetch(filePaths) {
+    for (const filePath of filePaths) {
+      if (typeof filePath !== 'string' || this.lookup(filePath)) continue;
+      this.analyze(filePath).catch(error => {
+        console.warn('[LoudnessAnalyzer] Analysis failed for', filePath, error.message);
+      });
+    }
+  }
+
+  /**
+   * Start queued jobs up to the concurrency limit.
+   *
+   * @private
+   * @author zevinDev
+   */
+  _drain() {
+    while (!this._destroyed && this._running.size < this._concurrency && this._queue.length > 0) {
+      const job = this._queue.shift();
+      const run = { ffmpeg: null };
+      this._running.add(run);
+      this._measure(job.filePath, run)
+        .then(result => {
+          const entry = [result.integrated, result.range, result.truePeak, result.samplePeak, result.duration]
+            .map(v => (Number.isFinite(v) ? Math.round(v * 100) / 100 : null));
+          this._entries.set(job.key, entry);
+          this._scheduleSave();
+          job.resolve(this.lookup(job.filePath) ?? result);
+        })
+        .catch(job.reject)
+        .finally(() => {
+          this._running.delete(run);
+          this._drain();
+        });
+    }
+  }
+
+  /**
+   * Measure one file natively.
+   *
+   * @private
+   * @param {string} filePath - Audio file.
+   * @param {object} run - Receives the ffmpeg process so destroy() can stop it.
+   * @returns {Promise<object>} Native result.
+   * @author zevinDev
+   */
+  async _measure(filePath, run) {
+    if (canDecodeNatively(this._portaudio, filePath)) {
+      try {
+        return await this._portaudio.analyzeLoudnessAsync(filePath);
+      } catch {
+        // A WAV variant the addon does not read: fall through to ffmpeg
+      }
+    }
+    if (!this._ffmpegPath || typeof this._portaudio.createPipe !== 'function') {
+      throw new Error(`Cannot decode ${filePath} without ffmpeg`);
+    }
+    const info = await getAudioInfo(filePath);
+    const sourceChannels = Number(info?.channels);
+    const channels = sourceChannels > 0 && sourceChannels <= MAX_ANALYSIS_CHANNELS ? sourceChannels : 2;
+    const args = buildFFmpegArgs({ input: filePath, sampleRate: ANALYSIS_SAMPLE_RATE, channels, sampleFormat: 'f32le' });
+    const { readFd, writeFd } = this._portaudio.createPipe();
+    let exitCode = null;
+    let exited;
+    try {
+      run.ffmpeg = createFFmpegProcess(this._ffmpegPath, args, { stdio: ['ignore', writeFd, 'ignore'] });
+      exited = new Promise(resolveExit => {
+        run.ffmpeg.on('close', code => { exitCode = code; resolveExit(); });
+        run.ffmpeg.on('error', () => resolveExit());
+      });
+    } catch (error) {
+      closeSync(readFd);
+      throw error;
+    } finally {
+      closeSync(writeFd);
+    }
+    // The addon closes readFd when it reaches EOF
+    const result = await this._portaudio.analyzeLoudnessAsync({ fd: readFd, sampleRate: ANALYSIS_SAMPLE_RATE, channels });
+    await exited;
+    if (exitCode !== 0) {
+      throw new Error(`FFmpeg exited with code ${exitCode}`);
+    }
+    return result;
+  }
+
+  /**
+   * Stop all work, rejecting queued analyses, and write pending results.
+   *
+   * @returns {void}
+   * @author zevinDev
+   */
+  destroy() {
+    this._destroyed = true;
+    for (const job of this._queue.splice(0)) {
+      job.reject(new Error('Loudness analyzer destroyed'));
+    }
+    for (const run of this._running) {
+      killFFmpegProcess(run.ffmpeg);
+    }
+    if (this._saveTimer) {
+      clearTimeout(this._saveTimer);
+      this._save();
+    }
+  }
+}
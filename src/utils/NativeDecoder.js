@@ -0,0 +1,43 @@
+/**
+ * @module NativeDecoder
+ * @author zevinDev
+ * @description In-process decoding for formats the native addon reads itself
+ */
+
+// The addon's decoder handles RIFF/WAVE; anything else goes through ffmpeg
+const NATIVE_EXTENSIONS = /\.(wav|wave)$/i;
+
+/**
+ * Whether a file is worth handing to the native decoder. The addon still checks the
+ * header and declines files it cannot play, so this only avoids opening the rest.
+ *
+ * @param {object} portaudio - Native binding.
+ * @param {string} filePath - Audio file.
+ * @returns {boolean} True when the binding has a decoder and the file looks supported.
+ * @author zevinDev
+ */
+export function canDecodeNatively(portaudio, filePath) {
+  return typeof portaudio?.attachDecoder === 'function' && typeof filePath === 'string' && NATIVE_EXTENSIONS.test(filePath);
+}
+
+/**
+ * Read a natively decodable file's stream info without spawning ffprobe.
+ *
+ * @param {object} portaudio - Native binding.
+ * @param {string} filePath - Audio file.
+ * @returns {{sampleRate: number, channels: number, bitDepth: number, duration: number}|null} Stream info in the shape of getAudioInfo(), or null if ffprobe is needed.
+ * @author zevinDev
+ * @example
+ * const info = probeNativeAudio(portaudio, 'track.wav') ?? await getAudioInfo('track.wav');
+ */
+export function probeNativeAudio(portaudio, filePath) {
+  if (!canDecodeNatively(portaudio, filePath) || typeof portaudio.probeAudioFile !== 'function') return null;
+  const probe = portaudio.probeAudioFile(filePath);
+  if (!probe) return null;
+  return {
+    sampleRate: probe.sampleRate,
+    channels: probe.channels,
+    bitDepth: probe.bitDepth,
+    duration: probe.duration
+  };
+}
@@ -0,0 +1,262 @@
+/**
+ * @module PcmCache
+ * @author zevinDev
+ * @description On-disk cache of decoded PCM, played back natively through mmap
+ */
+
+import { createHash } from 'node:crypto';
+import {
+  closeSync, mkdirSync, openSync, readSync, renameSync, statSync, unlinkSync, utimesSync, writeSync
+} from 'node:fs';
+import { readdir, stat, unlink } from 'node:fs/promises';
+import { join, resolve } from 'node:path';
+
+// Keep in sync with native/pcm_cache.h
+const HEADER_BYTES = 4096;
+const MAGIC = 'ZKPCM001';
+const FLAG_COMPLETE = 1;
+const FORMAT_CODES = { f32le: 0, s16le: 1, s24le: 2, s32le: 3 };
+const BYTES_PER_SAMPLE = { f32le: 4, s16le: 2, s24le: 3, s32le: 4 };
+
+const ENTRY_SUFFIX = '.pcm';
+const TEMP_SUFFIX = '.tmp';
+// Unfinished entries older than this are left over from crashed processes
+const STALE_TEMP_MS = 24 * 60 * 60 * 1000;
+
+/**
+ * Build a cache file header.
+ *
+ * @param {object} format - { sampleRate, channels, sampleFormat }.
+ * @param {number} frames - Number of frames in the file.
+ * @param {boolean} complete - Whether the decode is complete.
+ * @returns {Buffer} Header of HEADER_BYTES bytes.
+ * @author zevinDev
+ */
+function buildHeader(format, frames, complete) {
+  const header = Buffer.alloc(HEADER_BYTES);
+  header.write(MAGIC, 0, 'latin1');
+  header.writeUInt32LE(HEADER_BYTES, 8);
+  header.writeUInt32LE(format.sampleRate, 12);
+  header.writeUInt32LE(format.channels, 16);
+  header.writeUInt32LE(FORMAT_CODES[format.sampleFormat], 20);
+  header.writeUInt32LE(complete ? FLAG_COMPLETE : 0, 24);
+  header.writeBigUInt64LE(BigInt(frames), 32);
+  return header;
+}
+
+/**
+ * Size-capped, LRU-evicted cache of decoded PCM files shared by every process using the
+ * same directory. Entries are keyed by source path, mtime, size and target format; the
+ * most recently played entries are kept (last use is recorded in each file's mtime).
+ *
+ * @class
+ * @author zevinDev
+ * @example
+ * const cache = new PcmCache({ directory: '/var/cache/zeaker', maxBytes: 4 * 1024 ** 3 });
+ * const hit = cache.lookup('track.flac', { sampleRate: 44100, channels: 2, sampleFormat: 's16le' });
+ */
+export class PcmCache {
+  /**
+   * @param {object} options - Cache options.
+   * @param {string} options.directory - Directory holding the cache files (created if missing).
+   * @param {number} [options.maxBytes=2147483648] - Total size cap in bytes.
+   */
+  constructor({ directory, maxBytes = 2 * 1024 ** 3 }) {
+    if (!directory || typeof directory !== 'string') {
+      throw new Error('PcmCache requires a directory');
+    }
+    this._directory = resolve(directory);
+    this._maxBytes = maxBytes;
+    this._evicting = null;
+    mkdirSync(this._directory, { recursive: true });
+  }
+
+  /**
+   * Whether a target format can be cached.
+   *
+   * @param {object} format - { sampleRate, channels, sampleFormat }.
+   * @returns {boolean} True for the formats the native side can play back.
+   * @author zevinDev
+   */
+  supports(format) {
+    return format?.sampleFormat in FORMAT_CODES && format.sampleRate > 0 && format.channels > 0;
+  }
+
+  /**
+   * Path of the entry for a source file and target format, or null if the source is missing.
+   *
+   * @private
+   * @param {string} filePath - Source audio file.
+   * @param {object} format - { sampleRate, channels, sampleFormat }.
+   * @returns {string|null} Entry path.
+   * @author zevinDev
+   */
+  _entryPath(filePath, format) {
+    let info;
+    try {
+      info = statSync(filePath);
+    } catch {
+      return null;
+    }
+    const key = createHash('sha1')
+      .update([resolve(filePath), info.mtimeMs, info.size, format.sampleRate, format.channels, format.sampleFormat].join('\0'))
+      .digest('hex');
+    return join(this._directory, key + ENTRY_SUFFIX);
+  }
+
+  /**
+   * Look up a complete entry and mark it as recently used.
+   *
+   * @param {string} filePath - Source audio file.
+   * @param {object} format - { sampleRate, channels, sampleFormat }.
+   * @returns {{path: string, frames: number}|null} Entry, or null on a miss.
+   * @author zevinDev
+   */
+  lookup(filePath, format) {
+    if (!this.supports(format)) return null;
+    const path = this._entryPath(filePath, format);
+    if (!path) return null;
+    let fd;
+    try {
+      fd = openSync(path, 'r');
+      const header = Buffer.alloc(40);
+      if (readSync(fd, header, 0, header.length, 0) < header.length) return null;
+      if (header.toString('latin1', 0, 8) !== MAGIC || !(header.readUInt32LE(24) & FLAG_COMPLETE)) return null;
+      const now = new Date();
+      utimesSync(path, now, now);
+      return { path, frames: Number(header.readBigUInt64LE(32)) };
+    } catch {
+      return null;
+    } finally {
+      if (fd !== undefined) closeSync(fd);
+    }
+  }
+
+  /**
+   * Start a new entry to be filled with raw PCM appended to `fd`. Call finalize() once
+   * the whole track has been written, or abort() if decoding stopped early.
+   *
+   * @param {string} filePath - Source audio file.
+   * @param {object} format - { sampleRate, channels, sampleFormat }.
+   * @returns {{fd: number, finalize: Function, abort: Function, release: Function}|null} Entry writer, or null if not cacheable.
+   * @author zevinDev
+   */
+  createEntry(filePath, format) {
+    if (!this.supports(format)) return null;
+    const path = this._entryPath(filePath, format);
+    if (!path) return null;
+    const tempPath = `${path}.${process.pid}.${Date.now()}${TEMP_SUFFIX}`;
+    let fd;
+    try {
+      fd = openSync(tempPath, 'a');
+      writeSync(fd, buildHeader(format, 0, false));
+    } catch (error) {
+      if (fd !== undefined) closeSync(fd);
+      try { unlinkSync(tempPath); } catch {}
+      console.warn('[PcmCache] Cannot create cache entry:', error.message);
+      return null;
+    }
+    const bytesPerFrame = format.channels * BYTES_PER_SAMPLE[format.sampleFormat];
+    let owned = true;
+    let done = false;
+    const closeOwned = () => {
+      if (owned) closeSync(fd);
+      owned = false;
+    };
+    return {
+      fd,
+      // The fd was handed to someone who closes it (the native pipe reader)
+      release: () => {
+        owned = false;
+      },
+      finalize: () => {
+        if (done) return false;
+        done = true;
+        closeOwned();
+        try {
+          const size = statSync(tempPath).size;
+          const frames = Math.floor((size - HEADER_BYTES) / bytesPerFrame);
+          if (frames <= 0) throw new Error('empty decode');
+          const headerFd = openSync(tempPath, 'r+');
+          try {
+            writeSync(headerFd, buildHeader(format, frames, true), 0, HEADER_BYTES, 0);
+          } finally {
+            closeSync(headerFd);
+          }
+          // Atomic publish: readers only ever see complete entries under the final name
+          renameSync(tempPath, path);
+        } catch {
+          try { unlinkSync(tempPath); } catch {}
+          return false;
+        }
+        this.evict();
+        return true;
+      },
+      abort: () => {
+        if (done) return;
+        done = true;
+        closeOwned();
+        try { unlinkSync(tempPath); } catch {}
+      }
+    };
+  }
+
+  /**
+   * Delete least recently used entries until the cache fits in maxBytes.
+   * Runs in the background; concurrent calls share one pass.
+   *
+   * @returns {Promise<void>} Resolves when the pass is done.
+   * @author zevinDev
+   */
+  evict() {
+    if (!this._evicting) {
+      this._evicting = this._evictPass().finally(() => {
+        this._evicting = null;
+      });
+    }
+    return this._evicting;
+  }
+
+  /**
+   * One eviction pass over the cache directory.
+   *
+   * @private
+   * @returns {Promise<void>} Resolves when done.
+   * @author zevinDev
+   */
+  async _evictPass() {
+    let names;
+    try {
+      names = await readdir(this._directory);
+    } catch {
+      return;
+    }
+    const entries = [];
+    let total = 0;
+    const now = Date.now();
+    for (const name of names) {
+      const path = join(this._directory, name);
+      let info;
+      try {
+        info = await stat(path);
+      } catch {
+        continue;
+      }
+      if (name.endsWith(TEMP_SUFFIX)) {
+        if (now - info.mtimeMs > STALE_TEMP_MS) await unlink(path).catch(() => {});
+        continue;
+      }
+      if (!name.endsWith(ENTRY_SUFFIX)) continue;
+      entries.push({ path, size: info.size, lastUsed: info.mtimeMs });
+      total += info.size;
+    }
+    entries.sort((a, b) => a.lastUsed - b.lastUsed);
+    for (const entry of entries) {
+      if (total <= this._maxBytes) break;
+      // Processes already playing an entry keep their mapping after the unlink
+      await unlink(entry.path).catch(() => {});
+      total -= entry.size;
+    }
+  }
+}
+
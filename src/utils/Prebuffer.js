@@ -0,0 +1,262 @@
+/**
+ * @module Prebuffer
+ * @author zevinDev
+ * @description Bounded PCM prebuffer with decoder backpressure
+ */
+
+/**
+ * FIFO of decoded PCM capped at a fixed number of bytes. Uses the native block pool
+ * when the binding provides it (samples then live outside the JS heap and blocks are
+ * recycled between tracks), otherwise a queue of Buffers with the same cap.
+ *
+ * @class
+ * @author zevinDev
+ * @example
+ * const prebuffer = new PcmPrebuffer({ capacityBytes: 30 * 44100 * 2 * 4, portaudio });
+ * pipeToPrebuffer(ffmpeg.stdout, prebuffer);
+ * prebuffer.drainToRing(ring);
+ */
+export class PcmPrebuffer {
+  /**
+   * @param {object} options - Prebuffer options.
+   * @param {number} options.capacityBytes - Most bytes held at once.
+   * @param {object} [options.portaudio] - Native binding; enables the native block pool.
+   */
+  constructor({ capacityBytes, portaudio = null }) {
+    if (!(capacityBytes > 0)) {
+      throw new Error('Prebuffer capacity must be a positive number of bytes');
+    }
+    this._capacity = Math.floor(capacityBytes);
+    this._portaudio = typeof portaudio?.createPrebuffer === 'function' ? portaudio : null;
+    this._id = this._portaudio ? this._portaudio.createPrebuffer(this._capacity) : null;
+    this._chunks = [];
+    this._queued = 0;
+    this._ended = false;
+    this._onDrain = null;
+  }
+
+  /**
+   * Bytes currently queued.
+   *
+   * @returns {number} Queued bytes.
+   * @author zevinDev
+   */
+  get queuedBytes() {
+    return this._id !== null ? this._portaudio.getPrebufferState(this._id).queuedBytes : this._queued;
+  }
+
+  /**
+   * Most bytes held at once.
+   *
+   * @returns {number} Capacity in bytes.
+   * @author zevinDev
+   */
+  get capacityBytes() {
+    return this._capacity;
+  }
+
+  /**
+   * Whether the prebuffer is at its cap (the producer should pause).
+   *
+   * @returns {boolean} True when full.
+   * @author zevinDev
+   */
+  isFull() {
+    return this.queuedBytes >= this._capacity;
+  }
+
+  /**
+   * Queue as much of a chunk as fits.
+   *
+   * @param {Buffer|Uint8Array} chunk - PCM data.
+   * @returns {number} Bytes accepted.
+   * @author zevinDev
+   */
+  write(chunk) {
+    if (this._id !== null) return this._portaudio.prebufferWrite(this._id, chunk);
+    const n = Math.min(chunk.length, this._capacity - this._queued);
+    if (n <= 0) return 0;
+    // Copy so the queue never pins the producer's (possibly pooled) buffers
+    this._chunks.push(Buffer.from(chunk.subarray(0, n)));
+    this._queued += n;
+    return n;
+  }
+
+  /**
+   * Take up to maxBytes from the front.
+   *
+   * @param {number} [maxBytes] - Most bytes to return (everything queued by default).
+   * @returns {Buffer} PCM data (empty when nothing is queued).
+   * @author zevinDev
+   */
+  read(maxBytes = Infinity) {
+    let out;
+    if (this._id !== null) {
+      out = this._portaudio.prebufferRead(this._id, Number.isFinite(maxBytes) ? maxBytes : this._capacity);
+    } else {
+      const parts = [];
+      let remaining = Math.min(maxBytes, this._queued);
+      while (remaining > 0) {
+        const head = this._chunks[0];
+        if (head.length <= remaining) {
+          parts.push(this._chunks.shift());
+          remaining -= head.length;
+        } else {
+          parts.push(head.subarray(0, remaining));
+          this._chunks[0] = head.subarray(remaining);
+          remaining = 0;
+        }
+      }
+      out = Buffer.concat(parts);
+      this._queued -= out.length;
+    }
+    if (out.length > 0) this._drained();
+    return out;
+  }
+
+  /**
+   * Move as much queued PCM as fits into a mixer voice ring. With the native pool the
+   * copy happens natively for ring-mode voices (pass streamId and voiceId).
+   *
+   * @param {import('./RingBuffer.js').PcmRingWriter} ring - Destination ring (its only producer).
+   * @param {number} [streamId] - Stream owning the ring, for the native path.
+   * @param {number} [voiceId] - Voice owning the ring, for the native path.
+   * @returns {number} Bytes moved.
+   * @author zevinDev
+   */
+  drainToRing(ring, streamId, voiceId) {
+    let moved;
+    if (this._id !== null && streamId !== undefined && voiceId !== undefined) {
+      moved = this._portaudio.prebufferToVoice(this._id, streamId, voiceId);
+      if (moved > 0) this._drained();
+    } else {
+      moved = ring.write(this.read(ring.writeAvailable()));
+    }
+    return moved;
+  }
+
+  /**
+   * Mark the end of the producer's data.
+   *
+   * @author zevinDev
+   */
+  end() {
+    this._ended = true;
+  }
+
+  /**
+   * Whether the producer is done and everything queued has been taken.
+   *
+   * @returns {boolean} True once exhausted.
+   * @author zevinDev
+   */
+  isDrained() {
+    return this._ended && this.queuedBytes === 0;
+  }
+
+  /**
+   * Whether the producer has finished.
+   *
+   * @returns {boolean} True after end().
+   * @author zevinDev
+   */
+  endOfStream() {
+    return this._ended;
+  }
+
+  /**
+   * Register a callback for when space frees up (used to resume a paused producer).
+   *
+   * @param {Function|null} callback - Called after reads.
+   * @author zevinDev
+   */
+  onDrain(callback) {
+    this._onDrain = callback;
+  }
+
+  /**
+   * Release the queued data (native blocks go back to the pool).
+   *
+   * @author zevinDev
+   */
+  destroy() {
+    if (this._id !== null) {
+      this._portaudio.destroyPrebuffer(this._id);
+      this._id = null;
+      this._portaudio = null;
+    }
+    this._chunks = [];
+    this._queued = 0;
+    this._onDrain = null;
+  }
+
+  /**
+   * Notify the producer that space was freed.
+   *
+   * @private
+   * @author zevinDev
+   */
+  _drained() {
+    this._onDrain?.();
+  }
+}
+
+/**
+ * Feed a readable PCM stream into a prebuffer, pausing the readable at the cap and
+ * resuming once the consumer has taken half of it.
+ *
+ * @param {import('stream').Readable} readable - PCM source (e.g. ffmpeg stdout).
+ * @param {PcmPrebuffer} prebuffer - Destination prebuffer.
+ * @returns {{ hasPending: Function, stop: Function }} Pump control handle.
+ * @author zevinDev
+ */
+export function pipeToPrebuffer(readable, prebuffer) {
+  let pending = null;
+  let stopped = false;
+  const resumeBelow = prebuffer.capacityBytes / 2;
+
+  const flush = () => {
+    if (pending) {
+      const n = prebuffer.write(pending);
+      pending = n < pending.length ? pending.subarray(n) : null;
+    }
+    if (!pending) readable.resume();
+  };
+
+  prebuffer.onDrain(() => {
+    if (!stopped && pending && prebuffer.queuedBytes <= resumeBelow) flush();
+  });
+
+  const onData = chunk => {
+    const n = prebuffer.write(chunk);
+    if (n < chunk.length) {
+      pending = chunk.subarray(n);
+      readable.pause();
+    }
+  };
+  const onEnd = () => {
+    // The last chunk may still be pending; end() once it is in
+    const finish = () => {
+      if (stopped) return;
+      if (pending) {
+        setTimeout(finish, 10);
+        return;
+      }
+      prebuffer.end();
+    };
+    finish();
+  };
+  readable.on('data', onData);
+  readable.once('end', onEnd);
+
+  return {
+    hasPending: () => pending !== null,
+    stop: () => {
+      stopped = true;
+      pending = null;
+      prebuffer.onDrain(null);
+      readable.off('data', onData);
+      readable.off('end', onEnd);
+    }
+  };
+}
@@ -0,0 +1,281 @@
+/**
+ * @module RingBuffer
+ * @author zevinDev
+ * @description JavaScript producer side of the native lock-free PCM ring buffer
+ */
+
+// Keep in sync with native/ring_buffer.h
+const RING_HEADER_BYTES = 256;
+const WRITE_INDEX_SLOT = 0;
+const READ_INDEX_SLOT = 16;
+const FLAGS_SLOT = 32;
+const RETAIN_SLOT = 48;
+const RING_FLAG_END_OF_STREAM = 1;
+
+/**
+ * Producer for a ring-mode PortAudio stream.
+ * Writes PCM bytes straight into the ring's ArrayBuffer and publishes them with Atomics,
+ * so the native audio callback never has to wait for the event loop.
+ *
+ * @class
+ * @author zevinDev
+ * @example
+ * const streamId = portaudio.openStreamAsync({ device: 0, channels: 2, sampleRate: 48000 });
+ * const ring = new PcmRingWriter(portaudio.getStreamRing(streamId), 2 * 4);
+ * ring.write(pcmChunk);
+ */
+export class PcmRingWriter {
+  /**
+   * @param {ArrayBuffer} arrayBuffer - Ring storage returned by portaudio.getStreamRing().
+   * @param {number} bytesPerFrame - Size of one interleaved frame in bytes.
+   */
+  constructor(arrayBuffer, bytesPerFrame) {
+    this._header = new Int32Array(arrayBuffer, 0, RING_HEADER_BYTES / 4);
+    this._data = new Uint8Array(arrayBuffer, RING_HEADER_BYTES);
+    this._capacity = this._data.length;
+    this._mask = this._capacity - 1;
+    this._bytesPerFrame = bytesPerFrame;
+    // Consumed bytes the native side keeps behind the read index for seeking back
+    this._retain = Atomics.load(this._header, RETAIN_SLOT) >>> 0;
+    this._lastReadIndex = Atomics.load(this._header, READ_INDEX_SLOT) >>> 0;
+    this._consumedBytes = 0;
+  }
+
+  /**
+   * Size of one interleaved frame in bytes.
+   *
+   * @returns {number} Bytes per frame.
+   * @author zevinDev
+   */
+  get bytesPerFrame() {
+    return this._bytesPerFrame;
+  }
+
+  /**
+   * Number of bytes currently queued in the ring.
+   *
+   * @returns {number} Queued bytes.
+   * @author zevinDev
+   */
+  readAvailable() {
+    return (Atomics.load(this._header, WRITE_INDEX_SLOT) - Atomics.load(this._header, READ_INDEX_SLOT)) >>> 0;
+  }
+
+  /**
+   * Number of bytes that can be written without overwriting unread data.
+   *
+   * @returns {number} Free bytes.
+   * @author zevinDev
+   */
+  writeAvailable() {
+    return Math.max(this._capacity - this._retain - this.readAvailable(), 0);
+  }
+
+  /**
+   * Number of already consumed bytes still held behind the read index, i.e. how far
+   * the native side can seek back without new data.
+   *
+   * @returns {number} Retained bytes.
+   * @author zevinDev
+   */
+  historyAvailable() {
+    return Math.min(this._capacity - this.readAvailable(), this._retain, this.consumedBytes());
+  }
+
+  /**
+   * Whether the ring holds less than one whole frame.
+   *
+   * @returns {boolean} True if the consumer has nothing left to play.
+   * @author zevinDev
+   */
+  isDrained() {
+    return this.readAvailable() < this._bytesPerFrame;
+  }
+
+  /**
+   * Copy as much of a PCM chunk into the ring as fits.
+   *
+   * @param {Buffer|Uint8Array|Float32Array} chunk - PCM data in the stream's sample format.
+   * @returns {number} Number of bytes accepted (may be less than chunk.byteLength).
+   * @author zevinDev
+   */
+  write(chunk) {
+    const bytes = chunk instanceof Uint8Array
+      ? chunk
+      : new Uint8Array(chunk.buffer, chunk.byteOffset, chunk.byteLength);
+    const w = Atomics.load(this._header, WRITE_INDEX_SLOT) >>> 0;
+    const used = (w - (Atomics.load(this._header, READ_INDEX_SLOT) >>> 0)) >>> 0;
+    const n = Math.min(bytes.length, Math.max(this._capacity - this._retain - used, 0));
+    if (n === 0) return 0;
+    const pos = w & this._mask;
+    const first = Math.min(n, this._capacity - pos);
+    this._data.set(bytes.subarray(0, first), pos);
+    if (n > first) {
+      this._data.set(bytes.subarray(first, n), 0);
+    }
+    Atomics.store(this._header, WRITE_INDEX_SLOT, (w + n) | 0);
+    return n;
+  }
+
+  /**
+   * Mark the end of the producer's data.
+   *
+   * @author zevinDev
+   */
+  end() {
+    Atomics.or(this._header, FLAGS_SLOT, RING_FLAG_END_OF_STREAM);
+  }
+
+  /**
+   * Whether the producer (JS or a native pipe reader) has marked the end of its data.
+   *
+   * @returns {boolean} True once no more data will be written.
+   * @author zevinDev
+   */
+  endOfStream() {
+    return (Atomics.load(this._header, FLAGS_SLOT) & RING_FLAG_END_OF_STREAM) !== 0;
+  }
+
+  /**
+   * Total bytes consumed by the audio callback since this writer was created (in-place
+   * seeks move it back and forth). Must be polled at least once per 2 GiB of audio to
+   * account for index wrap-around.
+   *
+   * @returns {number} Consumed bytes.
+   * @author zevinDev
+   */
+  consumedBytes() {
+    const r = Atomics.load(this._header, READ_INDEX_SLOT) >>> 0;
+    this._consumedBytes += (r - this._lastReadIndex) | 0;
+    this._lastReadIndex = r;
+    return this._consumedBytes;
+  }
+}
+
+/**
+ * Consumer for a native capture ring (duplex input or loopback of the output mix).
+ * The audio callback appends interleaved float32 frames; read() drains everything
+ * queued in one copy, so polling every few hundred milliseconds is enough.
+ *
+ * @class
+ * @author zevinDev
+ * @example
+ * const capture = portaudio.getCaptureRing(streamId);
+ * const reader = new PcmRingReader(capture.buffer, capture.channels);
+ * setInterval(() => encoder.write(reader.read()), 250);
+ */
+export class PcmRingReader {
+  /**
+   * @param {ArrayBuffer} arrayBuffer - Ring storage from portaudio.getCaptureRing().buffer.
+   * @param {number} channels - Interleaved channels per frame.
+   */
+  constructor(arrayBuffer, channels) {
+    this._header = new Int32Array(arrayBuffer, 0, RING_HEADER_BYTES / 4);
+    this._data = new Uint8Array(arrayBuffer, RING_HEADER_BYTES);
+    this._capacity = this._data.length;
+    this._mask = this._capacity - 1;
+    this._channels = channels;
+    this._bytesPerFrame = channels * 4;
+  }
+
+  /**
+   * Interleaved channels per frame.
+   *
+   * @returns {number} Channel count.
+   * @author zevinDev
+   */
+  get channels() {
+    return this._channels;
+  }
+
+  /**
+   * Number of whole frames waiting to be read.
+   *
+   * @returns {number} Queued frames.
+   * @author zevinDev
+   */
+  framesAvailable() {
+    const used = (Atomics.load(this._header, WRITE_INDEX_SLOT) - Atomics.load(this._header, READ_INDEX_SLOT)) >>> 0;
+    return Math.floor(used / this._bytesPerFrame);
+  }
+
+  /**
+   * Take up to `maxFrames` frames out of the ring.
+   *
+   * @param {number} [maxFrames=Infinity] - Most frames to read.
+   * @returns {Float32Array} Interleaved samples (empty when nothing was queued).
+   * @author zevinDev
+   */
+  read(maxFrames = Infinity) {
+    const r = Atomics.load(this._header, READ_INDEX_SLOT) >>> 0;
+    const frames = Math.min(this.framesAvailable(), maxFrames);
+    const n = frames * this._bytesPerFrame;
+    const out = new Float32Array(frames * this._channels);
+    if (n === 0) return out;
+    const bytes = new Uint8Array(out.buffer);
+    const pos = r & this._mask;
+    const first = Math.min(n, this._capacity - pos);
+    bytes.set(this._data.subarray(pos, pos + first), 0);
+    if (n > first) {
+      bytes.set(this._data.subarray(0, n - first), first);
+    }
+    Atomics.store(this._header, READ_INDEX_SLOT, (r + n) | 0);
+    return out;
+  }
+}
+
+/**
+ * Feed a readable PCM stream into a ring, pausing the readable while the ring is full.
+ *
+ * @param {import('stream').Readable} readable - PCM source (e.g. ffmpeg stdout).
+ * @param {PcmRingWriter} ring - Destination ring.
+ * @param {object} [options] - Pump options.
+ * @param {number} [options.intervalMs=10] - How often to retry a pending chunk while the ring is full.
+ * @param {Function} [options.onChunk] - Called with every chunk as it arrives (e.g. visualization).
+ * @returns {{ hasPending: Function, stop: Function }} Pump control handle.
+ * @author zevinDev
+ */
+export function pipeToRing(readable, ring, { intervalMs = 10, onChunk } = {}) {
+  let pending = null;
+  let timer = null;
+
+  const flush = () => {
+    const n = ring.write(pending);
+    pending = n < pending.length ? pending.subarray(n) : null;
+    if (!pending) {
+      clearInterval(timer);
+      timer = null;
+      readable.resume();
+    }
+  };
+
+  const onData = chunk => {
+    if (onChunk) {
+      try { onChunk(chunk); } catch (error) {
+        console.warn('[RingBuffer] onChunk callback error:', error.message);
+      }
+    }
+    if (pending) {
+      pending = Buffer.concat([pending, chunk]);
+      return;
+    }
+    const n = ring.write(chunk);
+    if (n < chunk.length) {
+      pending = chunk.subarray(n);
+      readable.pause();
+      if (!timer) timer = setInterval(flush, intervalMs);
+    }
+  };
+
+  readable.on('data', onData);
+
+  return {
+    hasPending: () => pending !== null,
+    stop: () => {
+      readable.off('data', onData);
+      if (timer) clearInterval(timer);
+      timer = null;
+      pending = null;
+    }
+  };
+}
@@ -0,0 +1,93 @@
+/**
+ * @module StreamClock
+ * @author zevinDev
+ * @description Reader for the native sample-accurate playback clock
+ */
+
+// Keep in sync with native/stream_clock.h
+const SEQUENCE_SLOT = 0;
+const FRAMES_RENDERED_SLOT = 1;
+const FRAMES_DELIVERED_SLOT = 2;
+const FRAMES_AT_DAC_SLOT = 3;
+const DAC_TIME_SLOT = 4;
+const CALLBACK_TIME_SLOT = 5;
+const SAMPLE_RATE_SLOT = 6;
+const CALLBACKS_SLOT = 7;
+const CLOCK_SLOTS = 8;
+
+/**
+ * Playback clock published by the native audio callback.
+ * Reads the counters straight out of the stream's clock ArrayBuffer, so it can be
+ * sampled as often as needed (e.g. every animation frame) without calling into the addon.
+ *
+ * @class
+ * @author zevinDev
+ * @example
+ * const clock = new StreamClock(portaudio.getStreamClock(streamId), () => portaudio.getStreamTime(streamId));
+ * const seconds = clock.audibleFrames() / clock.snapshot().sampleRate;
+ */
+export class StreamClock {
+  /**
+   * @param {ArrayBuffer} arrayBuffer - Clock storage returned by portaudio.getStreamClock().
+   * @param {Function} [getStreamTime] - Returns the current stream time; used to interpolate between callbacks.
+   */
+  constructor(arrayBuffer, getStreamTime = null) {
+    this._words = new BigUint64Array(arrayBuffer, 0, CLOCK_SLOTS);
+    this._doubles = new Float64Array(arrayBuffer, 0, CLOCK_SLOTS);
+    this._getStreamTime = getStreamTime;
+  }
+
+  /**
+   * Consistent copy of the clock counters.
+   *
+   * @returns {{framesRendered: number, framesDelivered: number, framesAtDac: number, dacTime: number, callbackTime: number, sampleRate: number, callbacks: number}} Clock state.
+   * @author zevinDev
+   */
+  snapshot() {
+    // Seqlock: retry while the callback is mid-update or updated during the read
+    for (;;) {
+      const seq = Atomics.load(this._words, SEQUENCE_SLOT);
+      if (seq & 1n) continue;
+      const snapshot = {
+        framesRendered: Number(this._words[FRAMES_RENDERED_SLOT]),
+        framesDelivered: Number(this._words[FRAMES_DELIVERED_SLOT]),
+        framesAtDac: Number(this._words[FRAMES_AT_DAC_SLOT]),
+        dacTime: this._doubles[DAC_TIME_SLOT],
+        callbackTime: this._doubles[CALLBACK_TIME_SLOT],
+        sampleRate: this._doubles[SAMPLE_RATE_SLOT],
+        callbacks: Number(this._words[CALLBACKS_SLOT])
+      };
+      if (Atomics.load(this._words, SEQUENCE_SLOT) === seq) return snapshot;
+    }
+  }
+
+  /**
+   * Number of delivered frames that have reached the DAC.
+   * Uses the current stream time when a getter was supplied, otherwise the time of
+   * the latest callback (so the result then trails by at most one buffer).
+   *
+   * @param {object} [snapshot] - Clock state from snapshot(); read fresh when omitted.
+   * @returns {number} Audible frames.
+   * @author zevinDev
+   */
+  audibleFrames(snapshot = this.snapshot()) {
+    const { framesDelivered, framesAtDac, dacTime, callbackTime, sampleRate } = snapshot;
+    if (snapshot.callbacks === 0) return 0;
+    // Hosts that cannot report DAC times leave them at 0; assume no output latency then
+    if (!dacTime) return framesDelivered;
+    const now = this._getStreamTime ? this._getStreamTime() : callbackTime;
+    const frames = framesAtDac + Math.round((now - dacTime) * sampleRate);
+    return Math.min(Math.max(frames, 0), framesDelivered);
+  }
+
+  /**
+   * Number of delivered frames still queued in the device (handed over but not yet audible).
+   *
+   * @returns {number} Pending frames.
+   * @author zevinDev
+   */
+  pendingFrames() {
+    const snapshot = this.snapshot();
+    return snapshot.framesDelivered - this.audibleFrames(snapshot);
+  }
+}
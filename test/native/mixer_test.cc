@@ -0,0 +1,140 @@
+// Mixer unit tests: build and run with `npm run test:native` (needs a C++17 compiler;
+// only the PortAudio headers are used, not the library).
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <stdlib.h>
+#include <unistd.h>
+#include "mixer.h"
+#include "wav_decoder.h"
+
+static int g_failures = 0;
+
+#define EXPECT(cond, ...)                               \
+  do                                                    \
+  {                                                     \
+    if (!(cond))                                        \
+    {                                                   \
+      std::printf("FAIL %s:%d: ", __FILE__, __LINE__);  \
+      std::printf(__VA_ARGS__);                         \
+      std::printf("\n");                                \
+      ++g_failures;                                     \
+    }                                                   \
+  } while (0)
+
+static const int kChannels = 2;
+static const uint32_t kRingCapacity = 1 << 16;
+
+// A voice of `mixer` reading from `storage`, filled with `frames` of silence
+static void StartSilentVoice(Mixer &mixer, int index, std::vector<uint8_t> &storage, uint32_t bytesPerFrame, uint32_t frames)
+{
+  storage.assign(kRingHeaderBytes + kRingCapacity, 0);
+  MixerVoice &v = mixer.Voice(index);
+  v.ring.Attach(storage.data(), kRingCapacity);
+  mixer.SetVoiceRate(index, 48000.0, 48000.0, 0);
+  v.envelope.Reset(1.0f);
+  v.prefillFrames = 0;
+  std::vector<uint8_t> silence(frames * bytesPerFrame, 0);
+  v.ring.Write(silence.data(), static_cast<uint32_t>(silence.size()));
+  v.state.store(kVoiceActive, std::memory_order_release);
+}
+
+// Silence in gives silence out, whatever was in the output buffer before
+static void TestSilence(PaSampleFormat format, const char *name)
+{
+  const uint32_t frames = 3 * kMixBlockFrames / 2;
+  Mixer mixer;
+  mixer.Configure(kChannels, format);
+  std::vector<uint8_t> storage;
+  StartSilentVoice(mixer, 0, storage, kChannels * BytesPerSample(format), frames);
+  std::vector<float> out(frames * kChannels, 0.75f);
+  mixer.Render(out.data(), frames);
+  uint32_t dirty = 0;
+  for (float sample : out)
+    dirty += sample != 0.0f;
+  EXPECT(dirty == 0, "%s: %u of %zu output samples not silent", name, dirty, out.size());
+}
+
+// Write a 16-bit stereo WAVE file of `frames` constant nonzero frames; returns its fd
+static int WriteWavFile(uint32_t frames)
+{
+  char path[] = "/tmp/mixer_test_XXXXXX";
+  int fd = mkstemp(path);
+  unlink(path);
+  const uint32_t dataBytes = frames * 4;
+  std::vector<uint8_t> file(44 + dataBytes);
+  auto le32 = [&](size_t at, uint32_t v) { std::memcpy(&file[at], &v, 4); };
+  auto le16 = [&](size_t at, uint16_t v) { std::memcpy(&file[at], &v, 2); };
+  std::memcpy(&file[0], "RIFF", 4);
+  le32(4, 36 + dataBytes);
+  std::memcpy(&file[8], "WAVEfmt ", 8);
+  le32(16, 16);
+  le16(20, 1);
+  le16(22, 2);
+  le32(24, 48000);
+  le32(28, 48000 * 4);
+  le16(32, 4);
+  le16(34, 16);
+  std::memcpy(&file[36], "data", 4);
+  le32(40, dataBytes);
+  for (uint32_t i = 0; i < frames * 2; ++i)
+    le16(44 + i * 2, 8192);
+  EXPECT(write(fd, file.data(), file.size()) == static_cast<ssize_t>(file.size()), "cannot write the WAVE file");
+  return fd;
+}
+
+// A ring whose free space never reaches a whole decode block still plays to the end
+static void TestSmallRingDecode()
+{
+  const uint32_t frames = 20000;
+  const uint32_t ringBytes = 4096; // 512 float stereo frames, half of them retained
+  int fd = WriteWavFile(frames);
+  std::vector<uint8_t> head(44);
+  EXPECT(pread(fd, head.data(), head.size(), 0) == 44, "cannot read the WAVE header");
+  WavFormat format;
+  EXPECT(ParseWavHeader(head.data(), head.size(), 44 + frames * 4, &format), "WAVE header not parsed");
+  Mixer mixer;
+  mixer.Configure(kChannels, paFloat32);
+  std::vector<uint8_t> storage(kRingHeaderBytes + ringBytes, 0);
+  MixerVoice &v = mixer.Voice(0);
+  v.ring.Attach(storage.data(), ringBytes);
+  v.ring.SetRetain(ringBytes / 2);
+  mixer.SetVoiceRate(0, 48000.0, 48000.0, 0);
+  v.envelope.Reset(1.0f);
+  v.prefillFrames = 0;
+  v.state.store(kVoiceActive, std::memory_order_release);
+  std::atomic<bool> stop{false};
+  std::thread decoder(WavDecoderLoop, &v.ring, &stop, fd, format, uint64_t{0}, paFloat32, kChannels);
+  std::vector<float> out(256 * kChannels);
+  uint32_t played = 0;
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!v.finished.load() && std::chrono::steady_clock::now() < deadline)
+  {
+    mixer.Render(out.data(), 256);
+    for (uint32_t i = 0; i < out.size(); i += kChannels)
+      played += out[i] != 0.0f;
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  stop.store(true);
+  decoder.join();
+  EXPECT(v.finished.load(), "small ring: voice never reached end-of-stream (%u of %u frames played)", played, frames);
+  EXPECT(played == frames, "small ring: %u of %u frames played", played, frames);
+}
+
+int main()
+{
+  TestSilence(paFloat32, "float32");
+  TestSilence(paInt16, "int16");
+  TestSilence(paInt24, "int24");
+  TestSilence(paInt32, "int32");
+  TestSmallRingDecode();
+  if (g_failures > 0)
+  {
+    std::printf("%d failure(s)\n", g_failures);
+    return 1;
+  }
+  std::printf("OK\n");
+  return 0;
+}
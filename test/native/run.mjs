@@ -0,0 +1,34 @@
+/**
+ * @file Builds and runs the native unit tests (test/native/*_test.cc) with the system
+ * C++ compiler ($CXX, default c++). They only use the headers under native/.
+ * @author zevinDev
+ *
+ *   npm run test:native
+ */
+
+import { execFileSync } from 'child_process';
+import fs from 'fs';
+import path from 'path';
+import { fileURLToPath } from 'url';
+
+const __dirname = path.dirname(fileURLToPath(import.meta.url));
+const ROOT = path.join(__dirname, '../..');
+const OUT_DIR = path.join(ROOT, 'build/test');
+const CXX = process.env.CXX || 'c++';
+
+fs.mkdirSync(OUT_DIR, { recursive: true });
+let failed = 0;
+for (const source of fs.readdirSync(__dirname).filter(file => file.endsWith('_test.cc'))) {
+  const binary = path.join(OUT_DIR, path.basename(source, '.cc'));
+  try {
+    execFileSync(CXX, ['-std=c++17', '-O0', '-g', '-Wall', '-Wextra',
+      '-I', path.join(ROOT, 'native'), '-I', path.join(ROOT, 'native/include'),
+      path.join(__dirname, source), '-o', binary], { stdio: 'inherit' });
+    execFileSync(binary, { stdio: 'inherit' });
+    console.log(`PASS ${source}`);
+  } catch {
+    failed++;
+    console.error(`FAIL ${source}`);
+  }
+}
+process.exit(failed > 0 ? 1 : 0);
@@ -0,0 +1,52 @@
+/**
+ * @file Import smoke test: every module under src/ must parse, and the package entry must
+ * load and export the classes declared in src/index.d.ts. Needs no audio hardware or
+ * native addon (the binding is only loaded on first use).
+ * @author zevinDev
+ *
+ *   node test/smoke.mjs
+ */
+
+import fs from 'fs';
+import path from 'path';
+import { fileURLToPath, pathToFileURL } from 'url';
+
+const __dirname = path.dirname(fileURLToPath(import.meta.url));
+const SRC_DIR = path.join(__dirname, '../src');
+
+function listModules(dir) {
+  return fs.readdirSync(dir, { withFileTypes: true }).flatMap(entry => {
+    const file = path.join(dir, entry.name);
+    if (entry.isDirectory()) return listModules(file);
+    return entry.name.endsWith('.js') ? [file] : [];
+  });
+}
+
+let failures = 0;
+for (const file of listModules(SRC_DIR)) {
+  try {
+    await import(pathToFileURL(file).href);
+  } catch (error) {
+    failures++;
+    console.error(`FAIL ${path.relative(SRC_DIR, file)}: ${error.message}`);
+  }
+}
+
+const declarations = fs.readFileSync(path.join(SRC_DIR, 'index.d.ts'), 'utf8');
+const declared = [...declarations.matchAll(/^export class (\w+)/gm)].map(match => match[1]);
+const entry = await import(pathToFileURL(path.join(SRC_DIR, 'index.js')).href).catch(error => {
+  console.error(`FAIL index.js: ${error.message}`);
+  return {};
+});
+for (const name of declared) {
+  if (typeof entry[name] !== 'function') {
+    failures++;
+    console.error(`FAIL index.js does not export ${name}`);
+  }
+}
+
+if (failures > 0) {
+  console.error(`${failures} failure(s)`);
+  process.exit(1);
+}
+console.log(`OK: ${declared.length} exports`);